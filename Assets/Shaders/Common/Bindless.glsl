@@ -0,0 +1,25 @@
+// material table of the bindless path, see FrameGraph::BindlessMaterials
+// requires GL_EXT_nonuniform_qualifier for the runtime sized array, enable it right after #version
+
+#ifndef BINDLESS_INCLUDED
+#define BINDLESS_INCLUDED
+
+struct BindlessMaterial
+{
+    vec4 baseColorFactor;
+    float roughness;
+    float metallic;
+    uint baseColorTex;
+    uint normalMap;
+    uint metallicRoughnessMap;
+    uint emissiveMap;
+    uint padding0;
+    uint padding1;
+};
+
+layout(set = SET_MATERIAL, binding = 0) uniform sampler2D bindlessTextures[];
+layout(set = SET_MATERIAL, binding = 1) readonly buffer BindlessMaterials
+{
+    BindlessMaterial materials[];
+} bindlessMaterials;
+#endif
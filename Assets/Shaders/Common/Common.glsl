@@ -9,10 +9,18 @@
 #define SET_MATERIAL 2
 #define SET_OBJECT 3
 #define MAX_LIGHT_COUNT 32
+#define MAX_SHADOW_CASCADES 4
 
 layout( push_constant ) uniform Transform
 {
     mat4 model;
+#if G_BINDLESS
+    uint materialIndex;
+#endif
+#if G_SHADOW_CASCADE
+    // the cascade of the shadow map being drawn
+    uint shadowCascade;
+#endif
 } pconst;
 
 layout(set = SET_GLOBAL, binding = 0) uniform SceneInfo
@@ -24,9 +32,31 @@ layout(set = SET_GLOBAL, binding = 0) uniform SceneInfo
     mat4 worldToShadow;
     vec4 lightCount; // x: lightCount
     vec4 shadowMapSize;
+    vec4 shadowCascades; // x: cascade count
+    // view space distance every cascade ends at
+    vec4 shadowCascadeSplits;
+    mat4 worldToShadowCascades[MAX_SHADOW_CASCADES];
     Light lights[MAX_LIGHT_COUNT];
 } scene;
 
+#if G_INSTANCING
+// transforms of the draw list, see FrameGraph::SceneInstances
+layout(set = SET_GLOBAL, binding = 6) readonly buffer SceneInstances
+{
+    mat4 models[];
+} sceneInstances;
+// the transform of every instance, a draw's instances are consecutive from firstInstance. GPU culled draws only have
+// their visible instances
+layout(set = SET_GLOBAL, binding = 7) readonly buffer SceneInstanceIndices
+{
+    uint indices[];
+} sceneInstanceIndices;
+// only valid in vertex shaders
+#define OBJECT_MODEL sceneInstances.models[sceneInstanceIndices.indices[gl_InstanceIndex]]
+#else
+#define OBJECT_MODEL pconst.model
+#endif
+
 #define shadowMapSampler shadowMapSampler_sampler_linear
 #define shadowMap shadowMap_sampler_linear
 
@@ -40,6 +70,24 @@ layout(set = SET_GLOBAL, binding = 4) uniform samplerShadow shadowMapSampler;
 #endif
 layout(set = SET_GLOBAL, binding = 5) uniform samplerCube environmentMap;
 
+// The shadow map coordinate of a world space position, the uv in xy and the depth in z. The cascades are side by side
+// in the shadow map, the first one that ends beyond the position's view depth is used. w is 0 when the position is
+// outside of the shadow map
+vec4 ShadowCoord(vec3 positionWS)
+{
+    float viewDepth = -(scene.view * vec4(positionWS, 1)).z;
+    int cascadeCount = int(scene.shadowCascades.x);
+    int cascade = 0;
+    while (cascade < cascadeCount - 1 && viewDepth > scene.shadowCascadeSplits[cascade])
+        cascade += 1;
+
+    vec4 positionCS = scene.worldToShadowCascades[cascade] * vec4(positionWS, 1);
+    vec3 coord = positionCS.xyz / positionCS.w;
+    vec2 uv = coord.xy * 0.5 + 0.5;
+    bool inside = uv.x > 0 && uv.x < 1 && uv.y > 0 && uv.y < 1 && viewDepth <= scene.shadowCascadeSplits[cascade];
+    return vec4((uv.x + cascade) / cascadeCount, uv.y, coord.z, inside ? 1 : 0);
+}
+
 #if G_PCF
 float PcfShadow(vec2 shadowCoord, float objShadowDepth)
 {
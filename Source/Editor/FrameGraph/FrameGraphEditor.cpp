@@ -151,6 +151,73 @@ void FrameGraphEditor::Draw(ax::NodeEditor::EditorContext* context, FrameGraph::
         graph->ReportValidation();
     }
     ImGui::SameLine();
+    if (ImGui::Button("Queue Timeline"))
+    {
+        ImGui::OpenPopup("Queue Timeline");
+    }
+    if (ImGui::BeginPopup("Queue Timeline"))
+    {
+        auto timeline = graph->GetQueueTimeline();
+        if (!graph->IsCompiled() || timeline.empty())
+        {
+            ImGui::Text("Compile the graph to see which queue its passes run on");
+        }
+        else if (ImGui::BeginTable("Queues", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Main");
+            ImGui::TableSetupColumn("Async Compute");
+            ImGui::TableHeadersRow();
+            for (auto& entry : timeline)
+            {
+                ImGui::TableNextRow();
+                if (entry.join)
+                {
+                    // the main queue waits here for the async compute work recorded so far
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextDisabled("wait for async compute");
+                    ImGui::TableNextRow();
+                }
+                ImGui::TableSetColumnIndex(entry.queue == QueueType::AsyncCompute ? 1 : 0);
+                ImGui::TextUnformatted(entry.name.c_str());
+            }
+            ImGui::EndTable();
+        }
+        ImGui::EndPopup();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("GPU Timings"))
+    {
+        ImGui::OpenPopup("GPU Timings");
+    }
+    if (ImGui::BeginPopup("GPU Timings"))
+    {
+        auto timings = graph->GetPassTimings();
+        if (!graph->IsCompiled() || timings.empty())
+        {
+            ImGui::Text("No timings yet, the graph has to run a few frames on a device with timestamp queries");
+        }
+        else if (ImGui::BeginTable("Timings", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Pass");
+            ImGui::TableSetupColumn("Queue");
+            ImGui::TableSetupColumn("GPU ms");
+            ImGui::TableHeadersRow();
+            for (auto& timing : timings)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::TextUnformatted(timing.name.c_str());
+                ImGui::TableSetColumnIndex(1);
+                ImGui::TextUnformatted(timing.queue == QueueType::AsyncCompute ? "async compute" : "main");
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.3f", timing.gpuTime);
+            }
+            ImGui::EndTable();
+            ImGui::Text("Frame: %.3f ms", graph->GetGpuFrameTime());
+        }
+        ImGui::EndPopup();
+    }
+    ImGui::SameLine();
 
     Shader* s = graph->GetTemplateSceneShader();
     const char* templateShaderName = "Template Scene Shader";
@@ -164,6 +164,10 @@ public:
                 {
                     EditorState::selectedObject = mesh;
                 }
+                bool isStatic = meshRenderer.IsStatic();
+                if (ImGui::Checkbox("Static", &isStatic))
+                    meshRenderer.SetStatic(isStatic);
+
                 // show materials
                 ImGui::Text("Materials: ");
                 std::vector<Material*> mats = meshRenderer.GetMaterials();
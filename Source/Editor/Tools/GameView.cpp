@@ -251,6 +251,10 @@ bool GameView::Tick()
         {
             menuSelected = "Change Resolution";
         }
+        if (ImGui::MenuItem(dynamicResolution ? "Dynamic Resolution: On" : "Dynamic Resolution: Off"))
+        {
+            dynamicResolution = !dynamicResolution;
+        }
         ImGui::EndMenuBar();
     }
 
@@ -276,6 +280,21 @@ bool GameView::Tick()
         scene->SetMainCamera(gameCamera);
     }
 
+    if (scene)
+    {
+        if (FrameGraph::Graph* graph = scene->GetMainCamera()->GetFrameGraph())
+        {
+            // images sized relative to the output are recreated without compiling the graph again
+            graph->SetOutputSize({sceneImage->GetDescription().width, sceneImage->GetDescription().height});
+
+            // the frame time stands in for the GPU time on devices without timestamp queries
+            float gpuFrameTime = graph->GetGpuFrameTime();
+            if (dynamicResolution)
+                resolutionController.Update(gpuFrameTime > 0 ? gpuFrameTime : Time::DeltaTime() * 1000);
+            graph->SetRenderScale(dynamicResolution ? resolutionController.GetScale() : 1.0f);
+        }
+    }
+
     if (strcmp(menuSelected, "Change Resolution") == 0)
     {
         ImGui::OpenPopup("Change Resolution");
@@ -2,6 +2,7 @@
 #include "../Tool.hpp"
 #include "Core/Scene/Scene.hpp"
 #include "Core/Scene/SceneManager.hpp"
+#include "Rendering/DynamicResolution.hpp"
 
 namespace Engine::Editor
 {
@@ -34,6 +35,8 @@ private:
     std::unique_ptr<GameObject> editorCameraGO;
     Gfx::Image* graphOutputImage = nullptr;
     bool useViewCamera = true;
+    bool dynamicResolution = false;
+    DynamicResolution resolutionController;
 
     struct
     {
@@ -1,5 +1,6 @@
 #include "AssetDatabase.hpp"
 #include "Importers.hpp"
+#include "Rendering/FrameGraph/SceneInstances.hpp"
 #include <iostream>
 #include <spdlog/spdlog.h>
 namespace Engine
@@ -355,6 +356,8 @@ void AssetDatabase::LoadEngineInternal()
     f("31D454BF-3D2D-46C4-8201-80377D12E1D2", "Shaders/Game/ShadowMap.shad");
     f("57F37367-05D5-4570-AFBB-C4146042B31E", "Shaders/Game/SimpleLit.shad");
     f("0138F949-B23B-48F6-9C25-4138EB0A6A0C", "Shaders/Game/SurfelCube.shad");
+    ComputeShader* cullingShader =
+        (ComputeShader*)f("7C4B1E52-9A3D-4F86-B2E1-5D0C8A6F3E94", "Shaders/Game/CullInstances.comp");
     f("B307F24D-658B-4FE9-835E-5F11302E6B67", "Shaders/Game/PostProcess/FXAA.shad");
     f("6F2137D1-345A-40CE-B1BD-11585675D36D", "Shaders/Game/PostProcess/ReinhardToneMapping.shad");
     f("D2D2BB92-14F1-4C1C-B671-22EB78909BB5", "Shaders/Utils/CopyOnly.shad");
@@ -363,6 +366,7 @@ void AssetDatabase::LoadEngineInternal()
     f("32E85603-337B-4BB6-8F82-1B3051615D2C", "Models/ZArrow.glb");
 
     Shader::SetDefault(standardShader);
+    FrameGraph::SceneInstances::SetDefaultCullingShader(cullingShader);
 }
 
 void AssetDatabase::Assets::UpdateAssetData(AssetData* assetData)
@@ -28,6 +28,7 @@ public:
     {
         this->intensity = intensity;
     }
+    // a fixed box around the light, used when the frame graph doesn't fit shadow cascades to the camera
     glm::mat4 WorldToShadowMatrix();
 
     LightType GetLightType() const
@@ -7,21 +7,35 @@ namespace Engine
 DEFINE_OBJECT(MeshRenderer, "00412ED6-89D3-4DD3-9D56-754820250E78");
 MeshRenderer::MeshRenderer(GameObject* parent, Mesh* mesh, Material* material)
     : Component(parent), mesh(mesh), materials({material})
-{}
+{
+    BumpVersion();
+}
 
 MeshRenderer::MeshRenderer(GameObject* parent) : MeshRenderer(parent, nullptr, nullptr) {}
 
-MeshRenderer::MeshRenderer() : Component(nullptr), mesh(nullptr), materials(){};
+MeshRenderer::MeshRenderer() : Component(nullptr), mesh(nullptr), materials()
+{
+    BumpVersion();
+}
 
 void MeshRenderer::SetMesh(Mesh* mesh)
 {
     this->mesh = mesh;
     this->materials.resize(mesh->GetSubmeshes().size());
+    BumpVersion();
 }
 
 void MeshRenderer::SetMaterials(std::span<Material*> materials)
 {
     this->materials = std::vector<Material*>(materials.begin(), materials.end());
+    BumpVersion();
+}
+
+void MeshRenderer::BumpVersion()
+{
+    // shared by every renderer so that a new renderer doesn't reuse the version of a destroyed one
+    static uint64_t lastVersion = 0;
+    version = ++lastVersion;
 }
 
 Mesh* MeshRenderer::GetMesh()
@@ -40,12 +54,17 @@ void MeshRenderer::Serialize(Serializer* s) const
     Component::Serialize(s);
     s->Serialize("mesh", mesh);
     s->Serialize("materials", materials);
+    s->Serialize("isStatic", (uint32_t)isStatic);
 }
 void MeshRenderer::Deserialize(Serializer* s)
 {
     Component::Deserialize(s);
     s->Deserialize("mesh", mesh);
     s->Deserialize("materials", materials);
+    uint32_t staticFlag = 0;
+    s->Deserialize("isStatic", staticFlag);
+    isStatic = staticFlag;
+    BumpVersion();
 }
 
 std::unique_ptr<Component> MeshRenderer::Clone(GameObject& owner)
@@ -55,6 +74,7 @@ std::unique_ptr<Component> MeshRenderer::Clone(GameObject& owner)
     clone->mesh = mesh;
     clone->materials = materials;
     clone->aabb = aabb;
+    clone->isStatic = isStatic;
 
     return clone;
 }
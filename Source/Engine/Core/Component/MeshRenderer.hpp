@@ -23,6 +23,33 @@ public:
     Mesh* GetMesh();
     const std::vector<Material*>& GetMaterials();
 
+    // the level of detail that is drawn, picked every frame by the scene sort node
+    uint32_t GetLod() const
+    {
+        return lod;
+    }
+    void SetLod(uint32_t lod)
+    {
+        this->lod = lod;
+    }
+
+    // a static renderer doesn't move or change its mesh, its shadows are cached
+    bool IsStatic() const
+    {
+        return isStatic;
+    }
+    void SetStatic(bool isStatic)
+    {
+        this->isStatic = isStatic;
+        BumpVersion();
+    }
+
+    // changes whenever the mesh, the materials or IsStatic do, two renderers never share a version
+    uint64_t GetVersion() const
+    {
+        return version;
+    }
+
     void Serialize(Serializer* s) const override;
     void Deserialize(Serializer* s) override;
     std::unique_ptr<Component> Clone(GameObject& owner) override;
@@ -32,11 +59,16 @@ private:
     Mesh* mesh = nullptr;
     std::vector<Material*> materials = {};
     AABB aabb;
+    uint32_t lod = 0;
+    bool isStatic = false;
+    uint64_t version = 0;
     // UniPtr<Gfx::ShaderResource>
     // objectShaderResource; // TODO: should be an EDITABLE but we can't directly serialize a ShaderResource
 
     // we need shader to create a shader resource, but it's not known untill user set one.
     // this is a helper function to create objectShaderResource if it doesn't exist
     void TryCreateObjectShaderResource();
+
+    void BumpVersion();
 };
 } // namespace Engine
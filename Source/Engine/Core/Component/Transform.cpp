@@ -5,13 +5,24 @@
 namespace Engine
 {
 DEFINE_OBJECT(Transform, "5583B41B-9FB5-4706-829C-399D7221C789");
-Transform::Transform() : Component(nullptr) {}
+Transform::Transform() : Component(nullptr)
+{
+    BumpVersion();
+}
 Transform::Transform(GameObject* gameObject) : Component(gameObject)
 {
     position = glm::vec3(0, 0, 0);
     scale = glm::vec3(1, 1, 1);
     rotationEuler = glm::vec3(0, 0, 0);
     rotation = glm::quat(rotationEuler);
+    BumpVersion();
+}
+
+void Transform::BumpVersion()
+{
+    // shared by every transform so that a new transform doesn't reuse the version of a destroyed one
+    static uint64_t lastVersion = 0;
+    version = ++lastVersion;
 }
 
 const std::vector<Transform*>& Transform::GetChildren()
@@ -71,17 +82,20 @@ void Transform::SetRotation(const glm::vec3& rotation)
 {
     rotationEuler = rotation;
     this->rotation = glm::quat(rotation);
+    BumpVersion();
 }
 
 void Transform::SetRotation(const glm::quat& rotation)
 {
     this->rotation = rotation;
+    BumpVersion();
 }
 
 void Transform::SetPosition(const glm::vec3& position)
 {
     auto delta = position - this->position;
     this->position = position;
+    BumpVersion();
 
     for (Transform* tsm : children)
     {
@@ -92,6 +106,7 @@ void Transform::SetPosition(const glm::vec3& position)
 void Transform::SetScale(const glm::vec3& scale)
 {
     this->scale = scale;
+    BumpVersion();
 }
 
 const glm::vec3& Transform::GetPosition()
@@ -117,6 +132,7 @@ const glm::quat& Transform::GetRotationQuat() const
 void Transform::Translate(const glm::vec3& translate)
 {
     this->position += translate;
+    BumpVersion();
 
     for (Transform* tsm : children)
     {
@@ -152,6 +168,7 @@ void Transform::Deserialize(Serializer* s)
     s->Deserialize("scale", scale);
     s->Deserialize("parent", parent);
     s->Deserialize("children", children);
+    BumpVersion();
 }
 
 glm::vec3 Transform::GetForward()
@@ -181,6 +198,7 @@ void Transform::Rotate(float angle, glm::vec3 axis, RotationCoordinate coord)
     if (coord == RotationCoordinate::Self)
     {
         rotation = glm::rotate(rotation, angle, axis);
+        BumpVersion();
     }
     else if (coord == RotationCoordinate::Parent && parent != nullptr)
     {}
@@ -44,6 +44,12 @@ public:
     glm::mat4 GetModelMatrix() const;
     void SetModelMatrix(const glm::mat4& model);
 
+    // changes whenever the model matrix does, two transforms never share a version
+    uint64_t GetVersion() const
+    {
+        return version;
+    }
+
     void Serialize(Serializer* s) const override;
     void Deserialize(Serializer* s) override;
 
@@ -60,6 +66,9 @@ private:
 
     Transform* parent = nullptr;
     std::vector<Transform*> children;
+    uint64_t version = 0;
+
+    void BumpVersion();
 };
 
 } // namespace Engine
@@ -1,8 +1,10 @@
 #include "Mesh.hpp"
 #include "GfxDriver/GfxDriver.hpp"
 #include "Libs/GLB.hpp"
-#include "Rendering/ImmediateGfx.hpp"
+#include "Libs/MeshOptimizer.hpp"
+#include "Libs/MeshSimplifier.hpp"
 #include "Rendering/RenderPipeline.hpp"
+#include <algorithm>
 #include <filesystem>
 
 namespace Engine
@@ -29,46 +31,26 @@ Submesh::Submesh(
         vertexBufferSize += binding.byteSize;
     }
 
-    // create vertex buffer
-    Gfx::Buffer::CreateInfo bufCreateInfo;
-    bufCreateInfo.size = vertexBufferSize;
-    bufCreateInfo.usages = Gfx::BufferUsage::Vertex | Gfx::BufferUsage::Transfer_Dst;
-    bufCreateInfo.debugName = name.data();
-    gfxVertexBuffer = Gfx::GfxDriver::Instance()->CreateBuffer(bufCreateInfo);
-
-    // calculate index buffer size
-    std::size_t indexBufferSize = indexCount * (indexBufferType == Gfx::IndexBufferType::UInt16 ? 2 : 4);
-    bufCreateInfo.size = indexBufferSize;
-    bufCreateInfo.usages = Gfx::BufferUsage::Index | Gfx::BufferUsage::Transfer_Dst;
-    bufCreateInfo.debugName = name.data();
-    gfxIndexBuffer = Gfx::GfxDriver::Instance()->CreateBuffer(bufCreateInfo);
-    //
-    // bufCreateInfo.size = indexBufferSize + vertexBufferSize;
-    // bufCreateInfo.usages = Gfx::BufferUsage::Transfer_Src;
-    // bufCreateInfo.debugName = "mesh staging buffer";
-    // bufCreateInfo.visibleInCPU = true;
-    // auto stagingBuffer = Gfx::GfxDriver::Instance()->CreateBuffer(bufCreateInfo);
-
-    RenderPipeline::Singleton().UploadBuffer(*gfxVertexBuffer, vertexBuffer.get(), vertexBufferSize);
-    RenderPipeline::Singleton().UploadBuffer(*gfxIndexBuffer, indexBuffer.get(), indexBufferSize);
-
-    // memcpy(stagingBuffer->GetCPUVisibleAddress(), this->vertexBuffer.get(), vertexBufferSize);
-    // memcpy(
-    //     (uint8_t*)stagingBuffer->GetCPUVisibleAddress() + vertexBufferSize,
-    //     this->indexBuffer.get(),
-    //     indexBufferSize
-    // );
-    //
-    // ImmediateGfx::OnetimeSubmit(
-    //     [this, vertexBufferSize, indexBufferSize, &stagingBuffer](Gfx::CommandBuffer& cmd)
-    //     {
-    //         Gfx::BufferCopyRegion bufferCopyRegions[] = {{0, 0, vertexBufferSize}};
-    //         cmd.CopyBuffer(stagingBuffer, gfxVertexBuffer, bufferCopyRegions);
-    //
-    //         bufferCopyRegions[0] = {vertexBufferSize, 0, indexBufferSize};
-    //         cmd.CopyBuffer(stagingBuffer, gfxIndexBuffer, bufferCopyRegions);
-    //     }
-    // );
+    // the bindings' layout is arbitrary, so the vertex data is kept as bytes and bound at its offset
+    auto& arena = GeometryArena::Singleton();
+    vertexRange = arena.AllocateVertexBytes(vertexBufferSize);
+    for (auto& binding : this->bindings)
+    {
+        binding.byteOffset += vertexRange.GetOffset();
+    }
+
+    size_t indexByteSize = indexBufferType == Gfx::IndexBufferType::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    std::size_t indexBufferSize = indexCount * indexByteSize;
+    indexRange = arena.AllocateIndices(indexCount, indexBufferType);
+    firstIndex = indexRange.GetOffset() / indexByteSize;
+    lods = {{firstIndex, (uint32_t)indexCount, 0}};
+
+    // batched with the other uploads of the next frame instead of a submit per submesh
+    auto& pipeline = RenderPipeline::Singleton();
+    if (vertexRange.IsValid())
+        pipeline.UploadBuffer(*GetVertexBuffer(), this->vertexBuffer.get(), vertexBufferSize, vertexRange.GetOffset());
+    if (indexRange.IsValid())
+        pipeline.UploadBuffer(*GetIndexBuffer(), this->indexBuffer.get(), indexBufferSize, indexRange.GetOffset());
 };
 
 void Submesh::SetIndices(std::vector<uint32_t>&& indices)
@@ -107,94 +89,127 @@ void Submesh::Apply()
 {
     bindings.clear();
 
-    VertexBinding posBinding{
-        .byteOffset = 0,
-        .byteSize = positions.size() * sizeof(glm::vec3),
-        .name = "position",
-    };
-
-    VertexBinding attrBinding{
-        .byteOffset = posBinding.byteSize,
-        .byteSize = attributes.GetSize(),
-        .name = "attributes",
-    };
+    auto& arena = GeometryArena::Singleton();
+    std::vector<GeometryArena::Write> writes;
 
-    bindings.push_back(posBinding);
-    bindings.push_back(attrBinding);
-
-    // calculate vertex buffer size
-    std::size_t vertexBufferSize = 0;
-    for (auto& binding : this->bindings)
+    uint32_t vertexCount = positions.size();
+    size_t positionDataSize = vertexCount * sizeof(glm::vec3);
+    std::vector<uint8_t> attributeData = attributes.GetData();
+    size_t attributeDataSize = attributeData.size();
+    if (vertexCount != 0 && attributeDataSize % vertexCount == 0)
     {
-        vertexBufferSize += binding.byteSize;
+        // positions and interleaved attributes are the two streams of a shared layout
+        uint32_t attributeStride = attributeDataSize / vertexCount;
+        uint32_t strides[] = {sizeof(glm::vec3), attributeStride};
+        vertexRange = arena.AllocateVertices(strides, vertexCount);
+        vertexOffset = vertexRange.GetOffset();
+
+        uint64_t positionOffset = vertexRange.GetStreamOffset(0);
+        uint64_t attributeOffset = vertexRange.GetStreamOffset(1);
+        bindings.push_back({positionOffset, positionDataSize, "position"});
+        bindings.push_back({attributeOffset, attributeDataSize, "attributes"});
+        writes.push_back({
+            GetVertexBuffer(),
+            positionOffset + vertexOffset * sizeof(glm::vec3),
+            positions.data(),
+            positionDataSize,
+        });
+        writes.push_back({
+            GetVertexBuffer(),
+            attributeOffset + vertexOffset * attributeStride,
+            attributeData.data(),
+            attributeDataSize,
+        });
+    }
+    else
+    {
+        vertexRange = arena.AllocateVertexBytes(positionDataSize + attributeDataSize);
+        vertexOffset = 0;
+
+        uint64_t offset = vertexRange.GetOffset();
+        bindings.push_back({offset, positionDataSize, "position"});
+        bindings.push_back({offset + positionDataSize, attributeDataSize, "attributes"});
+        writes.push_back({GetVertexBuffer(), offset, positions.data(), positionDataSize});
+        writes.push_back({GetVertexBuffer(), offset + positionDataSize, attributeData.data(), attributeDataSize});
     }
 
-    // create vertex buffer
-    Gfx::Buffer::CreateInfo bufCreateInfo;
-    bufCreateInfo.size = vertexBufferSize;
-    bufCreateInfo.usages = Gfx::BufferUsage::Vertex | Gfx::BufferUsage::Transfer_Dst;
-    bufCreateInfo.debugName = name.data();
-    gfxVertexBuffer = Gfx::GfxDriver::Instance()->CreateBuffer(bufCreateInfo);
-
-    // calculate index buffer size
+    // the levels of detail follow the indices in the same range
+    indexCount = indices.size();
+    size_t totalIndexCount = indexCount;
+    for (auto& level : lodIndices)
+        totalIndexCount += level.size();
+    indexRange = arena.AllocateIndices(totalIndexCount, indexBufferType);
     size_t indexByteSize = indexBufferType == Gfx::IndexBufferType::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
-    std::size_t indexBufferSize = indices.size() * indexByteSize;
-    bufCreateInfo.size = indexBufferSize;
-    bufCreateInfo.usages = Gfx::BufferUsage::Index | Gfx::BufferUsage::Transfer_Dst;
-    bufCreateInfo.debugName = name.data();
-    gfxIndexBuffer = Gfx::GfxDriver::Instance()->CreateBuffer(bufCreateInfo);
-
-    // create staging buffer
-    bufCreateInfo.size = indexBufferSize + vertexBufferSize;
-    bufCreateInfo.usages = Gfx::BufferUsage::Transfer_Src;
-    bufCreateInfo.debugName = "mesh staging buffer";
-    bufCreateInfo.visibleInCPU = true;
-    auto stagingBuffer = Gfx::GfxDriver::Instance()->CreateBuffer(bufCreateInfo);
-
-    size_t positionDataSize = positions.size() * sizeof(glm::vec3);
-    size_t attribtueDataSize = attributes.GetData().size();
-
-    memcpy(stagingBuffer->GetCPUVisibleAddress(), positions.data(), positionDataSize);
-    memcpy(
-        (uint8_t*)stagingBuffer->GetCPUVisibleAddress() + positionDataSize,
-        attributes.GetData().data(),
-        attribtueDataSize
-    );
+    firstIndex = indexRange.GetOffset() / indexByteSize;
 
+    lods = {{firstIndex, (uint32_t)indexCount, 0}};
+    for (size_t i = 0; i < lodIndices.size(); ++i)
+    {
+        const SubmeshLod& previous = lods.back();
+        lods.push_back({previous.firstIndex + previous.indexCount, (uint32_t)lodIndices[i].size(), lodErrors[i]});
+    }
+
+    std::vector<uint16_t> indices16;
     if (indexBufferType == Gfx::IndexBufferType::UInt16)
     {
-        std::vector<uint16_t> temp(indices.size());
-        const size_t indicesSize = indices.size();
-        for (size_t i = 0; i < indicesSize; ++i)
+        indices16.reserve(totalIndexCount);
+        indices16.assign(indices.begin(), indices.end());
+        for (auto& level : lodIndices)
+            indices16.insert(indices16.end(), level.begin(), level.end());
+        size_t size = indices16.size() * sizeof(uint16_t);
+        writes.push_back({GetIndexBuffer(), indexRange.GetOffset(), indices16.data(), size});
+    }
+    else
+    {
+        for (size_t i = 0; i < lods.size(); ++i)
         {
-            temp[i] = indices[i];
+            const std::vector<uint32_t>& levelIndices = i == 0 ? indices : lodIndices[i - 1];
+            uint64_t offset = (uint64_t)lods[i].firstIndex * sizeof(uint32_t);
+            writes.push_back({GetIndexBuffer(), offset, levelIndices.data(), levelIndices.size() * sizeof(uint32_t)});
         }
-        memcpy(
-            (uint8_t*)stagingBuffer->GetCPUVisibleAddress() + positionDataSize + attribtueDataSize,
-            temp.data(),
-            indicesSize * sizeof(uint16_t)
-        );
     }
-    else
+
+    arena.Upload(writes);
+}
+
+void Submesh::GenerateLods(uint32_t maxLodCount, float reduction)
+{
+    lodIndices.clear();
+    lodErrors.clear();
+
+    // every level simplifies the one before, its error is bounded by the sum of the errors so far
+    float error = 0;
+    for (uint32_t level = 1; level < maxLodCount; ++level)
     {
-        memcpy(
-            (uint8_t*)stagingBuffer->GetCPUVisibleAddress() + positionDataSize + attribtueDataSize,
-            indices.data(),
-            indices.size() * sizeof(uint32_t)
-        );
+        const std::vector<uint32_t>& source = lodIndices.empty() ? indices : lodIndices.back();
+        size_t target = (size_t)(source.size() / 3 * reduction) * 3;
+        float levelError;
+        std::vector<uint32_t> result = SimplifyMesh(positions, source, target, FLT_MAX, &levelError);
+
+        // borders and seams are kept, a level that didn't get halfway to its target isn't worth its memory
+        if (result.empty() || result.size() > (source.size() + target) / 2)
+            break;
+
+        // the simplification leaves the triangles in the order of the source, not of the cache
+        OptimizeVertexCache(result, positions.size());
+        error += levelError;
+        lodErrors.push_back(error);
+        lodIndices.push_back(std::move(result));
     }
-    indexCount = indices.size();
+}
 
-    ImmediateGfx::OnetimeSubmit(
-        [this, vertexBufferSize, indexBufferSize, &stagingBuffer](Gfx::CommandBuffer& cmd)
-        {
-            Gfx::BufferCopyRegion bufferCopyRegions[] = {{0, 0, vertexBufferSize}};
-            cmd.CopyBuffer(stagingBuffer, gfxVertexBuffer, bufferCopyRegions);
+void Submesh::GenerateMeshlets()
+{
+    meshlets = BuildMeshlets(positions, indices);
+    OptimizeMeshletVertexCache(meshlets, indices, positions.size());
+}
 
-            bufferCopyRegions[0] = {vertexBufferSize, 0, indexBufferSize};
-            cmd.CopyBuffer(stagingBuffer, gfxIndexBuffer, bufferCopyRegions);
-        }
-    );
+const SubmeshLod& Submesh::GetLod(uint32_t level) const
+{
+    static const SubmeshLod none = {};
+    if (lods.empty())
+        return none;
+    return lods[std::min<size_t>(level, lods.size() - 1)];
 }
 
 const AABB& Submesh::GetAABB() const
@@ -245,6 +260,36 @@ const AABB& Mesh::GetAABB() const
     return aabb;
 }
 
+uint32_t Mesh::GetLodCount() const
+{
+    uint32_t count = 0;
+    for (auto& submesh : submeshes)
+        count = std::max(count, submesh.GetLodCount());
+    return count;
+}
+
+float Mesh::GetLodError(uint32_t level) const
+{
+    float error = 0;
+    for (auto& submesh : submeshes)
+        error = std::max(error, submesh.GetLod(level).error);
+    return error;
+}
+
+uint32_t Mesh::SelectLod(float errorToScreen, uint32_t current, float threshold, float hysteresis) const
+{
+    uint32_t level = 0;
+    uint32_t lodCount = GetLodCount();
+    for (uint32_t l = 1; l < lodCount; ++l)
+    {
+        float limit = l > current ? threshold * (1 - hysteresis) : threshold;
+        if (GetLodError(l) * errorToScreen > limit)
+            break;
+        level = l;
+    }
+    return level;
+}
+
 Mesh::~Mesh() {}
 
 } // namespace Engine
@@ -1,7 +1,9 @@
 #pragma once
 #include "Core/Asset.hpp"
 #include "GfxDriver/Buffer.hpp"
+#include "Libs/Meshlets.hpp"
 #include "Libs/Ptr.hpp"
+#include "Rendering/GeometryArena.hpp"
 #include "Utils/Structs.hpp"
 #include <glm/glm.hpp>
 #include <iterator>
@@ -66,6 +68,15 @@ private:
     std::vector<uint8_t> data;
 };
 
+// a level of detail of a submesh, a range of its index buffer that draws the same vertices
+struct SubmeshLod
+{
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    // upper bound of the distance to the full detail surface, in object space
+    float error = 0;
+};
+
 class Submesh
 {
     // general version API
@@ -88,14 +99,40 @@ public:
     const AABB& GetAABB() const;
     void SetAABB(const AABB& aabb);
 
+    // the buffers are shared with other submeshes, draws select the submesh with GetFirstIndex and GetVertexOffset
     Gfx::Buffer* GetIndexBuffer() const
     {
-        return gfxIndexBuffer.get();
+        return indexRange.GetBuffer();
     }
 
     Gfx::Buffer* GetVertexBuffer() const
     {
-        return gfxVertexBuffer.get();
+        return vertexRange.GetBuffer();
+    }
+
+    uint32_t GetFirstIndex() const
+    {
+        return firstIndex;
+    }
+
+    int32_t GetVertexOffset() const
+    {
+        return vertexOffset;
+    }
+
+    // level 0 is the submesh itself, the others are simplified by GenerateLods
+    uint32_t GetLodCount() const
+    {
+        return lods.size();
+    }
+
+    // clamped to the coarsest level
+    const SubmeshLod& GetLod(uint32_t level) const;
+
+    // the meshlets of level 0, their index ranges are relative to GetFirstIndex
+    std::span<const Meshlet> GetMeshlets() const
+    {
+        return meshlets;
     }
 
     std::span<const VertexBinding> GetBindings() const
@@ -104,8 +141,12 @@ public:
     }
 
 private:
-    std::unique_ptr<Gfx::Buffer> gfxVertexBuffer = nullptr;
-    std::unique_ptr<Gfx::Buffer> gfxIndexBuffer = nullptr;
+    GeometryArena::Range vertexRange;
+    GeometryArena::Range indexRange;
+    uint32_t firstIndex = 0;
+    int32_t vertexOffset = 0;
+    std::vector<SubmeshLod> lods;
+    std::vector<Meshlet> meshlets;
     Gfx::IndexBufferType indexBufferType = Gfx::IndexBufferType::UInt16;
     std::vector<VertexBinding> bindings;
     AABB aabb;
@@ -120,6 +161,12 @@ public:
     void SetVertexAttribute(VertexAttribute&& vertAttributes);
     void SetVertexAttribute(const VertexAttribute& vertAttributes);
     void SetPositions(const std::vector<glm::vec3>& positions);
+    // simplify the indices into up to maxLodCount - 1 coarser levels, each with about reduction of the triangles of
+    // the level before. Stops early when a level can't be simplified further. Called before Apply
+    void GenerateLods(uint32_t maxLodCount, float reduction = 0.5f);
+    // split the indices into meshlets and reorder them so every meshlet is a range of them, the triangles of a
+    // meshlet in the order of the vertex cache. Called before Apply
+    void GenerateMeshlets();
     void Apply();
 
     const std::vector<uint32_t>& GetIndices() const;
@@ -130,6 +177,9 @@ private:
     std::vector<uint32_t> indices;
     std::vector<glm::vec3> positions; // binding 0,
     VertexAttribute attributes;       // binding 1, interleaved
+    // the indices and errors of the levels after level 0
+    std::vector<std::vector<uint32_t>> lodIndices;
+    std::vector<float> lodErrors;
 
     // v0.1 API
 public:
@@ -173,6 +223,17 @@ public:
 
     const AABB& GetAABB() const;
 
+    // the most levels of detail of a submesh
+    uint32_t GetLodCount() const;
+
+    // the largest error of the submeshes at level, a submesh with fewer levels uses its coarsest
+    float GetLodError(uint32_t level) const;
+
+    // the coarsest level whose error covers at most threshold of the screen height, errorToScreen scales an object
+    // space error to a fraction of the screen height. Levels coarser than current have to be below threshold by the
+    // hysteresis, so an object at the boundary of two levels doesn't switch between them every frame
+    uint32_t SelectLod(float errorToScreen, uint32_t current, float threshold, float hysteresis) const;
+
     bool LoadFromFile(const char* path) override;
 
     const std::vector<Submesh>& GetSubmeshes()
@@ -189,11 +250,11 @@ public:
             std::numeric_limits<float>::max(),
             std::numeric_limits<float>::max()};
         glm::vec3 max = {
-            std::numeric_limits<float>::min(),
-            std::numeric_limits<float>::min(),
-            std::numeric_limits<float>::min()};
+            std::numeric_limits<float>::lowest(),
+            std::numeric_limits<float>::lowest(),
+            std::numeric_limits<float>::lowest()};
 
-        for (auto& submesh : submeshes)
+        for (auto& submesh : this->submeshes)
         {
             auto& aabb = submesh.GetAABB();
             min.x = glm::min(min.x, aabb.min.x);
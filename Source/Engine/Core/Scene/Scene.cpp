@@ -65,13 +65,17 @@ std::vector<GameObject*> Scene::GetAllGameObjects()
 {
     std::vector<GameObject*> objs;
     objs.reserve(256);
+    GetAllGameObjects(objs);
+    return objs;
+}
 
+void Scene::GetAllGameObjects(std::vector<GameObject*>& objs)
+{
+    objs.clear();
     for (auto& obj : roots)
     {
         ::Engine::GetAllGameObjects(obj->GetTransform(), objs);
     }
-
-    return objs;
 }
 
 GameObject* Scene::CopyGameObject(GameObject& gameObject)
@@ -33,6 +33,8 @@ public:
     void DestroyGameObject(GameObject* obj);
 
     std::vector<GameObject*> GetAllGameObjects();
+    // clears objs and fills it, a reused vector doesn't allocate
+    void GetAllGameObjects(std::vector<GameObject*>& objs);
 
     std::vector<Light*> GetActiveLights();
 
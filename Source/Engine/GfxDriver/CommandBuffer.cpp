@@ -1,4 +1,5 @@
 #include "CommandBuffer.hpp"
+#include <algorithm>
 
 namespace Engine::Gfx
 {
@@ -12,4 +13,46 @@ void CommandBuffer::BindSubmesh(const Submesh& submesh)
     BindVertexBuffer(bindings, 0);
     BindIndexBuffer(submesh.GetIndexBuffer(), 0, submesh.GetIndexBufferType());
 }
+
+static bool IsOrdered(const GPUBarrier& earlier, const GPUBarrier& later)
+{
+    bool earlierMemory = earlier.buffer == nullptr && earlier.image == nullptr;
+    bool laterMemory = later.buffer == nullptr && later.image == nullptr;
+    if (earlierMemory || laterMemory)
+        return true;
+
+    if (earlier.buffer != nullptr)
+        return earlier.buffer.Get() == later.buffer.Get();
+
+    ImageSubresourceRange range = earlier.imageInfo.subresourceRange;
+    return earlier.image.Get() == later.image.Get() && range.Overlaps(later.imageInfo.subresourceRange);
+}
+
+std::vector<uint32_t> BatchBarriers(std::span<const GPUBarrier> barriers)
+{
+    std::vector<uint32_t> batches(barriers.size());
+    std::vector<std::pair<PipelineStageFlags, PipelineStageFlags>> batchStages;
+    for (size_t i = 0; i < barriers.size(); ++i)
+    {
+        // the earliest batch after the batches of the barriers this one has to follow
+        uint32_t first = 0;
+        for (size_t j = 0; j < i; ++j)
+        {
+            if (IsOrdered(barriers[j], barriers[i]))
+                first = std::max(first, batches[j] + 1);
+        }
+
+        std::pair<PipelineStageFlags, PipelineStageFlags> stages(barriers[i].srcStageMask, barriers[i].dstStageMask);
+        first = std::min<uint32_t>(first, batchStages.size());
+        auto iter = std::find(batchStages.begin() + first, batchStages.end(), stages);
+        if (iter == batchStages.end())
+        {
+            batchStages.push_back(stages);
+            iter = batchStages.end() - 1;
+        }
+        batches[i] = iter - batchStages.begin();
+    }
+
+    return batches;
+}
 } // namespace Engine::Gfx
@@ -1,10 +1,13 @@
 #pragma once
 
 #include "Buffer.hpp"
+#include "CommandQueue.hpp"
 #include "Core/Graphics/Mesh.hpp"
+#include "Event.hpp"
 #include "FrameBuffer.hpp"
 #include "GfxEnums.hpp"
 #include "Image.hpp"
+#include "QueryPool.hpp"
 #include "RenderPass.hpp"
 #include "ShaderConfig.hpp"
 #include "ShaderResource.hpp"
@@ -19,6 +22,14 @@ enum class CommandBufferType
     Secondary
 };
 
+// how the commands of a subpass are provided
+enum class SubpassContents
+{
+    Inline,
+    // only ExecuteCommands with secondary command buffers is allowed in the subpass
+    Secondary_Command_Buffers
+};
+
 #define GFX_QUEUE_FAMILY_IGNORED ~0U
 #define GFX_WHOLE_SIZE ~0ULL
 // source stage/accessMask/queueFamilyIndex/imageLayout is tracked by
@@ -50,6 +61,12 @@ struct GPUBarrier
     } imageInfo;
 };
 
+// Group the barriers into batches recorded by one pipeline barrier each, returns the batch of every barrier. Batches
+// are numbered in recording order, a batch has barriers of one stage pair. Barriers on the same buffer, or on
+// overlapping subresources of the same image, keep the order they are given in: a barrier goes into a batch after the
+// batches of the earlier ones on the same resource. Memory barriers are ordered with all other barriers
+std::vector<uint32_t> BatchBarriers(std::span<const GPUBarrier> barriers);
+
 struct BufferCopyRegion
 {
     uint64_t srcOffset;
@@ -65,6 +82,15 @@ struct BufferImageCopyRegion
     Extent3D extend;
 };
 
+struct ImageCopyRegion
+{
+    Gfx::ImageSubresourceLayers srcLayers;
+    Offset3D srcOffset;
+    Gfx::ImageSubresourceLayers dstLayers;
+    Offset3D dstOffset;
+    Extent3D extent;
+};
+
 struct VertexBufferBinding
 {
     Gfx::Buffer* buffer;
@@ -90,17 +116,65 @@ struct DescriptorBinding
     Buffer* buffer;
 };
 
+// the layout of an indexed indirect draw in a buffer, written by the GPU for GPU driven draws
+struct DrawIndexedIndirectCommand
+{
+    uint32_t indexCount;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t firstInstance;
+};
+
 struct BlitOp
 {
     std::optional<uint32_t> srcMip;
     std::optional<uint32_t> dstMip;
 };
 
+// how many state binding calls reached the api and how many were dropped because the state was already bound
+struct CommandCallCount
+{
+    uint32_t issued = 0;
+    uint32_t skipped = 0;
+};
+
+// collected between Begin and End of a command buffer
+struct CommandBufferStats
+{
+    CommandCallCount pipeline;
+    CommandCallCount descriptorSet;
+    CommandCallCount vertexBuffer;
+    CommandCallCount indexBuffer;
+    CommandCallCount pushConstant;
+    // draw calls and the instances they drew, an indirect draw counts its draws but not their instances
+    uint32_t draws = 0;
+    uint32_t instances = 0;
+
+    CommandBufferStats& operator+=(const CommandBufferStats& other)
+    {
+        auto add = [](CommandCallCount& count, const CommandCallCount& otherCount)
+        {
+            count.issued += otherCount.issued;
+            count.skipped += otherCount.skipped;
+        };
+        add(pipeline, other.pipeline);
+        add(descriptorSet, other.descriptorSet);
+        add(vertexBuffer, other.vertexBuffer);
+        add(indexBuffer, other.indexBuffer);
+        add(pushConstant, other.pushConstant);
+        draws += other.draws;
+        instances += other.instances;
+        return *this;
+    }
+};
+
 class CommandBuffer
 {
 public:
     virtual ~CommandBuffer(){};
 
+    // the buffers are shared with other submeshes, draw it with the submesh's GetFirstIndex and GetVertexOffset
     void BindSubmesh(const Submesh& submesh);
 
     // virtual void BindResource(RefPtr<Gfx::ShaderResource> resource) = 0;
@@ -111,19 +185,36 @@ public:
     virtual void BindIndexBuffer(RefPtr<Gfx::Buffer> buffer, uint64_t offset, Gfx::IndexBufferType indexBufferType) = 0;
     virtual void BindShaderProgram(RefPtr<Gfx::ShaderProgram> program, const Gfx::ShaderConfig& config) = 0;
 
-    virtual void BeginRenderPass(Gfx::RenderPass& renderPass, const std::vector<Gfx::ClearValue>& clearValues) = 0;
+    virtual void BeginRenderPass(
+        Gfx::RenderPass& renderPass,
+        const std::vector<Gfx::ClearValue>& clearValues,
+        SubpassContents contents = SubpassContents::Inline
+    ) = 0;
     virtual void NextRenderPass() = 0;
     virtual void EndRenderPass() = 0;
 
     virtual void DrawIndexed(
         uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, uint32_t vertexOffset, uint32_t firstInstance
     ) = 0;
+    // drawCount DrawIndexedIndirectCommands read from buffer, drawCount > 1 requires GPUFeatures::drawIndirect
+    virtual void DrawIndexedIndirect(Buffer* buffer, uint64_t offset, uint32_t drawCount, uint32_t stride) = 0;
+    // the draw count is read from countBuffer and clamped to maxDrawCount, requires GPUFeatures::drawIndirectCount
+    virtual void DrawIndexedIndirectCount(
+        Buffer* buffer,
+        uint64_t offset,
+        Buffer* countBuffer,
+        uint64_t countOffset,
+        uint32_t maxDrawCount,
+        uint32_t stride
+    ) = 0;
     virtual void Blit(RefPtr<Gfx::Image> from, RefPtr<Gfx::Image> to, BlitOp blitOp = {}) = 0;
     virtual void Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) = 0;
 
     virtual void PushDescriptor(ShaderProgram& shader, uint32_t set, std::span<DescriptorBinding> bindings) = 0;
     virtual void SetPushConstant(RefPtr<Gfx::ShaderProgram> shaderProgram, void* data) = 0;
     virtual void SetScissor(uint32_t firstScissor, uint32_t scissorCount, Rect2D* rect) = 0;
+    // clears rect of the depth attachment of the current subpass, only inside a render pass
+    virtual void ClearDepthAttachment(const Rect2D& rect, float depth) = 0;
     virtual void SetViewport(const Viewport& viewport) = 0;
     virtual void Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) = 0;
     virtual void DispatchIndir(Buffer* buffer, size_t bufferOffset) = 0;
@@ -147,9 +238,39 @@ public:
     virtual void CopyBufferToImage(
         RefPtr<Gfx::Buffer> src, RefPtr<Gfx::Image> dst, std::span<BufferImageCopyRegion> regions
     ) = 0;
+    // src is in the Transfer_Src layout and dst in the Transfer_Dst layout, the formats are the same
+    virtual void CopyImage(RefPtr<Gfx::Image> src, RefPtr<Gfx::Image> dst, std::span<ImageCopyRegion> regions) = 0;
     virtual void Barrier(GPUBarrier* barriers, uint32_t barrierCount) = 0;
+
+    // split barrier: the barriers of a WaitEvents on the event only wait for the work of stages before SetEvent.
+    // srcStages of WaitEvents has to be the union of the stages the events were set with
+    virtual void SetEvent(Event& event, PipelineStageFlags stages) = 0;
+    virtual void ResetEvent(Event& event, PipelineStageFlags stages) = 0;
+    virtual void WaitEvents(
+        std::span<Event* const> events, PipelineStageFlags srcStages, GPUBarrier* barriers, uint32_t barrierCount
+    ) = 0;
+
+    // queries have to be reset before they are written again, outside of a render pass
+    virtual void ResetQueryPool(QueryPool& queryPool, uint32_t first, uint32_t count) = 0;
+    // the timestamp is written when the commands before it finished stage
+    virtual void WriteTimestamp(QueryPool& queryPool, uint32_t query, PipelineStageFlags stage) = 0;
+
     virtual void Begin() = 0;
+    // begin a secondary command buffer that records into the subpass of renderPass, nothing is inherited from the
+    // primary command buffer except the render pass
+    virtual void Begin(Gfx::RenderPass& renderPass, uint32_t subpass) = 0;
+    // record secondary command buffers into this primary command buffer, their stats are added to this one's
+    virtual void ExecuteCommands(std::span<CommandBuffer* const> cmdBufs) = 0;
+
+    // Work on another queue. The submission of this command buffer is split: the ended cmdBuf is submitted to queue
+    // after the commands recorded so far and waits for them, the commands recorded after Fork don't wait for it.
+    // Bound state and dynamic state don't carry over the split
+    virtual void Fork(CommandQueue& queue, CommandBuffer& cmdBuf) = 0;
+    // the commands recorded after Join wait for the command buffers forked before it, End joins the remaining ones
+    virtual void Join() = 0;
     virtual void End() = 0;
     virtual void Reset(bool releaseResource) = 0;
+
+    virtual const CommandBufferStats& GetStats() = 0;
 };
 } // namespace Engine::Gfx
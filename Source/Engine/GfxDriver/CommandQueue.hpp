@@ -5,6 +5,8 @@ namespace Engine
 enum class QueueType : uint32_t
 {
     Main,
+    // compute only, runs concurrently with the main queue
+    AsyncCompute,
 };
 
 class CommandQueue
@@ -0,0 +1,11 @@
+#pragma once
+
+namespace Engine::Gfx
+{
+// device side signal used to split a barrier, see CommandBuffer::SetEvent
+class Event
+{
+public:
+    virtual ~Event(){};
+};
+} // namespace Engine::Gfx
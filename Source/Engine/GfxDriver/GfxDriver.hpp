@@ -4,14 +4,17 @@
 #include "CommandBuffer.hpp"
 #include "CommandPool.hpp"
 #include "CommandQueue.hpp"
+#include "Event.hpp"
 #include "Fence.hpp"
 #include "Image.hpp"
 #include "ImageView.hpp"
 #include "Libs/EnumFlags.hpp"
 #include "Libs/Ptr.hpp"
+#include "QueryPool.hpp"
 #include "Semaphore.hpp"
 
 #include <SDL2/SDL.h>
+#include <filesystem>
 #include <glm/glm.hpp>
 #include <memory>
 #include <span>
@@ -21,6 +24,7 @@
 
 #if defined(_WIN32) || defined(_WIN64)
 #undef CreateSemaphore
+#undef CreateEvent
 #endif
 
 namespace Engine::Gfx
@@ -36,6 +40,18 @@ struct GPUFeatures
     bool textureCompressionETC2 = false;
     bool textureCompressionBC = true;
     bool textureCompressionASTC4x4 = false;
+    // runtime sized texture arrays for bindless materials
+    bool descriptorIndexing = false;
+    // a compute queue next to the main queue, GetQueue(QueueType::AsyncCompute) is null without it
+    bool asyncCompute = false;
+    // CommandBuffer::WriteTimestamp works on every queue
+    bool timestamps = false;
+    // nanoseconds per timestamp tick
+    float timestampPeriod = 1;
+    // DrawIndexedIndirect with a firstInstance and a drawCount other than 1
+    bool drawIndirect = false;
+    // CommandBuffer::DrawIndexedIndirectCount
+    bool drawIndirectCount = false;
 };
 
 enum class AcquireNextSwapChainImageResult
@@ -52,6 +68,9 @@ public:
     {
         // the initial window size used to create sdl window
         Extent2D windowSize;
+
+        // where the pipeline cache is loaded from and saved to on shutdown, empty to keep it in memory only
+        std::filesystem::path pipelineCachePath;
     };
 
     static RefPtr<GfxDriver> Instance();
@@ -75,6 +94,11 @@ public:
     virtual UniPtr<RenderPass> CreateRenderPass() = 0;
     virtual UniPtr<FrameBuffer> CreateFrameBuffer(RefPtr<RenderPass> renderPass) = 0;
     virtual UniPtr<Image> CreateImage(const ImageDescription& description, ImageUsageFlags usages) = 0;
+    // images that share one memory allocation. Writing one of them invalidates the content of the others, the caller
+    // has to make sure their uses don't overlap
+    virtual std::vector<std::unique_ptr<Image>> CreateAliasedImages(
+        std::span<const ImageDescription> descriptions, std::span<const ImageUsageFlags> usages
+    ) = 0;
     virtual UniPtr<ShaderProgram> CreateShaderProgram(
         const std::string& name,
         std::shared_ptr<const ShaderConfig> config,
@@ -97,6 +121,8 @@ public:
 
     virtual UniPtr<Semaphore> CreateSemaphore(const Semaphore::CreateInfo& createInfo) = 0;
     virtual UniPtr<Fence> CreateFence(const Fence::CreateInfo& createInfo) = 0;
+    virtual std::unique_ptr<Event> CreateEvent() = 0;
+    virtual std::unique_ptr<QueryPool> CreateTimestampQueryPool(uint32_t queryCount) = 0;
 
     virtual void QueueSubmit(
         RefPtr<CommandQueue> queue,
@@ -2,14 +2,16 @@
 
 namespace Engine::Gfx
 {
-bool HasWriteAccessMask(AccessMaskFlags flags)
+AccessMaskFlags WriteAccessMask(AccessMaskFlags flags)
 {
-    if (HasFlag(flags, AccessMask::Shader_Write) || HasFlag(flags, AccessMask::Color_Attachment_Write) ||
-        HasFlag(flags, AccessMask::Transfer_Write) || HasFlag(flags, AccessMask::Host_Write) ||
-        HasFlag(flags, AccessMask::Memory_Write))
-        return true;
+    return flags & (AccessMask::Shader_Write | AccessMask::Color_Attachment_Write |
+                    AccessMask::Depth_Stencil_Attachment_Write | AccessMask::Transfer_Write | AccessMask::Host_Write |
+                    AccessMask::Memory_Write);
+}
 
-    return false;
+bool HasWriteAccessMask(AccessMaskFlags flags)
+{
+    return WriteAccessMask(flags) != AccessMask::None;
 }
 
 bool HasReadAccessMask(AccessMaskFlags flags)
@@ -17,6 +17,8 @@ ENUM_FLAGS(BufferUsage, uint64_t){
     Index = 0x00000040,
     Vertex = 0x00000080,
     Indirect = 0x00000100,
+    // also used on the async compute queue, see ImageUsage::AsyncCompute
+    AsyncCompute = 0x00000200,
 };
 
 ENUM_FLAGS(ImageAspect, uint64_t){
@@ -158,7 +160,14 @@ enum Enum : uint32_t
     DepthStencilAttachment = 0x2,
     Texture = 0x4,
     TransferSrc = 0x8,
-    TransferDst = 0x10
+    TransferDst = 0x10,
+    // attachment only used inside a render pass, backed by lazily allocated memory when the device has it
+    Transient = 0x20,
+    // read by a later subpass of the same render pass at the pixel it's drawing
+    InputAttachment = 0x40,
+    // also used on the async compute queue. The image is shared concurrently by the queue families, which can turn
+    // off compression, so only images async compute passes use have it
+    AsyncCompute = 0x80
 };
 }
 typedef uint32_t ImageUsageFlags;
@@ -252,6 +261,8 @@ ENUM_FLAGS(AccessMask, uint64_t){
     Memory_Read = 0x00008000,
     Memory_Write = 0x00010000,
 };
+// only the write bits of flags
+AccessMaskFlags WriteAccessMask(AccessMaskFlags flags);
 bool HasWriteAccessMask(AccessMaskFlags flags);
 bool HasReadAccessMask(AccessMaskFlags flags);
 bool IsDepthStencilFormat(ImageFormat format);
@@ -139,6 +139,10 @@ public:
     virtual ImageSubresourceRange GetSubresourceRange() = 0;
     virtual ImageView& GetDefaultImageView() = 0;
     virtual ImageLayout GetImageLayout() = 0;
+    virtual ImageUsageFlags GetUsages() = 0;
+
+    // bytes of device memory the image needs, 0 if the image isn't backed by memory the driver allocated
+    virtual uint64_t GetMemorySize() = 0;
 
 protected:
 };
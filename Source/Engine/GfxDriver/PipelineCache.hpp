@@ -0,0 +1,169 @@
+#pragma once
+#include "ShaderConfig.hpp"
+#include "ThirdParty/xxHash/xxhash.h"
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Engine::Gfx
+{
+// Pipelines of one shader program, looked up by config, render pass and subpass.
+// The lookup goes through a 64 bit key, a hit is only returned when the full state compares equal.
+// Command buffers are recorded from several threads: Find doesn't lock, it probes an open addressing index whose
+// slots only ever change from empty to an entry, or to a newer entry with the same key. Insert locks and fills a slot
+// in place. When the index is half full it's copied to one twice as large and the copy is published, the old index may
+// still be read by another thread so it's kept until the cache is destroyed. The old indices together are smaller
+// than the current one
+template <class Pipeline, class RenderPass>
+class PipelineCache
+{
+public:
+    PipelineCache()
+    {
+        indices.push_back(std::make_unique<Index>(16));
+        published.store(indices.back().get(), std::memory_order_release);
+    }
+
+    PipelineCache(const PipelineCache& other) = delete;
+
+    // returns nullptr when no pipeline was created for this state yet
+    const Pipeline* Find(const ShaderConfig& config, RenderPass renderPass, uint32_t subpass) const
+    {
+        const Index& index = *published.load(std::memory_order_acquire);
+        const Entry* entry = Find(index, GetKey(config, renderPass, subpass), config, renderPass, subpass);
+        return entry ? &entry->pipeline : nullptr;
+    }
+
+    // returns the cached pipeline, or creates it with create() and caches it. Threads requesting the same state
+    // at the same time get the same pipeline
+    template <class F>
+    Pipeline Request(const ShaderConfig& config, RenderPass renderPass, uint32_t subpass, F&& create)
+    {
+        uint64_t key = GetKey(config, renderPass, subpass);
+        if (const Entry* entry = Find(*published.load(std::memory_order_acquire), key, config, renderPass, subpass))
+            return entry->pipeline;
+
+        std::lock_guard lock(mutex);
+        // another thread may have created it while we waited
+        if (const Entry* entry = Find(*published.load(std::memory_order_relaxed), key, config, renderPass, subpass))
+            return entry->pipeline;
+
+        Pipeline pipeline = create();
+        Publish(key, config, renderPass, subpass, pipeline);
+        return pipeline;
+    }
+
+    void Insert(const ShaderConfig& config, RenderPass renderPass, uint32_t subpass, Pipeline pipeline)
+    {
+        std::lock_guard lock(mutex);
+        Publish(GetKey(config, renderPass, subpass), config, renderPass, subpass, pipeline);
+    }
+
+    // not thread safe
+    template <class F>
+    void ForEach(F&& f) const
+    {
+        for (auto& entry : entries)
+            f(entry->pipeline);
+    }
+
+    // not thread safe
+    size_t Size() const
+    {
+        return entries.size();
+    }
+
+    static uint64_t GetKey(const ShaderConfig& config, RenderPass renderPass, uint32_t subpass)
+    {
+        static_assert(sizeof(RenderPass) <= sizeof(uint64_t));
+        uint64_t key[3] = {config.GetHash(), 0, subpass};
+        memcpy(&key[1], &renderPass, sizeof(RenderPass));
+        return XXH64(key, sizeof(key), 0);
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        ShaderConfig config;
+        RenderPass renderPass;
+        uint32_t subpass;
+        Pipeline pipeline;
+
+        // entry inserted earlier with the same key
+        const Entry* next;
+    };
+
+    struct Index
+    {
+        Index(size_t capacity) : slots(capacity) {}
+
+        // the newest entry of a key, the size is a power of two
+        std::vector<std::atomic<const Entry*>> slots;
+        // only touched with mutex locked
+        size_t count = 0;
+
+        // the slot of key, or the empty slot it goes to
+        size_t Probe(uint64_t key) const
+        {
+            size_t mask = slots.size() - 1;
+            for (size_t i = key & mask;; i = (i + 1) & mask)
+            {
+                const Entry* head = slots[i].load(std::memory_order_acquire);
+                if (head == nullptr || head->key == key)
+                    return i;
+            }
+        }
+    };
+
+    // entries are heap allocated and never modified after they are published
+    std::vector<std::unique_ptr<Entry>> entries;
+    std::vector<std::unique_ptr<Index>> indices;
+    std::atomic<const Index*> published;
+    std::mutex mutex;
+
+    static const Entry* Find(
+        const Index& index, uint64_t key, const ShaderConfig& config, RenderPass renderPass, uint32_t subpass
+    )
+    {
+        const Entry* head = index.slots[index.Probe(key)].load(std::memory_order_acquire);
+        for (const Entry* entry = head; entry != nullptr; entry = entry->next)
+        {
+            if (entry->subpass == subpass && entry->renderPass == renderPass && entry->config == config)
+                return entry;
+        }
+        return nullptr;
+    }
+
+    // called with mutex locked
+    void Publish(uint64_t key, const ShaderConfig& config, RenderPass renderPass, uint32_t subpass, Pipeline pipeline)
+    {
+        Index* index = indices.back().get();
+        std::atomic<const Entry*>* slot = &index->slots[index->Probe(key)];
+        const Entry* next = slot->load(std::memory_order_relaxed);
+        entries.push_back(std::make_unique<Entry>(Entry{key, config, renderPass, subpass, pipeline, next}));
+
+        // keep the load factor under 1/2 so probe sequences stay short
+        if (next == nullptr && (index->count + 1) * 2 > index->slots.size())
+        {
+            auto grown = std::make_unique<Index>(index->slots.size() * 2);
+            for (auto& old : index->slots)
+            {
+                if (const Entry* head = old.load(std::memory_order_relaxed))
+                    grown->slots[grown->Probe(head->key)].store(head, std::memory_order_relaxed);
+            }
+            grown->count = index->count;
+            indices.push_back(std::move(grown));
+            index = indices.back().get();
+            slot = &index->slots[index->Probe(key)];
+        }
+
+        if (next == nullptr)
+            index->count += 1;
+        slot->store(entries.back().get(), std::memory_order_release);
+        published.store(index, std::memory_order_release);
+    }
+};
+} // namespace Engine::Gfx
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+namespace Engine::Gfx
+{
+// GPU timestamps written by CommandBuffer::WriteTimestamp, see GPUFeatures::timestampPeriod for their unit
+class QueryPool
+{
+public:
+    virtual ~QueryPool(){};
+
+    virtual uint32_t GetQueryCount() = 0;
+
+    // copy the timestamps of the queries [first, first + results.size()) without waiting for the GPU, returns false
+    // if any of them isn't written yet
+    virtual bool GetResults(uint32_t first, std::span<uint64_t> results) = 0;
+};
+} // namespace Engine::Gfx
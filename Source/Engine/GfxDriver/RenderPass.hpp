@@ -44,7 +44,13 @@ public:
 
     virtual ~RenderPass() {}
 
-    virtual void AddSubpass(const std::vector<Attachment>& colors, std::optional<Attachment> depth) = 0;
+    // inputs are read by the subpass' shaders with subpassInput, their load and store operations are not used. A
+    // subresource used by several subpasses is one attachment, it's loaded by its first use and stored by its last
+    virtual void AddSubpass(
+        const std::vector<Attachment>& colors,
+        std::optional<Attachment> depth,
+        const std::vector<Attachment>& inputs = {}
+    ) = 0;
     virtual void ClearSubpass() = 0;
 
 private:
@@ -62,5 +62,8 @@ struct ShaderConfig
     std::vector<std::vector<std::string>> features;
 
     bool operator==(const ShaderConfig& other) const noexcept;
+
+    // hash of the states compared in operator==, equal configs have equal hashes
+    uint64_t GetHash() const noexcept;
 };
 } // namespace Engine::Gfx
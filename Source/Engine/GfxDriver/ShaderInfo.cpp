@@ -268,6 +268,8 @@ void Process(ShaderStageInfo& out, nlohmann::json& sr)
         Process(out.bindings, BindingType::SeparateImage, out.stage, sr["separate_images"], sr);
     if (sr.contains("separate_samplers"))
         Process(out.bindings, BindingType::SeparateSampler, out.stage, sr["separate_samplers"], sr);
+    if (sr.contains("subpass_inputs"))
+        Process(out.bindings, BindingType::SubpassInput, out.stage, sr["subpass_inputs"], sr);
 }
 
 void Process(
@@ -318,6 +320,12 @@ void Process(
                             lname.find("shadow") != bindingType.npos ? true : false;
                         break;
                     }
+                case BindingType::SubpassInput:
+                    {
+                        new (&b.binding.subpassInput) SubpassInput();
+                        b.binding.subpassInput.attachmentIndex = bindingJson.value("input_attachment_index", 0);
+                        break;
+                    }
                 default: assert(0 && "Not implemented");
             }
             b.count = bindingJson.value("array", std::vector<int>{1})[0];
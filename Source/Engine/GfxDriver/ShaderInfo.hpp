@@ -125,6 +125,12 @@ struct SeparateSampler
     bool enableCompare;
 };
 
+// subpassInput, reads the attachment of the render pass at the fragment's pixel
+struct SubpassInput
+{
+    uint32_t attachmentIndex;
+};
+
 using Outputs = std::vector<Output>;
 using Inputs = std::vector<Input>;
 using UBOs = std::vector<UBO>;
@@ -145,7 +151,8 @@ enum class BindingType
     SSBO,
     Texture,
     SeparateImage,
-    SeparateSampler
+    SeparateSampler,
+    SubpassInput
 };
 
 enum class TextureType
@@ -206,6 +213,15 @@ struct Binding
                     binding.separateSampler = other.binding.separateSampler;
                     break;
                 }
+            case BindingType::SubpassInput:
+                {
+                    if (type != BindingType::SubpassInput)
+                    {
+                        new (&binding.subpassInput) SubpassInput();
+                    }
+                    binding.subpassInput = other.binding.subpassInput;
+                    break;
+                }
         }
 
         type = other.type;
@@ -220,6 +236,7 @@ struct Binding
             case BindingType::SeparateImage: binding.separateImage.~SeparateImage(); break;
             case BindingType::SeparateSampler: binding.separateSampler.~SeparateSampler(); break;
             case BindingType::SSBO: binding.ssbo.~SSBO(); break;
+            case BindingType::SubpassInput: binding.subpassInput.~SubpassInput(); break;
         }
     }
 
@@ -236,6 +253,7 @@ struct Binding
         Texture texture;
         SeparateImage separateImage;
         SeparateSampler separateSampler;
+        SubpassInput subpassInput;
         UBO ubo;
         SSBO ssbo;
     } binding;
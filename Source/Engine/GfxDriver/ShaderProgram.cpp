@@ -1,4 +1,6 @@
 #include "ShaderProgram.hpp"
+#include "ThirdParty/xxHash/xxhash.h"
+#include <cstring>
 
 namespace Engine::Gfx
 {
@@ -29,4 +31,50 @@ bool ShaderConfig::operator==(const ShaderConfig& other) const noexcept
            color.blendConstants[2] == other.color.blendConstants[2] &&
            color.blendConstants[3] == other.color.blendConstants[3];
 }
+
+uint64_t ShaderConfig::GetHash() const noexcept
+{
+    // pack the states into a plain array first, the structs have padding that we don't want to hash
+    auto packStencil = [](const StencilOpState& s, uint32_t* dst)
+    {
+        dst[0] = (uint32_t)s.failOp;
+        dst[1] = (uint32_t)s.passOp;
+        dst[2] = (uint32_t)s.depthFailOp;
+        dst[3] = (uint32_t)s.compareOp;
+        dst[4] = s.compareMask;
+        dst[5] = s.writeMask;
+        dst[6] = s.reference;
+    };
+
+    uint32_t states[26];
+    states[0] = (uint32_t)cullMode;
+    states[1] = depth.writeEnable | depth.testEnable << 1 | depth.boundTestEnable << 2 | stencil.testEnable << 3;
+    states[2] = (uint32_t)depth.compOp;
+    memcpy(&states[3], &depth.minBounds, sizeof(float));
+    memcpy(&states[4], &depth.maxBounds, sizeof(float));
+    packStencil(stencil.front, &states[5]);
+    packStencil(stencil.back, &states[12]);
+    memcpy(&states[19], color.blendConstants, sizeof(float) * 4);
+    states[23] = (uint32_t)color.blends.size();
+    states[24] = 0;
+    states[25] = 0;
+
+    uint64_t hash = XXH64(states, sizeof(states), 0);
+    for (const ColorBlendAttachmentState& b : color.blends)
+    {
+        uint32_t blend[8] = {
+            b.blendEnable,
+            (uint32_t)b.srcColorBlendFactor,
+            (uint32_t)b.dstColorBlendFactor,
+            (uint32_t)b.colorBlendOp,
+            (uint32_t)b.srcAlphaBlendFactor,
+            (uint32_t)b.dstAlphaBlendFactor,
+            (uint32_t)b.alphaBlendOp,
+            (uint32_t)b.colorWriteMask,
+        };
+        hash = XXH64(blend, sizeof(blend), hash);
+    }
+
+    return hash;
+}
 } // namespace Engine::Gfx
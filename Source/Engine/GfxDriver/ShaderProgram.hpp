@@ -7,6 +7,7 @@
 #include <vector>
 namespace Engine::Gfx
 {
+class RenderPass;
 struct ShaderResourceLayout
 {
     std::string name;
@@ -27,6 +28,9 @@ public:
         return isCompute;
     }
 
+    // create the pipeline for this config and render pass ahead of the first bind so that it doesn't hitch a frame
+    virtual void WarmUp(const ShaderConfig& config, RenderPass& renderPass, uint32_t subpass){};
+
 protected:
     bool isCompute;
 };
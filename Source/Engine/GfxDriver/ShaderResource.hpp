@@ -5,6 +5,7 @@
 #include "GfxEnums.hpp"
 #include "Libs/Ptr.hpp"
 #include "StorageBuffer.hpp"
+#include <span>
 #include <string>
 #include <unordered_map>
 
@@ -20,6 +21,9 @@ public:
     virtual void SetImage(const std::string& bindingName, Gfx::Image* buffer) = 0;
     virtual void SetImage(const std::string& bindingName, Gfx::ImageView* imageView) = 0;
     virtual void SetImage(const std::string& bindingName, nullptr_t) = 0;
+    // fill a runtime sized texture array, only valid when descriptor indexing is supported. nullptr elements are
+    // bound to a default texture
+    virtual void SetImages(const std::string& bindingName, std::span<Gfx::ImageView* const> imageViews) = 0;
 
     virtual ~ShaderResource(){};
 
@@ -24,7 +24,8 @@ VKDevice::VKDevice(VKInstance* instance, VKSurface* surface, QueueRequest* queue
         bool found = false;
         for (; queueFamilyIndex < queueFamilyProperties.size(); ++queueFamilyIndex)
         {
-            if (queueFamilyProperties[queueFamilyIndex].queueFlags & request.flags)
+            VkQueueFlags familyFlags = queueFamilyProperties[queueFamilyIndex].queueFlags;
+            if ((familyFlags & request.flags) && (familyFlags & request.excludedFlags) == 0)
             {
                 VkBool32 surfaceSupport = false;
                 vkGetPhysicalDeviceSurfaceSupportKHR(
@@ -46,11 +47,10 @@ VKDevice::VKDevice(VKInstance* instance, VKSurface* surface, QueueRequest* queue
                 }
             }
         }
-        if (!found)
+        if (!found && !request.optional)
             throw std::runtime_error("Vulkan: Can't find required queue family index");
 
-        queueFamilyIndices[i] = queueFamilyIndex;
-        queuePriorities[i][0] = request.priority;
+        queueFamilyIndices[i] = found ? queueFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
     }
 
     VkDeviceQueueCreateInfo queueCreateInfos[16];
@@ -58,11 +58,15 @@ VKDevice::VKDevice(VKInstance* instance, VKSurface* surface, QueueRequest* queue
     int queueCreateInfoCount = 0;
     for (int i = 0; i < requestsCount; ++i)
     {
+        if (queueFamilyIndices[i] == VK_QUEUE_FAMILY_IGNORED)
+            continue;
+
         bool skip = false;
         // found duplicate queueFamilyIndex
-        for (int j = 0; j < i; ++j)
+        for (int j = 0; j < queueCreateInfoCount; ++j)
         {
-            if (queueCreateInfos[j].queueFamilyIndex == queueFamilyIndices[i])
+            if (queueCreateInfos[j].queueFamilyIndex == queueFamilyIndices[i] &&
+                queueCreateInfos[j].queueCount < queueFamilyProperties[queueFamilyIndices[i]].queueCount)
             {
                 queueCreateInfos[j].queueCount += 1;
                 queuePriorities[j][queueCreateInfos[j].queueCount - 1] = queueRequests[i].priority;
@@ -73,12 +77,14 @@ VKDevice::VKDevice(VKInstance* instance, VKSurface* surface, QueueRequest* queue
 
         if (!skip)
         {
-            queueCreateInfos[i].flags = 0;
-            queueCreateInfos[i].pNext = VK_NULL_HANDLE;
-            queueCreateInfos[i].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-            queueCreateInfos[i].queueFamilyIndex = queueFamilyIndices[i];
-            queueCreateInfos[i].queueCount = 1;
-            queueCreateInfos[i].pQueuePriorities = queuePriorities[i];
+            int c = queueCreateInfoCount;
+            queuePriorities[c][0] = queueRequests[i].priority;
+            queueCreateInfos[c].flags = 0;
+            queueCreateInfos[c].pNext = VK_NULL_HANDLE;
+            queueCreateInfos[c].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            queueCreateInfos[c].queueFamilyIndex = queueFamilyIndices[i];
+            queueCreateInfos[c].queueCount = 1;
+            queueCreateInfos[c].pQueuePriorities = queuePriorities[c];
             queueCreateInfoCount += 1;
         }
     }
@@ -97,6 +103,27 @@ VKDevice::VKDevice(VKInstance* instance, VKSurface* surface, QueueRequest* queue
 
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     deviceCreateInfo.pNext = VK_NULL_HANDLE;
+
+    // bindless materials
+    descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    if (gpu.IsDescriptorIndexingSupported())
+    {
+        deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        descriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+        descriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        descriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+        deviceCreateInfo.pNext = &descriptorIndexingFeatures;
+    }
+
+    // GPU driven draws
+    if (gpu.IsDrawIndirectSupported())
+    {
+        requiredDeviceFeatures.multiDrawIndirect = VK_TRUE;
+        requiredDeviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+    }
+    if (gpu.IsDrawIndirectCountSupported())
+        deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
     deviceCreateInfo.queueCreateInfoCount = queueCreateInfoCount;
     deviceCreateInfo.pQueueCreateInfos = queueCreateInfos;
 
@@ -111,12 +138,20 @@ VKDevice::VKDevice(VKInstance* instance, VKSurface* surface, QueueRequest* queue
     // Get the device' queue
     for (int i = 0; i < requestsCount; ++i)
     {
+        if (queueFamilyIndices[i] == VK_QUEUE_FAMILY_IGNORED)
+        {
+            queues.push_back(VKCommandQueue());
+            continue;
+        }
+
         VkQueue queue = VK_NULL_HANDLE;
         uint32_t queueIndex = 0;
-        // make sure each queue is unique
+        uint32_t queueCount = queueFamilyProperties[queueFamilyIndices[i]].queueCount;
+        // make sure each queue is unique, requests beyond the family's queue count share its last queue
         for (int j = 0; j < queues.size(); ++j)
         {
-            if (queues[j].queueIndex == queueIndex)
+            if (queues[j].queueFamilyIndex == queueFamilyIndices[i] && queues[j].queueIndex == queueIndex &&
+                queueIndex + 1 < queueCount)
             {
                 queueIndex += 1;
             }
@@ -138,6 +173,11 @@ VKDevice::VKDevice(VKInstance* instance, VKSurface* surface, QueueRequest* queue
     {
         throw std::runtime_error("Could not get a valid function pointer for vkCmdPushDescriptorSetKHR");
     }
+    if (gpu.IsDrawIndirectCountSupported())
+    {
+        auto func = vkGetDeviceProcAddr(deviceHandle, "vkCmdDrawIndexedIndirectCountKHR");
+        VKExtensionFunc::vkCmdDrawIndexedIndirectCountKHR = (PFN_vkCmdDrawIndexedIndirectCountKHR)func;
+    }
 }
 
 VKDevice::~VKDevice()
@@ -17,6 +17,10 @@ public:
         VkQueueFlags flags;
         bool requireSurfaceSupport;
         float priority;
+        // the family must not support these, used to find a dedicated compute family
+        VkQueueFlags excludedFlags = 0;
+        // an optional queue that isn't found is left with a null handle instead of throwing
+        bool optional = false;
     };
 
     VKDevice(VKInstance* instance, VKSurface* surface, QueueRequest* requests, int requestsCount);
@@ -51,9 +55,12 @@ private:
     VkDevice deviceHandle;
     VKPhysicalDevice gpu;
 
-    VkPhysicalDeviceFeatures requiredDeviceFeatures{}; // no feature required yet
+    // optional features are only enabled when the gpu supports them
+    VkPhysicalDeviceFeatures requiredDeviceFeatures{};
     std::vector<const char*> deviceExtensions = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME};
+    // only chained into device creation when the gpu supports descriptor indexing
+    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures{};
 
     std::vector<VKCommandQueue> queues;
 
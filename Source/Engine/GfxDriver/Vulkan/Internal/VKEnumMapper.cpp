@@ -230,6 +230,10 @@ VkImageUsageFlags MapImageUsage(ImageUsageFlags in)
         flags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
     if (in & ImageUsage::TransferDst)
         flags |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (in & ImageUsage::Transient)
+        flags |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    if (in & ImageUsage::InputAttachment)
+        flags |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
 
     return flags;
 }
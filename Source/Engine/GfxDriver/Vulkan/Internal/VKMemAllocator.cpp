@@ -60,12 +60,46 @@ void VKMemAllocator::CreateImage(
 )
 {
     VmaAllocationCreateInfo allocationCreateInfo{};
+
+    // tile based GPUs keep transient attachments in on-chip memory, other devices don't have such a memory type
+    if (imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+    {
+        allocationCreateInfo.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+        VkResult result =
+            vmaCreateImage(allocator_vma, &imageCreateInfo, &allocationCreateInfo, &image, &allocation, allocationInfo);
+        if (result == VK_SUCCESS)
+            return;
+    }
+
     allocationCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
 
     VK_CHECK(vmaCreateImage(allocator_vma, &imageCreateInfo, &allocationCreateInfo, &image, &allocation, allocationInfo)
     );
 }
 
+void VKMemAllocator::CreateUnboundImage(
+    VkImageCreateInfo& imageCreateInfo, VkImage& image, VkMemoryRequirements& requirements
+)
+{
+    VK_CHECK(vkCreateImage(device->GetHandle(), &imageCreateInfo, VK_NULL_HANDLE, &image));
+    vkGetImageMemoryRequirements(device->GetHandle(), image, &requirements);
+}
+
+void VKMemAllocator::BindImageMemory(VkImage image, VmaAllocation allocation)
+{
+    VK_CHECK(vmaBindImageMemory(allocator_vma, allocation, image));
+}
+
+VmaAllocation VKMemAllocator::AllocateMemory(const VkMemoryRequirements& requirements)
+{
+    VmaAllocationCreateInfo allocationCreateInfo{};
+    allocationCreateInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    VK_CHECK(vmaAllocateMemory(allocator_vma, &requirements, &allocationCreateInfo, &allocation, nullptr));
+    return allocation;
+}
+
 VkBuffer VKMemAllocator::GetStageBuffer(uint32_t size, VmaAllocation& allocation, VmaAllocationInfo& allocationInfo)
 {
     VkBufferCreateInfo bufferCreateInfo{};
@@ -99,6 +133,11 @@ void VKMemAllocator::DestoryImage(VkImage image, VmaAllocation allocation)
     pendingImages.push_back({image, allocation});
 }
 
+void VKMemAllocator::FreeMemory(VmaAllocation allocation)
+{
+    pendingAllocations.push_back(allocation);
+}
+
 void VKMemAllocator::DestroyPendingResources()
 {
 
@@ -110,8 +149,14 @@ void VKMemAllocator::DestroyPendingResources()
     {
         vmaDestroyImage(allocator_vma, b.first, b.second);
     }
+    // after the images, aliased memory outlives the images bound to it
+    for (auto& a : pendingAllocations)
+    {
+        vmaFreeMemory(allocator_vma, a);
+    }
 
     pendingBuffers.clear();
     pendingImages.clear();
+    pendingAllocations.clear();
 }
 } // namespace Engine::Gfx
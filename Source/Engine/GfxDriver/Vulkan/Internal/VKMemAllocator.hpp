@@ -51,8 +51,15 @@ public:
         VmaAllocation& allocation,
         VmaAllocationInfo* allocationInfo = nullptr
     );
+    // image without memory, bind it with BindImageMemory before use
+    void CreateUnboundImage(VkImageCreateInfo& imageCreateInfo, VkImage& image, VkMemoryRequirements& requirements);
+    void BindImageMemory(VkImage image, VmaAllocation allocation);
+    // memory that satisfies all the requirements, used to alias resources
+    VmaAllocation AllocateMemory(const VkMemoryRequirements& requirements);
     void DestroyBuffer(VkBuffer buffer, VmaAllocation allocation);
+    // allocation can be nullptr if the image doesn't own its memory
     void DestoryImage(VkImage image, VmaAllocation allocation);
+    void FreeMemory(VmaAllocation allocation);
 
     void DestroyPendingResources();
 
@@ -74,5 +81,6 @@ public:
 private:
     std::vector<std::pair<VkBuffer, VmaAllocation>> pendingBuffers;
     std::vector<std::pair<VkImage, VmaAllocation>> pendingImages;
+    std::vector<VmaAllocation> pendingAllocations;
 };
 } // namespace Engine::Gfx
@@ -59,12 +59,12 @@ void VKObjectManager::DestroyShaderModule(VkShaderModule module)
 
 void VKObjectManager::CreateGraphicsPipeline(VkGraphicsPipelineCreateInfo& createInfo, VkPipeline& pipeline)
 {
-    VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &createInfo, VK_NULL_HANDLE, &pipeline));
+    VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &createInfo, VK_NULL_HANDLE, &pipeline));
 }
 
 void VKObjectManager::CreateComputePipeline(VkComputePipelineCreateInfo& createInfo, VkPipeline& pipeline)
 {
-    VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &createInfo, VK_NULL_HANDLE, &pipeline));
+    VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &createInfo, VK_NULL_HANDLE, &pipeline));
 }
 
 void VKObjectManager::DestroyPipeline(VkPipeline pipeline)
@@ -43,6 +43,12 @@ public:
         return device;
     }
 
+    // pipelines created after this call go through the given cache, VK_NULL_HANDLE disables it
+    void SetPipelineCache(VkPipelineCache cache)
+    {
+        pipelineCache = cache;
+    }
+
 private:
     std::vector<VkImageView> pendingImageViews;
     std::vector<VkRenderPass> pendingRenderPasses;
@@ -56,5 +62,6 @@ private:
     std::vector<VkSampler> pendingSamplers;
     std::vector<VkCommandPool> pendingCommandPools;
     VkDevice device;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
 };
 } // namespace Engine::Gfx
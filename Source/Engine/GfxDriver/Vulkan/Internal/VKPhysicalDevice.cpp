@@ -2,12 +2,17 @@
 #include "VKInstance.hpp"
 #include "VKSurface.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <set>
 #include <stdexcept>
 #include <string>
 #include <vector>
 namespace Engine::Gfx
 {
+// upper bound of the bindless texture array, the device limit is usually far larger than what a scene needs
+static const uint32_t MAX_BINDLESS_TEXTURE_COUNT = 4096;
+
 VKPhysicalDevice::VKPhysicalDevice(VkPhysicalDevice gpu, VKSurface* surface)
 {
     this->gpu = gpu;
@@ -24,6 +29,47 @@ VKPhysicalDevice::VKPhysicalDevice(VkPhysicalDevice gpu, VKSurface* surface)
 
     availableExtensions.resize(count);
     vkEnumerateDeviceExtensionProperties(gpu, nullptr, &count, availableExtensions.data());
+
+    QueryDescriptorIndexing();
+}
+
+bool VKPhysicalDevice::IsExtensionAvailable(const char* name) const
+{
+    for (auto& extension : availableExtensions)
+    {
+        if (std::strcmp(extension.extensionName, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+void VKPhysicalDevice::QueryDescriptorIndexing()
+{
+    // vkGetPhysicalDeviceFeatures2 is core in 1.1
+    if (physicalDeviceProperties.apiVersion < VK_API_VERSION_1_1 ||
+        !IsExtensionAvailable(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+        return;
+
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &indexingFeatures;
+    vkGetPhysicalDeviceFeatures2(gpu, &features2);
+
+    descriptorIndexingSupported = indexingFeatures.runtimeDescriptorArray &&
+                                  indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+                                  indexingFeatures.descriptorBindingPartiallyBound;
+    if (descriptorIndexingSupported)
+    {
+        // the array shares the per stage limit with the other textures of the shader
+        const VkPhysicalDeviceLimits& limits = physicalDeviceProperties.limits;
+        maxBindlessTextureCount = std::min(
+            {MAX_BINDLESS_TEXTURE_COUNT,
+             limits.maxPerStageDescriptorSampledImages / 2,
+             limits.maxDescriptorSetSampledImages / 2}
+        );
+    }
 }
 
 std::vector<VKPhysicalDevice> VKPhysicalDevice::GetAllPhysicalDevices(VKInstance* instance, VKSurface* surface)
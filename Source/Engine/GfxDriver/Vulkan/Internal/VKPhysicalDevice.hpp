@@ -17,6 +17,27 @@ public:
 
     const std::vector<VkExtensionProperties>& GetAvailableExtensions() const { return availableExtensions; }
 
+    bool IsExtensionAvailable(const char* name) const;
+
+    // runtime sized, partially bound texture arrays (VK_EXT_descriptor_indexing)
+    bool IsDescriptorIndexingSupported() const { return descriptorIndexingSupported; }
+
+    // capacity of a runtime sized texture array, 0 if descriptor indexing is not supported
+    uint32_t GetMaxBindlessTextureCount() const { return maxBindlessTextureCount; }
+
+    // indirect draws with a firstInstance and more than one draw per call (multiDrawIndirect and
+    // drawIndirectFirstInstance)
+    bool IsDrawIndirectSupported() const
+    {
+        return physicalDeviceFeatures.multiDrawIndirect && physicalDeviceFeatures.drawIndirectFirstInstance;
+    }
+
+    // draw counts read from a buffer (VK_KHR_draw_indirect_count)
+    bool IsDrawIndirectCountSupported() const
+    {
+        return IsExtensionAvailable(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+
     // const uint32_t& GetTransferQueueFamilyIndex() const { return graphicsQueueFamilyIndex; }
 
     VkPhysicalDevice GetHandle() const { return gpu; }
@@ -43,6 +64,11 @@ private:
     std::vector<VkQueueFamilyProperties> queueFamilyProperties;
     std::vector<VkExtensionProperties> availableExtensions;
 
+    bool descriptorIndexingSupported = false;
+    uint32_t maxBindlessTextureCount = 0;
+
+    void QueryDescriptorIndexing();
+
     static std::vector<VKPhysicalDevice> GetAllPhysicalDevices(VKInstance* instance, VKSurface* surface);
     void GetRequiredQueuesFamilyIndices(VKPhysicalDevice& physicalDevice);
     void QuerySurfaceData(VKInstance* attachedInstance);
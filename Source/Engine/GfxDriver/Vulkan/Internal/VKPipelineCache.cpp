@@ -0,0 +1,128 @@
+#include "VKPipelineCache.hpp"
+#include <cstring>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+namespace Engine::Gfx
+{
+VKPipelineCache::VKPipelineCache(
+    VkDevice device, const VkPhysicalDeviceProperties& properties, const std::filesystem::path& path
+)
+    : device(device), properties(properties), path(path)
+{
+    std::vector<char> initialData;
+    if (!path.empty() && std::filesystem::exists(path))
+    {
+        std::ifstream f(path, std::ios::binary);
+        FileHeader header{};
+        if (f.read((char*)&header, sizeof(FileHeader)) && IsCompatible(header))
+        {
+            // the size comes from the file, don't allocate more than the file holds
+            std::error_code error;
+            uintmax_t fileSize = std::filesystem::file_size(path, error);
+            if (error || header.dataSize > fileSize - sizeof(FileHeader))
+            {
+                SPDLOG_WARN("pipeline cache {} is truncated, discarded", path.string());
+            }
+            else
+            {
+                initialData.resize(header.dataSize);
+                if (!f.read(initialData.data(), header.dataSize))
+                {
+                    SPDLOG_WARN("pipeline cache {} is truncated, discarded", path.string());
+                    initialData.clear();
+                }
+            }
+        }
+        else
+        {
+            SPDLOG_INFO("pipeline cache {} doesn't match current device or driver, discarded", path.string());
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .initialDataSize = initialData.size(),
+        .pInitialData = initialData.empty() ? nullptr : initialData.data(),
+    };
+
+    if (vkCreatePipelineCache(device, &createInfo, VK_NULL_HANDLE, &cache) != VK_SUCCESS)
+    {
+        // the driver may still refuse the blob, start from an empty cache in that case
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        if (vkCreatePipelineCache(device, &createInfo, VK_NULL_HANDLE, &cache) != VK_SUCCESS)
+        {
+            SPDLOG_ERROR("failed to create pipeline cache");
+            cache = VK_NULL_HANDLE;
+        }
+    }
+}
+
+VKPipelineCache::~VKPipelineCache()
+{
+    if (cache != VK_NULL_HANDLE)
+        vkDestroyPipelineCache(device, cache, VK_NULL_HANDLE);
+}
+
+bool VKPipelineCache::Save()
+{
+    if (cache == VK_NULL_HANDLE || path.empty())
+        return false;
+
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(device, cache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+        return false;
+
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(device, cache, &dataSize, data.data()) != VK_SUCCESS)
+        return false;
+
+    FileHeader header{
+        .magic = MAGIC,
+        .headerVersion = HEADER_VERSION,
+        .vendorID = properties.vendorID,
+        .deviceID = properties.deviceID,
+        .driverVersion = properties.driverVersion,
+        .pipelineCacheUUID = {},
+        .dataSize = dataSize,
+    };
+    memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    std::error_code ec;
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path(), ec);
+
+    // write to a temporary file first so that a crash during saving doesn't leave a broken cache behind
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!f.write((const char*)&header, sizeof(FileHeader)) || !f.write(data.data(), dataSize))
+        {
+            SPDLOG_WARN("failed to write pipeline cache to {}", tmpPath.string());
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec)
+    {
+        SPDLOG_WARN("failed to save pipeline cache to {}: {}", path.string(), ec.message());
+        return false;
+    }
+
+    return true;
+}
+
+bool VKPipelineCache::IsCompatible(const FileHeader& header)
+{
+    return header.magic == MAGIC && header.headerVersion == HEADER_VERSION &&
+           header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+           header.driverVersion == properties.driverVersion &&
+           memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+} // namespace Engine::Gfx
@@ -0,0 +1,48 @@
+#pragma once
+#include <filesystem>
+#include <vulkan/vulkan.h>
+
+namespace Engine::Gfx
+{
+// A driver wide VkPipelineCache that persists across runs.
+// The blob on disk is prefixed by our own header so that a cache written by another gpu or driver version is rejected
+// before it reaches the driver
+class VKPipelineCache
+{
+public:
+    // path can be empty, in which case the cache lives only in memory
+    VKPipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::filesystem::path& path);
+    VKPipelineCache(const VKPipelineCache& other) = delete;
+    ~VKPipelineCache();
+
+    // write the current cache data to path, returns false if nothing is written
+    bool Save();
+
+    VkPipelineCache GetHandle()
+    {
+        return cache;
+    }
+
+private:
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t headerVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+    };
+
+    static constexpr uint32_t MAGIC = 0x4C575043; // "CPWL"
+    static constexpr uint32_t HEADER_VERSION = 1;
+
+    VkDevice device;
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties properties;
+    std::filesystem::path path;
+
+    bool IsCompatible(const FileHeader& header);
+};
+} // namespace Engine::Gfx
@@ -52,10 +52,12 @@ VKBuffer::VKBuffer(const CreateInfo& createInfo)
     vkCreateInfo.flags = 0;
     vkCreateInfo.size = size;
     vkCreateInfo.usage = usage;
-    vkCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    vkCreateInfo.queueFamilyIndexCount = 1;
-    uint32_t queueFamily = VKContext::Instance()->mainQueue->queueFamilyIndex;
-    vkCreateInfo.pQueueFamilyIndices = &queueFamily;
+    // only buffers the async compute queue uses are shared by the queue families
+    auto& queueFamilies = VKContext::Instance()->queueFamilies;
+    bool concurrent = HasFlag(createInfo.usages, BufferUsage::AsyncCompute) && queueFamilies.size() > 1;
+    vkCreateInfo.sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    vkCreateInfo.queueFamilyIndexCount = concurrent ? queueFamilies.size() : 1;
+    vkCreateInfo.pQueueFamilyIndices = queueFamilies.data();
 
     VmaAllocationCreateInfo allocationCreateInfo{};
     allocationCreateInfo.usage = vmaMemUsage;
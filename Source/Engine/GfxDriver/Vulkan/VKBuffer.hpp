@@ -1,6 +1,7 @@
 #pragma once
 #include "../Buffer.hpp"
 #include "Internal/VKMemAllocator.hpp"
+#include "VKObjectID.hpp"
 #include <cinttypes>
 
 namespace Engine::Gfx
@@ -29,6 +30,12 @@ public:
         return buffer;
     }
 
+    // see NextVKObjectID
+    uint64_t GetUniqueID() const
+    {
+        return uniqueID;
+    }
+
 private:
     std::string name;
     RefPtr<VKMemAllocator> allocator;
@@ -42,6 +49,7 @@ private:
     VmaAllocationInfo allocationInfo;
     VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
     VkAccessFlags accessMask = VK_ACCESS_MEMORY_READ_BIT;
+    uint64_t uniqueID = NextVKObjectID();
 
     void CreateBuffer();
 };
@@ -1,13 +1,17 @@
 #include "VKCommandBuffer.hpp"
 #include "Internal/VKDevice.hpp"
 #include "Internal/VKEnumMapper.hpp"
+#include "ThirdParty/xxHash/xxhash.h"
 #include "VKBuffer.hpp"
 #include "VKContext.hpp"
+#include "VKEvent.hpp"
 #include "VKExtensionFunc.hpp"
 #include "VKFrameBuffer.hpp"
+#include "VKQueryPool.hpp"
 #include "VKRenderTarget.hpp"
 #include "VKShaderProgram.hpp"
 #include "VKShaderResource.hpp"
+#include <algorithm>
 #include <spdlog/spdlog.h>
 
 #ifdef _WIN32
@@ -17,14 +21,26 @@
 namespace Engine::Gfx
 {
 
-VKCommandBuffer::VKCommandBuffer(VkCommandBuffer vkCmdBuf) : vkCmdBuf(vkCmdBuf) {}
+VKCommandBuffer::VKCommandBuffer(VkCommandBuffer vkCmdBuf, VkCommandPool commandPool)
+    : vkCmdBuf(vkCmdBuf), commandPool(commandPool), handles{vkCmdBuf}
+{}
 
 VKCommandBuffer::~VKCommandBuffer() {}
 
-void VKCommandBuffer::BeginRenderPass(Gfx::RenderPass& renderPass_, const std::vector<Gfx::ClearValue>& clearValues)
+void VKCommandBuffer::BeginRenderPass(
+    Gfx::RenderPass& renderPass_, const std::vector<Gfx::ClearValue>& clearValues, SubpassContents contents
+)
 {
     Gfx::VKRenderPass& vRenderPass = static_cast<Gfx::VKRenderPass&>(renderPass_);
     VkRenderPass vkRenderPass = vRenderPass.GetHandle();
+
+    // passes merged into one render pass each begin and end it, a later pass continues in its subpass
+    if (renderPass == &vRenderPass && renderIndex + 1 < vRenderPass.GetSubpassCount())
+    {
+        NextSubpass(clearValues, contents);
+        return;
+    }
+
     renderPass = &vRenderPass;
     renderIndex = 0;
 
@@ -51,11 +67,20 @@ void VKCommandBuffer::BeginRenderPass(Gfx::RenderPass& renderPass_, const std::v
     }
     renderPassBeginInfo.pClearValues = vkClearValues;
 
-    vkCmdBeginRenderPass(vkCmdBuf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(
+        vkCmdBuf,
+        &renderPassBeginInfo,
+        contents == SubpassContents::Inline ? VK_SUBPASS_CONTENTS_INLINE
+                                            : VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+    );
 }
 
 void VKCommandBuffer::EndRenderPass()
 {
+    // the passes merged into the later subpasses end it
+    if (renderIndex + 1 < renderPass->GetSubpassCount())
+        return;
+
     vkCmdEndRenderPass(vkCmdBuf);
     renderPass = nullptr;
 }
@@ -114,9 +139,14 @@ void VKCommandBuffer::PushDescriptor(ShaderProgram& shader, uint32_t set, std::s
         i += 1;
     }
 
+    // the pushed descriptors replace whatever set was bound at this index
+    VkPipelineBindPoint bindPoint = GetBindPoint(shader);
+    if (set < 4)
+        bound.descriptorSets[bindPoint][set] = VK_NULL_HANDLE;
+
     VKExtensionFunc::vkCmdPushDescriptorSetKHR(
         vkCmdBuf,
-        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        bindPoint,
         vkShader.GetVKPipelineLayout(),
         set,
         bindings.size(),
@@ -178,28 +208,52 @@ void VKCommandBuffer::BindResource(uint32_t set, Gfx::ShaderResource* resource_)
 
 void VKCommandBuffer::BindShaderProgram(RefPtr<Gfx::ShaderProgram> bProgram, const ShaderConfig& config)
 {
-    assert(renderPass != nullptr);
-
-    shaderProgram = (VKShaderProgram*)bProgram.Get();
-    shaderConfig = &config;
-    // setResources[0].needUpdate = true;
-    // setResources[1].needUpdate = true;
-    // setResources[2].needUpdate = true;
-    // setResources[3].needUpdate = true;
+    assert(renderPass != nullptr || bProgram->IsCompute());
 
     VKShaderProgram* program = static_cast<VKShaderProgram*>(bProgram.Get());
 
-    // binding pipeline
-    auto pipeline = program->RequestPipeline(config, renderPass->GetHandle(), renderIndex);
+    // descriptor sets are resolved per shader program, ask the bound resources again for the new program
+    if (program != shaderProgram)
+    {
+        for (auto& r : setResources)
+        {
+            if (r.resource)
+                r.needUpdate = true;
+        }
+    }
+
+    shaderProgram = program;
+    shaderConfig = &config;
 
-    if (bProgram->IsCompute())
+    // sets and push constants bound with another pipeline layout may be disturbed, forget about them. Sets only
+    // belong to the bind point of the pipeline
+    VkPipelineLayout pipelineLayout = program->GetVKPipelineLayout();
+    VkPipelineBindPoint bindPoint = GetBindPoint(*program);
+    if (pipelineLayout != bound.pipelineLayouts[bindPoint])
     {
-        vkCmdBindPipeline(vkCmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        bound.pipelineLayouts[bindPoint] = pipelineLayout;
+        for (auto& set : bound.descriptorSets[bindPoint])
+            set = VK_NULL_HANDLE;
     }
-    else
+    if (pipelineLayout != bound.pushConstantLayout)
+    {
+        bound.pushConstantLayout = pipelineLayout;
+        bound.pushConstantSize = 0;
+    }
+
+    // binding pipeline
+    VkRenderPass vkRenderPass = program->IsCompute() ? VK_NULL_HANDLE : renderPass->GetHandle();
+    auto pipeline = program->RequestPipeline(config, vkRenderPass, renderIndex);
+
+    if (pipeline == bound.pipeline)
     {
-        vkCmdBindPipeline(vkCmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        stats.pipeline.skipped += 1;
+        return;
     }
+
+    bound.pipeline = pipeline;
+    stats.pipeline.issued += 1;
+    vkCmdBindPipeline(vkCmdBuf, bindPoint, pipeline);
 }
 
 void VKCommandBuffer::SetScissor(uint32_t firstScissor, uint32_t scissorCount, Rect2D* rect)
@@ -218,20 +272,51 @@ void VKCommandBuffer::SetScissor(uint32_t firstScissor, uint32_t scissorCount, R
     vkCmdSetScissor(vkCmdBuf, firstScissor, scissorCount, vkRects);
 }
 
+void VKCommandBuffer::ClearDepthAttachment(const Rect2D& rect, float depth)
+{
+    VkClearAttachment clear{
+        .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+        .colorAttachment = 0,
+        .clearValue = {.depthStencil = {depth, 0}},
+    };
+    VkClearRect clearRect{
+        .rect = {{rect.offset.x, rect.offset.y}, {rect.extent.width, rect.extent.height}},
+        .baseArrayLayer = 0,
+        .layerCount = 1,
+    };
+    vkCmdClearAttachments(vkCmdBuf, 1, &clear, 1, &clearRect);
+}
+
 void VKCommandBuffer::BindVertexBuffer(
     std::span<const VertexBufferBinding> vertexBufferBindings, uint32_t firstBindingIndex
 )
 {
-    assert(vertexBufferBindings.size() <= 16);
+    assert(firstBindingIndex + vertexBufferBindings.size() <= 16);
     VkBuffer vkBuffers[16];
     uint64_t vkOffsets[16];
+    bool redundant = firstBindingIndex + vertexBufferBindings.size() <= bound.vertexBufferCount;
     for (uint32_t i = 0; i < vertexBufferBindings.size(); ++i)
     {
         VKBuffer* vkbuf = static_cast<VKBuffer*>(vertexBufferBindings[i].buffer);
         vkBuffers[i] = vkbuf->GetHandle();
         vkOffsets[i] = vertexBufferBindings[i].offset;
+
+        uint32_t slot = firstBindingIndex + i;
+        redundant =
+            redundant && bound.vertexBuffers[slot] == vkBuffers[i] && bound.vertexBufferOffsets[slot] == vkOffsets[i];
+        bound.vertexBuffers[slot] = vkBuffers[i];
+        bound.vertexBufferOffsets[slot] = vkOffsets[i];
     }
 
+    if (redundant)
+    {
+        stats.vertexBuffer.skipped += 1;
+        return;
+    }
+
+    bound.vertexBufferCount =
+        std::max(bound.vertexBufferCount, firstBindingIndex + (uint32_t)vertexBufferBindings.size());
+    stats.vertexBuffer.issued += 1;
     vkCmdBindVertexBuffers(vkCmdBuf, firstBindingIndex, vertexBufferBindings.size(), vkBuffers, vkOffsets);
 }
 
@@ -244,6 +329,16 @@ void VKCommandBuffer::BindIndexBuffer(
         indexBufferType == Gfx::IndexBufferType::UInt16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
 
     VkBuffer indexBuf = buffer->GetHandle();
+    if (indexBuf == bound.indexBuffer && offset == bound.indexBufferOffset && indexType == bound.indexType)
+    {
+        stats.indexBuffer.skipped += 1;
+        return;
+    }
+
+    bound.indexBuffer = indexBuf;
+    bound.indexBufferOffset = offset;
+    bound.indexType = indexType;
+    stats.indexBuffer.issued += 1;
     vkCmdBindIndexBuffer(vkCmdBuf, indexBuf, offset, indexType);
 }
 
@@ -252,12 +347,44 @@ void VKCommandBuffer::DrawIndexed(
 )
 {
     UpdateDescriptorSetBinding();
-    vkCmdDrawIndexed(vkCmdBuf, indexCount, instanceCount, firstIndex, vertexOffset, firstIndex);
+    stats.draws += 1;
+    stats.instances += instanceCount;
+    vkCmdDrawIndexed(vkCmdBuf, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+}
+
+void VKCommandBuffer::DrawIndexedIndirect(Buffer* buffer, uint64_t offset, uint32_t drawCount, uint32_t stride)
+{
+    UpdateDescriptorSetBinding();
+    stats.draws += drawCount;
+    VKBuffer* buf = static_cast<VKBuffer*>(buffer);
+    vkCmdDrawIndexedIndirect(vkCmdBuf, buf->GetHandle(), offset, drawCount, stride);
+}
+
+void VKCommandBuffer::DrawIndexedIndirectCount(
+    Buffer* buffer, uint64_t offset, Buffer* countBuffer, uint64_t countOffset, uint32_t maxDrawCount, uint32_t stride
+)
+{
+    UpdateDescriptorSetBinding();
+    // the real count is only known on the GPU
+    stats.draws += maxDrawCount;
+    VKBuffer* buf = static_cast<VKBuffer*>(buffer);
+    VKBuffer* countBuf = static_cast<VKBuffer*>(countBuffer);
+    VKExtensionFunc::vkCmdDrawIndexedIndirectCountKHR(
+        vkCmdBuf,
+        buf->GetHandle(),
+        offset,
+        countBuf->GetHandle(),
+        countOffset,
+        maxDrawCount,
+        stride
+    );
 }
 
 void VKCommandBuffer::Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
 {
     UpdateDescriptorSetBinding();
+    stats.draws += 1;
+    stats.instances += instanceCount;
     vkCmdDraw(vkCmdBuf, vertexCount, instanceCount, firstVertex, firstInstance);
 }
 
@@ -267,6 +394,73 @@ void VKCommandBuffer::NextRenderPass()
     vkCmdNextSubpass(vkCmdBuf, VK_SUBPASS_CONTENTS_INLINE);
 }
 
+void VKCommandBuffer::NextSubpass(const std::vector<Gfx::ClearValue>& clearValues, SubpassContents contents)
+{
+    renderIndex += 1;
+    bool inlineContents = contents == SubpassContents::Inline;
+    vkCmdNextSubpass(
+        vkCmdBuf,
+        inlineContents ? VK_SUBPASS_CONTENTS_INLINE : VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+    );
+
+    auto subpassClears = renderPass->GetSubpassClears(renderIndex);
+    if (subpassClears.empty())
+        return;
+
+    std::vector<VkClearAttachment> clears;
+    for (const VKRenderPass::SubpassClear& c : subpassClears)
+    {
+        VkClearAttachment clear = c.clear;
+        if (c.clearValueIndex < clearValues.size())
+            memcpy(&clear.clearValue, &clearValues[c.clearValueIndex], sizeof(VkClearValue));
+        clears.push_back(clear);
+    }
+    auto extent = renderPass->GetExtent();
+    VkClearRect rect{.rect = {{0, 0}, {extent.width, extent.height}}, .baseArrayLayer = 0, .layerCount = 1};
+
+    if (inlineContents)
+    {
+        vkCmdClearAttachments(vkCmdBuf, clears.size(), clears.data(), 1, &rect);
+        return;
+    }
+
+    // a subpass recorded from secondary command buffers can't clear inline
+    if (clearHandleIndex == clearHandles.size())
+    {
+        VkCommandBufferAllocateInfo allocInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext = VK_NULL_HANDLE,
+            .commandPool = commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1,
+        };
+        VkCommandBuffer handle;
+        vkAllocateCommandBuffers(GetDevice()->GetHandle(), &allocInfo, &handle);
+        clearHandles.push_back(handle);
+    }
+    VkCommandBuffer clearCmd = clearHandles[clearHandleIndex++];
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .renderPass = renderPass->GetHandle(),
+        .subpass = renderIndex,
+        .framebuffer = VK_NULL_HANDLE,
+        .occlusionQueryEnable = VK_FALSE,
+        .queryFlags = 0,
+        .pipelineStatistics = 0,
+    };
+    VkCommandBufferBeginInfo beginInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritanceInfo};
+    vkBeginCommandBuffer(clearCmd, &beginInfo);
+    vkCmdClearAttachments(clearCmd, clears.size(), clears.data(), 1, &rect);
+    vkEndCommandBuffer(clearCmd);
+    vkCmdExecuteCommands(vkCmdBuf, 1, &clearCmd);
+}
+
 void VKCommandBuffer::SetPushConstant(RefPtr<Gfx::ShaderProgram> shaderProgram_, void* data)
 {
     VKShaderProgram* shaderProgram = static_cast<VKShaderProgram*>(shaderProgram_.Get());
@@ -280,7 +474,26 @@ void VKCommandBuffer::SetPushConstant(RefPtr<Gfx::ShaderProgram> shaderProgram_,
         totalSize += pushConstant.data.size;
     }
 
-    vkCmdPushConstants(vkCmdBuf, shaderProgram->GetVKPipelineLayout(), stages, 0, totalSize, data);
+    // push constants survive pipeline binds as long as the layout is the same, skip data that is already there
+    VkPipelineLayout layout = shaderProgram->GetVKPipelineLayout();
+    bool cachable = totalSize <= sizeof(bound.pushConstant);
+    if (cachable && layout == bound.pushConstantLayout && totalSize == bound.pushConstantSize &&
+        memcmp(bound.pushConstant, data, totalSize) == 0)
+    {
+        stats.pushConstant.skipped += 1;
+        return;
+    }
+
+    if (cachable && layout == bound.pushConstantLayout)
+    {
+        memcpy(bound.pushConstant, data, totalSize);
+        bound.pushConstantSize = totalSize;
+    }
+    else
+        bound.pushConstantSize = 0;
+
+    stats.pushConstant.issued += 1;
+    vkCmdPushConstants(vkCmdBuf, layout, stages, 0, totalSize, data);
 }
 
 void VKCommandBuffer::CopyBuffer(
@@ -335,6 +548,42 @@ void VKCommandBuffer::CopyBufferToImage(
     );
 }
 
+void VKCommandBuffer::CopyImage(RefPtr<Gfx::Image> src, RefPtr<Gfx::Image> dst, std::span<ImageCopyRegion> regions)
+{
+    assert(!regions.empty());
+    auto mapLayers = [](const Gfx::ImageSubresourceLayers& layers)
+    {
+        return VkImageSubresourceLayers{
+            .aspectMask = MapImageAspect(layers.aspectMask),
+            .mipLevel = layers.mipLevel,
+            .baseArrayLayer = layers.baseArrayLayer,
+            .layerCount = layers.layerCount,
+        };
+    };
+
+    std::vector<VkImageCopy> vkRegions;
+    for (auto& r : regions)
+    {
+        vkRegions.push_back({
+            .srcSubresource = mapLayers(r.srcLayers),
+            .srcOffset = {r.srcOffset.x, r.srcOffset.y, r.srcOffset.z},
+            .dstSubresource = mapLayers(r.dstLayers),
+            .dstOffset = {r.dstOffset.x, r.dstOffset.y, r.dstOffset.z},
+            .extent = {r.extent.width, r.extent.height, r.extent.depth},
+        });
+    }
+
+    vkCmdCopyImage(
+        vkCmdBuf,
+        static_cast<VKImage*>(src.Get())->GetImage(),
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        static_cast<VKImage*>(dst.Get())->GetImage(),
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        vkRegions.size(),
+        vkRegions.data()
+    );
+}
+
 void VKCommandBuffer::Begin()
 {
     VkCommandBufferBeginInfo beginInfo{
@@ -343,16 +592,179 @@ void VKCommandBuffer::Begin()
         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
         .pInheritanceInfo = nullptr};
 
+    // nothing is bound on a newly begun command buffer
+    bound = {};
+    stats = {};
+    for (auto& r : setResources)
+    {
+        if (r.resource)
+            r.needUpdate = true;
+    }
+
+    vkCmdBuf = handles[0];
+    handleIndex = 0;
+    submissions.clear();
+    partWaits.clear();
+    forkSignals.clear();
+    semaphoreIndex = 0;
+    clearHandleIndex = 0;
+    renderPass = nullptr;
+    resolvedSets.Clear();
+
     vkBeginCommandBuffer(vkCmdBuf, &beginInfo);
 }
 
+void VKCommandBuffer::Begin(Gfx::RenderPass& renderPass_, uint32_t subpass)
+{
+    renderPass = static_cast<VKRenderPass*>(&renderPass_);
+    renderIndex = subpass;
+
+    // the framebuffer is optional, it's left out because the render pass may create it lazily and this can be called
+    // from several threads
+    VkCommandBufferInheritanceInfo inheritanceInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .renderPass = renderPass->GetHandle(),
+        .subpass = subpass,
+        .framebuffer = VK_NULL_HANDLE,
+        .occlusionQueryEnable = VK_FALSE,
+        .queryFlags = 0,
+        .pipelineStatistics = 0,
+    };
+    VkCommandBufferBeginInfo beginInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritanceInfo};
+
+    // resources bound in an earlier recording may be gone
+    bound = {};
+    stats = {};
+    for (auto& r : setResources)
+        r = {};
+    shaderProgram = nullptr;
+    submissions.clear();
+    partWaits.clear();
+    resolvedSets.Clear();
+
+    vkBeginCommandBuffer(vkCmdBuf, &beginInfo);
+}
+
+void VKCommandBuffer::ExecuteCommands(std::span<CommandBuffer* const> cmdBufs)
+{
+    std::vector<VkCommandBuffer> vkCmdBufs;
+    vkCmdBufs.reserve(cmdBufs.size());
+    for (CommandBuffer* c : cmdBufs)
+    {
+        auto vkCmd = static_cast<VKCommandBuffer*>(c);
+        vkCmdBufs.push_back(vkCmd->GetHandle());
+        stats += vkCmd->GetStats();
+    }
+
+    vkCmdExecuteCommands(vkCmdBuf, vkCmdBufs.size(), vkCmdBufs.data());
+
+    // the secondary command buffers leave the primary's bound state undefined
+    bound = {};
+    for (auto& r : setResources)
+    {
+        if (r.resource)
+            r.needUpdate = true;
+    }
+}
+
+void VKCommandBuffer::Fork(CommandQueue& queue, CommandBuffer& cmdBuf)
+{
+    auto& forked = static_cast<VKCommandBuffer&>(cmdBuf);
+    VkSemaphore recorded = NextSemaphore();
+    VkSemaphore finished = NextSemaphore();
+    SplitRecording({recorded}, {});
+
+    // the forked command buffer may be split itself
+    const std::vector<Submission>& forkedSubmissions = forked.GetSubmissions();
+    size_t first = submissions.size();
+    submissions.insert(submissions.end(), forkedSubmissions.begin(), forkedSubmissions.end());
+    for (size_t i = first; i < submissions.size(); ++i)
+    {
+        if (submissions[i].queue == VK_NULL_HANDLE)
+            submissions[i].queue = static_cast<VKCommandQueue&>(queue).queue;
+    }
+    submissions[first].waits.push_back(recorded);
+    submissions.back().signals.push_back(finished);
+    forkSignals.push_back(finished);
+
+    stats += forked.GetStats();
+}
+
+void VKCommandBuffer::Join()
+{
+    if (forkSignals.empty())
+        return;
+
+    SplitRecording({}, std::move(forkSignals));
+    forkSignals.clear();
+}
+
 void VKCommandBuffer::End()
 {
+    // the fence and semaphores the command buffer is submitted with also cover the forked work
+    Join();
     vkEndCommandBuffer(vkCmdBuf);
+    submissions.push_back({VK_NULL_HANDLE, vkCmdBuf, std::move(partWaits), {}});
+    partWaits.clear();
 }
 
-void VKCommandBuffer::Barrier(GPUBarrier* barriers, uint32_t barrierCount)
+VkSemaphore VKCommandBuffer::NextSemaphore()
+{
+    if (semaphoreIndex == semaphores.size())
+        semaphores.push_back(std::make_unique<VKSemaphore>(false));
+
+    return semaphores[semaphoreIndex++]->GetHandle();
+}
+
+void VKCommandBuffer::SplitRecording(std::vector<VkSemaphore>&& signals, std::vector<VkSemaphore>&& nextWaits)
+{
+    vkEndCommandBuffer(vkCmdBuf);
+    submissions.push_back({VK_NULL_HANDLE, vkCmdBuf, std::move(partWaits), std::move(signals)});
+    partWaits = std::move(nextWaits);
+
+    handleIndex += 1;
+    if (handleIndex == handles.size())
+    {
+        VkCommandBufferAllocateInfo allocInfo{
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext = VK_NULL_HANDLE,
+            .commandPool = commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        VkCommandBuffer handle;
+        vkAllocateCommandBuffers(GetDevice()->GetHandle(), &allocInfo, &handle);
+        handles.push_back(handle);
+    }
+    vkCmdBuf = handles[handleIndex];
+
+    VkCommandBufferBeginInfo beginInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr};
+    vkBeginCommandBuffer(vkCmdBuf, &beginInfo);
+
+    // state doesn't carry over to another command buffer
+    bound = {};
+    for (auto& r : setResources)
+    {
+        if (r.resource)
+            r.needUpdate = true;
+    }
+}
+
+void VKCommandBuffer::CollectBarriers(GPUBarrier* barriers, uint32_t barrierCount)
 {
+    imageMemoryBarriers.clear();
+    bufferMemoryBarriers.clear();
+    memoryMemoryBarriers.clear();
+
     for (int i = 0; i < barrierCount; ++i)
     {
         const GPUBarrier& barrier = barriers[i];
@@ -370,18 +782,7 @@ void VKCommandBuffer::Barrier(GPUBarrier* barriers, uint32_t barrierCount)
             memoryBarrier.buffer = buffer->GetHandle();
             memoryBarrier.offset = 0;
             memoryBarrier.size = VK_WHOLE_SIZE;
-            vkCmdPipelineBarrier(
-                vkCmdBuf,
-                MapPipelineStage(barrier.srcStageMask),
-                MapPipelineStage(barrier.dstStageMask),
-                VK_DEPENDENCY_BY_REGION_BIT,
-                0,
-                VK_NULL_HANDLE,
-                1,
-                &memoryBarrier,
-                0,
-                VK_NULL_HANDLE
-            );
+            bufferMemoryBarriers.push_back(memoryBarrier);
         }
         else if (barrier.image != nullptr)
         {
@@ -412,19 +813,7 @@ void VKCommandBuffer::Barrier(GPUBarrier* barriers, uint32_t barrierCount)
             vkBarrier.dstQueueFamilyIndex = barrier.imageInfo.dstQueueFamilyIndex;
             vkBarrier.image = image->GetImage();
             vkBarrier.subresourceRange = range;
-
-            vkCmdPipelineBarrier(
-                vkCmdBuf,
-                MapPipelineStage(barrier.srcStageMask),
-                MapPipelineStage(barrier.dstStageMask),
-                VK_DEPENDENCY_BY_REGION_BIT,
-                0,
-                VK_NULL_HANDLE,
-                0,
-                VK_NULL_HANDLE,
-                1,
-                &vkBarrier
-            );
+            imageMemoryBarriers.push_back(vkBarrier);
 
             image->NotifyLayoutChange(vkBarrier.newLayout);
         }
@@ -436,22 +825,131 @@ void VKCommandBuffer::Barrier(GPUBarrier* barriers, uint32_t barrierCount)
             memBarrier.srcAccessMask = MapAccessMask(barrier.srcAccessMask);
             memBarrier.dstAccessMask = MapAccessMask(barrier.dstAccessMask);
             memoryMemoryBarriers.push_back(memBarrier);
-            vkCmdPipelineBarrier(
-                vkCmdBuf,
-                MapPipelineStage(barrier.srcStageMask),
-                MapPipelineStage(barrier.dstStageMask),
-                VK_DEPENDENCY_DEVICE_GROUP_BIT,
-                1,
-                &memBarrier,
-                0,
-                VK_NULL_HANDLE,
-                0,
-                VK_NULL_HANDLE
-            );
         }
     }
 }
 
+void VKCommandBuffer::Barrier(GPUBarrier* barriers, uint32_t barrierCount)
+{
+    CollectBarriers(barriers, barrierCount);
+
+    // barriers with the same stages are recorded by one vkCmdPipelineBarrier, layout transitions of a subresource
+    // stay in order
+    std::vector<uint32_t> batches = BatchBarriers({barriers, barrierCount});
+    uint32_t batchCount = barrierCount == 0 ? 0 : *std::max_element(batches.begin(), batches.end()) + 1;
+
+    std::vector<VkMemoryBarrier> memBarriers;
+    std::vector<VkBufferMemoryBarrier> bufBarriers;
+    std::vector<VkImageMemoryBarrier> imgBarriers;
+    for (uint32_t batch = 0; batch < batchCount; ++batch)
+    {
+        memBarriers.clear();
+        bufBarriers.clear();
+        imgBarriers.clear();
+
+        PipelineStageFlags srcStages = PipelineStage::None;
+        PipelineStageFlags dstStages = PipelineStage::None;
+        uint32_t memIndex = 0;
+        uint32_t bufIndex = 0;
+        uint32_t imgIndex = 0;
+        for (uint32_t i = 0; i < barrierCount; ++i)
+        {
+            bool match = batches[i] == batch;
+            if (match)
+            {
+                srcStages = barriers[i].srcStageMask;
+                dstStages = barriers[i].dstStageMask;
+            }
+
+            if (barriers[i].buffer != nullptr)
+            {
+                if (match)
+                    bufBarriers.push_back(bufferMemoryBarriers[bufIndex]);
+                bufIndex += 1;
+            }
+            else if (barriers[i].image != nullptr)
+            {
+                if (match)
+                    imgBarriers.push_back(imageMemoryBarriers[imgIndex]);
+                imgIndex += 1;
+            }
+            else
+            {
+                if (match)
+                    memBarriers.push_back(memoryMemoryBarriers[memIndex]);
+                memIndex += 1;
+            }
+        }
+
+        vkCmdPipelineBarrier(
+            vkCmdBuf,
+            MapPipelineStage(srcStages),
+            MapPipelineStage(dstStages),
+            VK_DEPENDENCY_BY_REGION_BIT,
+            memBarriers.size(),
+            memBarriers.data(),
+            bufBarriers.size(),
+            bufBarriers.data(),
+            imgBarriers.size(),
+            imgBarriers.data()
+        );
+    }
+}
+
+void VKCommandBuffer::SetEvent(Event& event, PipelineStageFlags stages)
+{
+    vkCmdSetEvent(vkCmdBuf, static_cast<VKEvent&>(event).GetHandle(), MapPipelineStage(stages));
+}
+
+void VKCommandBuffer::ResetEvent(Event& event, PipelineStageFlags stages)
+{
+    vkCmdResetEvent(vkCmdBuf, static_cast<VKEvent&>(event).GetHandle(), MapPipelineStage(stages));
+}
+
+void VKCommandBuffer::WaitEvents(
+    std::span<Event* const> events, PipelineStageFlags srcStages, GPUBarrier* barriers, uint32_t barrierCount
+)
+{
+    std::vector<VkEvent> vkEvents;
+    for (Event* e : events)
+        vkEvents.push_back(static_cast<VKEvent*>(e)->GetHandle());
+
+    PipelineStageFlags dstStages = PipelineStage::None;
+    for (uint32_t i = 0; i < barrierCount; ++i)
+        dstStages |= barriers[i].dstStageMask;
+
+    CollectBarriers(barriers, barrierCount);
+    vkCmdWaitEvents(
+        vkCmdBuf,
+        vkEvents.size(),
+        vkEvents.data(),
+        MapPipelineStage(srcStages),
+        MapPipelineStage(dstStages),
+        memoryMemoryBarriers.size(),
+        memoryMemoryBarriers.data(),
+        bufferMemoryBarriers.size(),
+        bufferMemoryBarriers.data(),
+        imageMemoryBarriers.size(),
+        imageMemoryBarriers.data()
+    );
+}
+
+void VKCommandBuffer::ResetQueryPool(QueryPool& queryPool, uint32_t first, uint32_t count)
+{
+    vkCmdResetQueryPool(vkCmdBuf, static_cast<VKQueryPool&>(queryPool).GetHandle(), first, count);
+}
+
+void VKCommandBuffer::WriteTimestamp(QueryPool& queryPool, uint32_t query, PipelineStageFlags stage)
+{
+    // stage is a single stage
+    vkCmdWriteTimestamp(
+        vkCmdBuf,
+        (VkPipelineStageFlagBits)MapPipelineStage(stage),
+        static_cast<VKQueryPool&>(queryPool).GetHandle(),
+        query
+    );
+}
+
 void VKCommandBuffer::CopyImageToBuffer(
     RefPtr<Gfx::Image> src, RefPtr<Gfx::Buffer> dst, std::span<BufferImageCopyRegion> regions
 )
@@ -489,7 +987,11 @@ void VKCommandBuffer::CopyImageToBuffer(
 
 void VKCommandBuffer::Reset(bool releaseResource)
 {
-    vkResetCommandBuffer(vkCmdBuf, releaseResource ? VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT : 0);
+    for (VkCommandBuffer handle : handles)
+        vkResetCommandBuffer(handle, releaseResource ? VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT : 0);
+    for (VkCommandBuffer handle : clearHandles)
+        vkResetCommandBuffer(handle, releaseResource ? VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT : 0);
+    vkCmdBuf = handles[0];
 }
 
 void VKCommandBuffer::Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
@@ -509,25 +1011,52 @@ void VKCommandBuffer::UpdateDescriptorSetBinding(uint32_t index)
 {
     if (setResources[index].needUpdate && setResources[index].resource)
     {
-        auto sourceSet = setResources[index].resource->GetDescriptorSet(index, shaderProgram);
-        if (sourceSet != VK_NULL_HANDLE && sourceSet != bindedDescriptorSets[index])
+        auto sourceSet = ResolveDescriptorSet(index, setResources[index].resource);
+        if (sourceSet == VK_NULL_HANDLE)
+            return;
+
+        setResources[index].needUpdate = false;
+        VkPipelineBindPoint bindPoint = GetBindPoint(*shaderProgram);
+        if (sourceSet == bound.descriptorSets[bindPoint][index])
         {
-            bindedDescriptorSets[index] = sourceSet;
-            vkCmdBindDescriptorSets(
-                vkCmdBuf,
-                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                shaderProgram->GetVKPipelineLayout(),
-                index,
-                1,
-                &bindedDescriptorSets[index],
-                0,
-                VK_NULL_HANDLE
-            );
-            setResources[index].needUpdate = false;
+            stats.descriptorSet.skipped += 1;
+            return;
         }
+
+        bound.descriptorSets[bindPoint][index] = sourceSet;
+        stats.descriptorSet.issued += 1;
+        vkCmdBindDescriptorSets(
+            vkCmdBuf,
+            bindPoint,
+            shaderProgram->GetVKPipelineLayout(),
+            index,
+            1,
+            &bound.descriptorSets[bindPoint][index],
+            0,
+            VK_NULL_HANDLE
+        );
     }
 }
 
+VkDescriptorSet VKCommandBuffer::ResolveDescriptorSet(uint32_t set, VKShaderResource* resource)
+{
+    uintptr_t key[3] = {(uintptr_t)resource, (uintptr_t)shaderProgram, set};
+    uint64_t hash = XXH64(key, sizeof(key), 0);
+    ResolvedSet* resolved = resolvedSets.Find(hash);
+    if (resolved && resolved->resource == resource && resolved->program == shaderProgram && resolved->set == set &&
+        resolved->version == resource->GetVersion())
+        return resolved->descriptorSet;
+
+    VkDescriptorSet descriptorSet = resource->GetDescriptorSet(set, shaderProgram);
+    resolvedSets.Insert(hash, {resource, shaderProgram, set, resource->GetVersion(), descriptorSet});
+    return descriptorSet;
+}
+
+VkPipelineBindPoint VKCommandBuffer::GetBindPoint(ShaderProgram& program)
+{
+    return program.IsCompute() ? VK_PIPELINE_BIND_POINT_COMPUTE : VK_PIPELINE_BIND_POINT_GRAPHICS;
+}
+
 void VKCommandBuffer::UpdateDescriptorSetBinding()
 {
     UpdateDescriptorSetBinding(0);
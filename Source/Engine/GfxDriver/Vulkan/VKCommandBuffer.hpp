@@ -2,9 +2,12 @@
 #include "../CommandBuffer.hpp"
 #include "Internal/VKMemAllocator.hpp"
 #include "Internal/VKObjectManager.hpp"
+#include "Libs/FlatHashMap.hpp"
 #include "VKRenderPass.hpp"
 #include "VKRenderTarget.hpp"
+#include "VKSemaphore.hpp"
 #include <functional>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan.h>
@@ -17,11 +20,16 @@ class VKDevice;
 class VKCommandBuffer : public CommandBuffer
 {
 public:
-    VKCommandBuffer(VkCommandBuffer vkCmdBuf);
+    // further command buffers are allocated from commandPool when Fork or Join split the recording
+    VKCommandBuffer(VkCommandBuffer vkCmdBuf, VkCommandPool commandPool);
     VKCommandBuffer(const VKCommandBuffer& other) = delete;
     ~VKCommandBuffer();
 
-    void BeginRenderPass(Gfx::RenderPass& renderPass, const std::vector<Gfx::ClearValue>& clearValues) override;
+    void BeginRenderPass(
+        Gfx::RenderPass& renderPass,
+        const std::vector<Gfx::ClearValue>& clearValues,
+        SubpassContents contents = SubpassContents::Inline
+    ) override;
     void EndRenderPass() override;
 
     void Blit(RefPtr<Gfx::Image> from, RefPtr<Gfx::Image> to, BlitOp blitOp = {}) override;
@@ -37,11 +45,21 @@ public:
     void DrawIndexed(
         uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, uint32_t vertexOffset, uint32_t firstInstance
     ) override;
+    void DrawIndexedIndirect(Buffer* buffer, uint64_t offset, uint32_t drawCount, uint32_t stride) override;
+    void DrawIndexedIndirectCount(
+        Buffer* buffer,
+        uint64_t offset,
+        Buffer* countBuffer,
+        uint64_t countOffset,
+        uint32_t maxDrawCount,
+        uint32_t stride
+    ) override;
     void SetViewport(const Viewport& viewport) override;
     void CopyImageToBuffer(RefPtr<Gfx::Image> src, RefPtr<Gfx::Buffer> dst, std::span<BufferImageCopyRegion> regions)
         override;
     void SetPushConstant(RefPtr<Gfx::ShaderProgram> shaderProgram, void* data) override;
     void SetScissor(uint32_t firstScissor, uint32_t scissorCount, Rect2D* rect) override;
+    void ClearDepthAttachment(const Rect2D& rect, float depth) override;
     void Draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) override;
     void Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) override;
     void DispatchIndir(Buffer* buffer, size_t bufferOffset) override;
@@ -52,24 +70,92 @@ public:
         override;
     void CopyBufferToImage(RefPtr<Gfx::Buffer> src, RefPtr<Gfx::Image> dst, std::span<BufferImageCopyRegion> regions)
         override;
+    void CopyImage(RefPtr<Gfx::Image> src, RefPtr<Gfx::Image> dst, std::span<ImageCopyRegion> regions) override;
     void Barrier(GPUBarrier* barriers, uint32_t barrierCount) override;
+    void SetEvent(Event& event, PipelineStageFlags stages) override;
+    void ResetEvent(Event& event, PipelineStageFlags stages) override;
+    void WaitEvents(
+        std::span<Event* const> events, PipelineStageFlags srcStages, GPUBarrier* barriers, uint32_t barrierCount
+    ) override;
+    void ResetQueryPool(QueryPool& queryPool, uint32_t first, uint32_t count) override;
+    void WriteTimestamp(QueryPool& queryPool, uint32_t query, PipelineStageFlags stage) override;
     void Begin() override;
+    void Begin(Gfx::RenderPass& renderPass, uint32_t subpass) override;
+    void ExecuteCommands(std::span<CommandBuffer* const> cmdBufs) override;
+    void Fork(CommandQueue& queue, CommandBuffer& cmdBuf) override;
+    void Join() override;
     void End() override;
     void Reset(bool releaseResource) override;
 
+    const CommandBufferStats& GetStats() override
+    {
+        return stats;
+    }
+
     VkCommandBuffer GetHandle() const
     {
         return vkCmdBuf;
     }
 
+    // a part of the recording with the semaphores it waits for and signals
+    struct Submission
+    {
+        // VK_NULL_HANDLE for the queue the command buffer is submitted to
+        VkQueue queue;
+        VkCommandBuffer cmd;
+        std::vector<VkSemaphore> waits;
+        std::vector<VkSemaphore> signals;
+    };
+
+    // valid after End, the parts Fork and Join split the recording into in submission order
+    const std::vector<Submission>& GetSubmissions()
+    {
+        return submissions;
+    }
+
 private:
+    // the handle being recorded into
     VkCommandBuffer vkCmdBuf;
+    VkCommandPool commandPool;
+    // the handle the command buffer was allocated with and the ones allocated for split recordings
+    std::vector<VkCommandBuffer> handles;
+    uint32_t handleIndex = 0;
+    std::vector<Submission> submissions;
+    // waited for by the part being recorded
+    std::vector<VkSemaphore> partWaits;
+    // signaled by forked command buffers that aren't joined yet
+    std::vector<VkSemaphore> forkSignals;
+    // every semaphore is signaled and waited for once per recording, they are reused after Begin
+    std::vector<std::unique_ptr<VKSemaphore>> semaphores;
+    uint32_t semaphoreIndex = 0;
+    // secondary command buffers clearing the attachments of subpasses recorded from secondary command buffers
+    std::vector<VkCommandBuffer> clearHandles;
+    uint32_t clearHandleIndex = 0;
 
     std::vector<VkImageMemoryBarrier> imageMemoryBarriers;
     std::vector<VkBufferMemoryBarrier> bufferMemoryBarriers;
     std::vector<VkMemoryBarrier> memoryMemoryBarriers;
 
-    VkDescriptorSet bindedDescriptorSets[4];
+    // the state that is currently set on vkCmdBuf, used to drop redundant binding calls
+    struct BoundState
+    {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        // graphics and compute have their own sets, indexed by VkPipelineBindPoint
+        VkPipelineLayout pipelineLayouts[2] = {};
+        VkDescriptorSet descriptorSets[2][4] = {};
+        uint32_t vertexBufferCount = 0;
+        VkBuffer vertexBuffers[16] = {};
+        uint64_t vertexBufferOffsets[16] = {};
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        uint64_t indexBufferOffset = 0;
+        VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+        // push constants are shared by the bind points
+        VkPipelineLayout pushConstantLayout = VK_NULL_HANDLE;
+        uint32_t pushConstantSize = 0;
+        uint8_t pushConstant[256];
+    } bound;
+    CommandBufferStats stats;
+
     VKRenderPass* renderPass = nullptr;
     uint32_t renderIndex = -1;
 
@@ -80,11 +166,32 @@ private:
         VKShaderResource* resource = VK_NULL_HANDLE;
     } setResources[4] = {};
 
-    VKShaderProgram* shaderProgram;
+    VKShaderProgram* shaderProgram = nullptr;
     const ShaderConfig* shaderConfig;
+
+    // descriptor sets resolved during this recording. A command buffer is recorded by one thread at a time, so a
+    // hit doesn't lock anything, the resource is only asked (and locked) again when it changed
+    struct ResolvedSet
+    {
+        VKShaderResource* resource;
+        VKShaderProgram* program;
+        uint32_t set;
+        uint64_t version;
+        VkDescriptorSet descriptorSet;
+    };
+    FlatHashMap<ResolvedSet> resolvedSets;
     bool needUpdateDescriptorSetBinding;
 
+    // fill imageMemoryBarriers, bufferMemoryBarriers and memoryMemoryBarriers, image layouts are tracked in order
+    void CollectBarriers(GPUBarrier* barriers, uint32_t barrierCount);
     void UpdateDescriptorSetBinding();
     void UpdateDescriptorSetBinding(uint32_t set);
+    static VkPipelineBindPoint GetBindPoint(ShaderProgram& program);
+    VkDescriptorSet ResolveDescriptorSet(uint32_t set, VKShaderResource* resource);
+    VkSemaphore NextSemaphore();
+    // continue a render pass several passes were merged into, clears the attachments the subpass uses first
+    void NextSubpass(const std::vector<Gfx::ClearValue>& clearValues, SubpassContents contents);
+    // end the handle being recorded into and continue in the next one
+    void SplitRecording(std::vector<VkSemaphore>&& signals, std::vector<VkSemaphore>&& nextWaits);
 };
 } // namespace Engine::Gfx
@@ -35,7 +35,7 @@ std::vector<UniPtr<Gfx::CommandBuffer>> VKCommandPool::AllocateCommandBuffers(Co
     std::vector<UniPtr<Gfx::CommandBuffer>> rlt;
     for (int i = 0; i < count; ++i)
     {
-        rlt.push_back(MakeUnique<VKCommandBuffer>(cmdBufsTemp[i]));
+        rlt.push_back(MakeUnique<VKCommandBuffer>(cmdBufsTemp[i], commandPool));
     }
 
     delete[] cmdBufsTemp;
@@ -6,6 +6,7 @@
 #include "Libs/Ptr.hpp"
 #include "VKDescriptorPool.hpp"
 #include "VKSharedResource.hpp"
+#include <vector>
 namespace Engine::Gfx
 {
 class VKDevice;
@@ -24,6 +25,10 @@ public:
     RefPtr<VKSharedResource> sharedResource;
     RefPtr<VKSwapChain> swapchain;
     RefPtr<const VKCommandQueue> mainQueue;
+    // null if the device has no compute queue of its own
+    RefPtr<const VKCommandQueue> asyncComputeQueue;
+    // the main family first. Images and buffers with the AsyncCompute usage are shared by all of them
+    std::vector<uint32_t> queueFamilies;
     RefPtr<VKDescriptorPoolCache> descriptorPoolCache;
 
 private:
@@ -6,7 +6,11 @@
 
 namespace Engine::Gfx
 {
-VKDescriptorPool::VKDescriptorPool(RefPtr<VKContext> context, VkDescriptorSetLayoutCreateInfo& layoutCreateInfo)
+VKDescriptorPool::VKDescriptorPool(
+    RefPtr<VKContext> context,
+    VkDescriptorSetLayoutCreateInfo& layoutCreateInfo,
+    const VkDescriptorBindingFlags* bindingFlags
+)
     : context(context)
 {
     std::unordered_map<VkDescriptorType, uint32_t> poolSizesMap;
@@ -21,7 +25,18 @@ VKDescriptorPool::VKDescriptorPool(RefPtr<VKContext> context, VkDescriptorSetLay
         poolSizes.push_back({iter.first, iter.second});
     }
 
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo{};
+    if (bindingFlags)
+    {
+        bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        bindingFlagsCreateInfo.pNext = layoutCreateInfo.pNext;
+        bindingFlagsCreateInfo.bindingCount = layoutCreateInfo.bindingCount;
+        bindingFlagsCreateInfo.pBindingFlags = bindingFlags;
+        layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+    }
     context->objManager->CreateDescriptorSetLayout(layoutCreateInfo, layout);
+    if (bindingFlags)
+        layoutCreateInfo.pNext = bindingFlagsCreateInfo.pNext;
 }
 
 VKDescriptorPool::~VKDescriptorPool()
@@ -42,16 +57,19 @@ VKDescriptorPool::~VKDescriptorPool()
 
 VKDescriptorPool::VKDescriptorPool(VKDescriptorPool&& other)
     : createInfo(other.createInfo), layout(std::exchange(other.layout, VK_NULL_HANDLE)),
-      poolSizes(std::exchange(other.poolSizes, {})), context(other.context),
+      poolSizes(std::exchange(other.poolSizes, {})), scaledPoolSizes(std::exchange(other.scaledPoolSizes, {})),
+      context(other.context),
       fullPools(std::exchange(other.fullPools, {})), freeSets(std::exchange(other.freeSets, {})),
+      retiredSets{std::exchange(other.retiredSets[0], {}), std::exchange(other.retiredSets[1], {})},
       freePool(std::exchange(other.freePool, VK_NULL_HANDLE))
 {
-    createInfo.poolSizeCount = this->poolSizes.size();
-    createInfo.pPoolSizes = this->poolSizes.data();
+    createInfo.poolSizeCount = this->scaledPoolSizes.size();
+    createInfo.pPoolSizes = this->scaledPoolSizes.data();
 }
 
 VkDescriptorSet VKDescriptorPool::Allocate()
 {
+    std::lock_guard lock(mutex);
     if (!freeSets.empty())
     {
         auto set = freeSets.back();
@@ -89,18 +107,28 @@ VkDescriptorSet VKDescriptorPool::Allocate()
     return set;
 }
 
+void VKDescriptorPool::RecycleRetiredSets()
+{
+    std::lock_guard lock(mutex);
+    freeSets.insert(freeSets.end(), retiredSets[1].begin(), retiredSets[1].end());
+    retiredSets[1].clear();
+    std::swap(retiredSets[0], retiredSets[1]);
+}
+
 VkDescriptorPool VKDescriptorPool::CreateNewPool()
 {
     createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     createInfo.pNext = VK_NULL_HANDLE;
     createInfo.flags = 0;
     createInfo.maxSets = createInfo.maxSets == 0 ? 2 : createInfo.maxSets * 2;
-    for (auto& poolSize : poolSizes)
+    // scale from the per set count, scaling the previous pool's count compounds and gets huge for bindless arrays
+    scaledPoolSizes = poolSizes;
+    for (auto& poolSize : scaledPoolSizes)
     {
         poolSize.descriptorCount *= createInfo.maxSets;
     }
-    createInfo.poolSizeCount = this->poolSizes.size();
-    createInfo.pPoolSizes = this->poolSizes.data();
+    createInfo.poolSizeCount = this->scaledPoolSizes.size();
+    createInfo.pPoolSizes = this->scaledPoolSizes.data();
 
     // this can happen when we have an empty descriptor set with zero binding
     VkDescriptorPoolSize dummyPoolSize;
@@ -118,22 +146,50 @@ VkDescriptorPool VKDescriptorPool::CreateNewPool()
 }
 
 VKDescriptorPool& VKDescriptorPoolCache::RequestDescriptorPool(
-    const std::string& shaderName, VkDescriptorSetLayoutCreateInfo createInfo
+    const std::string& shaderName,
+    VkDescriptorSetLayoutCreateInfo createInfo,
+    const VkDescriptorBindingFlags* bindingFlags
 )
 {
-    auto it = descriptorLayoutPoolCache.find(createInfo);
+    DescriptorPoolKey key{createInfo, {}};
+    if (bindingFlags)
+        key.bindingFlags.assign(bindingFlags, bindingFlags + createInfo.bindingCount);
+
+    auto it = descriptorLayoutPoolCache.find(key);
     if (it != descriptorLayoutPoolCache.end())
     {
         return it->second;
     }
     else
     {
-        auto pair =
-            descriptorLayoutPoolCache.emplace(std::make_pair(createInfo, VKDescriptorPool(context, createInfo)));
+        auto pair = descriptorLayoutPoolCache.emplace(
+            std::make_pair(std::move(key), VKDescriptorPool(context, createInfo, bindingFlags))
+        );
         return pair.first->second;
     }
 }
 
+void VKDescriptorPoolCache::RecycleRetiredSets()
+{
+    for (auto& iter : descriptorLayoutPoolCache)
+    {
+        iter.second.RecycleRetiredSets();
+    }
+}
+
+bool DescriptorPoolKey::operator==(const DescriptorPoolKey& other) const
+{
+    return createInfo == other.createInfo && bindingFlags == other.bindingFlags;
+}
+
+std::size_t DescriptorPoolKeyHash::operator()(const DescriptorPoolKey& k) const
+{
+    size_t hash = VkDescriptorSetLayoutCreateInfoHash{}(k.createInfo);
+    if (!k.bindingFlags.empty())
+        hash ^= XXH64(k.bindingFlags.data(), k.bindingFlags.size() * sizeof(VkDescriptorBindingFlags), 0);
+    return hash;
+}
+
 std::size_t VkDescriptorSetLayoutCreateInfoHash::operator()(const VkDescriptorSetLayoutCreateInfo& c) const
 {
     using std::size_t;
@@ -1,5 +1,6 @@
 #pragma once
 #include "Libs/Ptr.hpp"
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -10,7 +11,12 @@ class VKContext;
 class VKDescriptorPool
 {
 public:
-    VKDescriptorPool(RefPtr<VKContext> context, VkDescriptorSetLayoutCreateInfo& layoutCreateInfo);
+    // bindingFlags is optional, one entry per binding of layoutCreateInfo
+    VKDescriptorPool(
+        RefPtr<VKContext> context,
+        VkDescriptorSetLayoutCreateInfo& layoutCreateInfo,
+        const VkDescriptorBindingFlags* bindingFlags = nullptr
+    );
     VKDescriptorPool(const VKDescriptorPool& other) = delete;
     VKDescriptorPool(VKDescriptorPool&& other);
     VkDescriptorSetLayout GetLayout()
@@ -19,22 +25,34 @@ public:
     }
     VkDescriptorSet Allocate();
 
+    // the set may still be referenced by frames in flight, it's handed out again only after RecycleRetiredSets has
+    // been called twice
     void Free(VkDescriptorSet set)
     {
-        freeSets.push_back(set);
+        std::lock_guard lock(mutex);
+        retiredSets[0].push_back(set);
     }
 
+    // called once per frame after the fence of the previous frame is signaled
+    void RecycleRetiredSets();
+
     ~VKDescriptorPool();
 
 private:
     VkDescriptorPoolCreateInfo createInfo{};
     VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    // descriptor count of a single set
     std::vector<VkDescriptorPoolSize> poolSizes;
+    std::vector<VkDescriptorPoolSize> scaledPoolSizes;
     RefPtr<VKContext> context;
 
     std::vector<VkDescriptorPool> fullPools{};
     std::vector<VkDescriptorSet> freeSets;
+    // [0]: retired during the frame being recorded, [1]: retired during the frame that is in flight
+    std::vector<VkDescriptorSet> retiredSets[2];
     VkDescriptorPool freePool = VK_NULL_HANDLE;
+    // the pool is shared by the resources of every shader with this layout, they may be resolved from several threads
+    std::mutex mutex;
 
     VkDescriptorPool CreateNewPool();
 };
@@ -44,16 +62,36 @@ struct VkDescriptorSetLayoutCreateInfoHash
     std::size_t operator()(const VkDescriptorSetLayoutCreateInfo& c) const;
 };
 
+// layouts with the same bindings but different binding flags need their own pool
+struct DescriptorPoolKey
+{
+    VkDescriptorSetLayoutCreateInfo createInfo;
+    // one entry per binding, empty when no binding has flags
+    std::vector<VkDescriptorBindingFlags> bindingFlags;
+
+    bool operator==(const DescriptorPoolKey& other) const;
+};
+
+struct DescriptorPoolKeyHash
+{
+    std::size_t operator()(const DescriptorPoolKey& k) const;
+};
+
 // TODO: this is bad, too many pools are created
 struct VKDescriptorPoolCache
 {
     VKDescriptorPoolCache(RefPtr<VKContext> context) : context(context) {}
-    VKDescriptorPool& RequestDescriptorPool(const std::string& shaderName, VkDescriptorSetLayoutCreateInfo createInfo);
+    // bindingFlags is optional, one entry per binding of createInfo
+    VKDescriptorPool& RequestDescriptorPool(
+        const std::string& shaderName,
+        VkDescriptorSetLayoutCreateInfo createInfo,
+        const VkDescriptorBindingFlags* bindingFlags = nullptr
+    );
+    void RecycleRetiredSets();
 
 private:
     // we hash manually and use std::size_t as key to avoid dangling pointer of createInfo
-    std::unordered_map<VkDescriptorSetLayoutCreateInfo, VKDescriptorPool, VkDescriptorSetLayoutCreateInfoHash>
-        descriptorLayoutPoolCache;
+    std::unordered_map<DescriptorPoolKey, VKDescriptorPool, DescriptorPoolKeyHash> descriptorLayoutPoolCache;
     RefPtr<VKContext> context;
 
 private:
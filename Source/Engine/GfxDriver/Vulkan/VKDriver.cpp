@@ -7,12 +7,16 @@
 #include "Internal/VKMemAllocator.hpp"
 #include "Internal/VKObjectManager.hpp"
 #include "Internal/VKPhysicalDevice.hpp"
+#include "Internal/VKPipelineCache.hpp"
 #include "Internal/VKSurface.hpp"
 #include "Internal/VKSwapChain.hpp"
 #include "VKBuffer.hpp"
 #include "VKCommandPool.hpp"
 #include "VKContext.hpp"
+#include "VKEvent.hpp"
+#include "VKExtensionFunc.hpp"
 #include "VKFence.hpp"
+#include "VKQueryPool.hpp"
 #include "VKShaderModule.hpp"
 #include "VKShaderResource.hpp"
 
@@ -36,6 +40,7 @@
 #endif
 #if defined(_WIN32) || defined(_WIN64)
 #undef CreateSemaphore
+#undef CreateEvent
 #endif
 
 namespace Engine::Gfx
@@ -56,15 +61,37 @@ VKDriver::VKDriver(const CreateInfo& createInfo)
     instance = new VKInstance(appWindow->GetVkRequiredExtensions());
     surface = new VKSurface(*instance, appWindow);
     VKDevice::QueueRequest queueRequest[] = {
-        {VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT, true, 1}};
+        {VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT, true, 1},
+        // async compute, only a family without graphics runs next to the main queue
+        {VK_QUEUE_COMPUTE_BIT, false, 1, VK_QUEUE_GRAPHICS_BIT, true},
+    };
     device = new VKDevice(instance, surface, queueRequest, sizeof(queueRequest) / sizeof(VKDevice::QueueRequest));
     context->device = device;
     mainQueue = &device->GetQueue(0);
     context->mainQueue = mainQueue;
+    context->queueFamilies = {mainQueue->queueFamilyIndex};
+    if (device->GetQueue(1).queue != VK_NULL_HANDLE)
+    {
+        asyncComputeQueue = &device->GetQueue(1);
+        context->asyncComputeQueue = asyncComputeQueue;
+        context->queueFamilies.push_back(asyncComputeQueue->queueFamilyIndex);
+    }
     gpu = &device->GetGPU();
+    gpuFeatures.descriptorIndexing = gpu->IsDescriptorIndexingSupported();
+    gpuFeatures.asyncCompute = asyncComputeQueue != nullptr;
+    auto& queueFamilies = gpu->GetQueueFamilyProperties();
+    gpuFeatures.timestamps = queueFamilies[mainQueue->queueFamilyIndex].timestampValidBits != 0 &&
+                             (asyncComputeQueue == nullptr ||
+                              queueFamilies[asyncComputeQueue->queueFamilyIndex].timestampValidBits != 0);
+    gpuFeatures.timestampPeriod = gpu->GetPhysicalDeviceProperties().limits.timestampPeriod;
+    gpuFeatures.drawIndirect = gpu->IsDrawIndirectSupported();
+    gpuFeatures.drawIndirectCount = VKExtensionFunc::vkCmdDrawIndexedIndirectCountKHR != nullptr;
     device_vk = device->GetHandle();
     objectManager = new VKObjectManager(device_vk);
     context->objManager = objectManager;
+    pipelineCache =
+        MakeUnique1<VKPipelineCache>(device_vk, gpu->GetPhysicalDeviceProperties(), createInfo.pipelineCachePath);
+    objectManager->SetPipelineCache(pipelineCache->GetHandle());
 
     // Create other objects
     memAllocator = new VKMemAllocator(instance->GetHandle(), device, gpu->GetHandle(), mainQueue->queueFamilyIndex);
@@ -198,6 +225,8 @@ VKDriver::~VKDriver()
 
     descriptorPoolCache = nullptr;
     objectManager->DestroyPendingResources();
+    pipelineCache->Save();
+    pipelineCache = nullptr;
     commandPool = nullptr;
     inFlightFrame.imageAcquireSemaphore = nullptr;
     SamplerCachePool::DestroyPool();
@@ -337,6 +366,16 @@ UniPtr<Fence> VKDriver::CreateFence(const Fence::CreateInfo& createInfo)
     return MakeUnique1<VKFence>(createInfo);
 }
 
+std::unique_ptr<Event> VKDriver::CreateEvent()
+{
+    return std::make_unique<VKEvent>();
+}
+
+std::unique_ptr<QueryPool> VKDriver::CreateTimestampQueryPool(uint32_t queryCount)
+{
+    return std::make_unique<VKQueryPool>(queryCount);
+}
+
 UniPtr<Buffer> VKDriver::CreateBuffer(const Buffer::CreateInfo& createInfo)
 {
     return MakeUnique1<VKBuffer>(createInfo);
@@ -356,6 +395,16 @@ UniPtr<Image> VKDriver::CreateImage(const ImageDescription& description, ImageUs
 {
     return MakeUnique1<VKImage>(description, usages);
 }
+
+std::vector<std::unique_ptr<Image>> VKDriver::CreateAliasedImages(
+    std::span<const ImageDescription> descriptions, std::span<const ImageUsageFlags> usages
+)
+{
+    std::vector<std::unique_ptr<Image>> images;
+    for (auto& image : VKImage::CreateAliased(descriptions, usages))
+        images.push_back(std::move(image));
+    return images;
+}
 UniPtr<ShaderProgram> VKDriver::CreateShaderProgram(
     const std::string& name,
     std::shared_ptr<const ShaderConfig> config,
@@ -373,7 +422,10 @@ RefPtr<CommandQueue> VKDriver::GetQueue(QueueType type)
     switch (type)
     {
         case Engine::QueueType::Main: return static_cast<CommandQueue*>(mainQueue.Get());
+        case Engine::QueueType::AsyncCompute: return static_cast<CommandQueue*>(asyncComputeQueue.Get());
     }
+
+    return nullptr;
 }
 
 void VKDriver::QueueSubmit(
@@ -385,49 +437,83 @@ void VKDriver::QueueSubmit(
     RefPtr<Fence> signalFence
 )
 {
-    std::vector<VkSemaphore> vkWaitSemaphores;
-    std::vector<VkSemaphore> vkSignalSemaphores;
-    std::vector<VkPipelineStageFlags> vkPipelineStageFlags;
-    std::vector<VkCommandBuffer> vkCmdBufs;
+    auto vkqueue = static_cast<VKCommandQueue*>(queue.Get());
 
-    for (auto w : waitSemaphores)
+    // command buffers split by Fork and Join become several batches, consecutive parts without semaphores between
+    // them share one
+    struct Batch
     {
-        auto vkWaitSemaphore = static_cast<VKSemaphore*>(w.Get());
-        vkWaitSemaphores.push_back(vkWaitSemaphore->GetHandle());
-    }
-
-    for (auto s : signalSemaphroes)
+        VkQueue queue;
+        std::vector<VkSemaphore> waits;
+        std::vector<VkPipelineStageFlags> waitStages;
+        std::vector<VkCommandBuffer> cmdBufs;
+        std::vector<VkSemaphore> signals;
+    };
+    std::vector<Batch> batches;
+    for (auto c : cmdBufs)
     {
-        auto vkSignalSemaphore = static_cast<VKSemaphore*>(s.Get());
-        vkSignalSemaphores.push_back(vkSignalSemaphore->GetHandle());
+        for (const VKCommandBuffer::Submission& s : static_cast<VKCommandBuffer*>(c)->GetSubmissions())
+        {
+            VkQueue q = s.queue == VK_NULL_HANDLE ? vkqueue->queue : s.queue;
+            if (batches.empty() || batches.back().queue != q || !batches.back().signals.empty() || !s.waits.empty())
+                batches.push_back({q});
+
+            Batch& batch = batches.back();
+            batch.waits.insert(batch.waits.end(), s.waits.begin(), s.waits.end());
+            batch.waitStages.resize(batch.waits.size(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+            batch.cmdBufs.push_back(s.cmd);
+            batch.signals.insert(batch.signals.end(), s.signals.begin(), s.signals.end());
+        }
     }
+    if (batches.empty())
+        batches.push_back({vkqueue->queue});
 
-    for (auto p : waitDstStageMasks)
+    // a wait also covers the batches submitted after it, a signal the ones before it on the same queue. The first and
+    // the last part are always on the queue the command buffers are submitted to
+    for (size_t i = 0; i < waitSemaphores.size(); ++i)
     {
-        vkPipelineStageFlags.push_back(MapPipelineStage(p));
+        batches.front().waits.push_back(static_cast<VKSemaphore*>(waitSemaphores[i].Get())->GetHandle());
+        batches.front().waitStages.push_back(MapPipelineStage(waitDstStageMasks[i]));
     }
 
-    for (auto c : cmdBufs)
+    for (auto s : signalSemaphroes)
     {
-        vkCmdBufs.push_back(static_cast<VKCommandBuffer*>(c)->GetHandle());
+        batches.back().signals.push_back(static_cast<VKSemaphore*>(s.Get())->GetHandle());
     }
 
-    auto vkqueue = static_cast<VKCommandQueue*>(queue.Get());
+    VkFence fence = signalFence == nullptr ? VK_NULL_HANDLE : static_cast<VKFence*>(signalFence.Get())->GetHandle();
 
-    VkSubmitInfo submitInfo;
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pNext = VK_NULL_HANDLE;
-    submitInfo.waitSemaphoreCount = vkWaitSemaphores.size();
-    submitInfo.pWaitSemaphores = vkWaitSemaphores.data();
-    submitInfo.pWaitDstStageMask = vkPipelineStageFlags.data();
-    submitInfo.commandBufferCount = vkCmdBufs.size();
-    submitInfo.pCommandBuffers = vkCmdBufs.data();
-    submitInfo.signalSemaphoreCount = vkSignalSemaphores.size();
-    submitInfo.pSignalSemaphores = vkSignalSemaphores.data();
+    std::vector<VkSubmitInfo> submitInfos;
+    for (size_t begin = 0; begin < batches.size();)
+    {
+        size_t end = begin + 1;
+        while (end < batches.size() && batches[end].queue == batches[begin].queue)
+            end += 1;
 
-    VkFence fence = signalFence == nullptr ? VK_NULL_HANDLE : static_cast<VKFence*>(signalFence.Get())->GetHandle();
+        submitInfos.clear();
+        for (size_t i = begin; i < end; ++i)
+        {
+            VkSubmitInfo submitInfo;
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.pNext = VK_NULL_HANDLE;
+            submitInfo.waitSemaphoreCount = batches[i].waits.size();
+            submitInfo.pWaitSemaphores = batches[i].waits.data();
+            submitInfo.pWaitDstStageMask = batches[i].waitStages.data();
+            submitInfo.commandBufferCount = batches[i].cmdBufs.size();
+            submitInfo.pCommandBuffers = batches[i].cmdBufs.data();
+            submitInfo.signalSemaphoreCount = batches[i].signals.size();
+            submitInfo.pSignalSemaphores = batches[i].signals.data();
+            submitInfos.push_back(submitInfo);
+        }
 
-    vkQueueSubmit(vkqueue->queue, 1, &submitInfo, fence);
+        vkQueueSubmit(
+            batches[begin].queue,
+            submitInfos.size(),
+            submitInfos.data(),
+            end == batches.size() ? fence : VK_NULL_HANDLE
+        );
+        begin = end;
+    }
 }
 
 UniPtr<CommandPool> VKDriver::CreateCommandPool(const CommandPool::CreateInfo& createInfo)
@@ -478,6 +564,7 @@ void VKDriver::ClearResources()
 {
     context->objManager->DestroyPendingResources();
     context->allocator->DestroyPendingResources();
+    descriptorPoolCache->RecycleRetiredSets();
 }
 
 std::unique_ptr<ShaderResource> VKDriver::CreateShaderResource()
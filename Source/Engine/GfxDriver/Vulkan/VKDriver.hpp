@@ -30,6 +30,7 @@ class VKFrameBuffer;
 class VKRenderPass;
 class VKSharedResource;
 class VKContext;
+class VKPipelineCache;
 struct VKDescriptorPoolCache;
 class VKDriver : public Gfx::GfxDriver
 {
@@ -69,12 +70,17 @@ public:
 
     virtual UniPtr<Semaphore> CreateSemaphore(const Semaphore::CreateInfo& createInfo) override;
     virtual UniPtr<Fence> CreateFence(const Fence::CreateInfo& createInfo) override;
+    std::unique_ptr<Event> CreateEvent() override;
+    std::unique_ptr<QueryPool> CreateTimestampQueryPool(uint32_t queryCount) override;
     UniPtr<Buffer> CreateBuffer(const Buffer::CreateInfo& createInfo) override;
     std::unique_ptr<ShaderResource> CreateShaderResource() override;
     std::unique_ptr<ImageView> CreateImageView(const ImageView::CreateInfo& createInfo) override;
     UniPtr<RenderPass> CreateRenderPass() override;
     UniPtr<FrameBuffer> CreateFrameBuffer(RefPtr<RenderPass> renderPass) override;
     UniPtr<Image> CreateImage(const ImageDescription& description, ImageUsageFlags usages) override;
+    std::vector<std::unique_ptr<Image>> CreateAliasedImages(
+        std::span<const ImageDescription> descriptions, std::span<const ImageUsageFlags> usages
+    ) override;
     UniPtr<ShaderProgram> CreateShaderProgram(
         const std::string& name,
         std::shared_ptr<const ShaderConfig> config,
@@ -108,6 +114,7 @@ private:
 
     VKMemAllocator* memAllocator;
     VKObjectManager* objectManager;
+    UniPtr<VKPipelineCache> pipelineCache;
 
     VkDevice device_vk;
     VKSwapChainImage* swapChainImage;
@@ -115,6 +122,7 @@ private:
     UniPtr<VKSharedResource> sharedResource;
     UniPtr<VKDescriptorPoolCache> descriptorPoolCache;
     RefPtr<VKCommandQueue> mainQueue;
+    RefPtr<VKCommandQueue> asyncComputeQueue;
 
     UniPtr<VKCommandPool> commandPool;
 
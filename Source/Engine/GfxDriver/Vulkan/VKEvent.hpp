@@ -0,0 +1,27 @@
+#pragma once
+#include "../Event.hpp"
+#include "VKContext.hpp"
+#include <vulkan/vulkan.h>
+
+namespace Engine::Gfx
+{
+class VKEvent : public Event
+{
+public:
+    VKEvent()
+    {
+        VkEventCreateInfo vkCreateInfo;
+        vkCreateInfo.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO;
+        vkCreateInfo.pNext = VK_NULL_HANDLE;
+        vkCreateInfo.flags = 0;
+        vkCreateEvent(GetDevice()->GetHandle(), &vkCreateInfo, VK_NULL_HANDLE, &vkEvent);
+    }
+
+    ~VKEvent() { vkDestroyEvent(GetDevice()->GetHandle(), vkEvent, VK_NULL_HANDLE); }
+
+    VkEvent GetHandle() const { return vkEvent; }
+
+private:
+    VkEvent vkEvent;
+};
+} // namespace Engine::Gfx
@@ -3,4 +3,5 @@
 namespace Engine::Gfx
 {
 PFN_vkCmdPushDescriptorSetKHR VKExtensionFunc::vkCmdPushDescriptorSetKHR = nullptr;
+PFN_vkCmdDrawIndexedIndirectCountKHR VKExtensionFunc::vkCmdDrawIndexedIndirectCountKHR = nullptr;
 }
@@ -7,5 +7,7 @@ class VKExtensionFunc
 {
 public:
     static PFN_vkCmdPushDescriptorSetKHR vkCmdPushDescriptorSetKHR;
+    // null when VK_KHR_draw_indirect_count is not supported
+    static PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR;
 };
 } // namespace Engine::Gfx
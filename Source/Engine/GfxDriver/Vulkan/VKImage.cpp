@@ -8,6 +8,8 @@
 #include "VKImageView.hpp"
 #include <vma/vk_mem_alloc.h>
 
+#include <algorithm>
+#include <cassert>
 #include <spdlog/spdlog.h>
 
 namespace Engine::Gfx
@@ -15,7 +17,7 @@ namespace Engine::Gfx
 
 VKImage::VKImage() : imageView(nullptr){};
 VKImage::VKImage(const ImageDescription& imageDescription, ImageUsageFlags usageFlags)
-    : usageFlags(MapImageUsage(usageFlags)), imageDescription(imageDescription), imageView(nullptr)
+    : usageFlags(MapImageUsage(usageFlags)), usages(usageFlags), imageDescription(imageDescription), imageView(nullptr)
 {
     format_vk = MapFormat(imageDescription.format);
 
@@ -31,7 +33,8 @@ VKImage::VKImage(const ImageDescription& imageDescription, ImageUsageFlags usage
 }
 
 VKImage::VKImage(VkImage image, const ImageDescription& imageDescription, ImageUsageFlags usageFlags)
-    : usageFlags(MapImageUsage(usageFlags)), image_vk(image), imageDescription(imageDescription), imageView(nullptr)
+    : usageFlags(MapImageUsage(usageFlags)), usages(usageFlags), image_vk(image), imageDescription(imageDescription),
+      imageView(nullptr)
 {
     format_vk = MapFormat(imageDescription.format);
 
@@ -46,8 +49,9 @@ VKImage::VKImage(VkImage image, const ImageDescription& imageDescription, ImageU
 
 VKImage::VKImage(VKImage&& other)
     : arrayLayers(other.arrayLayers), imageType_vk(other.imageType_vk), usageFlags(other.usageFlags),
-      image_vk(std::exchange(other.image_vk, VK_NULL_HANDLE)),
-      allocation_vma(std::exchange(other.allocation_vma, VK_NULL_HANDLE)), layout(other.layout),
+      usages(other.usages), image_vk(std::exchange(other.image_vk, VK_NULL_HANDLE)),
+      allocation_vma(std::exchange(other.allocation_vma, VK_NULL_HANDLE)),
+      sharedAllocation(std::move(other.sharedAllocation)), memorySize(other.memorySize), layout(other.layout),
       stageMask(other.stageMask), accessMask(other.accessMask), imageDescription(other.imageDescription),
       imageView(std::exchange(other.imageView, VK_NULL_HANDLE))
 {}
@@ -56,11 +60,76 @@ VKImage::~VKImage()
 {
     if (image_vk != VK_NULL_HANDLE && allocation_vma != nullptr)
         VKContext::Instance()->allocator->DestoryImage(image_vk, allocation_vma);
+    else if (image_vk != VK_NULL_HANDLE && sharedAllocation != nullptr)
+        VKContext::Instance()->allocator->DestoryImage(image_vk, nullptr);
 }
 
-void VKImage::MakeVkObjects()
+std::vector<std::unique_ptr<VKImage>> VKImage::CreateAliased(
+    std::span<const ImageDescription> descriptions, std::span<const ImageUsageFlags> usages
+)
+{
+    assert(descriptions.size() == usages.size());
+    auto allocator = VKContext::Instance()->allocator;
+
+    std::vector<std::unique_ptr<VKImage>> images;
+    std::vector<VKImage*> sharing;
+    VkMemoryRequirements sharedRequirements{.size = 0, .alignment = 1, .memoryTypeBits = ~0u};
+    for (size_t i = 0; i < descriptions.size(); ++i)
+    {
+        std::unique_ptr<VKImage> image(new VKImage());
+        image->usageFlags = MapImageUsage(usages[i]);
+        image->usages = usages[i];
+        image->imageDescription = descriptions[i];
+        image->format_vk = MapFormat(descriptions[i].format);
+        image->arrayLayers = descriptions[i].isCubemap ? 6 : 1;
+
+        VkImageCreateInfo imageCreateInfo = image->GetVkImageCreateInfo();
+        VkMemoryRequirements requirements;
+        allocator->CreateUnboundImage(imageCreateInfo, image->image_vk, requirements);
+        image->memorySize = requirements.size;
+
+        if ((sharedRequirements.memoryTypeBits & requirements.memoryTypeBits) != 0)
+        {
+            sharedRequirements.size = std::max(sharedRequirements.size, requirements.size);
+            sharedRequirements.alignment = std::max(sharedRequirements.alignment, requirements.alignment);
+            sharedRequirements.memoryTypeBits &= requirements.memoryTypeBits;
+            sharing.push_back(image.get());
+        }
+        else
+        {
+            // no memory type suits both, the image keeps its own memory
+            image->allocation_vma = allocator->AllocateMemory(requirements);
+            allocator->BindImageMemory(image->image_vk, image->allocation_vma);
+        }
+
+        images.push_back(std::move(image));
+    }
+
+    if (!sharing.empty())
+    {
+        std::shared_ptr<VmaAllocation_T> sharedAllocation(
+            allocator->AllocateMemory(sharedRequirements),
+            [](VmaAllocation allocation) { VKContext::Instance()->allocator->FreeMemory(allocation); }
+        );
+
+        for (VKImage* image : sharing)
+        {
+            allocator->BindImageMemory(image->image_vk, sharedAllocation.get());
+            image->sharedAllocation = sharedAllocation;
+        }
+    }
+
+    for (auto& image : images)
+    {
+        image->CreateImageView();
+        image->SetName("Unnamed");
+    }
+
+    return images;
+}
+
+VkImageCreateInfo VKImage::GetVkImageCreateInfo()
 {
-    // create the image
     VkImageCreateInfo imageCreateInfo;
     imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageCreateInfo.pNext = VK_NULL_HANDLE;
@@ -73,13 +142,24 @@ void VKImage::MakeVkObjects()
     imageCreateInfo.samples = MapSampleCount(imageDescription.multiSampling);
     imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageCreateInfo.usage = usageFlags;
-    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageCreateInfo.queueFamilyIndexCount = 1;
-    imageCreateInfo.pQueueFamilyIndices = &VKContext::Instance()->mainQueue->queueFamilyIndex;
+    // concurrent sharing can turn off compression, images the async compute queue doesn't use stay on the main family
+    auto& queueFamilies = VKContext::Instance()->queueFamilies;
+    bool concurrent = (usages & ImageUsage::AsyncCompute) && queueFamilies.size() > 1;
+    imageCreateInfo.sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    imageCreateInfo.queueFamilyIndexCount = concurrent ? queueFamilies.size() : 1;
+    imageCreateInfo.pQueueFamilyIndices = queueFamilies.data();
     imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    return imageCreateInfo;
+}
+
+void VKImage::MakeVkObjects()
+{
+    // create the image
+    VkImageCreateInfo imageCreateInfo = GetVkImageCreateInfo();
     layout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     VKContext::Instance()->allocator->CreateImage(imageCreateInfo, image_vk, allocation_vma, &allocationInfo_vma);
+    memorySize = allocationInfo_vma.size;
 }
 
 void VKImage::CreateImageView()
@@ -11,6 +11,8 @@
 #include <vulkan/vulkan.h>
 
 #include <cinttypes>
+#include <memory>
+#include <span>
 #include <string>
 #include <vector>
 namespace Engine::Gfx
@@ -24,6 +26,12 @@ public:
     VKImage(const VKImage& other) = delete;
     VKImage(VKImage&& other);
     ~VKImage() override;
+
+    // images bound to one allocation, sized for the largest of them
+    static std::vector<std::unique_ptr<VKImage>> CreateAliased(
+        std::span<const ImageDescription> descriptions, std::span<const ImageUsageFlags> usages
+    );
+
     ImageView& GetDefaultImageView() override;
     virtual VkImageView GetDefaultVkImageView();
     virtual VkImage GetImage()
@@ -41,6 +49,14 @@ public:
         return imageDescription;
     }
     virtual ImageSubresourceRange GetSubresourceRange() override;
+    uint64_t GetMemorySize() override
+    {
+        return memorySize;
+    }
+    ImageUsageFlags GetUsages() override
+    {
+        return usages;
+    }
 
     virtual VkImageSubresourceRange GetDefaultSubresourceRange();
     virtual void SetName(std::string_view name) override;
@@ -56,12 +72,16 @@ protected:
     uint32_t arrayLayers = 1;
     VkImageType imageType_vk = VK_IMAGE_TYPE_2D;
     VkImageUsageFlags usageFlags;
+    ImageUsageFlags usages = 0;
     VkImage image_vk = VK_NULL_HANDLE;
     VkFormat format_vk = VK_FORMAT_UNDEFINED;
     VkImageSubresourceRange defaultSubResourceRange;
 
     VmaAllocationInfo allocationInfo_vma;
     VmaAllocation allocation_vma = nullptr;
+    // set instead of allocation_vma when the memory is aliased with other images
+    std::shared_ptr<VmaAllocation_T> sharedAllocation;
+    VkDeviceSize memorySize = 0;
 
     VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
     VkPipelineStageFlags stageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
@@ -72,6 +92,7 @@ protected:
 
     ImageViewType GenerateDefaultImageViewViewType();
     ImageSubresourceRange GenerateDefaultSubresourceRange();
+    VkImageCreateInfo GetVkImageCreateInfo();
     void MakeVkObjects();
     void CreateImageView();
 };
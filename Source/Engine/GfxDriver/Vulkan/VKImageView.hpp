@@ -1,6 +1,7 @@
 #pragma once
 #include "../ImageView.hpp"
 #include "VKImage.hpp"
+#include "VKObjectID.hpp"
 #include <vulkan/vulkan.h>
 
 namespace Engine::Gfx
@@ -38,6 +39,12 @@ public:
 
     virtual VkImageSubresourceRange GetVkSubresourceRange();
 
+    // see NextVKObjectID
+    uint64_t GetUniqueID() const
+    {
+        return uniqueID;
+    }
+
     ImageViewType GetImageViewType() override
     {
         return imageViewType;
@@ -50,5 +57,6 @@ protected:
     VkImageView handle = VK_NULL_HANDLE;
     ImageSubresourceRange subresourceRange;
     ImageViewType imageViewType;
+    uint64_t uniqueID = NextVKObjectID();
 };
 } // namespace Engine::Gfx
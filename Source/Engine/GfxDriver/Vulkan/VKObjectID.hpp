@@ -0,0 +1,14 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace Engine::Gfx
+{
+// The driver can hand out the handle of a destroyed object to a new one. Caches that may outlive the objects they
+// refer to key on these ids as well, an id is never reused
+inline uint64_t NextVKObjectID()
+{
+    static std::atomic<uint64_t> next = 1;
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+} // namespace Engine::Gfx
@@ -0,0 +1,48 @@
+#pragma once
+#include "../QueryPool.hpp"
+#include "VKContext.hpp"
+#include <vulkan/vulkan.h>
+
+namespace Engine::Gfx
+{
+class VKQueryPool : public QueryPool
+{
+public:
+    VKQueryPool(uint32_t queryCount) : queryCount(queryCount)
+    {
+        VkQueryPoolCreateInfo vkCreateInfo;
+        vkCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        vkCreateInfo.pNext = VK_NULL_HANDLE;
+        vkCreateInfo.flags = 0;
+        vkCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        vkCreateInfo.queryCount = queryCount;
+        vkCreateInfo.pipelineStatistics = 0;
+        vkCreateQueryPool(GetDevice()->GetHandle(), &vkCreateInfo, VK_NULL_HANDLE, &vkQueryPool);
+    }
+
+    ~VKQueryPool() { vkDestroyQueryPool(GetDevice()->GetHandle(), vkQueryPool, VK_NULL_HANDLE); }
+
+    uint32_t GetQueryCount() override { return queryCount; }
+
+    bool GetResults(uint32_t first, std::span<uint64_t> results) override
+    {
+        VkResult result = vkGetQueryPoolResults(
+            GetDevice()->GetHandle(),
+            vkQueryPool,
+            first,
+            results.size(),
+            results.size_bytes(),
+            results.data(),
+            sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT
+        );
+        return result == VK_SUCCESS;
+    }
+
+    VkQueryPool GetHandle() const { return vkQueryPool; }
+
+private:
+    VkQueryPool vkQueryPool;
+    uint32_t queryCount;
+};
+} // namespace Engine::Gfx
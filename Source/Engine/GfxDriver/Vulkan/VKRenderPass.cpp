@@ -5,6 +5,7 @@
 #include "VKContext.hpp"
 #include "VKImage.hpp"
 #include "VKImageView.hpp"
+#include <algorithm>
 #include <spdlog/spdlog.h>
 #include <vulkan/vulkan.h>
 namespace Engine::Gfx
@@ -20,9 +21,46 @@ VKRenderPass::~VKRenderPass()
         VKContext::Instance()->objManager->DestroyFramebuffer(fb);
 }
 
-void VKRenderPass::AddSubpass(const std::vector<Attachment>& colors, std::optional<Attachment> depth)
+void VKRenderPass::AddSubpass(
+    const std::vector<Attachment>& colors, std::optional<Attachment> depth, const std::vector<Attachment>& inputs
+)
 {
-    subpasses.emplace_back(colors, depth);
+    subpasses.emplace_back(colors, depth, inputs);
+}
+
+std::vector<ImageView*> VKRenderPass::CollectAttachments(std::vector<std::vector<uint32_t>>* refs)
+{
+    std::vector<ImageView*> views;
+    auto indexOf = [&views](ImageView* view)
+    {
+        for (uint32_t i = 0; i < views.size(); ++i)
+        {
+            if (&views[i]->GetImage() == &view->GetImage() &&
+                views[i]->GetSubresourceRange() == view->GetSubresourceRange())
+                return i;
+        }
+
+        views.push_back(view);
+        return (uint32_t)views.size() - 1;
+    };
+
+    if (refs)
+        refs->clear();
+    for (auto& subpass : subpasses)
+    {
+        std::vector<uint32_t> subpassRefs;
+        for (Attachment& colorAtta : subpass.colors)
+            subpassRefs.push_back(indexOf(colorAtta.imageView));
+        if (subpass.depth != std::nullopt)
+            subpassRefs.push_back(indexOf(subpass.depth->imageView));
+        for (Attachment& inputAtta : subpass.inputs)
+            subpassRefs.push_back(indexOf(inputAtta.imageView));
+
+        if (refs)
+            refs->push_back(std::move(subpassRefs));
+    }
+
+    return views;
 }
 
 VkFramebuffer VKRenderPass::CreateFrameBuffer()
@@ -33,30 +71,17 @@ VkFramebuffer VKRenderPass::CreateFrameBuffer()
     createInfo.flags = 0;
     createInfo.renderPass = renderPass;
 
-    VkImageView imageViews[64] = {};
-    uint32_t attaIndex = 0;
     // same way to order pAttachments as in CreateRenderPass
-    for (auto& subpass : subpasses)
+    std::vector<ImageView*> attachments = CollectAttachments();
+    std::vector<VkImageView> imageViews;
+    for (ImageView* attachment : attachments)
     {
-        // color attachments
-        for (Attachment& colorAtta : subpass.colors)
+        if (swapChainProxy == nullptr)
         {
-            VKImageView* imageView = static_cast<VKImageView*>(colorAtta.imageView);
-            if (swapChainProxy == nullptr)
-            {
-                swapChainProxy = dynamic_cast<VKSwapChainImage*>(&colorAtta.imageView->GetImage());
-            }
-
-            imageViews[attaIndex] = imageView->GetHandle();
-            attaIndex += 1;
+            swapChainProxy = dynamic_cast<VKSwapChainImage*>(&attachment->GetImage());
         }
 
-        // depth attachment
-        if (subpass.depth != std::nullopt)
-        {
-            imageViews[attaIndex] = static_cast<VKImageView*>(subpass.depth->imageView)->GetHandle();
-            attaIndex += 1;
-        }
+        imageViews.push_back(static_cast<VKImageView*>(attachment)->GetHandle());
     }
 
     VKImageView* firstImageView = static_cast<VKImageView*>(
@@ -64,8 +89,8 @@ VkFramebuffer VKRenderPass::CreateFrameBuffer()
                                          : subpasses.front().colors.front().imageView
     );
 
-    createInfo.attachmentCount = attaIndex;
-    createInfo.pAttachments = imageViews;
+    createInfo.attachmentCount = imageViews.size();
+    createInfo.pAttachments = imageViews.data();
 
     Gfx::Image* image = subpasses[0].colors.empty() ? nullptr : &subpasses[0].colors[0].imageView->GetImage();
     if (image == nullptr)
@@ -89,103 +114,156 @@ void VKRenderPass::CreateRenderPass()
     createInfo.pNext = VK_NULL_HANDLE;
     createInfo.flags = 0;
 
-    VkAttachmentDescription attachmentDescriptions[64];
+    std::vector<std::vector<uint32_t>> refs;
+    std::vector<ImageView*> attachments = CollectAttachments(&refs);
+    assert(attachments.size() <= 64);
+    assert(subpasses.size() <= 64);
 
-    uint32_t attachmentCount = 0;
-    for (auto& subpass : subpasses)
+    VkAttachmentDescription attachmentDescriptions[64];
+    // the subpasses an attachment is first and last used in
+    int firstUses[64];
+    int lastUses[64];
+    bool stored[64] = {};
+    std::fill(std::begin(firstUses), std::end(firstUses), -1);
+
+    // references are filled before pointers to them are taken
+    std::vector<std::vector<VkAttachmentReference>> colorRefs(subpasses.size());
+    std::vector<VkAttachmentReference> depthRefs(subpasses.size());
+    std::vector<std::vector<VkAttachmentReference>> inputRefs(subpasses.size());
+    std::vector<std::vector<uint32_t>> preserves(subpasses.size());
+    subpassClears.assign(subpasses.size(), {});
+
+    auto use = [&](int subpassIndex, uint32_t index, Attachment& atta, VkImageLayout layout, bool input)
     {
-        attachmentCount += subpass.colors.size();
-        if (subpass.depth != std::nullopt)
+        VkAttachmentDescription& desc = attachmentDescriptions[index];
+        auto& image = atta.imageView->GetImage();
+        if (firstUses[index] == -1)
         {
-            attachmentCount += 1;
+            firstUses[index] = subpassIndex;
+            desc.flags = 0;
+            desc.format = MapFormat(image.GetDescription().format);
+            desc.samples = MapSampleCount(image.GetDescription().multiSampling);
+            desc.loadOp = input ? VK_ATTACHMENT_LOAD_OP_LOAD : MapAttachmentLoadOp(atta.loadOp);
+            desc.stencilLoadOp = input ? VK_ATTACHMENT_LOAD_OP_LOAD : MapAttachmentLoadOp(atta.stencilLoadOp);
+            desc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+            desc.initialLayout = layout;
         }
-    }
-    assert(attachmentCount <= 64);
-
-    createInfo.attachmentCount = attachmentCount;
-    createInfo.pAttachments = attachmentDescriptions;
 
-    VkSubpassDescription subpassDescriptions[64];
-    VkAttachmentReference attachmentReference[128];
-    assert(subpasses.size() <= 64);
+        if (!input)
+        {
+            desc.storeOp = MapAttachmentStoreOp(atta.storeOp);
+            desc.stencilStoreOp = MapAttachmentStoreOp(atta.storeOp);
+            stored[index] = true;
+        }
+        desc.finalLayout = layout;
+        lastUses[index] = subpassIndex;
+    };
 
-    uint32_t subpassDescIndex = 0;
-    uint32_t attachmentDescIndex = 0;
-    uint32_t refIndex = 0;
-    for (auto& subpass : subpasses)
+    for (int subpassIndex = 0; subpassIndex < subpasses.size(); ++subpassIndex)
     {
-        subpassDescriptions[subpassDescIndex].flags = 0;
-        subpassDescriptions[subpassDescIndex].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpassDescriptions[subpassDescIndex].inputAttachmentCount = 0;
-        subpassDescriptions[subpassDescIndex].pInputAttachments = VK_NULL_HANDLE;
-        subpassDescriptions[subpassDescIndex].pResolveAttachments = VK_NULL_HANDLE;
-        subpassDescriptions[subpassDescIndex].preserveAttachmentCount = 0;
-        subpassDescriptions[subpassDescIndex].pPreserveAttachments = VK_NULL_HANDLE;
-
-        // color attachments
-        subpassDescriptions[subpassDescIndex].colorAttachmentCount = subpass.colors.size();
-        subpassDescriptions[subpassDescIndex].pColorAttachments = attachmentReference + refIndex;
+        Subpass& subpass = subpasses[subpassIndex];
+        uint32_t refIndex = 0;
+
         for (Attachment& colorAtta : subpass.colors)
         {
-            attachmentDescriptions[attachmentDescIndex].flags = 0;
-            auto& image = colorAtta.imageView->GetImage();
-            auto format = MapFormat(image.GetDescription().format);
-            attachmentDescriptions[attachmentDescIndex].format = format;
-
-            attachmentDescriptions[attachmentDescIndex].samples = MapSampleCount(image.GetDescription().multiSampling);
-            attachmentDescriptions[attachmentDescIndex].loadOp = MapAttachmentLoadOp(colorAtta.loadOp);
-            attachmentDescriptions[attachmentDescIndex].storeOp = MapAttachmentStoreOp(colorAtta.storeOp);
-            attachmentDescriptions[attachmentDescIndex].stencilLoadOp = MapAttachmentLoadOp(colorAtta.stencilLoadOp);
-            attachmentDescriptions[attachmentDescIndex].stencilStoreOp = MapAttachmentStoreOp(colorAtta.storeOp);
-            attachmentDescriptions[attachmentDescIndex].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-            attachmentDescriptions[attachmentDescIndex].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-            attachmentReference[refIndex].attachment = attachmentDescIndex;
-            attachmentReference[refIndex].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-            attachmentDescIndex += 1;
-            refIndex += 1;
+            uint32_t index = refs[subpassIndex][refIndex++];
+            if (subpassIndex != 0 && firstUses[index] == -1 && colorAtta.loadOp == AttachmentLoadOperation::Clear)
+            {
+                VkClearAttachment clear{
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .colorAttachment = (uint32_t)colorRefs[subpassIndex].size(),
+                };
+                subpassClears[subpassIndex].push_back({refIndex - 1, clear});
+            }
+
+            use(subpassIndex, index, colorAtta, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, false);
+            colorRefs[subpassIndex].push_back({index, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
         }
 
-        // depth attachment
+        depthRefs[subpassIndex].attachment = VK_ATTACHMENT_UNUSED;
         if (subpass.depth != std::nullopt)
         {
-            subpassDescriptions[subpassDescIndex].pDepthStencilAttachment = attachmentReference + refIndex;
-
-            attachmentDescriptions[attachmentDescIndex].flags = 0;
-            attachmentDescriptions[attachmentDescIndex].format =
-                MapFormat(subpass.depth->imageView->GetImage().GetDescription().format);
-            attachmentDescriptions[attachmentDescIndex].samples =
-                MapSampleCount(subpass.depth->imageView->GetImage().GetDescription().multiSampling);
-            attachmentDescriptions[attachmentDescIndex].loadOp = MapAttachmentLoadOp(subpass.depth->loadOp);
-            attachmentDescriptions[attachmentDescIndex].storeOp = MapAttachmentStoreOp(subpass.depth->storeOp);
-            attachmentDescriptions[attachmentDescIndex].stencilLoadOp =
-                MapAttachmentLoadOp(subpass.depth->stencilLoadOp);
-            attachmentDescriptions[attachmentDescIndex].stencilStoreOp = MapAttachmentStoreOp(subpass.depth->storeOp);
-            attachmentDescriptions[attachmentDescIndex].initialLayout =
-                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-            attachmentDescriptions[attachmentDescIndex].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-            attachmentReference[refIndex].attachment = attachmentDescIndex;
-            attachmentReference[refIndex].layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-            attachmentDescIndex += 1;
-            refIndex += 1;
+            uint32_t index = refs[subpassIndex][refIndex++];
+            if (subpassIndex != 0 && firstUses[index] == -1)
+            {
+                VkFormat format = MapFormat(subpass.depth->imageView->GetImage().GetDescription().format);
+                VkImageAspectFlags aspectMask = 0;
+                if (subpass.depth->loadOp == AttachmentLoadOperation::Clear)
+                    aspectMask |= VK_IMAGE_ASPECT_DEPTH_BIT;
+                if (subpass.depth->stencilLoadOp == AttachmentLoadOperation::Clear && VKUtils::FormatHasStencil(format))
+                    aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+                if (aspectMask != 0)
+                    subpassClears[subpassIndex].push_back({refIndex - 1, {.aspectMask = aspectMask}});
+            }
+
+            use(subpassIndex, index, *subpass.depth, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, false);
+            depthRefs[subpassIndex] = {index, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
         }
-        else
+
+        for (Attachment& inputAtta : subpass.inputs)
         {
-            subpassDescriptions[subpassDescIndex].pDepthStencilAttachment = VK_NULL_HANDLE;
+            uint32_t index = refs[subpassIndex][refIndex++];
+            VkImageLayout layout = IsDepthStencilFormat(inputAtta.imageView->GetImage().GetDescription().format)
+                                       ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                       : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            use(subpassIndex, index, inputAtta, layout, true);
+            inputRefs[subpassIndex].push_back({index, layout});
         }
+    }
 
-        if (subpassDescIndex != 0)
-        {}
+    for (uint32_t index = 0; index < attachments.size(); ++index)
+    {
+        VkAttachmentDescription& desc = attachmentDescriptions[index];
+        // the clear values only reach the first subpass' attachments
+        if (firstUses[index] != 0)
+        {
+            if (desc.loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR)
+                desc.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            if (desc.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_CLEAR)
+                desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        }
 
-        subpassDescIndex += 1;
+        // only read as an input, the content stays
+        if (!stored[index])
+        {
+            desc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+        }
+
+        // subpasses between the uses keep the content
+        for (int subpassIndex = firstUses[index] + 1; subpassIndex < lastUses[index]; ++subpassIndex)
+        {
+            auto& subpassRefs = refs[subpassIndex];
+            if (std::find(subpassRefs.begin(), subpassRefs.end(), index) == subpassRefs.end())
+                preserves[subpassIndex].push_back(index);
+        }
+    }
+
+    createInfo.attachmentCount = attachments.size();
+    createInfo.pAttachments = attachmentDescriptions;
+
+    VkSubpassDescription subpassDescriptions[64];
+    for (int subpassIndex = 0; subpassIndex < subpasses.size(); ++subpassIndex)
+    {
+        VkSubpassDescription& desc = subpassDescriptions[subpassIndex];
+        desc.flags = 0;
+        desc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        desc.inputAttachmentCount = inputRefs[subpassIndex].size();
+        desc.pInputAttachments = inputRefs[subpassIndex].data();
+        desc.colorAttachmentCount = colorRefs[subpassIndex].size();
+        desc.pColorAttachments = colorRefs[subpassIndex].data();
+        desc.pResolveAttachments = VK_NULL_HANDLE;
+        desc.pDepthStencilAttachment =
+            depthRefs[subpassIndex].attachment == VK_ATTACHMENT_UNUSED ? VK_NULL_HANDLE : &depthRefs[subpassIndex];
+        desc.preserveAttachmentCount = preserves[subpassIndex].size();
+        desc.pPreserveAttachments = preserves[subpassIndex].data();
     }
 
     createInfo.subpassCount = subpasses.size();
     createInfo.pSubpasses = subpassDescriptions;
 
+    dependencies.clear();
     VkSubpassDependency externalDependency;
     externalDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     externalDependency.dstSubpass = 0;
@@ -194,9 +272,49 @@ void VKRenderPass::CreateRenderPass()
     externalDependency.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
     externalDependency.dstAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_MEMORY_READ_BIT;
     externalDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+    dependencies.push_back(externalDependency);
+
+    // a subpass waits for the earlier subpass that used one of its attachments last. Only the pixel being drawn is
+    // read, so the dependency is by region and the attachments can stay in tile memory
+    const VkPipelineStageFlags framebufferStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                                   VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                                   VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    for (int subpassIndex = 1; subpassIndex < subpasses.size(); ++subpassIndex)
+    {
+        for (uint32_t index : refs[subpassIndex])
+        {
+            int srcSubpass = -1;
+            for (int pre = subpassIndex - 1; pre >= 0 && srcSubpass == -1; --pre)
+            {
+                if (std::find(refs[pre].begin(), refs[pre].end(), index) != refs[pre].end())
+                    srcSubpass = pre;
+            }
+
+            bool exists = std::any_of(
+                dependencies.begin(),
+                dependencies.end(),
+                [&](const VkSubpassDependency& d)
+                { return d.srcSubpass == (uint32_t)srcSubpass && d.dstSubpass == (uint32_t)subpassIndex; }
+            );
+            if (srcSubpass == -1 || exists)
+                continue;
+
+            dependencies.push_back({
+                .srcSubpass = (uint32_t)srcSubpass,
+                .dstSubpass = (uint32_t)subpassIndex,
+                .srcStageMask = framebufferStages,
+                .dstStageMask = framebufferStages | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                                 VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT,
+            });
+        }
+    }
 
-    createInfo.dependencyCount = 1;
-    createInfo.pDependencies = &externalDependency;
+    createInfo.dependencyCount = dependencies.size();
+    createInfo.pDependencies = dependencies.data();
 
     VKContext::Instance()->objManager->CreateRenderPass(createInfo, renderPass);
 }
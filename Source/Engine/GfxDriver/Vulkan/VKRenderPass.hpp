@@ -3,6 +3,7 @@
 #include "GfxDriver/Vulkan/VKImage.hpp"
 #include "GfxDriver/Vulkan/VKSwapchainImage.hpp"
 #include <optional>
+#include <span>
 #include <vector>
 #include <vulkan/vulkan.h>
 
@@ -17,7 +18,11 @@ public:
     VKRenderPass(const VKRenderPass& renderPass) = delete;
     VKRenderPass(VKRenderPass&& renderPass) = delete;
     ~VKRenderPass() override;
-    void AddSubpass(const std::vector<Attachment>& colors, std::optional<Attachment> depth) override;
+    void AddSubpass(
+        const std::vector<Attachment>& colors,
+        std::optional<Attachment> depth,
+        const std::vector<Attachment>& inputs = {}
+    ) override;
     void ClearSubpass() override
     {
         subpasses.clear();
@@ -27,9 +32,39 @@ public:
     VkRenderPass GetHandle();
     Extent2D GetExtent();
 
+    uint32_t GetSubpassCount()
+    {
+        return subpasses.size();
+    }
+
+    // an attachment first used by a later subpass with a clear load operation is cleared when that subpass starts.
+    // vkCmdBeginRenderPass only gets the clear values of the first subpass
+    struct SubpassClear
+    {
+        // index into the clear values the subpass is begun with, its colors come first, then its depth
+        uint32_t clearValueIndex;
+        VkClearAttachment clear;
+    };
+
+    // valid after GetHandle
+    std::span<const SubpassClear> GetSubpassClears(uint32_t subpass)
+    {
+        return subpassClears[subpass];
+    }
+
+    // the dependency of the first subpass on the commands before the render pass, then the dependencies between the
+    // subpasses. Valid after GetHandle
+    std::span<const VkSubpassDependency> GetSubpassDependencies()
+    {
+        return dependencies;
+    }
+
 protected:
     void CreateRenderPass();
     VkFramebuffer CreateFrameBuffer();
+    // the image views of the attachments in the order of the render pass' attachment descriptions. refs[subpass] has
+    // the indices of the subpass' colors, its depth and its inputs
+    std::vector<ImageView*> CollectAttachments(std::vector<std::vector<uint32_t>>* refs = nullptr);
 
     VkRenderPass renderPass = VK_NULL_HANDLE;
 
@@ -41,11 +76,19 @@ protected:
 
     struct Subpass
     {
-        Subpass(const std::vector<Attachment>& colors, std::optional<Attachment> depth) : colors(colors), depth(depth)
+        Subpass(
+            const std::vector<Attachment>& colors,
+            std::optional<Attachment> depth,
+            const std::vector<Attachment>& inputs
+        )
+            : colors(colors), depth(depth), inputs(inputs)
         {}
         std::vector<Attachment> colors;
         std::optional<Attachment> depth;
+        std::vector<Attachment> inputs;
     };
     std::vector<Subpass> subpasses;
+    std::vector<std::vector<SubpassClear>> subpassClears;
+    std::vector<VkSubpassDependency> dependencies;
 };
 } // namespace Engine::Gfx
@@ -10,6 +10,7 @@ VkDescriptorType MapBindingType(BindingType type)
         case BindingType::UBO: return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         case BindingType::SeparateImage: return VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
         case BindingType::SeparateSampler: return VK_DESCRIPTOR_TYPE_SAMPLER;
+        case BindingType::SubpassInput: return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
         default: assert(0 && "Map BindingType failed");
     }
 
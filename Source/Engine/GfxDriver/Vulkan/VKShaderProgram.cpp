@@ -7,10 +7,12 @@
 #include "ThirdParty/xxHash/xxhash.h"
 #include "VKContext.hpp"
 #include "VKDescriptorPool.hpp"
+#include "VKRenderPass.hpp"
 #include "VKShaderModule.hpp"
 #include "VKShaderProgram.hpp"
 #include <algorithm>
 #include <assert.h>
+#include <mutex>
 #include <spdlog/spdlog.h>
 
 namespace Engine::Gfx
@@ -185,6 +187,7 @@ VKShaderProgram::VKShaderProgram(
 
     // generate bindings
     DescriptorSetBindings descriptorSetBindings;
+    DescriptorSetBindingFlags descriptorSetBindingFlags;
     std::vector<VkSampler> immutableSamplerHandles;
     for (auto& iter : shaderInfo.bindings)
     {
@@ -194,8 +197,26 @@ VKShaderProgram::VKShaderProgram(
         b.binding = binding.bindingNum;
         b.descriptorCount = binding.count;
         b.descriptorType = ShaderInfo::Utils::MapBindingType(binding.type);
+        VkDescriptorBindingFlags bindingFlags = 0;
 
-        if (binding.type == ShaderInfo::BindingType::Texture)
+        // runtime sized array, used by bindless materials. Only the elements in use are written
+        bool runtimeArray = binding.count == 0;
+        if (runtimeArray)
+        {
+            b.descriptorCount = context->device->GetGPU().GetMaxBindlessTextureCount();
+            if (b.descriptorCount == 0)
+            {
+                SPDLOG_ERROR("{} uses a runtime sized array but descriptor indexing is not supported", name);
+                b.descriptorCount = 1;
+            }
+            else
+            {
+                // a new set is written when the array changes, so update after bind isn't needed
+                bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+            }
+        }
+
+        if (binding.type == ShaderInfo::BindingType::Texture && !runtimeArray)
         {
             std::string lowerBindingName = iter.first;
             for (auto& c : lowerBindingName)
@@ -216,6 +237,7 @@ VKShaderProgram::VKShaderProgram(
         else
             b.pImmutableSamplers = VK_NULL_HANDLE;
         descriptorSetBindings[iter.second.setNum].push_back(b);
+        descriptorSetBindingFlags[iter.second.setNum].push_back(bindingFlags);
     }
 
     for (auto& set : descriptorSetBindings)
@@ -237,7 +259,7 @@ VKShaderProgram::VKShaderProgram(
         //);
     }
 
-    GeneratePipelineLayoutAndGetDescriptorPool(descriptorSetBindings);
+    GeneratePipelineLayoutAndGetDescriptorPool(descriptorSetBindings, descriptorSetBindingFlags);
 
     if (config != nullptr)
     {
@@ -278,13 +300,16 @@ VKShaderProgram::~VKShaderProgram()
         objManager->DestroyPipelineLayout(pipelineLayout);
     }
 
-    for (auto v : caches)
+    pipelines.ForEach([this](VkPipeline pipeline) { objManager->DestroyPipeline(pipeline); });
+    if (VkPipeline pipeline = computePipeline.load())
     {
-        objManager->DestroyPipeline(v.pipeline);
+        objManager->DestroyPipeline(pipeline);
     }
 }
 
-void VKShaderProgram::GeneratePipelineLayoutAndGetDescriptorPool(DescriptorSetBindings& combined)
+void VKShaderProgram::GeneratePipelineLayoutAndGetDescriptorPool(
+    DescriptorSetBindings& combined, DescriptorSetBindingFlags& combinedFlags
+)
 {
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
     pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -323,11 +348,40 @@ void VKShaderProgram::GeneratePipelineLayoutAndGetDescriptorPool(DescriptorSetBi
         descriptorSetLayoutCreateInfo.bindingCount = combined[i].size();
         descriptorSetLayoutCreateInfo.pBindings = combined[i].data();
 
-        layoutHash.push_back(VkDescriptorSetLayoutCreateInfoHash{}(descriptorSetLayoutCreateInfo));
-        auto& pool =
-            VKContext::Instance()->descriptorPoolCache->RequestDescriptorPool(name, descriptorSetLayoutCreateInfo);
+        const VkDescriptorBindingFlags* bindingFlags = nullptr;
+        auto& flags = combinedFlags[i];
+        size_t hash = VkDescriptorSetLayoutCreateInfoHash{}(descriptorSetLayoutCreateInfo);
+        if (std::any_of(flags.begin(), flags.end(), [](VkDescriptorBindingFlags f) { return f != 0; }))
+        {
+            bindingFlags = flags.data();
+            hash ^= XXH64(flags.data(), flags.size() * sizeof(VkDescriptorBindingFlags), 0);
+        }
+
+        layoutHash.push_back(hash);
+        auto& pool = VKContext::Instance()->descriptorPoolCache->RequestDescriptorPool(
+            name,
+            descriptorSetLayoutCreateInfo,
+            bindingFlags
+        );
         descriptorPools.push_back(&pool);
         layouts[i] = pool.GetLayout();
+
+        SetBindings& resolved = setBindings.emplace_back();
+        auto setIter = shaderInfo.descriptorSetBinidngMap.find(i);
+        if (setIter != shaderInfo.descriptorSetBinidngMap.end())
+        {
+            for (auto& b : setIter->second.bindings)
+                resolved.bindings.push_back(&b.second);
+        }
+        std::sort(
+            resolved.bindings.begin(),
+            resolved.bindings.end(),
+            [](const ShaderInfo::Binding* l, const ShaderInfo::Binding* r) { return l->bindingNum < r->bindingNum; }
+        );
+        for (const ShaderInfo::Binding* b : resolved.bindings)
+        {
+            resolved.nameHash = XXH64(b->name.data(), b->name.size(), resolved.nameHash ^ b->bindingNum);
+        }
     }
     pipelineLayoutCreateInfo.pSetLayouts = layouts.data();
 
@@ -367,10 +421,17 @@ VkDescriptorSet VKShaderProgram::GetVKDescriptorSet()
 
 VkPipeline VKShaderProgram::RequestPipeline(const ShaderConfig& config, VkRenderPass renderPass, uint32_t subpass)
 {
+    // command buffers can be recorded from several threads, only creating a pipeline locks and only this program
     if (isCompute)
     {
-        if (!caches.empty())
-            return caches.front().pipeline;
+        VkPipeline pipeline = computePipeline.load(std::memory_order_acquire);
+        if (pipeline)
+            return pipeline;
+
+        std::lock_guard lock(computePipelineMutex);
+        pipeline = computePipeline.load(std::memory_order_relaxed);
+        if (pipeline)
+            return pipeline;
 
         VkComputePipelineCreateInfo createInfo{
             .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
@@ -382,23 +443,23 @@ VkPipeline VKShaderProgram::RequestPipeline(const ShaderConfig& config, VkRender
             .basePipelineIndex = 0,
         };
 
-        VkPipeline pipeline;
         objManager->CreateComputePipeline(createInfo, pipeline);
-
-        PipelineCache newCache;
-        newCache.pipeline = pipeline;
-        newCache.config = config;
-        caches.push_back(newCache);
-
+        computePipeline.store(pipeline, std::memory_order_release);
         return pipeline;
     }
 
-    for (auto& cache : caches)
-    {
-        if (cache.config == config && cache.subpass == subpass && cache.renderPass == renderPass)
-            return cache.pipeline;
-    }
+    return pipelines.Request(
+        config,
+        renderPass,
+        subpass,
+        [&]() { return CreateGraphicsPipeline(config, renderPass, subpass); }
+    );
+}
 
+VkPipeline VKShaderProgram::CreateGraphicsPipeline(
+    const ShaderConfig& config, VkRenderPass renderPass, uint32_t subpass
+)
+{
     VkGraphicsPipelineCreateInfo createInfo;
     createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     createInfo.pNext = VK_NULL_HANDLE;
@@ -547,16 +608,22 @@ VkPipeline VKShaderProgram::RequestPipeline(const ShaderConfig& config, VkRender
     VkPipeline pipeline;
     objManager->CreateGraphicsPipeline(createInfo, pipeline);
 
-    PipelineCache newCache;
-    newCache.pipeline = pipeline;
-    newCache.config = config;
-    newCache.renderPass = renderPass;
-    newCache.subpass = subpass;
-    caches.push_back(newCache);
-
     return pipeline;
 }
 
+void VKShaderProgram::WarmUp(const ShaderConfig& config, RenderPass& renderPass, uint32_t subpass)
+{
+    if (isCompute)
+        RequestPipeline(config, VK_NULL_HANDLE, 0);
+    else
+        RequestPipeline(config, static_cast<VKRenderPass&>(renderPass).GetHandle(), subpass);
+}
+
+const VKShaderProgram::SetBindings& VKShaderProgram::GetSetBindings(uint32_t set)
+{
+    return setBindings[set];
+}
+
 size_t VKShaderProgram::GetLayoutHash(uint32_t set)
 {
     if (set < layoutHash.size())
@@ -1,8 +1,11 @@
 #pragma once
 #include "../DescriptorSetSlot.hpp"
+#include "../PipelineCache.hpp"
 #include "../ShaderProgram.hpp"
 #include "VKShaderInfo.hpp"
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan.h>
@@ -75,6 +78,8 @@ public:
     VkPipeline RequestPipeline(const ShaderConfig& config, VkRenderPass renderPass, uint32_t subpass);
     VKDescriptorPool& GetDescriptorPool(DescriptorSetSlot slot);
 
+    void WarmUp(const ShaderConfig& config, RenderPass& renderPass, uint32_t subpass) override;
+
     const ShaderConfig& GetDefaultShaderConfig() override;
 
     const ShaderInfo::ShaderInfo& GetShaderInfo() override
@@ -88,16 +93,19 @@ public:
 
     size_t GetLayoutHash(uint32_t set);
 
+    // bindings of a descriptor set ordered by binding number, resolved once when the shader is created.
+    // nameHash identifies the binding names so a resource can tell if its name lookups are still valid
+    struct SetBindings
+    {
+        uint64_t nameHash = 0;
+        std::vector<const ShaderInfo::Binding*> bindings;
+    };
+    const SetBindings& GetSetBindings(uint32_t set);
+
 private:
     typedef std::unordered_map<SetNum, std::vector<VkDescriptorSetLayoutBinding>> DescriptorSetBindings;
+    typedef std::unordered_map<SetNum, std::vector<VkDescriptorBindingFlags>> DescriptorSetBindingFlags;
     typedef std::vector<std::unordered_map<VkDescriptorType, VkDescriptorPoolSize>> PoolSizeMap;
-    struct PipelineCache
-    {
-        VkPipeline pipeline;
-        VkRenderPass renderPass;
-        uint32_t subpass;
-        ShaderConfig config;
-    };
 
     std::string name;
     ShaderInfo::ShaderInfo shaderInfo;
@@ -107,13 +115,19 @@ private:
     std::unique_ptr<VKShaderModule> computeShaderModule;
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
     VKSwapChain* swapchain;
-    std::vector<PipelineCache> caches;
+    PipelineCache<VkPipeline, VkRenderPass> pipelines;
+    std::atomic<VkPipeline> computePipeline = VK_NULL_HANDLE;
+    std::mutex computePipelineMutex;
     std::vector<VkSampler> immutableSamplers;
     std::vector<size_t> layoutHash;
+    std::vector<SetBindings> setBindings;
     std::vector<RefPtr<VKDescriptorPool>> descriptorPools;
     VkDescriptorSet descriptorSet;
 
-    void GeneratePipelineLayoutAndGetDescriptorPool(DescriptorSetBindings& combined);
+    void GeneratePipelineLayoutAndGetDescriptorPool(
+        DescriptorSetBindings& combined, DescriptorSetBindingFlags& combinedFlags
+    );
+    VkPipeline CreateGraphicsPipeline(const ShaderConfig& config, VkRenderPass renderPass, uint32_t subpass);
 
     std::shared_ptr<const ShaderConfig> defaultShaderConfig = {};
 };
@@ -1,6 +1,7 @@
 #include "VKShaderResource.hpp"
 #include "Internal/VKDevice.hpp"
 #include "Internal/VKMemAllocator.hpp"
+#include "ThirdParty/xxHash/xxhash.h"
 #include "VKBuffer.hpp"
 #include "VKContext.hpp"
 #include "VKDescriptorPool.hpp"
@@ -9,6 +10,7 @@
 #include "VKSharedResource.hpp"
 #include <algorithm>
 #include <fmt/format.h>
+#include <mutex>
 #include <spdlog/spdlog.h>
 
 namespace Engine::Gfx
@@ -31,192 +33,347 @@ VKShaderResource::VKShaderResource()
 
 VKShaderResource::~VKShaderResource()
 {
-    for (auto d : sets)
+    for (auto& iter : sets)
     {
-        descriptorPool->Free(d.second);
+        for (auto& c : iter.second.cached)
+        {
+            iter.second.pool->Free(c.set);
+        }
+    }
+}
+
+void VKShaderResource::SetResource(const std::string& name, void* res, ResourceType type)
+{
+    // entries are never erased so that the refs resolved in sets stay valid
+    ResourceRef& ref = bindings[name];
+    if (ref.res != res || ref.type != type)
+    {
+        ref = {res, type};
+        version += 1;
     }
 }
 
 void VKShaderResource::SetBuffer(const std::string& name, Gfx::Buffer* buffer)
 {
-    bindings[name] = {buffer, ResourceType::Buffer};
-    rebuild = true;
+    SetResource(name, buffer, ResourceType::Buffer);
 }
 
 void VKShaderResource::SetImage(const std::string& name, Gfx::Image* image)
 {
-    bindings[name] = {&image->GetDefaultImageView(), ResourceType::ImageView};
-    rebuild = true;
+    SetResource(name, &image->GetDefaultImageView(), ResourceType::ImageView);
 }
 
 void VKShaderResource::SetImage(const std::string& name, Gfx::ImageView* imageView)
 {
-    bindings[name] = {imageView, ResourceType::ImageView};
-    rebuild = true;
+    SetResource(name, imageView, ResourceType::ImageView);
 }
 
 void VKShaderResource::SetImage(const std::string& name, nullptr_t)
 {
-    bindings.erase(name);
-    rebuild = true;
+    SetResource(name, nullptr, ResourceType::ImageView);
+}
+
+void VKShaderResource::SetImages(const std::string& name, std::span<Gfx::ImageView* const> imageViews)
+{
+    auto& views = imageArrays[name];
+    if (!std::equal(views.begin(), views.end(), imageViews.begin(), imageViews.end()))
+    {
+        views.assign(imageViews.begin(), imageViews.end());
+        version += 1;
+    }
+    SetResource(name, &views, ResourceType::ImageViewArray);
 }
 
 VkDescriptorSet VKShaderResource::GetDescriptorSet(uint32_t set, VKShaderProgram* shaderProgram)
 {
+    // command buffers cache the sets they resolved, this is only called again when the resource changed
+    std::lock_guard lock(mutex);
+
     size_t hash = shaderProgram->GetLayoutHash(set);
     if (hash == 0)
         return VK_NULL_HANDLE;
-    auto iter = sets.find(hash);
-    if (iter == sets.end() || rebuild)
+
+    ResolvedSet& resolved = sets[hash];
+    auto& setBindings = shaderProgram->GetSetBindings(set);
+    if (resolved.current != VK_NULL_HANDLE && resolved.version == version && resolved.nameHash == setBindings.nameHash)
+        return resolved.current;
+
+    if (resolved.pool == nullptr || resolved.nameHash != setBindings.nameHash || resolved.refs.empty())
     {
-        this->set = set;
-        layout = shaderProgram->GetVKPipelineLayout();
-
-        descriptorPool = &shaderProgram->GetDescriptorPool(set);
-        VkDescriptorSet descriptorSet = descriptorPool->Allocate();
-        sets[hash] = descriptorSet;
-        auto& shaderInfo = shaderProgram->GetShaderInfo();
-        VKDebugUtils::SetDebugName(
-            VK_OBJECT_TYPE_DESCRIPTOR_SET,
-            (uint64_t)descriptorSet,
-            (shaderProgram->GetName() + std::to_string(set)).c_str()
-        );
+        resolved.pool = &shaderProgram->GetDescriptorPool(set);
+        resolved.nameHash = setBindings.nameHash;
+        resolved.refs.clear();
+        for (const ShaderInfo::Binding* b : setBindings.bindings)
+        {
+            resolved.refs.push_back(&bindings[b->name]);
+        }
+    }
 
-        // create resources and write it to descriptor set
-        VkWriteDescriptorSet writes[32];
-        VkDescriptorBufferInfo bufferInfos[32];
-        VkDescriptorImageInfo imageInfos[32];
-        uint32_t bufferWriteIndex = 0;
-        uint32_t imageWriteIndex = 0;
-        uint32_t writeCount = 0;
-        auto iter = shaderInfo.descriptorSetBinidngMap.find(set);
-        if (iter != shaderInfo.descriptorSetBinidngMap.end())
+    this->set = set;
+    layout = shaderProgram->GetVKPipelineLayout();
+    resolved.current = WriteDescriptorSet(set, shaderProgram, resolved);
+    resolved.version = version;
+    return resolved.current;
+}
+
+VkDescriptorSet VKShaderResource::WriteDescriptorSet(
+    uint32_t set, VKShaderProgram* shaderProgram, ResolvedSet& resolved
+)
+{
+    auto& setBindings = shaderProgram->GetSetBindings(set);
+    assert(setBindings.bindings.size() <= 32);
+
+    // create resources and fill the write infos, the set they are written to is decided after we know the content
+    VkWriteDescriptorSet writes[32];
+    VkDescriptorBufferInfo bufferInfos[32];
+    VkDescriptorImageInfo imageInfos[32];
+    uint32_t bufferWriteIndex = 0;
+    uint32_t imageWriteIndex = 0;
+    uint32_t writeCount = 0;
+    // runtime sized arrays can be large, their infos live on the heap
+    std::vector<std::vector<VkDescriptorImageInfo>> arrayImageInfos;
+    // a handle of a destroyed object can be reused by a new one, the ids of the objects are part of the content
+    std::vector<uint64_t> objectIDs;
+    for (size_t bindingIndex = 0; bindingIndex < setBindings.bindings.size(); ++bindingIndex)
+    {
+        const ShaderInfo::Binding& b = *setBindings.bindings[bindingIndex];
+        ResourceRef resRef = *resolved.refs[bindingIndex];
+
+        if (b.count == 0)
         {
-            assert(iter->second.bindings.size() < 64);
+            // the binding is partially bound, elements that are not written are never accessed by the shader
+            if (resRef.type != ResourceType::ImageViewArray || resRef.res == nullptr)
+                continue;
+            auto& views = *(std::vector<Gfx::ImageView*>*)resRef.res;
+            uint32_t count = std::min((uint32_t)views.size(), device->GetGPU().GetMaxBindlessTextureCount());
+            if (count == 0)
+                continue;
 
-            for (auto& b : iter->second.bindings)
+            auto& infos = arrayImageInfos.emplace_back(count);
+            for (uint32_t i = 0; i < count; ++i)
             {
-                writes[writeCount].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                writes[writeCount].pNext = VK_NULL_HANDLE;
-                writes[writeCount].dstSet = descriptorSet;
-                writes[writeCount].descriptorType = ShaderInfo::Utils::MapBindingType(b.second.type);
-                writes[writeCount].dstBinding = b.second.bindingNum;
-                writes[writeCount].dstArrayElement = 0;
-                writes[writeCount].descriptorCount = b.second.count;
-                writes[writeCount].pImageInfo = VK_NULL_HANDLE;
-                writes[writeCount].pBufferInfo = VK_NULL_HANDLE;
-                writes[writeCount].pTexelBufferView = VK_NULL_HANDLE;
-
-                ResourceRef resRef = bindings[b.second.name];
-
-                switch (b.second.type)
+                VKImageView* imageView = (VKImageView*)views[i];
+                infos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                infos[i].sampler =
+                    b.type == ShaderInfo::BindingType::Texture ? sharedResource->GetDefaultSampler() : VK_NULL_HANDLE;
+                infos[i].imageView = imageView ? imageView->GetHandle()
+                                               : sharedResource->GetDefaultTexture2D()->GetDefaultVkImageView();
+                objectIDs.push_back(imageView ? imageView->GetUniqueID() : 0);
+            }
+
+            writes[writeCount] = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = VK_NULL_HANDLE,
+                .dstSet = VK_NULL_HANDLE,
+                .dstBinding = b.bindingNum,
+                .dstArrayElement = 0,
+                .descriptorCount = count,
+                .descriptorType = ShaderInfo::Utils::MapBindingType(b.type),
+                .pImageInfo = infos.data(),
+                .pBufferInfo = VK_NULL_HANDLE,
+                .pTexelBufferView = VK_NULL_HANDLE,
+            };
+            writeCount += 1;
+            continue;
+        }
+
+        writes[writeCount].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[writeCount].pNext = VK_NULL_HANDLE;
+        writes[writeCount].dstSet = VK_NULL_HANDLE;
+        writes[writeCount].descriptorType = ShaderInfo::Utils::MapBindingType(b.type);
+        writes[writeCount].dstBinding = b.bindingNum;
+        writes[writeCount].dstArrayElement = 0;
+        writes[writeCount].descriptorCount = b.count;
+        writes[writeCount].pImageInfo = VK_NULL_HANDLE;
+        writes[writeCount].pBufferInfo = VK_NULL_HANDLE;
+        writes[writeCount].pTexelBufferView = VK_NULL_HANDLE;
+
+        switch (b.type)
+        {
+            case ShaderInfo::BindingType::UBO:
+            case ShaderInfo::BindingType::SSBO:
                 {
-                    case ShaderInfo::BindingType::UBO:
-                    case ShaderInfo::BindingType::SSBO:
+                    for (int i = 0; i < writes[writeCount].descriptorCount; ++i)
+                    {
+                        VkDescriptorBufferInfo& bufferInfo = bufferInfos[bufferWriteIndex++];
+                        VKBuffer* buffer = nullptr;
+                        if (resRef.type != ResourceType::Buffer || resRef.res == nullptr)
                         {
-                            for (int i = 0; i < writes[writeCount].descriptorCount; ++i)
+                            auto bufferIter = buffers.find(b.name);
+                            if (bufferIter == buffers.end())
                             {
-                                VkDescriptorBufferInfo& bufferInfo = bufferInfos[bufferWriteIndex++];
-                                VKBuffer* buffer = nullptr;
-                                if (resRef.type != ResourceType::Buffer || resRef.res == nullptr)
-                                {
-                                    std::string bufferName =
-                                        fmt::format("Default Buffer for {}", shaderProgram->GetName());
-                                    Buffer::CreateInfo createInfo{
-                                        .usages =
-                                            (b.second.type == ShaderInfo::BindingType::UBO ? BufferUsage::Uniform
-                                                                                           : BufferUsage::Storage) |
-                                            BufferUsage::Transfer_Dst,
-                                        .size = b.second.binding.ubo.data.size,
-                                        .visibleInCPU = false,
-                                        .debugName = bufferName.c_str()};
-                                    auto defaultBuffer = std::make_unique<VKBuffer>(createInfo);
-                                    buffer = defaultBuffer.get();
-                                    buffers.insert(std::make_pair(b.first, std::move(defaultBuffer)));
-                                }
-                                else
-                                {
-                                    buffer = (VKBuffer*)resRef.res;
-                                }
-
-                                bufferInfo.buffer = buffer->GetHandle();
-                                bufferInfo.offset = i * b.second.binding.ubo.data.size;
-                                bufferInfo.range = b.second.binding.ubo.data.size;
-                                writes[writeCount].pBufferInfo = &bufferInfo;
+                                std::string bufferName = fmt::format("Default Buffer for {}", shaderProgram->GetName());
+                                Buffer::CreateInfo createInfo{
+                                    .usages = (b.type == ShaderInfo::BindingType::UBO ? BufferUsage::Uniform
+                                                                                      : BufferUsage::Storage) |
+                                              BufferUsage::Transfer_Dst,
+                                    // runtime sized storage buffers report a size of 0
+                                    .size = std::max<size_t>(b.binding.ubo.data.size, 16),
+                                    .visibleInCPU = false,
+                                    .debugName = bufferName.c_str()};
+                                bufferIter = buffers.emplace(b.name, std::make_unique<VKBuffer>(createInfo)).first;
                             }
-                            break;
+                            buffer = bufferIter->second.get();
                         }
-                    case ShaderInfo::BindingType::Texture:
-                    case ShaderInfo::BindingType::SeparateImage:
+                        else
                         {
-                            if (b.second.binding.texture.type == ShaderInfo::Texture::Type::Tex2D)
-                            {
-                                VkDescriptorImageInfo& imageInfo = imageInfos[imageWriteIndex++];
-                                imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                                imageInfo.sampler = b.second.type == ShaderInfo::BindingType::Texture
-                                                        ? sharedResource->GetDefaultSampler()
-                                                        : VK_NULL_HANDLE;
-                                VKImageView* imageView = (VKImageView*)resRef.res;
-                                if (resRef.res != nullptr && !imageView->GetImage().GetDescription().isCubemap &&
-                                    resRef.type == ResourceType::ImageView)
-                                {
-                                    imageInfo.imageView = imageView->GetHandle();
-                                }
-                                else
-                                {
-                                    imageInfo.imageView =
-                                        sharedResource->GetDefaultTexture2D()->GetDefaultVkImageView();
-                                }
-                                writes[writeCount].pImageInfo = &imageInfo;
-                            }
-                            else if (b.second.binding.texture.type == ShaderInfo::Texture::Type::TexCube)
-                            {
-                                VkDescriptorImageInfo& imageInfo = imageInfos[imageWriteIndex++];
-                                imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                                imageInfo.sampler = sharedResource->GetDefaultSampler();
-
-                                VKImageView* imageView = (VKImageView*)resRef.res;
-                                if (resRef.res != nullptr && imageView->GetImage().GetDescription().isCubemap &&
-                                    resRef.type != ResourceType::ImageView)
-                                {
-                                    imageInfo.imageView = imageView->GetHandle();
-                                }
-                                else
-                                {
-                                    imageInfo.imageView =
-                                        sharedResource->GetDefaultTextureCube()->GetDefaultVkImageView();
-                                }
-
-                                writes[writeCount].pImageInfo = &imageInfo;
-                            }
-                            break;
+                            buffer = (VKBuffer*)resRef.res;
                         }
-                    case ShaderInfo::BindingType::SeparateSampler:
+
+                        bufferInfo.buffer = buffer->GetHandle();
+                        objectIDs.push_back(buffer->GetUniqueID());
+                        bufferInfo.offset = i * b.binding.ubo.data.size;
+                        bufferInfo.range = b.binding.ubo.data.size == 0 ? VK_WHOLE_SIZE : b.binding.ubo.data.size;
+                        writes[writeCount].pBufferInfo = &bufferInfo;
+                    }
+                    break;
+                }
+            case ShaderInfo::BindingType::Texture:
+            case ShaderInfo::BindingType::SeparateImage:
+                {
+                    if (b.binding.texture.type == ShaderInfo::Texture::Type::Tex2D)
+                    {
+                        VkDescriptorImageInfo& imageInfo = imageInfos[imageWriteIndex++];
+                        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                        imageInfo.sampler = b.type == ShaderInfo::BindingType::Texture
+                                                ? sharedResource->GetDefaultSampler()
+                                                : VK_NULL_HANDLE;
+                        VKImageView* imageView = (VKImageView*)resRef.res;
+                        if (resRef.res != nullptr && !imageView->GetImage().GetDescription().isCubemap &&
+                            resRef.type == ResourceType::ImageView)
+                        {
+                            imageInfo.imageView = imageView->GetHandle();
+                            objectIDs.push_back(imageView->GetUniqueID());
+                        }
+                        else
+                        {
+                            imageInfo.imageView = sharedResource->GetDefaultTexture2D()->GetDefaultVkImageView();
+                            objectIDs.push_back(0);
+                        }
+                        writes[writeCount].pImageInfo = &imageInfo;
+                    }
+                    else if (b.binding.texture.type == ShaderInfo::Texture::Type::TexCube)
+                    {
+                        VkDescriptorImageInfo& imageInfo = imageInfos[imageWriteIndex++];
+                        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                        imageInfo.sampler = sharedResource->GetDefaultSampler();
+
+                        VKImageView* imageView = (VKImageView*)resRef.res;
+                        if (resRef.res != nullptr && imageView->GetImage().GetDescription().isCubemap &&
+                            resRef.type != ResourceType::ImageView)
                         {
-                            auto createInfo = SamplerCachePool::GenerateSamplerCreateInfoFromString(
-                                b.first,
-                                b.second.binding.separateSampler.enableCompare
-                            );
-                            VkSampler sampler = SamplerCachePool::RequestSampler(createInfo);
-                            VkDescriptorImageInfo& imageInfo = imageInfos[imageWriteIndex++];
-                            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                            imageInfo.sampler = sampler;
-                            imageInfo.imageView = VK_NULL_HANDLE;
-                            writes[writeCount].pImageInfo = &imageInfo;
-                            break;
+                            imageInfo.imageView = imageView->GetHandle();
+                            objectIDs.push_back(imageView->GetUniqueID());
                         }
-                    default: assert(0 && "Not implemented"); break;
+                        else
+                        {
+                            imageInfo.imageView = sharedResource->GetDefaultTextureCube()->GetDefaultVkImageView();
+                            objectIDs.push_back(0);
+                        }
+
+                        writes[writeCount].pImageInfo = &imageInfo;
+                    }
+                    break;
+                }
+            case ShaderInfo::BindingType::SeparateSampler:
+                {
+                    auto createInfo = SamplerCachePool::GenerateSamplerCreateInfoFromString(
+                        b.name,
+                        b.binding.separateSampler.enableCompare
+                    );
+                    VkSampler sampler = SamplerCachePool::RequestSampler(createInfo);
+                    VkDescriptorImageInfo& imageInfo = imageInfos[imageWriteIndex++];
+                    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                    imageInfo.sampler = sampler;
+                    imageInfo.imageView = VK_NULL_HANDLE;
+                    writes[writeCount].pImageInfo = &imageInfo;
+                    break;
+                }
+            case ShaderInfo::BindingType::SubpassInput:
+                {
+                    // the image has to be the attachment of the subpass the shader runs in, in the layout the subpass
+                    // reads it with
+                    VkDescriptorImageInfo& imageInfo = imageInfos[imageWriteIndex++];
+                    imageInfo.sampler = VK_NULL_HANDLE;
+                    VKImageView* imageView = (VKImageView*)resRef.res;
+                    if (resRef.res != nullptr && resRef.type == ResourceType::ImageView)
+                    {
+                        imageInfo.imageView = imageView->GetHandle();
+                        objectIDs.push_back(imageView->GetUniqueID());
+                        imageInfo.imageLayout = IsDepthStencilFormat(imageView->GetImage().GetDescription().format)
+                                                    ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                                    : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                    }
+                    else
+                    {
+                        imageInfo.imageView = sharedResource->GetDefaultTexture2D()->GetDefaultVkImageView();
+                        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                        objectIDs.push_back(0);
+                    }
+                    writes[writeCount].pImageInfo = &imageInfo;
+                    break;
                 }
+            default: assert(0 && "Not implemented"); break;
+        }
 
-                writeCount += 1;
-            }
+        writeCount += 1;
+    }
+
+    // the content is made of the handles, struct padding would make hashing the infos directly unstable
+    content.clear();
+    content.push_back(resolved.nameHash);
+    for (uint32_t i = 0; i < bufferWriteIndex; ++i)
+        content.insert(content.end(), {(uint64_t)bufferInfos[i].buffer, bufferInfos[i].offset, bufferInfos[i].range});
+    for (uint32_t i = 0; i < imageWriteIndex; ++i)
+    {
+        content.insert(
+            content.end(),
+            {(uint64_t)imageInfos[i].sampler, (uint64_t)imageInfos[i].imageView, (uint64_t)imageInfos[i].imageLayout}
+        );
+    }
+    for (auto& infos : arrayImageInfos)
+    {
+        content.push_back(infos.size());
+        for (auto& info : infos)
+            content.push_back((uint64_t)info.imageView);
+    }
+    content.insert(content.end(), objectIDs.begin(), objectIDs.end());
+    uint64_t contentKey = XXH64(content.data(), content.size() * sizeof(uint64_t), 0);
+
+    useCounter += 1;
+    for (auto& c : resolved.cached)
+    {
+        if (c.contentKey == contentKey && c.content == content)
+        {
+            c.lastUse = useCounter;
+            return c.set;
         }
+    }
 
-        rebuild = false;
-        vkUpdateDescriptorSets(device->GetHandle(), writeCount, writes, 0, VK_NULL_HANDLE);
-        return descriptorSet;
+    if (resolved.cached.size() >= MAX_CACHED_SETS_PER_LAYOUT)
+    {
+        // evict the least recently used set, the pool only hands it out again once frames in flight are done with it
+        auto lru = std::min_element(
+            resolved.cached.begin(),
+            resolved.cached.end(),
+            [](const CachedSet& l, const CachedSet& r) { return l.lastUse < r.lastUse; }
+        );
+        resolved.pool->Free(lru->set);
+        resolved.cached.erase(lru);
     }
 
-    return sets[hash];
+    VkDescriptorSet descriptorSet = resolved.pool->Allocate();
+    VKDebugUtils::SetDebugName(
+        VK_OBJECT_TYPE_DESCRIPTOR_SET,
+        (uint64_t)descriptorSet,
+        (shaderProgram->GetName() + std::to_string(set)).c_str()
+    );
+    for (uint32_t i = 0; i < writeCount; ++i)
+    {
+        writes[i].dstSet = descriptorSet;
+    }
+    vkUpdateDescriptorSets(device->GetHandle(), writeCount, writes, 0, VK_NULL_HANDLE);
+    resolved.cached.push_back({contentKey, content, descriptorSet, useCounter});
+    return descriptorSet;
 }
 } // namespace Engine::Gfx
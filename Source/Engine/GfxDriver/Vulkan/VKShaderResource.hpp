@@ -6,6 +6,7 @@
 #include "Internal/VKMemAllocator.hpp"
 #include "VKShaderInfo.hpp"
 #include "VKSharedResource.hpp"
+#include <mutex>
 #include <unordered_map>
 #include <vma/vk_mem_alloc.h>
 
@@ -27,8 +28,16 @@ public:
     void SetImage(const std::string& name, Gfx::Image* image) override;
     void SetImage(const std::string& name, Gfx::ImageView* imageView) override;
     void SetImage(const std::string& name, nullptr_t) override;
+    void SetImages(const std::string& name, std::span<Gfx::ImageView* const> imageViews) override;
+    // thread safe, the resource must not be modified while command buffers are recorded from other threads
     VkDescriptorSet GetDescriptorSet(uint32_t set, VKShaderProgram* shaderProgram);
 
+    // bumped when any binding changes
+    uint64_t GetVersion() const
+    {
+        return version;
+    }
+
     // ---------------------------- Old API ----------------------------------
 public:
     ~VKShaderResource() override;
@@ -37,14 +46,44 @@ protected:
     enum class ResourceType
     {
         ImageView,
-        Buffer
+        Buffer,
+        ImageViewArray
     };
 
     struct ResourceRef
     {
         void* res = nullptr;
-        ResourceType type;
+        ResourceType type = ResourceType::ImageView;
+    };
+
+    struct CachedSet
+    {
+        uint64_t contentKey;
+        // the handles and object ids written into the set, compared when the key matches
+        std::vector<uint64_t> content;
+        VkDescriptorSet set;
+        uint64_t lastUse;
     };
+
+    // descriptor sets of one set layout
+    struct ResolvedSet
+    {
+        // binding names the refs are resolved with, a shader with the same layout but different names re-resolves
+        uint64_t nameHash = 0;
+        // one entry per binding of the shader's set, points into bindings
+        std::vector<ResourceRef*> refs;
+        // resource version current was written with
+        uint64_t version = -1;
+        VkDescriptorSet current = VK_NULL_HANDLE;
+        VKDescriptorPool* pool = nullptr;
+        // sets keyed by the resources written into them, so switching back to a previous combination of resources
+        // doesn't allocate and write a new set
+        std::vector<CachedSet> cached;
+    };
+
+    // most materials only toggle between a few resource combinations
+    static constexpr size_t MAX_CACHED_SETS_PER_LAYOUT = 8;
+
     std::unordered_map<std::string, ResourceRef> bindings;
     VkPipelineLayout layout = VK_NULL_HANDLE;
     uint32_t set = -1;
@@ -52,10 +91,21 @@ protected:
     VKSharedResource* sharedResource;
     VKDevice* device;
 
-    VKDescriptorPool* descriptorPool = nullptr;
     std::unordered_map<std::string, std::unique_ptr<VKBuffer>> buffers;
+    // storage of ImageViewArray bindings
+    std::unordered_map<std::string, std::vector<Gfx::ImageView*>> imageArrays;
+
+    // keyed by layout hash
+    std::unordered_map<size_t, ResolvedSet> sets;
+    // bumped when any binding changes
+    uint64_t version = 0;
+    uint64_t useCounter = 0;
+    // scratch of WriteDescriptorSet
+    std::vector<uint64_t> content;
+    // guards sets and the scratch when several threads resolve descriptor sets of this resource
+    std::mutex mutex;
 
-    std::unordered_map<size_t, VkDescriptorSet> sets;
-    bool rebuild = false;
+    void SetResource(const std::string& name, void* res, ResourceType type);
+    VkDescriptorSet WriteDescriptorSet(uint32_t set, VKShaderProgram* shaderProgram, ResolvedSet& resolved);
 };
 } // namespace Engine::Gfx
@@ -0,0 +1,102 @@
+#pragma once
+#include <cinttypes>
+#include <cstddef>
+#include <vector>
+
+namespace Engine
+{
+// Open addressing hash map keyed by an already hashed 64 bit value.
+// Keys are expected to be well distributed (e.g. from xxHash), they are used as is to pick the bucket.
+// Entries live in one contiguous array so a lookup touches one or two cache lines instead of walking nodes
+template <class V>
+class FlatHashMap
+{
+public:
+    FlatHashMap(size_t initialCapacity = 16)
+    {
+        size_t capacity = 16;
+        while (capacity < initialCapacity)
+            capacity <<= 1;
+        slots.resize(capacity);
+    }
+
+    V* Find(uint64_t key)
+    {
+        size_t mask = slots.size() - 1;
+        for (size_t i = key & mask;; i = (i + 1) & mask)
+        {
+            Slot& slot = slots[i];
+            if (!slot.occupied)
+                return nullptr;
+            if (slot.key == key)
+                return &slot.value;
+        }
+    }
+
+    const V* Find(uint64_t key) const
+    {
+        return const_cast<FlatHashMap*>(this)->Find(key);
+    }
+
+    // insert or overwrite the value of key
+    V& Insert(uint64_t key, const V& value)
+    {
+        // keep the load factor under 1/2 so probe sequences stay short
+        if ((count + 1) * 2 > slots.size())
+            Grow();
+
+        Slot& slot = Probe(slots, key);
+        if (!slot.occupied)
+        {
+            slot.occupied = true;
+            slot.key = key;
+            count += 1;
+        }
+        slot.value = value;
+        return slot.value;
+    }
+
+    void Clear()
+    {
+        for (auto& slot : slots)
+            slot = Slot();
+        count = 0;
+    }
+
+    size_t Size() const
+    {
+        return count;
+    }
+
+private:
+    struct Slot
+    {
+        uint64_t key = 0;
+        V value{};
+        bool occupied = false;
+    };
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+
+    static Slot& Probe(std::vector<Slot>& slots, uint64_t key)
+    {
+        size_t mask = slots.size() - 1;
+        size_t i = key & mask;
+        while (slots[i].occupied && slots[i].key != key)
+            i = (i + 1) & mask;
+        return slots[i];
+    }
+
+    void Grow()
+    {
+        std::vector<Slot> newSlots(slots.size() * 2);
+        for (auto& slot : slots)
+        {
+            if (slot.occupied)
+                Probe(newSlots, slot.key) = slot;
+        }
+        slots.swap(newSlots);
+    }
+};
+} // namespace Engine
@@ -1,4 +1,6 @@
 #include "GLB.hpp"
+#include "MeshOptimizer.hpp"
+#include <cstring>
 #include <fstream>
 
 namespace Engine::Utils
@@ -8,7 +10,13 @@ static std::size_t WriteAccessorDataToBuffer(
     nlohmann::json& j, unsigned char* dstBuffer, std::size_t dstOffset, unsigned char* srcBuffer, int accessorIndex
 );
 
-static Submesh ExtractPrimitive(nlohmann::json& j, unsigned char* binaryData, int meshIndex, int primitiveIndex);
+static Submesh ExtractPrimitive(
+    nlohmann::json& j,
+    unsigned char* binaryData,
+    int meshIndex,
+    int primitiveIndex,
+    const GLBImportOptions& options
+);
 #define ATTRIBUTE_WRITE(attrName)                                                                                      \
     int index##attrName = primitiveJson["attributes"].value(#attrName, -1);                                            \
     if (index##attrName != -1)                                                                                         \
@@ -90,7 +98,7 @@ void GLB::SetAssetName(Asset* asset, nlohmann::json& j, const std::string& asset
 }
 
 std::vector<std::unique_ptr<Mesh>> GLB::ExtractMeshes(
-    nlohmann::json& jsonData, unsigned char*& binaryData, int maximumMesh
+    nlohmann::json& jsonData, unsigned char*& binaryData, int maximumMesh, const GLBImportOptions& options
 )
 {
     std::vector<std::unique_ptr<Mesh>> meshes;
@@ -104,7 +112,7 @@ std::vector<std::unique_ptr<Mesh>> GLB::ExtractMeshes(
         int primitiveSize = jsonData["meshes"][i]["primitives"].size();
         for (int j = 0; j < primitiveSize; ++j)
         {
-            submeshes.push_back(ExtractPrimitive(jsonData, binaryData, i, j));
+            submeshes.push_back(ExtractPrimitive(jsonData, binaryData, i, j, options));
         }
         mesh->SetSubmeshes(std::move(submeshes));
         meshes.push_back(std::move(mesh));
@@ -113,7 +121,13 @@ std::vector<std::unique_ptr<Mesh>> GLB::ExtractMeshes(
     return meshes;
 }
 
-Submesh ExtractPrimitive(nlohmann::json& j, unsigned char* binaryData, int meshIndex, int primitiveIndex)
+Submesh ExtractPrimitive(
+    nlohmann::json& j,
+    unsigned char* binaryData,
+    int meshIndex,
+    int primitiveIndex,
+    const GLBImportOptions& options
+)
 {
     auto& meshJson = j["meshes"][meshIndex];
     auto& primitiveJson = meshJson["primitives"][primitiveIndex];
@@ -265,6 +279,26 @@ Submesh ExtractPrimitive(nlohmann::json& j, unsigned char* binaryData, int meshI
             attributeOffset += byteSize;
         }
     }
+
+    if (options.optimizeVertexCache)
+        OptimizeVertexCache(indices, positions.size());
+
+    // the fetch order follows the triangle order, so it's optimized after it
+    if (options.optimizeVertexFetch)
+    {
+        size_t vertexCount;
+        std::vector<uint32_t> remap = OptimizeVertexFetch(indices, positions.size(), &vertexCount);
+        RemapIndices(indices, remap);
+
+        std::vector<glm::vec3> fetchPositions(vertexCount);
+        RemapVertices(fetchPositions.data(), positions.data(), sizeof(glm::vec3), remap);
+        positions = std::move(fetchPositions);
+
+        std::vector<uint8_t> fetchAttributes(vertexCount * attributeStride);
+        RemapVertices(fetchAttributes.data(), attributeData.data(), attributeStride, remap);
+        attributeData = std::move(fetchAttributes);
+    }
+
     attribute.SetData(std::move(attributeData));
 
     // get other attributes
@@ -272,6 +306,10 @@ Submesh ExtractPrimitive(nlohmann::json& j, unsigned char* binaryData, int meshI
     submesh.SetPositions(std::move(positions));
     submesh.SetIndices(std::move(indices));
     submesh.SetVertexAttribute(std::move(attribute));
+    if (options.generateMeshlets)
+        submesh.GenerateMeshlets();
+    if (options.lodCount > 1 && submesh.GetIndices().size() / 3 >= options.lodMinTriangles)
+        submesh.GenerateLods(options.lodCount, options.lodReduction);
     submesh.Apply();
 
     return submesh;
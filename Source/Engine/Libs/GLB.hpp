@@ -6,6 +6,24 @@
 
 namespace Engine::Utils
 {
+// how the meshes of a glb are processed when they are extracted
+struct GLBImportOptions
+{
+    // levels of detail of every submesh including the full one, 1 disables them. Meshes are extracted again on every
+    // load and the levels aren't cached, so they are only generated when asked for
+    uint32_t lodCount = 1;
+    // the triangles of a level relative to the level before
+    float lodReduction = 0.5f;
+    // smaller submeshes only have the full level
+    uint32_t lodMinTriangles = 256;
+    // reorder the triangles for the post transform vertex cache
+    bool optimizeVertexCache = true;
+    // reorder the vertices in the order the triangles use them, unused vertices are dropped
+    bool optimizeVertexFetch = true;
+    // split the submeshes into meshlets, which are culled one by one with GPU culling
+    bool generateMeshlets = false;
+};
+
 class GLB
 {
 public:
@@ -17,7 +35,10 @@ public:
     );
     static void SetAssetName(Asset* asset, nlohmann::json& j, const std::string& assetGroupName, int index);
     static std::vector<std::unique_ptr<Mesh>> ExtractMeshes(
-        nlohmann::json& jsonData, unsigned char*& binaryData, int maximumMesh = std::numeric_limits<int>::max()
+        nlohmann::json& jsonData,
+        unsigned char*& binaryData,
+        int maximumMesh = std::numeric_limits<int>::max(),
+        const GLBImportOptions& options = {}
     );
 };
 } // namespace Engine::Utils
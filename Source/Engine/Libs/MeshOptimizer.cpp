@@ -0,0 +1,194 @@
+#include "MeshOptimizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace Engine
+{
+namespace
+{
+// the cache the scores are tuned for, larger than the hardware caches as the scores only need a relative order
+constexpr uint32_t CACHE_SIZE = 32;
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+float VertexScore(int cachePosition, uint32_t remainingTriangles)
+{
+    // a vertex without triangles left can't add to any triangle's score
+    if (remainingTriangles == 0)
+        return -1;
+
+    float score = 0;
+    if (cachePosition >= 0)
+    {
+        // the vertices of the last triangle get a fixed score, it's better to not use them right away again
+        if (cachePosition < 3)
+            score = LAST_TRIANGLE_SCORE;
+        else
+        {
+            float scale = 1.0f / (CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+        }
+    }
+
+    // vertices with few triangles left are finished first, so they don't get left behind alone
+    score += VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+    return score;
+}
+} // namespace
+
+void OptimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // the triangles of every vertex, the first remaining[v] of them are the ones not emitted yet
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t index : indices)
+        remaining[index] += 1;
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    std::partial_sum(remaining.begin(), remaining.end(), offsets.begin() + 1);
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i)
+            adjacency[cursors[indices[i]]++] = i / 3;
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScores[v] = VertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        const uint32_t* tri = &indices[t * 3];
+        triangleScores[t] = vertexScores[tri[0]] + vertexScores[tri[1]] + vertexScores[tri[2]];
+    }
+    std::vector<uint8_t> emitted(triangleCount, 0);
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> newCache;
+    cache.reserve(CACHE_SIZE + 3);
+    newCache.reserve(CACHE_SIZE + 3);
+
+    size_t best = std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+    size_t cursor = 0;
+    while (result.size() < indices.size())
+    {
+        // the cache has no triangles left, continue with the next triangle not emitted in the input order
+        if (best == SIZE_MAX)
+        {
+            while (emitted[cursor])
+                ++cursor;
+            best = cursor;
+        }
+
+        const uint32_t* tri = &indices[best * 3];
+        result.insert(result.end(), tri, tri + 3);
+        emitted[best] = 1;
+
+        // the triangle's vertices move to the front of the cache, the others keep their order behind them
+        newCache.assign(tri, tri + 3);
+        for (uint32_t v : cache)
+        {
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                newCache.push_back(v);
+        }
+
+        for (int i = 0; i < 3; ++i)
+        {
+            uint32_t v = tri[i];
+            uint32_t* begin = &adjacency[offsets[v]];
+            uint32_t* end = begin + remaining[v];
+            *std::find(begin, end, (uint32_t)best) = *(end - 1);
+            remaining[v] -= 1;
+        }
+
+        // vertices pushed out of the cache lose their cache score, the ones inside score by their new position
+        best = SIZE_MAX;
+        float bestScore = -1;
+        for (size_t i = 0; i < newCache.size(); ++i)
+        {
+            uint32_t v = newCache[i];
+            float score = VertexScore(i < CACHE_SIZE ? (int)i : -1, remaining[v]);
+            float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+
+            for (uint32_t a = offsets[v]; a < offsets[v] + remaining[v]; ++a)
+            {
+                uint32_t t = adjacency[a];
+                triangleScores[t] += delta;
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    best = t;
+                }
+            }
+        }
+
+        if (newCache.size() > CACHE_SIZE)
+            newCache.resize(CACHE_SIZE);
+        std::swap(cache, newCache);
+    }
+
+    std::copy(result.begin(), result.end(), indices.begin());
+}
+
+float AnalyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize)
+{
+    if (indices.size() < 3)
+        return 0;
+
+    // a vertex is in the FIFO cache while fewer than cacheSize vertices were transformed after it
+    std::vector<size_t> transformedAt(vertexCount, 0);
+    size_t transformed = 0;
+    for (uint32_t index : indices)
+    {
+        if (transformedAt[index] == 0 || transformed - transformedAt[index] >= cacheSize)
+        {
+            transformed += 1;
+            transformedAt[index] = transformed;
+        }
+    }
+    return (float)transformed / (indices.size() / 3);
+}
+
+std::vector<uint32_t> OptimizeVertexFetch(
+    std::span<const uint32_t> indices, size_t vertexCount, size_t* uniqueVertexCount
+)
+{
+    std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+    uint32_t next = 0;
+    for (uint32_t index : indices)
+    {
+        if (remap[index] == UINT32_MAX)
+            remap[index] = next++;
+    }
+
+    if (uniqueVertexCount)
+        *uniqueVertexCount = next;
+    return remap;
+}
+
+void RemapIndices(std::span<uint32_t> indices, std::span<const uint32_t> remap)
+{
+    for (uint32_t& index : indices)
+        index = remap[index];
+}
+
+void RemapVertices(void* dst, const void* src, size_t stride, std::span<const uint32_t> remap)
+{
+    for (size_t v = 0; v < remap.size(); ++v)
+    {
+        if (remap[v] != UINT32_MAX)
+            memcpy((uint8_t*)dst + remap[v] * stride, (const uint8_t*)src + v * stride, stride);
+    }
+}
+} // namespace Engine
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace Engine
+{
+// Reorders the triangles so consecutive triangles share vertices in the post transform vertex cache, Tom Forsyth's
+// linear speed vertex cache optimisation. Every step emits the triangle with the highest score, the sum of its
+// vertices' scores, which favour vertices recently used and vertices with few triangles left
+void OptimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount);
+
+// the average number of vertices transformed per triangle with a FIFO cache of cacheSize vertices, 0.5 is the best
+// a regular grid can do and 3 the worst
+float AnalyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize = 16);
+
+// The new position of every vertex in the order indices first use them, so the vertex fetch reads memory forward.
+// Vertices no triangle uses are UINT32_MAX and get dropped, uniqueVertexCount receives the number of vertices kept
+std::vector<uint32_t> OptimizeVertexFetch(
+    std::span<const uint32_t> indices, size_t vertexCount, size_t* uniqueVertexCount = nullptr
+);
+
+void RemapIndices(std::span<uint32_t> indices, std::span<const uint32_t> remap);
+
+// copies every vertex of src, stride bytes each, to its new position in dst. dst holds the vertices that are kept
+void RemapVertices(void* dst, const void* src, size_t stride, std::span<const uint32_t> remap);
+
+} // namespace Engine
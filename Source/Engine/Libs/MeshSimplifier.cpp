@@ -0,0 +1,306 @@
+#include "MeshSimplifier.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace Engine
+{
+namespace
+{
+// sum of the squared distances to planes weighted by their triangles' areas
+struct Quadric
+{
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2 = 0;
+    double weight = 0;
+
+    void AddPlane(const glm::dvec3& n, double d, double w)
+    {
+        a2 += w * n.x * n.x;
+        ab += w * n.x * n.y;
+        ac += w * n.x * n.z;
+        ad += w * n.x * d;
+        b2 += w * n.y * n.y;
+        bc += w * n.y * n.z;
+        bd += w * n.y * d;
+        c2 += w * n.z * n.z;
+        cd += w * n.z * d;
+        d2 += w * d * d;
+        weight += w;
+    }
+
+    Quadric& operator+=(const Quadric& o)
+    {
+        a2 += o.a2, ab += o.ab, ac += o.ac, ad += o.ad;
+        b2 += o.b2, bc += o.bc, bd += o.bd;
+        c2 += o.c2, cd += o.cd;
+        d2 += o.d2;
+        weight += o.weight;
+        return *this;
+    }
+
+    double Evaluate(const glm::dvec3& p) const
+    {
+        double r = a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x;
+        r += b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y;
+        r += c2 * p.z * p.z + 2 * cd * p.z + d2;
+        // rounding can make it slightly negative
+        return std::max(r, 0.0);
+    }
+};
+
+struct Collapse
+{
+    double cost;
+    // mean squared distance, cost divided by the weight
+    double error;
+    // the vertex that is removed and the one it's replaced with, both in the same triangle
+    uint32_t from;
+    uint32_t to;
+};
+
+// the vertex of every position, vertices at the same position share the first of them
+std::vector<uint32_t> WeldPositions(std::span<const glm::vec3> positions)
+{
+    std::vector<uint32_t> order(positions.size());
+    std::iota(order.begin(), order.end(), 0);
+    auto less = [&](uint32_t a, uint32_t b)
+    {
+        const glm::vec3& pa = positions[a];
+        const glm::vec3& pb = positions[b];
+        if (pa.x != pb.x)
+            return pa.x < pb.x;
+        if (pa.y != pb.y)
+            return pa.y < pb.y;
+        if (pa.z != pb.z)
+            return pa.z < pb.z;
+        return a < b;
+    };
+    std::sort(order.begin(), order.end(), less);
+
+    std::vector<uint32_t> canonical(positions.size());
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        bool same = i != 0 && positions[order[i]] == positions[order[i - 1]];
+        canonical[order[i]] = same ? canonical[order[i - 1]] : order[i];
+    }
+    return canonical;
+}
+} // namespace
+
+std::vector<uint32_t> SimplifyMesh(
+    std::span<const glm::vec3> positions,
+    std::span<const uint32_t> indices,
+    size_t targetIndexCount,
+    float maxError,
+    float* error
+)
+{
+    std::vector<uint32_t> triangles(indices.begin(), indices.end());
+    if (error)
+        *error = 0;
+
+    const size_t vertexCount = positions.size();
+    std::vector<uint32_t> canonical = WeldPositions(positions);
+
+    // a position with more than one vertex is a seam, collapsing it would need to move every one of its vertices
+    std::vector<uint32_t> wedge(vertexCount, UINT32_MAX);
+    std::vector<uint8_t> locked(vertexCount, 0);
+    for (uint32_t index : triangles)
+    {
+        uint32_t c = canonical[index];
+        if (wedge[c] == UINT32_MAX)
+            wedge[c] = index;
+        else if (wedge[c] != index)
+            locked[c] = 1;
+    }
+
+    // edges used by one triangle are open borders, more than two are non manifold
+    std::vector<uint64_t> edges;
+    edges.reserve(triangles.size());
+    for (size_t t = 0; t < triangles.size(); t += 3)
+    {
+        for (int e = 0; e < 3; ++e)
+        {
+            uint64_t a = canonical[triangles[t + e]];
+            uint64_t b = canonical[triangles[t + (e + 1) % 3]];
+            if (a != b)
+                edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();)
+    {
+        size_t j = i + 1;
+        while (j < edges.size() && edges[j] == edges[i])
+            ++j;
+        if (j - i != 2)
+        {
+            locked[edges[i] >> 32] = 1;
+            locked[edges[i] & UINT32_MAX] = 1;
+        }
+        i = j;
+    }
+    edges = {};
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < triangles.size(); t += 3)
+    {
+        glm::dvec3 p0 = positions[triangles[t]];
+        glm::dvec3 p1 = positions[triangles[t + 1]];
+        glm::dvec3 p2 = positions[triangles[t + 2]];
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(normal);
+        if (length == 0)
+            continue;
+
+        normal /= length;
+        double d = -glm::dot(normal, p0);
+        for (int i = 0; i < 3; ++i)
+            quadrics[canonical[triangles[t + i]]].AddPlane(normal, d, length * 0.5);
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<uint32_t> remap(vertexCount);
+    double maxSquaredError = (double)maxError * maxError;
+    double largestError = 0;
+
+    while (triangles.size() > targetIndexCount)
+    {
+        // the triangles around every welded vertex
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (uint32_t index : triangles)
+            adjacencyOffsets[canonical[index] + 1] += 1;
+        std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+        adjacency.resize(triangles.size());
+        {
+            std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < triangles.size(); ++i)
+                adjacency[cursors[canonical[triangles[i]]]++] = i / 3;
+        }
+
+        // the cheaper direction of every edge, an interior edge is visited in the triangle where a < b
+        collapses.clear();
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            for (int e = 0; e < 3; ++e)
+            {
+                uint32_t i0 = triangles[t + e];
+                uint32_t i1 = triangles[t + (e + 1) % 3];
+                uint32_t c0 = canonical[i0];
+                uint32_t c1 = canonical[i1];
+                if (c0 >= c1 || (locked[c0] && locked[c1]))
+                    continue;
+
+                Quadric q = quadrics[c0];
+                q += quadrics[c1];
+                double cost0 = locked[c0] ? DBL_MAX : q.Evaluate(positions[c1]);
+                double cost1 = locked[c1] ? DBL_MAX : q.Evaluate(positions[c0]);
+                double cost = std::min(cost0, cost1);
+                double squaredError = q.weight > 0 ? cost / q.weight : 0;
+                if (squaredError > maxSquaredError)
+                    continue;
+
+                if (cost0 <= cost1)
+                    collapses.push_back({cost, squaredError, i0, i1});
+                else
+                    collapses.push_back({cost, squaredError, i1, i0});
+            }
+        }
+        std::sort(
+            collapses.begin(),
+            collapses.end(),
+            [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; }
+        );
+
+        std::iota(remap.begin(), remap.end(), 0);
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t triangleCount = triangles.size() / 3;
+        size_t collapseCount = 0;
+        for (const Collapse& collapse : collapses)
+        {
+            if (triangleCount * 3 <= targetIndexCount)
+                break;
+
+            uint32_t u = canonical[collapse.from];
+            uint32_t v = canonical[collapse.to];
+            if (touched[u] || touched[v])
+                continue;
+
+            // the triangles that keep their area must not flip when u moves to v
+            glm::dvec3 target = positions[v];
+            bool flipped = false;
+            uint32_t removed = 0;
+            for (uint32_t a = adjacencyOffsets[u]; a < adjacencyOffsets[u + 1] && !flipped; ++a)
+            {
+                const uint32_t* tri = &triangles[adjacency[a] * 3];
+                uint32_t c[3] = {canonical[tri[0]], canonical[tri[1]], canonical[tri[2]]};
+                if (c[0] == v || c[1] == v || c[2] == v)
+                {
+                    removed += 1;
+                    continue;
+                }
+
+                glm::dvec3 p[3] = {positions[c[0]], positions[c[1]], positions[c[2]]};
+                glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                for (int i = 0; i < 3; ++i)
+                {
+                    if (c[i] == u)
+                        p[i] = target;
+                }
+                glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+                // degenerate input triangles don't block collapses, new ones do
+                double d = glm::dot(before, after);
+                flipped = d < 0 || (d == 0 && before != glm::dvec3(0));
+            }
+            if (flipped)
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[v] += quadrics[u];
+            largestError = std::max(largestError, collapse.error);
+            triangleCount -= removed;
+            collapseCount += 1;
+
+            // the neighbourhood of u changed, its vertices wait for the next pass
+            for (uint32_t a = adjacencyOffsets[u]; a < adjacencyOffsets[u + 1]; ++a)
+            {
+                const uint32_t* tri = &triangles[adjacency[a] * 3];
+                for (int i = 0; i < 3; ++i)
+                    touched[canonical[tri[i]]] = 1;
+            }
+        }
+
+        if (collapseCount == 0)
+            break;
+
+        // a removed vertex was never a target in the same pass, one remap is enough
+        size_t write = 0;
+        for (size_t t = 0; t < triangles.size(); t += 3)
+        {
+            uint32_t i0 = remap[triangles[t]];
+            uint32_t i1 = remap[triangles[t + 1]];
+            uint32_t i2 = remap[triangles[t + 2]];
+            uint32_t c0 = canonical[i0];
+            uint32_t c1 = canonical[i1];
+            uint32_t c2 = canonical[i2];
+            if (c0 == c1 || c1 == c2 || c0 == c2)
+                continue;
+
+            triangles[write++] = i0;
+            triangles[write++] = i1;
+            triangles[write++] = i2;
+        }
+        triangles.resize(write);
+    }
+
+    if (error)
+        *error = std::sqrt(largestError);
+    return triangles;
+}
+} // namespace Engine
@@ -0,0 +1,26 @@
+#pragma once
+#include <cfloat>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace Engine
+{
+// Quadric error metric simplification (Garland and Heckbert) by edge collapse. An edge collapses into one of its
+// vertices, vertices are never moved, so the result indexes the same vertex buffer and the attributes stay valid.
+// Vertices at the same position are welded for the topology. Vertices on open borders and on attribute seams (a
+// position with more than one vertex) are kept. Collapses are done in passes: every pass collapses the cheapest
+// edges whose neighbourhoods don't overlap and rebuilds the adjacency.
+//
+// Returns the indices of the simplified triangles, at most targetIndexCount unless no more edges can collapse
+// without exceeding maxError or flipping a triangle. error receives the largest error of a collapse, the root mean
+// square distance to the planes of the triangles merged into the kept vertex, in the units of positions
+std::vector<uint32_t> SimplifyMesh(
+    std::span<const glm::vec3> positions,
+    std::span<const uint32_t> indices,
+    size_t targetIndexCount,
+    float maxError = FLT_MAX,
+    float* error = nullptr
+);
+} // namespace Engine
@@ -0,0 +1,242 @@
+#include "Meshlets.hpp"
+#include "MeshOptimizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace Engine
+{
+namespace
+{
+// the bounding sphere and the normal cone of the triangles of a meshlet
+void ComputeBounds(
+    Meshlet& meshlet,
+    std::span<const glm::vec3> positions,
+    std::span<const uint32_t> triangles,
+    std::span<const uint32_t> vertices
+)
+{
+    glm::vec3 min = positions[vertices[0]];
+    glm::vec3 max = min;
+    for (uint32_t v : vertices)
+    {
+        min = glm::min(min, positions[v]);
+        max = glm::max(max, positions[v]);
+    }
+    meshlet.center = (min + max) * 0.5f;
+    meshlet.radius = 0;
+    for (uint32_t v : vertices)
+        meshlet.radius = std::max(meshlet.radius, glm::length(positions[v] - meshlet.center));
+
+    std::vector<glm::vec3> normals;
+    normals.reserve(triangles.size() / 3);
+    glm::vec3 axis = glm::vec3(0);
+    for (size_t t = 0; t < triangles.size(); t += 3)
+    {
+        glm::vec3 p0 = positions[triangles[t]];
+        glm::vec3 normal = glm::cross(positions[triangles[t + 1]] - p0, positions[triangles[t + 2]] - p0);
+        float length = glm::length(normal);
+        // degenerate triangles are never visible
+        if (length == 0)
+            continue;
+
+        normals.push_back(normal * (1 / length));
+        axis = axis + normals.back();
+    }
+
+    meshlet.coneAxis = glm::vec3(0);
+    meshlet.coneCutoff = 1;
+    float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength < 1e-6f)
+        return;
+
+    axis = axis * (1 / axisLength);
+    float minDot = 1;
+    for (auto& normal : normals)
+        minDot = std::min(minDot, glm::dot(normal, axis));
+
+    // the normals spread over a hemisphere or more, some triangle faces every position
+    if (minDot <= 0)
+        return;
+
+    // a view direction within 90 degrees minus the spread of the cone to the axis sees the back of every triangle
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = std::sqrt(1 - minDot * minDot);
+}
+} // namespace
+
+std::vector<Meshlet> BuildMeshlets(
+    std::span<const glm::vec3> positions, std::span<uint32_t> indices, uint32_t maxVertices, uint32_t maxTriangles
+)
+{
+    std::vector<Meshlet> meshlets;
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || maxVertices < 3 || maxTriangles == 0)
+        return meshlets;
+
+    // the triangles of every vertex
+    const size_t vertexCount = positions.size();
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        offsets[indices[i] + 1] += 1;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i)
+            adjacency[cursors[indices[i]]++] = i / 3;
+    }
+
+    std::vector<uint8_t> used(triangleCount, 0);
+    // the meshlet a vertex or candidate triangle was last added to, numbered from 1
+    std::vector<uint32_t> vertexMeshlet(vertexCount, 0);
+    std::vector<uint32_t> candidateMeshlet(triangleCount, 0);
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint32_t> result;
+    result.reserve(triangleCount * 3);
+    size_t cursor = 0;
+
+    while (result.size() < triangleCount * 3)
+    {
+        uint32_t id = meshlets.size() + 1;
+        Meshlet meshlet;
+        meshlet.firstIndex = result.size();
+        candidates.clear();
+        meshletVertices.clear();
+
+        auto newVertexCount = [&](uint32_t t)
+        {
+            uint32_t count = 0;
+            for (int i = 0; i < 3; ++i)
+                count += vertexMeshlet[indices[t * 3 + i]] != id;
+            return count;
+        };
+
+        auto add = [&](uint32_t t)
+        {
+            used[t] = 1;
+            meshlet.triangleCount += 1;
+            for (int i = 0; i < 3; ++i)
+            {
+                uint32_t v = indices[t * 3 + i];
+                result.push_back(v);
+                if (vertexMeshlet[v] == id)
+                    continue;
+
+                vertexMeshlet[v] = id;
+                meshletVertices.push_back(v);
+                for (uint32_t a = offsets[v]; a < offsets[v + 1]; ++a)
+                {
+                    uint32_t neighbour = adjacency[a];
+                    if (!used[neighbour] && candidateMeshlet[neighbour] != id)
+                    {
+                        candidateMeshlet[neighbour] = id;
+                        candidates.push_back(neighbour);
+                    }
+                }
+            }
+        };
+
+        while (used[cursor])
+            ++cursor;
+        add(cursor);
+
+        while (meshlet.triangleCount < maxTriangles)
+        {
+            // the neighbour that adds the fewest vertices, one that adds none can't be beaten
+            uint32_t best = UINT32_MAX;
+            uint32_t bestCount = UINT32_MAX;
+            for (uint32_t t : candidates)
+            {
+                if (used[t])
+                    continue;
+
+                uint32_t count = newVertexCount(t);
+                if (count < bestCount)
+                {
+                    best = t;
+                    bestCount = count;
+                    if (count == 0)
+                        break;
+                }
+            }
+
+            if (best == UINT32_MAX)
+            {
+                while (cursor < triangleCount && used[cursor])
+                    ++cursor;
+                if (cursor == triangleCount)
+                    break;
+                best = cursor;
+                bestCount = newVertexCount(best);
+            }
+
+            // no other triangle adds fewer vertices, so none fits either
+            if (meshletVertices.size() + bestCount > maxVertices)
+                break;
+            add(best);
+        }
+
+        meshlet.vertexCount = meshletVertices.size();
+        std::span<const uint32_t> triangles(result.data() + meshlet.firstIndex, meshlet.triangleCount * 3);
+        ComputeBounds(meshlet, positions, triangles, meshletVertices);
+        meshlets.push_back(meshlet);
+    }
+
+    std::copy(result.begin(), result.end(), indices.begin());
+    return meshlets;
+}
+
+void OptimizeMeshletVertexCache(std::span<const Meshlet> meshlets, std::span<uint32_t> indices, size_t vertexCount)
+{
+    // the triangles of a meshlet are optimized on its own vertices, numbered from 0
+    std::vector<uint32_t> localIndex(vertexCount, UINT32_MAX);
+    std::vector<uint32_t> vertices;
+    std::vector<uint32_t> triangles;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        std::span<uint32_t> range = indices.subspan(meshlet.firstIndex, meshlet.triangleCount * 3);
+        vertices.clear();
+        triangles.assign(range.begin(), range.end());
+        for (uint32_t& index : triangles)
+        {
+            if (localIndex[index] == UINT32_MAX)
+            {
+                localIndex[index] = vertices.size();
+                vertices.push_back(index);
+            }
+            index = localIndex[index];
+        }
+
+        OptimizeVertexCache(triangles, vertices.size());
+        for (size_t i = 0; i < range.size(); ++i)
+            range[i] = vertices[triangles[i]];
+        for (uint32_t v : vertices)
+            localIndex[v] = UINT32_MAX;
+    }
+}
+
+bool IsMeshletVisible(const Meshlet& meshlet, std::span<const glm::vec4, 6> planes, const glm::vec3* viewPos)
+{
+    // the cull groups on the GPU have boxes, the sphere's box is tested like them
+    glm::vec3 extent = glm::vec3(meshlet.radius);
+    const glm::vec3& center = meshlet.center;
+    for (const glm::vec4& plane : planes)
+    {
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float reach = std::abs(plane.x) * extent.x + std::abs(plane.y) * extent.y + std::abs(plane.z) * extent.z;
+        if (distance < -reach)
+            return false;
+    }
+
+    if (viewPos != nullptr && meshlet.coneCutoff < 1)
+    {
+        glm::vec3 direction = center - *viewPos;
+        float radius = glm::length(extent);
+        if (glm::dot(direction, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(direction) + radius)
+            return false;
+    }
+    return true;
+}
+} // namespace Engine
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace Engine
+{
+// a cluster of triangles that are contiguous in the index buffer, culled as a whole
+struct Meshlet
+{
+    static constexpr uint32_t MAX_VERTICES = 64;
+    static constexpr uint32_t MAX_TRIANGLES = 124;
+
+    // range of the meshlet's triangles in the indices
+    uint32_t firstIndex = 0;
+    uint32_t triangleCount = 0;
+    // the distinct vertices its triangles use
+    uint32_t vertexCount = 0;
+    // bounding sphere
+    glm::vec3 center = glm::vec3(0);
+    float radius = 0;
+    // the normals of the triangles are within the cone around the axis. The meshlet faces away from a view position p
+    // when dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius, a cutoff of 1 never culls
+    glm::vec3 coneAxis = glm::vec3(0);
+    float coneCutoff = 1;
+};
+
+// Splits the triangles into meshlets of at most maxVertices vertices and maxTriangles triangles and reorders indices
+// so every meshlet is a range of them. A meshlet grows by the triangle next to it that adds the fewest vertices, it
+// continues with the next triangle in the order of indices when none is left next to it. Indices optimized for the
+// vertex cache keep most of their locality
+std::vector<Meshlet> BuildMeshlets(
+    std::span<const glm::vec3> positions,
+    std::span<uint32_t> indices,
+    uint32_t maxVertices = Meshlet::MAX_VERTICES,
+    uint32_t maxTriangles = Meshlet::MAX_TRIANGLES
+);
+
+// Reorders the triangles inside every meshlet for the post transform vertex cache, the meshlets keep their ranges.
+// BuildMeshlets leaves the triangles in the order the meshlets grew, which undoes an optimization done before it
+void OptimizeMeshletVertexCache(std::span<const Meshlet> meshlets, std::span<uint32_t> indices, size_t vertexCount);
+
+// The CPU reference of the meshlet culling of Game/CullInstances.comp, in the space of the meshlet. planes are the
+// frustum planes, a point p is inside when dot(plane.xyz, p) + plane.w >= 0. Back facing meshlets are only culled
+// with a viewPos
+bool IsMeshletVisible(const Meshlet& meshlet, std::span<const glm::vec4, 6> planes, const glm::vec3* viewPos);
+} // namespace Engine
@@ -0,0 +1,140 @@
+#include "RadixSort.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace Engine
+{
+static constexpr uint32_t RADIX_BITS = 8;
+static constexpr uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+static constexpr uint32_t PASS_COUNT = 64 / RADIX_BITS;
+// below this a block isn't worth handing to another thread
+static constexpr size_t MIN_KEYS_PER_BLOCK = 4096;
+
+void RadixSort(
+    std::vector<uint64_t>& keys, std::vector<uint32_t>& values, ThreadPool* threadPool, RadixSortScratch* scratch
+)
+{
+    assert(keys.size() == values.size());
+    const size_t count = keys.size();
+    if (count <= 1)
+        return;
+
+    RadixSortScratch localScratch;
+    if (scratch == nullptr)
+        scratch = &localScratch;
+
+    struct Blocks
+    {
+        size_t count;
+        size_t size;
+        uint32_t blockCount;
+    } blocks{count, count, 1};
+    if (threadPool)
+        blocks.blockCount = std::clamp<size_t>(count / MIN_KEYS_PER_BLOCK, 1, threadPool->GetThreadCount());
+    blocks.size = (count + blocks.blockCount - 1) / blocks.blockCount;
+    const uint32_t blockCount = blocks.blockCount;
+
+    // f(begin, end, block) for every block. The task only captures two references so std::function stores it
+    // without allocating
+    auto forEachBlock = [&blocks, threadPool](auto&& f)
+    {
+        auto task = [&blocks, &f](uint32_t block, uint32_t)
+        { f(block * blocks.size, std::min(blocks.count, (block + 1) * blocks.size), block); };
+
+        if (blocks.blockCount > 1)
+            threadPool->ParallelFor(blocks.blockCount, task);
+        else
+            task(0, 0);
+    };
+
+    // histograms of a block for every pass, the pass histogram of a block is turned into its scatter offsets
+    auto& histograms = scratch->histograms;
+    histograms.resize((size_t)blockCount * PASS_COUNT * RADIX_SIZE);
+    auto histogram = [&histograms](uint32_t block, uint32_t pass)
+    { return histograms.data() + ((size_t)block * PASS_COUNT + pass) * RADIX_SIZE; };
+
+    forEachBlock(
+        [&](size_t begin, size_t end, uint32_t block)
+        {
+            std::fill_n(histogram(block, 0), PASS_COUNT * RADIX_SIZE, 0);
+            for (size_t i = begin; i < end; ++i)
+            {
+                for (uint32_t pass = 0; pass < PASS_COUNT; ++pass)
+                    histogram(block, pass)[(keys[i] >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)] += 1;
+            }
+        }
+    );
+
+    // a digit that every key shares doesn't change the order, the counts of a digit are the same before every pass
+    bool skipPass[PASS_COUNT];
+    for (uint32_t pass = 0; pass < PASS_COUNT; ++pass)
+    {
+        skipPass[pass] = false;
+        for (uint32_t digit = 0; digit < RADIX_SIZE && !skipPass[pass]; ++digit)
+        {
+            size_t digitCount = 0;
+            for (uint32_t block = 0; block < blockCount; ++block)
+                digitCount += histogram(block, pass)[digit];
+            skipPass[pass] = digitCount == count;
+        }
+    }
+
+    auto& tempKeys = scratch->keys;
+    auto& tempValues = scratch->values;
+    tempKeys.resize(count);
+    tempValues.resize(count);
+    bool firstPass = true;
+    for (uint32_t pass = 0; pass < PASS_COUNT; ++pass)
+    {
+        if (skipPass[pass])
+            continue;
+
+        const uint32_t shift = pass * RADIX_BITS;
+
+        // the blocks hold other keys after a pass, the histograms counted up front are only right for the first one
+        if (!firstPass)
+        {
+            forEachBlock(
+                [&](size_t begin, size_t end, uint32_t block)
+                {
+                    size_t* h = histogram(block, pass);
+                    std::fill_n(h, RADIX_SIZE, 0);
+                    for (size_t i = begin; i < end; ++i)
+                        h[(keys[i] >> shift) & (RADIX_SIZE - 1)] += 1;
+                }
+            );
+        }
+        firstPass = false;
+
+        // keys of a digit go after the smaller digits, and within a digit block by block to keep the sort stable
+        size_t offset = 0;
+        for (uint32_t digit = 0; digit < RADIX_SIZE; ++digit)
+        {
+            for (uint32_t block = 0; block < blockCount; ++block)
+            {
+                size_t* h = histogram(block, pass);
+                size_t digitCount = h[digit];
+                h[digit] = offset;
+                offset += digitCount;
+            }
+        }
+
+        forEachBlock(
+            [&](size_t begin, size_t end, uint32_t block)
+            {
+                size_t* h = histogram(block, pass);
+                for (size_t i = begin; i < end; ++i)
+                {
+                    size_t dst = h[(keys[i] >> shift) & (RADIX_SIZE - 1)]++;
+                    tempKeys[dst] = keys[i];
+                    tempValues[dst] = values[i];
+                }
+            }
+        );
+
+        keys.swap(tempKeys);
+        values.swap(tempValues);
+    }
+}
+} // namespace Engine
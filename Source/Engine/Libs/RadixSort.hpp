@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Engine
+{
+class ThreadPool;
+
+// memory of RadixSort, reusing it avoids allocations once it has grown to the input size
+struct RadixSortScratch
+{
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> values;
+    std::vector<size_t> histograms;
+};
+
+// Stable LSD radix sort of 64 bit keys, 8 bits per pass. values are moved with their keys. Passes whose digit is the
+// same for every key are skipped, so keys that only use their high bits cost a few passes. With a thread pool, large
+// inputs are split into one block per thread and every pass counts and scatters the blocks in parallel
+void RadixSort(
+    std::vector<uint64_t>& keys,
+    std::vector<uint32_t>& values,
+    ThreadPool* threadPool = nullptr,
+    RadixSortScratch* scratch = nullptr
+);
+} // namespace Engine
@@ -0,0 +1,68 @@
+#include "RangeAllocator.hpp"
+#include <cassert>
+#include <iterator>
+
+namespace Engine
+{
+RangeAllocator::RangeAllocator(uint64_t capacity) : capacity(capacity), freeSize(capacity)
+{
+    if (capacity != 0)
+        freeRanges[0] = capacity;
+}
+
+uint64_t RangeAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+    if (size == 0 || size > freeSize)
+        return INVALID;
+
+    for (auto iter = freeRanges.begin(); iter != freeRanges.end(); ++iter)
+    {
+        uint64_t start = iter->first;
+        uint64_t end = start + iter->second;
+        uint64_t offset = (start + alignment - 1) / alignment * alignment;
+        if (offset + size > end)
+            continue;
+
+        // the padding before offset and the rest after it stay free
+        freeRanges.erase(iter);
+        if (offset != start)
+            freeRanges[start] = offset - start;
+        if (offset + size != end)
+            freeRanges[offset + size] = end - offset - size;
+        freeSize -= size;
+        return offset;
+    }
+
+    return INVALID;
+}
+
+void RangeAllocator::Free(uint64_t offset, uint64_t size)
+{
+    assert(offset + size <= capacity);
+    if (size == 0)
+        return;
+
+    freeSize += size;
+    auto next = freeRanges.lower_bound(offset);
+    assert(next == freeRanges.end() || next->first >= offset + size);
+
+    if (next != freeRanges.end() && next->first == offset + size)
+    {
+        size += next->second;
+        next = freeRanges.erase(next);
+    }
+
+    if (next != freeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        assert(prev->first + prev->second <= offset);
+        if (prev->first + prev->second == offset)
+        {
+            prev->second += size;
+            return;
+        }
+    }
+
+    freeRanges[offset] = size;
+}
+} // namespace Engine
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <map>
+
+namespace Engine
+{
+// First fit allocator of ranges in [0, capacity), the unit is up to the user. Free ranges are kept by offset and a
+// freed range is merged with its free neighbours, so unloading doesn't fragment the space
+class RangeAllocator
+{
+public:
+    static constexpr uint64_t INVALID = UINT64_MAX;
+
+    RangeAllocator(uint64_t capacity = 0);
+
+    // returns the offset of size units aligned to alignment, INVALID when no free range is large enough
+    uint64_t Allocate(uint64_t size, uint64_t alignment = 1);
+    void Free(uint64_t offset, uint64_t size);
+
+    uint64_t GetCapacity() const
+    {
+        return capacity;
+    }
+
+    uint64_t GetFreeSize() const
+    {
+        return freeSize;
+    }
+
+private:
+    uint64_t capacity;
+    uint64_t freeSize;
+    // offset to size of the free ranges
+    std::map<uint64_t, uint64_t> freeRanges;
+};
+} // namespace Engine
@@ -0,0 +1,132 @@
+#include "ShadowCascades.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Engine
+{
+void ComputeCascadeSplits(float near, float far, float lambda, std::span<float> splits)
+{
+    for (size_t i = 0; i < splits.size(); ++i)
+    {
+        float t = (i + 1) / (float)splits.size();
+        float logSplit = near * std::pow(far / near, t);
+        float uniformSplit = near + (far - near) * t;
+        splits[i] = lambda * logSplit + (1 - lambda) * uniformSplit;
+    }
+
+    if (!splits.empty())
+        splits.back() = far;
+}
+
+void FitShadowCascades(
+    const glm::mat4& cameraToWorld,
+    const glm::mat4& projection,
+    float near,
+    float far,
+    float lambda,
+    const glm::mat4& lightToWorld,
+    const glm::vec2& resolution,
+    float casterDistance,
+    std::span<ShadowCascade> cascades,
+    uint32_t cacheMargin
+)
+{
+    if (cascades.empty())
+        return;
+
+    float splits[MAX_SHADOW_CASCADES];
+    size_t count = std::min<size_t>(cascades.size(), MAX_SHADOW_CASCADES);
+    ComputeCascadeSplits(near, far, lambda, std::span<float>(splits, count));
+
+    // a corner of the slice at distance d is d * sqrt(spread) away from the view axis
+    float tanX = 1 / projection[0][0];
+    float tanY = 1 / std::abs(projection[1][1]);
+    float spread = tanX * tanX + tanY * tanY;
+
+    glm::vec3 cameraPos = glm::vec3(cameraToWorld[3]);
+    glm::vec3 forward = -glm::normalize(glm::vec3(cameraToWorld[2]));
+    glm::vec3 lightX = glm::normalize(glm::vec3(lightToWorld[0]));
+    glm::vec3 lightY = glm::normalize(glm::vec3(lightToWorld[1]));
+    glm::vec3 lightZ = glm::normalize(glm::vec3(lightToWorld[2]));
+
+    float sliceNear = near;
+    for (size_t i = 0; i < count; ++i)
+    {
+        float sliceFar = splits[i];
+
+        // the smallest sphere on the view axis around the corners of both ends of the slice, it only depends on the
+        // shape of the slice so it's the same for every camera orientation
+        float center = std::min((sliceNear + sliceFar) * (1 + spread) * 0.5f, sliceFar);
+        float nearDistance = (center - sliceNear) * (center - sliceNear) + sliceNear * sliceNear * spread;
+        float farDistance = (sliceFar - center) * (sliceFar - center) + sliceFar * sliceFar * spread;
+        float radius = std::sqrt(std::max(nearDistance, farDistance));
+        // float error would still change it a little
+        radius = std::ceil(radius * 16) / 16;
+
+        // snap the center in light space to the texel grid of the cascade, the cascade is a texel wider than the
+        // sphere on each side so the sphere stays inside when the center moves by up to a texel
+        glm::vec3 centerWS = cameraPos + forward * center;
+        float border = 2.0f * (1 + cacheMargin);
+        float width = radius * resolution.x / (resolution.x - border);
+        float height = radius * resolution.y / (resolution.y - border);
+        float texelWidth = 2 * width / resolution.x;
+        float texelHeight = 2 * height / resolution.y;
+        float depthMargin = cacheMargin * std::max(texelWidth, texelHeight);
+        float x = std::floor(glm::dot(lightX, centerWS) / texelWidth) * texelWidth;
+        float y = std::floor(glm::dot(lightY, centerWS) / texelHeight) * texelHeight;
+        float z = glm::dot(lightZ, centerWS);
+        float zNear = z - radius - casterDistance - depthMargin;
+        float zFar = z + radius + depthMargin;
+        float depthScale = 1 / (zFar - zNear);
+
+        // rows of the projection, x and y of the cascade to [-1, 1] with y flipped and z to [0, 1]
+        glm::mat4 m(1);
+        for (int c = 0; c < 3; ++c)
+        {
+            m[c][0] = lightX[c] / width;
+            m[c][1] = -lightY[c] / height;
+            m[c][2] = lightZ[c] * depthScale;
+            m[c][3] = 0;
+        }
+        m[3][0] = -x / width;
+        m[3][1] = y / height;
+        m[3][2] = -zNear * depthScale;
+        m[3][3] = 1;
+
+        // a cached cascade of the same orientation and size is kept while the sphere and its casters are inside it
+        glm::mat4& cached = cascades[i].worldToShadow;
+        bool keep = false;
+        if (cacheMargin != 0 && glm::mat3(cached) == glm::mat3(m))
+        {
+            glm::vec4 p = cached * glm::vec4(centerWS, 1);
+            keep = std::abs(p.x) + radius / width <= 1 && std::abs(p.y) + radius / height <= 1 &&
+                   p.z - (radius + casterDistance) * depthScale >= 0 && p.z + radius * depthScale <= 1;
+        }
+        if (!keep)
+            cached = m;
+
+        cascades[i].splitDistance = sliceFar;
+        sliceNear = sliceFar;
+    }
+}
+
+uint32_t ShadowCascadeCache::Update(std::span<const ShadowCascade> cascades, uint64_t castersHash)
+{
+    uint32_t cascadeCount = std::min<size_t>(cascades.size(), MAX_SHADOW_CASCADES);
+    uint32_t dirty = 0;
+    if (!valid || castersHash != this->castersHash || cascadeCount != count)
+        dirty = (1u << cascadeCount) - 1;
+
+    for (uint32_t c = 0; c < cascadeCount; ++c)
+    {
+        if (cascades[c].worldToShadow != worldToShadow[c])
+            dirty |= 1u << c;
+        worldToShadow[c] = cascades[c].worldToShadow;
+    }
+
+    valid = true;
+    this->castersHash = castersHash;
+    count = cascadeCount;
+    return dirty;
+}
+} // namespace Engine
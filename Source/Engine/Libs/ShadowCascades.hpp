@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+
+namespace Engine
+{
+constexpr uint32_t MAX_SHADOW_CASCADES = 4; // defined in Common/Common.glsl
+
+// a slice of the camera frustum with its own region of a cascaded shadow map
+struct ShadowCascade
+{
+    // world space to the cascade's clip space, y is flipped and the depth is 0 to 1 like the camera's projection
+    glm::mat4 worldToShadow;
+    // view space distance the slice ends at
+    float splitDistance;
+};
+
+// The view space distances the cascades between near and far end at, the practical split scheme of Zhang et al. 2006.
+// lambda blends the logarithmic split at 1, which keeps the shadow texels per screen pixel the same in every cascade,
+// and the uniform split at 0
+void ComputeCascadeSplits(float near, float far, float lambda, std::span<float> splits);
+
+// Fits an orthographic projection of the light to every slice of the camera frustum between near and far. A cascade
+// covers the bounding sphere of its slice so its size doesn't change when the camera rotates, and it moves in whole
+// texels of a resolution sized shadow map so the edges of the shadows don't shimmer when the camera moves. Casters up
+// to casterDistance in front of the sphere are kept. Only the rotation of lightToWorld is used, the light shines along
+// its z axis. projection is a symmetric perspective projection.
+//
+// With a cacheMargin the cascades are cacheMargin texels larger on every side, and a cascade keeps the matrix it has in
+// cascades while the sphere is still inside it. A cached cascade is only drawn again after the camera moved about
+// cacheMargin of its texels
+void FitShadowCascades(
+    const glm::mat4& cameraToWorld,
+    const glm::mat4& projection,
+    float near,
+    float far,
+    float lambda,
+    const glm::mat4& lightToWorld,
+    const glm::vec2& resolution,
+    float casterDistance,
+    std::span<ShadowCascade> cascades,
+    uint32_t cacheMargin = 0
+);
+
+// The cascades of a cache of static shadow casters that have to be drawn again. A cascade is dirty when its matrix
+// changed, all of them are when the casters or the number of cascades changed or the cache was invalidated
+class ShadowCascadeCache
+{
+public:
+    // returns the dirty cascades, a bit per cascade, and remembers cascades and castersHash as the cache's content
+    uint32_t Update(std::span<const ShadowCascade> cascades, uint64_t castersHash);
+
+    // the content of the cache is lost, e.g. its image was created again
+    void Invalidate()
+    {
+        valid = false;
+    }
+
+private:
+    bool valid = false;
+    uint64_t castersHash = 0;
+    uint32_t count = 0;
+    glm::mat4 worldToShadow[MAX_SHADOW_CASCADES];
+};
+} // namespace Engine
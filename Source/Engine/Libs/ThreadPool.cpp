@@ -0,0 +1,85 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+namespace Engine
+{
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (uint32_t i = 1; i < threadCount; ++i)
+        workers.emplace_back([this, i]() { WorkerLoop(i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mutex);
+        stop = true;
+    }
+    wake.notify_all();
+
+    for (auto& w : workers)
+        w.join();
+}
+
+void ThreadPool::ParallelFor(uint32_t taskCount, const std::function<void(uint32_t, uint32_t)>& task)
+{
+    if (taskCount == 0)
+        return;
+
+    if (workers.empty() || taskCount == 1)
+    {
+        for (uint32_t i = 0; i < taskCount; ++i)
+            task(i, 0);
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        this->task = &task;
+        this->taskCount = taskCount;
+        nextTask = 0;
+        busyWorkers = workers.size();
+        generation += 1;
+    }
+    wake.notify_all();
+
+    RunTasks(0);
+
+    // every worker has to see this generation before the next one starts
+    std::unique_lock lock(mutex);
+    done.wait(lock, [this]() { return busyWorkers == 0; });
+    this->task = nullptr;
+}
+
+void ThreadPool::WorkerLoop(uint32_t threadIndex)
+{
+    uint64_t seenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock lock(mutex);
+            wake.wait(lock, [this, seenGeneration]() { return stop || generation != seenGeneration; });
+            if (stop)
+                return;
+            seenGeneration = generation;
+        }
+
+        RunTasks(threadIndex);
+
+        {
+            std::lock_guard lock(mutex);
+            busyWorkers -= 1;
+        }
+        done.notify_one();
+    }
+}
+
+void ThreadPool::RunTasks(uint32_t threadIndex)
+{
+    for (uint32_t i = nextTask++; i < taskCount; i = nextTask++)
+        (*task)(i, threadIndex);
+}
+} // namespace Engine
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Engine
+{
+// A fixed set of worker threads that split one piece of work. ParallelFor blocks until all tasks are done and the
+// calling thread runs tasks as well. Only one thread may call ParallelFor at a time
+class ThreadPool
+{
+public:
+    // threadCount includes the calling thread, 0 uses every core
+    ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    uint32_t GetThreadCount()
+    {
+        return workers.size() + 1;
+    }
+
+    // call task(taskIndex, threadIndex) for every taskIndex in [0, taskCount). threadIndex is in [0, GetThreadCount())
+    // and no two tasks running at the same time share it
+    void ParallelFor(uint32_t taskCount, const std::function<void(uint32_t taskIndex, uint32_t threadIndex)>& task);
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // the current ParallelFor, workers pick it up when generation changes
+    const std::function<void(uint32_t, uint32_t)>* task = nullptr;
+    uint32_t taskCount = 0;
+    std::atomic<uint32_t> nextTask = 0;
+    uint32_t busyWorkers = 0;
+    uint64_t generation = 0;
+    bool stop = false;
+
+    void WorkerLoop(uint32_t threadIndex);
+    void RunTasks(uint32_t threadIndex);
+};
+} // namespace Engine
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace Engine
+{
+// Kahn's algorithm. dependents[i] lists the nodes that have to come after node i.
+// Returns the nodes in dependency order, or nothing if the graph has a cycle
+inline std::optional<std::vector<size_t>> TopologicalSort(const std::vector<std::vector<size_t>>& dependents)
+{
+    std::vector<size_t> inDegrees(dependents.size(), 0);
+    for (auto& d : dependents)
+    {
+        for (size_t dependent : d)
+            inDegrees[dependent] += 1;
+    }
+
+    std::vector<size_t> sorted;
+    sorted.reserve(dependents.size());
+    for (size_t i = 0; i < dependents.size(); ++i)
+    {
+        if (inDegrees[i] == 0)
+            sorted.push_back(i);
+    }
+
+    // sorted doubles as the queue of nodes whose dependencies are all placed
+    for (size_t head = 0; head < sorted.size(); ++head)
+    {
+        for (size_t dependent : dependents[sorted[head]])
+        {
+            if (--inDegrees[dependent] == 0)
+                sorted.push_back(dependent);
+        }
+    }
+
+    if (sorted.size() != dependents.size())
+        return std::nullopt;
+
+    return sorted;
+}
+} // namespace Engine
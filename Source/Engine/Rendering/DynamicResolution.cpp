@@ -0,0 +1,45 @@
+#include "DynamicResolution.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace Engine
+{
+DynamicResolution::DynamicResolution() : DynamicResolution(Settings()) {}
+
+DynamicResolution::DynamicResolution(const Settings& settings) : settings(settings), scale(settings.maxScale) {}
+
+void DynamicResolution::SetSettings(const Settings& settings)
+{
+    this->settings = settings;
+    scale = std::clamp(scale, settings.minScale, settings.maxScale);
+}
+
+bool DynamicResolution::Update(float gpuFrameTime)
+{
+    if (gpuFrameTime <= 0)
+        return false;
+
+    frameTime = frameTime < 0 ? gpuFrameTime : frameTime + (gpuFrameTime - frameTime) * 0.1f;
+
+    if (cooldown > 0)
+    {
+        cooldown -= 1;
+        return false;
+    }
+
+    // the GPU time follows the pixel count, which is the square of the scale
+    float desired = scale * std::sqrt(settings.targetFrameTime / frameTime);
+    desired = std::clamp(desired, settings.minScale, settings.maxScale);
+    desired = std::clamp(std::round(desired / settings.step) * settings.step, settings.minScale, settings.maxScale);
+
+    // within a step of the target, not worth recreating the images
+    if (std::abs(desired - scale) < settings.step * 0.5f)
+        return false;
+
+    scale = desired;
+    // the average was measured at the old scale
+    frameTime = -1;
+    cooldown = settings.cooldownFrames;
+    return true;
+}
+} // namespace Engine
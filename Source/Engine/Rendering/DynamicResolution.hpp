@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+
+namespace Engine
+{
+// Picks the render scale that keeps the GPU frame time at a target. The frame time is smoothed and the scale moves in
+// steps, so the images sized by it are only recreated when the load really changed
+class DynamicResolution
+{
+public:
+    struct Settings
+    {
+        // milliseconds
+        float targetFrameTime = 16.6f;
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+        // the scale is a multiple of it
+        float step = 0.05f;
+        // frames to wait after a change, the new size needs a few frames to show in the measurement
+        uint32_t cooldownFrames = 30;
+    };
+
+    DynamicResolution();
+    DynamicResolution(const Settings& settings);
+
+    // feed the GPU time of the last frame in milliseconds, returns true if the scale changed
+    bool Update(float gpuFrameTime);
+
+    float GetScale()
+    {
+        return scale;
+    }
+
+    void SetSettings(const Settings& settings);
+    const Settings& GetSettings()
+    {
+        return settings;
+    }
+
+private:
+    Settings settings;
+    float scale;
+    // exponential moving average, negative before the first measurement
+    float frameTime = -1;
+    uint32_t cooldown = 0;
+};
+} // namespace Engine
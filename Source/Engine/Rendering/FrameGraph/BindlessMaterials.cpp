@@ -0,0 +1,99 @@
+#include "BindlessMaterials.hpp"
+#include "Asset/Material.hpp"
+#include "GfxDriver/GfxDriver.hpp"
+#include "GfxDriver/ShaderProgram.hpp"
+#include "Rendering/RenderPipeline.hpp"
+#include <cstring>
+
+namespace Engine::FrameGraph
+{
+static_assert(sizeof(BindlessMaterials::MaterialParams) == 48, "must match BindlessMaterial in Common/Bindless.glsl");
+
+BindlessMaterials::BindlessMaterials() : shaderResource(GetGfxDriver()->CreateShaderResource()) {}
+
+bool BindlessMaterials::IsBindless(Gfx::ShaderProgram& shaderProgram)
+{
+    return shaderProgram.GetShaderInfo().bindings.contains(MATERIALS_BINDING);
+}
+
+void BindlessMaterials::BeginFrame()
+{
+    materialIndices.clear();
+    textureIndices.clear();
+    textures.clear();
+    textures.push_back(nullptr);
+    params.clear();
+}
+
+uint32_t BindlessMaterials::AddMaterial(Material& material)
+{
+    auto iter = materialIndices.find(&material);
+    if (iter != materialIndices.end())
+        return iter->second;
+
+    MaterialParams p{
+        .baseColorFactor = material.GetVector("PBR", "baseColorFactor"),
+        .roughness = material.GetFloat("PBR", "roughness"),
+        .metallic = material.GetFloat("PBR", "metallic"),
+        .baseColorTex = AddTexture(material, "baseColorTex_sampler_linear"),
+        .normalMap = AddTexture(material, "normalMap_sampler_linear"),
+        .metallicRoughnessMap = AddTexture(material, "metallicRoughnessMap_sampler_linear"),
+        .emissiveMap = AddTexture(material, "emissiveMap_sampler_linear"),
+        .padding = {0, 0},
+    };
+
+    uint32_t index = params.size();
+    params.push_back(p);
+    materialIndices[&material] = index;
+    return index;
+}
+
+uint32_t BindlessMaterials::AddTexture(Material& material, const char* param)
+{
+    Texture* texture = material.GetTexture(param);
+    if (texture == nullptr || texture->GetGfxImage() == nullptr)
+        return 0;
+
+    Gfx::ImageView* imageView = &texture->GetGfxImage()->GetDefaultImageView();
+    auto iter = textureIndices.find(imageView);
+    if (iter != textureIndices.end())
+        return iter->second;
+
+    uint32_t index = textures.size();
+    textures.push_back(imageView);
+    textureIndices[imageView] = index;
+    return index;
+}
+
+void BindlessMaterials::EndFrame()
+{
+    // the shader resource only rewrites the descriptor set when the array actually changed
+    shaderResource->SetImages(TEXTURES_BINDING, textures);
+
+    if (params.empty())
+        return;
+
+    size_t size = params.size() * sizeof(MaterialParams);
+    if (materialBuffer == nullptr || materialBuffer->GetSize() < size)
+    {
+        size_t capacity = 64 * sizeof(MaterialParams);
+        while (capacity < size)
+            capacity *= 2;
+
+        materialBuffer = GetGfxDriver()->CreateBuffer({
+            .usages = Gfx::BufferUsage::Transfer_Dst | Gfx::BufferUsage::Storage,
+            .size = capacity,
+            .visibleInCPU = false,
+            .debugName = "Bindless Materials",
+        });
+        shaderResource->SetBuffer(MATERIALS_BINDING, materialBuffer.get());
+        uploadedParams.clear();
+    }
+
+    if (params.size() != uploadedParams.size() || memcmp(params.data(), uploadedParams.data(), size) != 0)
+    {
+        RenderPipeline::Singleton().UploadBuffer(*materialBuffer, (uint8_t*)params.data(), size, 0);
+        uploadedParams = params;
+    }
+}
+} // namespace Engine::FrameGraph
@@ -0,0 +1,75 @@
+#pragma once
+#include "GfxDriver/Buffer.hpp"
+#include "GfxDriver/ShaderResource.hpp"
+#include <glm/glm.hpp>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace Engine
+{
+class Material;
+}
+
+namespace Engine::Gfx
+{
+class ShaderProgram;
+}
+
+namespace Engine::FrameGraph
+{
+// Material table of the bindless path (G_BINDLESS). Textures of the materials drawn in a frame go into one runtime
+// sized array and their parameters into one storage buffer, the table is bound once per pass and a draw only pushes
+// its material index. The layout matches Common/Bindless.glsl
+class BindlessMaterials
+{
+public:
+    static constexpr const char* TEXTURES_BINDING = "bindlessTextures";
+    static constexpr const char* MATERIALS_BINDING = "BindlessMaterials";
+
+    // std430 layout of BindlessMaterial
+    struct MaterialParams
+    {
+        glm::vec4 baseColorFactor;
+        float roughness;
+        float metallic;
+        uint32_t baseColorTex;
+        uint32_t normalMap;
+        uint32_t metallicRoughnessMap;
+        uint32_t emissiveMap;
+        uint32_t padding[2];
+    };
+
+    BindlessMaterials();
+
+    // true if the shader program reads its material from the table
+    static bool IsBindless(Gfx::ShaderProgram& shaderProgram);
+
+    // called before draw lists are built
+    void BeginFrame();
+
+    // index of the material in the table, it's added on first use in the frame
+    uint32_t AddMaterial(Material& material);
+
+    // upload the parameters if they changed and update the texture array
+    void EndFrame();
+
+    Gfx::ShaderResource* GetShaderResource()
+    {
+        return shaderResource.get();
+    }
+
+private:
+    std::unique_ptr<Gfx::ShaderResource> shaderResource;
+    std::unique_ptr<Gfx::Buffer> materialBuffer;
+    std::unordered_map<Material*, uint32_t> materialIndices;
+    std::unordered_map<Gfx::ImageView*, uint32_t> textureIndices;
+    // element 0 is nullptr and binds the default texture
+    std::vector<Gfx::ImageView*> textures;
+    std::vector<MaterialParams> params;
+    // content of materialBuffer
+    std::vector<MaterialParams> uploadedParams;
+
+    uint32_t AddTexture(Material& material, const char* param);
+};
+} // namespace Engine::FrameGraph
@@ -1,7 +1,9 @@
 #include "FrameGraph.hpp"
 #include "Core/Component/Transform.hpp"
 #include "Core/GameObject.hpp"
+#include "Libs/TopologicalSort.hpp"
 #include "Nodes/ImageNode.hpp"
+#include <algorithm>
 #include <spdlog/spdlog.h>
 
 namespace Engine::FrameGraph
@@ -62,6 +64,36 @@ bool Graph::Connect(FGID src, FGID dst)
     return true;
 }
 
+bool Graph::HasCycleIfLink(FGID src, FGID dst)
+{
+    std::unordered_map<FGID, size_t> indices;
+    for (size_t i = 0; i < nodes.size(); ++i)
+        indices[nodes[i]->GetID()] = i;
+
+    std::vector<std::vector<size_t>> dependents(nodes.size());
+    for (FGID c : connections)
+    {
+        auto srcIter = indices.find(GetSrcNodeIDFromConnect(c));
+        auto dstIter = indices.find(GetDstNodeIDFromConnect(c));
+        if (srcIter != indices.end() && dstIter != indices.end())
+            dependents[srcIter->second].push_back(dstIter->second);
+    }
+
+    // the node of the output property runs first, the link can be made from either end
+    Node* srcNode = GetNode(GetNodeID(src));
+    Property* srcProp = srcNode ? srcNode->GetProperty(src) : nullptr;
+    if (srcProp && srcProp->IsInput())
+        std::swap(src, dst);
+
+    auto srcIter = indices.find(GetNodeID(src));
+    auto dstIter = indices.find(GetNodeID(dst));
+    if (srcIter == indices.end() || dstIter == indices.end())
+        return false;
+    dependents[srcIter->second].push_back(dstIter->second);
+
+    return !TopologicalSort(dependents).has_value();
+}
+
 void Graph::DeleteNode(Node* node)
 {
     RequireRecompile();
@@ -192,10 +224,47 @@ void Graph::ProcessLights(Scene& gameScene)
     }
 
     sceneInfo.lightCount = glm::vec4(lights.size(), 0, 0, 0);
-    if (light)
+    ProcessShadowCascades(*graphResource.mainCamera, light);
+}
+
+void Graph::ProcessShadowCascades(Camera& camera, Light* light)
+{
+    const ShadowCascadeSettings& settings = graphResource.shadowCascades;
+    uint32_t count = std::min(settings.count, MAX_SHADOW_CASCADES);
+    if (light == nullptr || count == 0)
     {
-        sceneInfo.worldToShadow = light->WorldToShadowMatrix();
+        if (light)
+            sceneInfo.worldToShadow = light->WorldToShadowMatrix();
+        sceneInfo.shadowCascades = glm::vec4(1, 0, 0, 0);
+        sceneInfo.shadowCascadeSplits = glm::vec4(camera.GetFar());
+        sceneInfo.worldToShadowCascades[0] = sceneInfo.worldToShadow;
+        graphResource.fittedShadowCascades[0] = {sceneInfo.worldToShadow, camera.GetFar()};
+        return;
     }
+
+    ShadowCascade* cascades = graphResource.fittedShadowCascades;
+    FitShadowCascades(
+        camera.GetGameObject()->GetTransform()->GetModelMatrix(),
+        camera.GetProjectionMatrix(),
+        camera.GetNear(),
+        std::min(camera.GetFar(), settings.distance),
+        settings.splitLambda,
+        light->GetGameObject()->GetTransform()->GetModelMatrix(),
+        settings.resolution,
+        settings.casterDistance,
+        std::span<ShadowCascade>(cascades, count),
+        settings.cacheMargin
+    );
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        sceneInfo.worldToShadowCascades[i] = cascades[i].worldToShadow;
+        sceneInfo.shadowCascadeSplits[i] = cascades[i].splitDistance;
+    }
+    sceneInfo.worldToShadow = cascades[0].worldToShadow;
+    sceneInfo.shadowCascades = glm::vec4(count, 0, 0, 0);
+    glm::vec2 size = glm::vec2(settings.resolution.x * count, settings.resolution.y);
+    sceneInfo.shadowMapSize = glm::vec4(size, 1.0f / size.x, 1.0f / size.y);
 }
 
 void Graph::Execute(Gfx::CommandBuffer& cmd, Scene& scene)
@@ -210,11 +279,19 @@ void Graph::Execute(Gfx::CommandBuffer& cmd, Scene& scene)
 
     graphResource.mainCamera = camera;
 
+    if (bindlessMaterials)
+        bindlessMaterials->BeginFrame();
+    sceneInstances->BeginFrame();
+    graphResource.shadowCascades = {};
+
     for (auto& n : nodes)
     {
         n->Execute(graphResource);
     }
 
+    if (bindlessMaterials)
+        bindlessMaterials->EndFrame();
+
     RefPtr<Transform> camTsm = camera->GetGameObject()->GetTransform();
 
     glm::mat4 viewMatrix = camera->GetViewMatrix();
@@ -236,6 +313,20 @@ void Graph::Execute(Gfx::CommandBuffer& cmd, Scene& scene)
 
     memcpy(stagingBuffer->GetCPUVisibleAddress(), &sceneInfo, sizeof(sceneInfo));
     cmd.CopyBuffer(stagingBuffer, sceneGlobalBuffer, regions);
+    glm::vec3 cameraPos = camTsm->GetPosition();
+    sceneInstances->SetCullView(SceneInstances::CullView::Camera, vp, &cameraPos);
+    // every cascade draws only the casters inside it
+    uint32_t cascadeCount = sceneInfo.shadowCascades.x;
+    for (uint32_t i = 0; i < MAX_SHADOW_CASCADES; ++i)
+    {
+        SceneInstances::CullView view = SceneInstances::ShadowCascadeView(i);
+        if (i < cascadeCount)
+            sceneInstances->SetCullView(view, sceneInfo.worldToShadowCascades[i]);
+        else
+            sceneInstances->ClearCullView(view);
+    }
+    sceneInstances->Upload(cmd, *sceneShaderResource);
+    sceneInstances->Cull(cmd);
 
     cmd.BindResource(0, sceneShaderResource.get());
     Gfx::GPUBarrier barrier{
@@ -269,10 +360,25 @@ bool Graph::Compile()
     });
     sceneShaderResource->SetBuffer("SceneInfo", sceneGlobalBuffer.get());
 
-    graph = std::make_unique<RenderGraph::Graph>();
+    if (GetGfxDriver()->GetGPUFeatures().descriptorIndexing)
+    {
+        bindlessMaterials = std::make_unique<BindlessMaterials>();
+        graphResource.bindlessMaterials = bindlessMaterials.get();
+    }
 
-    Resources buildResources;
+    if (sceneInstances == nullptr)
+    {
+        sceneInstances = std::make_unique<SceneInstances>();
+        graphResource.sceneInstances = sceneInstances.get();
+    }
+
+    // rebuilt in place, images whose description didn't change are reused
+    if (graph == nullptr)
+        graph = std::make_unique<RenderGraph::Graph>();
+    else
+        graph->Clear();
 
+    buildResources = {};
     for (auto& n : nodes)
     {
         auto resources = n->Preprocess(*graph);
@@ -304,7 +410,31 @@ bool Graph::Compile()
         }
     }
 
-    graph->Process();
+    // the output image is displayed after the graph is executed
+    if (ImageNode* outputImage = dynamic_cast<ImageNode*>(outputImageNode))
+        graph->Export(outputImage->GetRenderNode(), 0);
+
+    ProcessRenderGraph(false);
+
+    compiled = true;
+    return compiled;
+}
+
+void Graph::ProcessRenderGraph(bool resize)
+{
+    for (auto& n : nodes)
+    {
+        n->Resize(outputSize, renderScale);
+    }
+
+    // only the images whose size changed are recreated, the frame in flight keeps the old ones until it finished
+    if (!resize)
+        graph->Process();
+    else if (!graph->ResizeImages())
+    {
+        GetGfxDriver()->WaitForIdle();
+        graph->Process();
+    }
 
     for (auto& n : nodes)
     {
@@ -315,9 +445,33 @@ bool Graph::Compile()
     {
         n->Finalize(*graph, buildResources);
     }
+}
 
-    compiled = true;
-    return compiled;
+void Graph::Resize()
+{
+    if (!compiled)
+        return;
+
+    ProcessRenderGraph(true);
+}
+
+void Graph::SetOutputSize(glm::uvec2 size)
+{
+    if (size == outputSize)
+        return;
+
+    outputSize = size;
+    Resize();
+}
+
+void Graph::SetRenderScale(float scale)
+{
+    scale = std::clamp(scale, 0.01f, 1.0f);
+    if (scale == renderScale)
+        return;
+
+    renderScale = scale;
+    Resize();
 }
 
 void Graph::SetOutputImageNode(FGID nodeID)
@@ -1,10 +1,13 @@
 #pragma once
 #include "Asset/Shader.hpp"
+#include "BindlessMaterials.hpp"
 #include "Core/Asset.hpp"
 #include "Core/Scene/Scene.hpp"
 #include "GraphResource.hpp"
+#include "Libs/ShadowCascades.hpp"
 #include "NodeBlueprint.hpp"
 #include "Nodes/Node.hpp"
+#include "SceneInstances.hpp"
 #include "Rendering/RenderGraph/Graph.hpp"
 
 #if ENGINE_EDITOR
@@ -120,6 +123,43 @@ public:
         return compiled;
     }
 
+    // the size the output image is shown at. Images sized relative to it and their render passes are recreated
+    // without compiling the graph again or waiting for the device
+    void SetOutputSize(glm::uvec2 size);
+    glm::uvec2 GetOutputSize()
+    {
+        return outputSize;
+    }
+
+    // scales the images that use dynamic resolution, clamped to (0, 1]. Resizes them like SetOutputSize
+    void SetRenderScale(float scale);
+    float GetRenderScale()
+    {
+        return renderScale;
+    }
+
+    // which queue each pass of the compiled graph runs on, in execution order
+    std::span<const RenderGraph::Graph::QueueTimelineEntry> GetQueueTimeline()
+    {
+        if (graph)
+            return graph->GetQueueTimeline();
+        return {};
+    }
+
+    // the GPU time of every pass of a recent frame, in execution order
+    std::span<const RenderGraph::Graph::PassTiming> GetPassTimings()
+    {
+        if (graph)
+            return graph->GetPassTimings();
+        return {};
+    }
+
+    // milliseconds, 0 until the first timings are read back
+    float GetGpuFrameTime()
+    {
+        return graph ? graph->GetGpuFrameTime() : 0;
+    }
+
 private:
     class IDPool : public Serializable
     {
@@ -188,6 +228,10 @@ private:
         glm::mat4 worldToShadow;
         glm::vec4 lightCount;
         glm::vec4 shadowMapSize;
+        // x: cascade count
+        glm::vec4 shadowCascades;
+        glm::vec4 shadowCascadeSplits;
+        glm::mat4 worldToShadowCascades[MAX_SHADOW_CASCADES];
         LightInfo lights[MAX_LIGHT_COUNT];
     } sceneInfo;
 
@@ -201,18 +245,27 @@ private:
     Node* outputImageNode = nullptr;
     GraphResource graphResource;
     Shader* templateSceneResourceShader;
+    // kept from Compile for resizing
+    Resources buildResources;
+    glm::uvec2 outputSize = {0, 0};
+    float renderScale = 1.0f;
 
     std::unique_ptr<RenderGraph::Graph> graph;
     std::unique_ptr<Gfx::ShaderResource> sceneShaderResource{};
     std::unique_ptr<Gfx::Buffer> sceneGlobalBuffer;
     std::unique_ptr<Gfx::Buffer> stagingBuffer;
+    std::unique_ptr<BindlessMaterials> bindlessMaterials;
+    std::unique_ptr<SceneInstances> sceneInstances;
 
-    bool HasCycleIfLink(FGID src, FGID dst)
-    {
-        return false; // not implemented
-    }
+    bool HasCycleIfLink(FGID src, FGID dst);
+    // size the images, create the resources of the render graph and finalize the nodes, the passes are built. resize
+    // only recreates the images whose size changed when the graph allows it
+    void ProcessRenderGraph(bool resize);
+    void Resize();
 
     void ProcessLights(Scene& gameScene);
+    // fit the cascades of the shadow map to the camera, a single cascade uses the light's shadow matrix
+    void ProcessShadowCascades(Camera& camera, Light* light);
     void RequireRecompile()
     {
         compiled = false;
@@ -1,9 +1,35 @@
 #pragma once
 #include "Core/Component/Camera.hpp"
+#include "Libs/ShadowCascades.hpp"
 namespace Engine::FrameGraph
 {
+class BindlessMaterials;
+class SceneInstances;
+
+// the cascaded shadow map a shadow map node renders, the graph fits the cascades to the main camera
+struct ShadowCascadeSettings
+{
+    // 0 when no node renders cascades, the light's single shadow matrix is used
+    uint32_t count = 0;
+    float splitLambda = 0.7f;
+    // view space distance the last cascade ends at
+    float distance = 100;
+    // size of a cascade in the shadow map, the cascades are side by side
+    glm::vec2 resolution = {1024, 1024};
+    float casterDistance = 100;
+    // texels a cascade keeps around its slice when it's cached, see FitShadowCascades
+    uint32_t cacheMargin = 0;
+};
+
 struct GraphResource
 {
     Camera* mainCamera;
+    // nullptr when descriptor indexing is not supported
+    BindlessMaterials* bindlessMaterials = nullptr;
+    SceneInstances* sceneInstances = nullptr;
+    // reset every frame, set by the node that renders the shadow map
+    ShadowCascadeSettings shadowCascades;
+    // the cascades fitted to the main camera this frame, the first count are valid when the passes record
+    ShadowCascade fittedShadowCascades[MAX_SHADOW_CASCADES] = {};
 };
 } // namespace Engine::FrameGraph
@@ -1,6 +1,10 @@
 #pragma once
 #include "../NodeBlueprint.hpp"
 #include "Asset/Shader.hpp"
+#include "GfxDriver/GfxDriver.hpp"
+#include "Rendering/ParallelCommandRecorder.hpp"
+#include "Rendering/RenderPipeline.hpp"
+#include <spdlog/spdlog.h>
 
 namespace Engine::FrameGraph
 {
@@ -21,6 +25,7 @@ public:
     std::vector<Resource> Preprocess(RenderGraph::Graph& graph) override
     {
         glm::vec4* clearValuesVal = GetConfigurablePtr<glm::vec4>("clear values");
+        bool* parallelRecording = GetConfigurablePtr<bool>("parallel recording");
         auto opaqueColorHandle = RenderGraph::StrToHandle("opaque color");
         auto opaqueDepthHnadle = RenderGraph::StrToHandle("opaque depth");
 
@@ -32,27 +37,54 @@ public:
             Gfx::Image* color = (Gfx::Image*)res.at(opaqueColorHandle)->GetResource();
             uint32_t width = color->GetDescription().width;
             uint32_t height = color->GetDescription().height;
-            cmd.BindResource(0, sceneShaderResource);
-            cmd.SetViewport(
-                {.x = 0, .y = 0, .width = (float)width, .height = (float)height, .minDepth = 0, .maxDepth = 1}
-            );
-            Rect2D rect = {{0, 0}, {width, height}};
             clearValues[0].color = {
                 {(*clearValuesVal)[0], (*clearValuesVal)[1], (*clearValuesVal)[2], (*clearValuesVal)[3]}};
             clearValues[1].depthStencil = {1};
 
-            cmd.SetScissor(0, 1, &rect);
-            cmd.BeginRenderPass(pass, clearValues);
-
-            // draw scene objects
-            for (auto& draw : *drawList)
+            // draw scene objects, bindless draws share one material resource so it's only bound once
+            auto recordDraws = [this, width, height](Gfx::CommandBuffer& cmd, size_t begin, size_t end)
+            {
+                // a secondary command buffer starts without any state
+                cmd.BindResource(0, sceneShaderResource);
+                cmd.SetViewport(
+                    {.x = 0, .y = 0, .width = (float)width, .height = (float)height, .minDepth = 0, .maxDepth = 1}
+                );
+                Rect2D rect = {{0, 0}, {width, height}};
+                cmd.SetScissor(0, 1, &rect);
+
+                Gfx::ShaderResource* materialResource = nullptr;
+                for (size_t i = begin; i < end;)
+                {
+                    auto& draw = (*drawList)[i];
+                    auto& material = drawList->GetMaterial(draw);
+                    cmd.BindShaderProgram(material.shader, *material.shaderConfig);
+                    cmd.BindVertexBuffer(draw.GetVertexBufferBindings(), 0);
+                    cmd.BindIndexBuffer(draw.indexBuffer, 0, draw.indexBufferType);
+                    if (material.shaderResource != materialResource)
+                    {
+                        cmd.BindResource(2, material.shaderResource);
+                        materialResource = material.shaderResource;
+                    }
+                    SceneObjectPushConstant pushConstant = drawList->GetPushConstant(draw);
+                    cmd.SetPushConstant(material.shader, &pushConstant);
+                    i += drawList->DrawIndexed(cmd, i, end, SceneInstances::CullView::Camera);
+                }
+            };
+
+            if (*parallelRecording && recorder == nullptr)
+                recorder = std::make_unique<ParallelCommandRecorder>(RenderPipeline::Singleton().GetThreadPool());
+
+            if (*parallelRecording && recorder->IsParallel(drawList->size()))
+            {
+                cmd.BeginRenderPass(pass, clearValues, Gfx::SubpassContents::Secondary_Command_Buffers);
+                // the graph may have merged the pass into the render pass of the pass before it
+                uint32_t subpass = forwardNode->GetPass()->GetSubpassIndex();
+                recorder->Record(cmd, pass, subpass, drawList->size(), recordDraws);
+            }
+            else
             {
-                cmd.BindShaderProgram(draw.shader, *draw.shaderConfig);
-                cmd.BindVertexBuffer(draw.vertexBufferBinding, 0);
-                cmd.BindIndexBuffer(draw.indexBuffer, 0, draw.indexBufferType);
-                cmd.BindResource(2, draw.shaderResource);
-                cmd.SetPushConstant(draw.shader, (void*)&draw.pushConstant);
-                cmd.DrawIndexed(draw.indexCount, 1, 0, 0, 0);
+                cmd.BeginRenderPass(pass, clearValues);
+                recordDraws(cmd, 0, drawList->size());
             }
 
             // draw skybox
@@ -70,6 +102,7 @@ public:
                 .AddColor(opaqueColorHandle)
                 .AddDepthStencil(opaqueDepthHnadle)
                 .SetExecFunc(execFunc)
+                .SetMergeable(true)
                 .Finish();
 
         return {
@@ -114,6 +147,26 @@ public:
         this->sceneShaderResource = &sceneShaderResource;
     };
 
+    void Finalize(RenderGraph::Graph& graph, Resources& resources) override
+    {
+        bool bindless = *GetConfigurablePtr<bool>("bindless materials");
+        if (bindless && !GetGfxDriver()->GetGPUFeatures().descriptorIndexing)
+        {
+            SPDLOG_WARN("descriptor indexing is not supported, bindless materials fall back to per material resources");
+            bindless = false;
+        }
+
+        if (bindless)
+            Shader::EnableFeature("G_BINDLESS");
+        else
+            Shader::DisableFeature("G_BINDLESS");
+    }
+
+    void OnDestroy() override
+    {
+        Shader::DisableFeature("G_BINDLESS");
+    }
+
     void Execute(GraphResource& graphResource) override {}
 
 private:
@@ -121,6 +174,8 @@ private:
     const DrawList* drawList;
     Gfx::ShaderResource* sceneShaderResource;
     std::vector<Gfx::ClearValue> clearValues;
+    // created on the first frame with parallel recording enabled
+    std::unique_ptr<ParallelCommandRecorder> recorder;
 
     void DefineNode()
     {
@@ -133,6 +188,8 @@ private:
         AddOutputProperty("depth", PropertyType::RenderGraphLink);
 
         AddConfig<ConfigurableType::Vec4>("clear values", glm::vec4{52 / 255.0f, 177 / 255.0f, 235 / 255.0f, 1});
+        AddConfig<ConfigurableType::Bool>("bindless materials", false);
+        AddConfig<ConfigurableType::Bool>("parallel recording", true);
         clearValues.resize(2);
     }
     static char _reg;
@@ -51,14 +51,15 @@ public:
         auto execFunc =
             [this, clears, shader](Gfx::CommandBuffer& cmd, Gfx::RenderPass& pass, const RenderGraph::ResourceRefs& res)
         {
+            // the render pass is always begun so the pass can be merged with the passes around it
+            cmd.BeginRenderPass(pass, clears);
             if (shader != nullptr)
             {
-                cmd.BeginRenderPass(pass, clears);
                 cmd.BindShaderProgram(shader->GetDefaultShaderProgram(), shader->GetDefaultShaderConfig());
                 cmd.BindResource(1, passResource.get());
                 cmd.Draw(6, 1, 0, 0);
-                cmd.EndRenderPass();
             }
+            cmd.EndRenderPass();
         };
 
         fullScreenPassNode = graph.AddNode(GetCustomName())
@@ -66,6 +67,7 @@ public:
                                  .InputRT("target color", 0)
                                  .AddColor(0)
                                  .SetExecFunc(execFunc)
+                                 .SetMergeable(true)
                                  .Finish();
 
         return {Resource(ResourceTag::RenderGraphLink{}, outputPropertyIDs["color"], fullScreenPassNode, 0)};
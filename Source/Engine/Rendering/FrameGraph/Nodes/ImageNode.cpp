@@ -55,6 +55,25 @@ std::vector<Resource> ImageNode::Preprocess(RenderGraph::Graph& graph)
         Resource(ResourceTag::Float{}, outputPropertyIDs["width"], size.y)};
 };
 
+void ImageNode::Resize(glm::uvec2 outputSize, float renderScale)
+{
+    // "size" is used until the output size is known
+    if (!GetConfigurableVal<bool>("relative size") || outputSize.x == 0 || outputSize.y == 0)
+        return;
+
+    float scale = GetConfigurableVal<float>("scale");
+    if (GetConfigurableVal<bool>("dynamic resolution"))
+        scale *= renderScale;
+
+    glm::uvec2 size = glm::max(glm::uvec2(glm::vec2(outputSize) * scale + 0.5f), glm::uvec2(1));
+    RenderGraph::RenderPass* pass = imageNode->GetPass();
+    for (RenderGraph::ResourceHandle handle : pass->GetResourceCreationRequests())
+    {
+        if (pass->GetResourceDescription(handle).type == RenderGraph::ResourceType::Image)
+            pass->SetImageExtent(handle, size.x, size.y);
+    }
+}
+
 void ImageNode::DefineNode()
 {
     AddOutputProperty("image", PropertyType::RenderGraphLink);
@@ -62,6 +81,11 @@ void ImageNode::DefineNode()
     AddConfig<ConfigurableType::Vec2Int>("size", glm::ivec2{512.0f, 512.0f});
     AddConfig<ConfigurableType::Format>("format", Gfx::ImageFormat::R8G8B8A8_UNorm);
     AddConfig<ConfigurableType::Int>("mip level", int{1});
+    // size the image to scale times the graph's output size instead
+    AddConfig<ConfigurableType::Bool>("relative size", false);
+    AddConfig<ConfigurableType::Float>("scale", 1.0f);
+    // also scaled by the graph's render scale, for the images rendered at the internal resolution
+    AddConfig<ConfigurableType::Bool>("dynamic resolution", false);
 }
 
 Gfx::Image* ImageNode::GetImage()
@@ -14,7 +14,12 @@ public:
     ImageNode(FGID id);
 
     Gfx::Image* GetImage();
+    RenderGraph::RenderNode* GetRenderNode()
+    {
+        return imageNode;
+    }
     std::vector<Resource> Preprocess(RenderGraph::Graph& graph) override;
+    void Resize(glm::uvec2 outputSize, float renderScale) override;
 
 private:
     RenderGraph::RenderNode* imageNode;
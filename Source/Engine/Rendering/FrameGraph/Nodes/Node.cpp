@@ -1,9 +1,45 @@
 #include "Node.hpp"
+#include "../BindlessMaterials.hpp"
+#include "../SceneInstances.hpp"
 #include "Core/Component/MeshRenderer.hpp"
 #include "Core/GameObject.hpp"
+#include "GfxDriver/ShaderConfig.hpp"
+#include "ThirdParty/xxHash/xxhash.h"
+#include <algorithm>
+#include <spdlog/spdlog.h>
 
 namespace Engine::FrameGraph
 {
+namespace
+{
+// FlatHashMap uses its keys as they are, the splitmix64 finalizer spreads the aligned pointer bits and is a bijection
+// so two pointers never share a key
+uint64_t PointerKey(const void* p)
+{
+    uint64_t x = (uint64_t)p;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// draws that only differ in their transform are drawn as instances of one draw
+bool IsSameInstancedDraw(const SceneObjectDrawData& a, const SceneObjectDrawData& b)
+{
+    if (a.material != b.material || a.indexBuffer != b.indexBuffer || a.indexCount != b.indexCount ||
+        a.indexBufferType != b.indexBufferType || a.firstIndex != b.firstIndex || a.vertexOffset != b.vertexOffset ||
+        a.isStatic != b.isStatic || a.vertexBindingCount != b.vertexBindingCount)
+        return false;
+
+    for (uint32_t i = 0; i < a.vertexBindingCount; ++i)
+    {
+        if (a.vertexBindings[i].buffer != b.vertexBindings[i].buffer ||
+            a.vertexBindings[i].offset != b.vertexBindings[i].offset)
+            return false;
+    }
+    return true;
+}
+} // namespace
+
 void Node::Serialize(Serializer* s) const
 {
     for (auto& c : configs)
@@ -162,47 +198,428 @@ void Node::Deserialize(Serializer* s)
     s->Deserialize("customName", customName);
 }
 
-void DrawList::Add(MeshRenderer& meshRenderer)
+void DrawList::Add(MeshRenderer& meshRenderer, BindlessMaterials* bindlessMaterials)
 {
     auto mesh = meshRenderer.GetMesh();
     if (mesh == nullptr)
         return;
 
     auto& submeshes = mesh->GetSubmeshes();
-    auto& materials = meshRenderer.GetMaterials();
+    auto& rendererMaterials = meshRenderer.GetMaterials();
+
+    // objects without a drawable submesh don't take a transform
+    uint32_t transform = UINT32_MAX;
+    for (int i = 0; i < submeshes.size() && i < rendererMaterials.size(); ++i)
+    {
+        Material* material = rendererMaterials[i];
+        if (material == nullptr)
+            continue;
+
+        uint32_t materialID;
+        if (uint32_t* id = materialIDs.Find(PointerKey(material)))
+            materialID = *id;
+        else
+        {
+            auto shader = material->GetShaderProgram();
+            if (shader == nullptr)
+                continue;
+
+            if (bindlessMaterials && BindlessMaterials::IsBindless(*shader))
+            {
+                uint32_t bindlessIndex = bindlessMaterials->AddMaterial(*material);
+                materialID = AddMaterial(
+                    shader,
+                    material->GetShaderConfig(),
+                    bindlessMaterials->GetShaderResource(),
+                    bindlessIndex
+                );
+            }
+            else
+            {
+                material->UploadDataToGPU();
+                materialID = AddMaterial(shader, material->GetShaderConfig(), material->GetShaderResource());
+            }
+            materials[materialID].source = material;
+            materialIDs.Insert(PointerKey(material), materialID);
+        }
+
+        if (transform == UINT32_MAX)
+            transform = AddTransform(meshRenderer.GetGameObject()->GetTransform()->GetModelMatrix());
+
+        AddSubmesh(submeshes[i], meshRenderer.GetLod(), materialID, transform, meshRenderer.IsStatic());
+    }
+}
+
+void DrawList::AddSubmesh(const Submesh& submesh, uint32_t lod, uint32_t material, uint32_t transform, bool isStatic)
+{
+    auto bindings = submesh.GetBindings();
+    if (bindings.size() > SceneObjectDrawData::MAX_VERTEX_BINDINGS)
+    {
+        SPDLOG_WARN("submesh with {} vertex bindings is not drawn", bindings.size());
+        return;
+    }
+
+    SceneObjectDrawData& draw = emplace_back();
+    draw.material = material;
+    draw.transform = transform;
+    const SubmeshLod& level = submesh.GetLod(lod);
+    draw.indexCount = level.indexCount;
+    draw.firstIndex = level.firstIndex;
+    const SubmeshLod& shadowLevel = isStatic ? submesh.GetLod(0) : level;
+    draw.shadowIndexCount = shadowLevel.indexCount;
+    draw.shadowFirstIndex = shadowLevel.firstIndex;
+    draw.vertexOffset = submesh.GetVertexOffset();
+    draw.indexBuffer = submesh.GetIndexBuffer();
+    draw.indexBufferType = submesh.GetIndexBufferType();
+    draw.bounds = submesh.GetAABB();
+    draw.isStatic = isStatic;
+    if (&level == &submesh.GetLod(0))
+    {
+        draw.meshlets = submesh.GetMeshlets().data();
+        draw.meshletCount = submesh.GetMeshlets().size();
+    }
+    draw.vertexBindingCount = bindings.size();
+    for (size_t i = 0; i < bindings.size(); ++i)
+    {
+        draw.vertexBindings[i] = {submesh.GetVertexBuffer(), bindings[i].byteOffset};
+    }
+}
+
+uint32_t DrawList::AddMaterial(
+    Gfx::ShaderProgram* shader,
+    const Gfx::ShaderConfig& shaderConfig,
+    Gfx::ShaderResource* shaderResource,
+    uint32_t bindlessIndex
+)
+{
+    const void* pipelineKey[] = {shader, &shaderConfig};
+    uint64_t pipelineHash = XXH64(pipelineKey, sizeof(pipelineKey), 0);
+    uint32_t pipeline;
+    if (uint32_t* id = pipelineIDs.Find(pipelineHash))
+        pipeline = *id;
+    else
+        pipeline = pipelineIDs.Insert(pipelineHash, pipelineCount++);
+
+    DrawMaterial& material = materials.emplace_back();
+    material.shader = shader;
+    material.shaderConfig = &shaderConfig;
+    material.shaderResource = shaderResource;
+    material.bindlessIndex = bindlessIndex;
+    material.pipeline = pipeline;
+    material.transparent = std::any_of(
+        shaderConfig.color.blends.begin(),
+        shaderConfig.color.blends.end(),
+        [](const Gfx::ColorBlendAttachmentState& blend) { return blend.blendEnable; }
+    );
+    material.instanced = shader && SceneInstances::IsInstanced(*shader);
+    return materials.size() - 1;
+}
+
+void DrawList::Clear()
+{
+    clear();
+    transforms.clear();
+    materials.clear();
+    materialIDs.Clear();
+    pipelineIDs.Clear();
+    pipelineCount = 0;
+}
+
+void DrawList::SwapScratchDraws()
+{
+    std::vector<SceneObjectDrawData>::swap(scratchDraws);
+}
+
+void DrawList::Append(const DrawList& other, BindlessMaterials* bindlessMaterials)
+{
+    uint32_t firstMaterial = materials.size();
+    for (const DrawMaterial& m : other.materials)
+    {
+        uint32_t bindlessIndex = m.bindlessIndex;
+        if (m.source && bindlessMaterials && BindlessMaterials::IsBindless(*m.shader))
+            bindlessIndex = bindlessMaterials->AddMaterial(*m.source);
+        else if (m.source)
+            m.source->UploadDataToGPU();
+        uint32_t material = AddMaterial(m.shader, *m.shaderConfig, m.shaderResource, bindlessIndex);
+        materials[material].source = m.source;
+        // draws added later share the entry
+        if (m.source)
+            materialIDs.Insert(PointerKey(m.source), material);
+    }
+
+    uint32_t firstTransform = transforms.size();
+    transforms.insert(transforms.end(), other.transforms.begin(), other.transforms.end());
+    size_t first = size();
+    insert(end(), other.begin(), other.end());
+    for (size_t i = first; i < size(); ++i)
+    {
+        (*this)[i].material += firstMaterial;
+        (*this)[i].transform += firstTransform;
+    }
+    instances = other.instances;
+}
+
+bool DrawList::AreMaterialsCurrent() const
+{
+    return std::all_of(
+        materials.begin(),
+        materials.end(),
+        [](const DrawMaterial& m) { return m.source == nullptr || m.source->GetShaderProgram() == m.shader; }
+    );
+}
+
+void DrawList::BuildInstances(SceneInstances& instances, bool instancing, bool gpuCulling, size_t first)
+{
+    this->instances = &instances;
+    gpuCulling = gpuCulling && instances.IsGpuCullingSupported();
 
-    for (int i = 0; i < submeshes.size() || i < materials.size(); ++i)
+    // group of every draw from first, groups are numbered in the order of their first draw
+    drawGroups.resize(size());
+    groupFirstDraws.clear();
+    groupCounts.clear();
+    groupNext.clear();
+    groupIDs.Clear();
+    for (uint32_t i = first; i < size(); ++i)
     {
-        auto material = i < materials.size() ? materials[i] : nullptr;
-        auto submesh = i < submeshes.size() ? &submeshes[i] : nullptr;
-        auto shader = material ? material->GetShaderProgram() : nullptr;
+        auto& draw = (*this)[i];
+        uint32_t group = groupFirstDraws.size();
+        uint32_t* head = nullptr;
+        if (instancing && materials[draw.material].instanced)
+        {
+            uint64_t key[5 + 2 * SceneObjectDrawData::MAX_VERTEX_BINDINGS] = {
+                draw.material,
+                (uint64_t)draw.indexBuffer,
+                (uint64_t)draw.indexCount << 32 | (uint64_t)draw.indexBufferType,
+                (uint64_t)draw.firstIndex << 32 | (uint32_t)draw.vertexOffset,
+                (uint64_t)draw.isStatic << 32 | draw.vertexBindingCount,
+            };
+            for (uint32_t b = 0; b < draw.vertexBindingCount; ++b)
+            {
+                key[5 + 2 * b] = (uint64_t)draw.vertexBindings[b].buffer;
+                key[6 + 2 * b] = draw.vertexBindings[b].offset;
+            }
+            uint64_t hash = XXH64(key, (5 + 2 * draw.vertexBindingCount) * sizeof(uint64_t), 0);
+
+            // different draws may share a hash, the groups with this hash are compared with the draw
+            head = groupIDs.Find(hash);
+            for (uint32_t g = head ? *head : NO_GROUP; g != NO_GROUP; g = groupNext[g])
+            {
+                if (IsSameInstancedDraw((*this)[groupFirstDraws[g]], draw))
+                {
+                    group = g;
+                    break;
+                }
+            }
+            if (group == groupFirstDraws.size() && head == nullptr)
+                head = &groupIDs.Insert(hash, NO_GROUP);
+        }
 
-        if (submesh != nullptr && material != nullptr && shader != nullptr)
+        if (group == groupFirstDraws.size())
         {
-            // material->SetMatrix("Transform", "model",
-            // meshRenderer->GetGameObject()->GetTransform()->GetModelMatrix());
-            uint32_t indexCount = submesh->GetIndexCount();
+            groupFirstDraws.push_back(i);
+            groupCounts.push_back(0);
+            groupNext.push_back(head ? *head : NO_GROUP);
+            if (head)
+                *head = group;
+        }
+        groupCounts[group] += 1;
+        drawGroups[i] = group;
+    }
+
+    // the transforms of a group are contiguous, firstInstance of a group's first draw is used as its cursor
+    uint32_t firstInstance = instances.Allocate(size() - first);
+    for (size_t g = 0; g < groupFirstDraws.size(); ++g)
+    {
+        (*this)[groupFirstDraws[g]].firstInstance = firstInstance;
+        firstInstance += groupCounts[g];
+    }
+
+    glm::mat4* instanceTransforms = instances.GetTransforms();
+    for (size_t i = first; i < size(); ++i)
+    {
+        auto& groupDraw = (*this)[groupFirstDraws[drawGroups[i]]];
+        instanceTransforms[groupDraw.firstInstance++] = transforms[(*this)[i].transform];
+    }
 
-            SceneObjectDrawData drawData;
-            drawData.vertexBufferBinding = std::vector<Gfx::VertexBufferBinding>();
-            for (auto& binding : submesh->GetBindings())
+    // every group is drawn by its first draw
+    scratchDraws.assign(begin(), begin() + first);
+    for (size_t g = 0; g < groupFirstDraws.size(); ++g)
+    {
+        auto& draw = scratchDraws.emplace_back((*this)[groupFirstDraws[g]]);
+        draw.instanceCount = groupCounts[g];
+        draw.firstInstance -= groupCounts[g];
+        draw.cullGroup = SceneInstances::NO_CULL_GROUP;
+        draw.cullGroupCount = 1;
+        // the others read their transform from the push constant
+        if (gpuCulling && materials[draw.material].instanced)
+        {
+            if (draw.meshletCount == 0)
+            {
+                draw.cullGroup = instances.AddCullGroup(
+                    draw.bounds,
+                    draw.firstInstance,
+                    draw.instanceCount,
+                    draw.indexCount,
+                    draw.firstIndex,
+                    draw.vertexOffset
+                );
+                if (draw.shadowIndexCount != draw.indexCount || draw.shadowFirstIndex != draw.firstIndex)
+                    instances.SetShadowIndices(draw.cullGroup, draw.shadowIndexCount, draw.shadowFirstIndex);
+            }
+            else
             {
-                drawData.vertexBufferBinding.push_back({submesh->GetVertexBuffer(), binding.byteOffset});
+                // back facing meshlets are only culled when their back faces aren't drawn
+                bool coneCulling = materials[draw.material].shaderConfig->cullMode == Gfx::CullMode::Back;
+                draw.cullGroupCount = draw.meshletCount;
+                for (uint32_t m = 0; m < draw.meshletCount; ++m)
+                {
+                    const Meshlet& meshlet = draw.meshlets[m];
+                    uint32_t group = instances.AddCullGroup(
+                        {meshlet.center - meshlet.radius, meshlet.center + meshlet.radius},
+                        draw.firstInstance,
+                        draw.instanceCount,
+                        meshlet.triangleCount * 3,
+                        draw.firstIndex + meshlet.firstIndex,
+                        draw.vertexOffset,
+                        coneCulling ? glm::vec4(meshlet.coneAxis, meshlet.coneCutoff) : glm::vec4(0, 0, 0, 1)
+                    );
+                    if (m == 0)
+                        draw.cullGroup = group;
+                }
             }
-            drawData.indexBuffer = submesh->GetIndexBuffer();
-            drawData.indexBufferType = submesh->GetIndexBufferType();
+        }
+    }
+    SwapScratchDraws();
+}
+
+uint32_t DrawList::DrawIndexed(
+    Gfx::CommandBuffer& cmd, size_t first, size_t end, SceneInstances::CullView view, bool ignoreMaterial
+) const
+{
+    const SceneObjectDrawData& draw = (*this)[first];
+    if (draw.cullGroup == SceneInstances::NO_CULL_GROUP)
+    {
+        bool shadow = view != SceneInstances::CullView::Camera;
+        uint32_t indexCount = shadow ? draw.shadowIndexCount : draw.indexCount;
+        uint32_t firstIndex = shadow ? draw.shadowFirstIndex : draw.firstIndex;
+        cmd.DrawIndexed(indexCount, draw.instanceCount, firstIndex, draw.vertexOffset, draw.firstInstance);
+        return 1;
+    }
+
+    // submeshes of a geometry arena page bind the same buffers, only their commands differ
+    uint32_t count = 1;
+    uint32_t commandCount = draw.cullGroupCount;
+    for (size_t i = first + 1; i < end; ++i)
+    {
+        const SceneObjectDrawData& next = (*this)[i];
+        bool sameState = next.cullGroup == draw.cullGroup + commandCount && next.indexBuffer == draw.indexBuffer &&
+                         next.indexBufferType == draw.indexBufferType &&
+                         next.vertexBindingCount == draw.vertexBindingCount && next.isStatic == draw.isStatic &&
+                         (ignoreMaterial || next.material == draw.material);
+        for (uint32_t b = 0; sameState && b < draw.vertexBindingCount; ++b)
+        {
+            sameState = next.vertexBindings[b].buffer == draw.vertexBindings[b].buffer &&
+                        next.vertexBindings[b].offset == draw.vertexBindings[b].offset;
+        }
+        if (!sameState)
+            break;
+        count += 1;
+        commandCount += next.cullGroupCount;
+    }
+
+    uint64_t offset = SceneInstances::GetDrawCommandOffset(view, draw.cullGroup);
+    uint32_t stride = SceneInstances::GetDrawCommandStride();
+    cmd.DrawIndexedIndirect(instances->GetDrawCommands(), offset, commandCount, stride);
+    return count;
+}
 
-            material->UploadDataToGPU();
-            drawData.shaderResource = material->GetShaderResource();
-            drawData.shader = shader;
-            drawData.shaderConfig = &material->GetShaderConfig();
-            auto modelMatrix = meshRenderer.GetGameObject()->GetTransform()->GetModelMatrix();
-            drawData.pushConstant = modelMatrix;
-            drawData.indexCount = indexCount;
+uint64_t DrawList::HashStaticDraws() const
+{
+    uint64_t hash = 0;
+    for (const SceneObjectDrawData& draw : *this)
+    {
+        if (!draw.isStatic)
+            continue;
 
-            push_back(std::move(drawData));
+        // the camera's level of detail and whether the level has meshlets don't change the shadow
+        uint64_t key[4 + 2 * SceneObjectDrawData::MAX_VERTEX_BINDINGS] = {
+            (uint64_t)draw.indexBuffer,
+            (uint64_t)draw.shadowIndexCount << 32 | (uint64_t)draw.indexBufferType,
+            (uint64_t)draw.shadowFirstIndex << 32 | (uint32_t)draw.vertexOffset,
+            draw.vertexBindingCount,
+        };
+        for (uint32_t b = 0; b < draw.vertexBindingCount; ++b)
+        {
+            key[4 + 2 * b] = (uint64_t)draw.vertexBindings[b].buffer;
+            key[5 + 2 * b] = draw.vertexBindings[b].offset;
         }
+        uint64_t drawHash = XXH64(key, (4 + 2 * draw.vertexBindingCount) * sizeof(uint64_t), 0);
+
+        // instances are summed so the order of the draws and of the instances of a draw doesn't matter
+        if (instances != nullptr)
+        {
+            const glm::mat4* models = instances->GetTransforms() + draw.firstInstance;
+            for (uint32_t i = 0; i < draw.instanceCount; ++i)
+                hash += XXH64(&models[i], sizeof(glm::mat4), drawHash);
+        }
+        else
+            hash += XXH64(&transforms[draw.transform], sizeof(glm::mat4), drawHash);
     }
+    return hash;
+}
+
+void DrawList::Sort(DrawSortMode mode, const glm::vec3& viewPos, float farPlane, ThreadPool* threadPool)
+{
+    if (mode == DrawSortMode::None || size() <= 1)
+        return;
+
+    // pipeline and material ids only need to group equal draws, they are numbered in the order they were added
+    constexpr uint32_t pipelineBits = 20;
+    constexpr uint32_t materialBits = 19;
+    constexpr uint32_t depthBits = 24;
+    constexpr uint64_t depthMax = (1ull << depthBits) - 1;
+
+    sortKeys.resize(size());
+    sortIndices.resize(size());
+    for (uint32_t i = 0; i < size(); ++i)
+    {
+        auto& draw = (*this)[i];
+        const DrawMaterial& material = materials[draw.material];
+        uint64_t pipeline = material.pipeline & ((1ull << pipelineBits) - 1);
+        uint64_t materialID = draw.material & ((1ull << materialBits) - 1);
+
+        float distance = glm::length(glm::vec3(transforms[draw.transform][3]) - viewPos);
+        uint64_t depth = std::clamp(distance / farPlane, 0.0f, 1.0f) * depthMax;
+
+        uint64_t key = (uint64_t)material.transparent << 63;
+        if (material.transparent)
+        {
+            // back to front, the pipeline and material only break ties
+            key |= (depthMax - depth) << (63 - depthBits);
+            key |= pipeline << materialBits | materialID;
+        }
+        else if (mode == DrawSortMode::State)
+        {
+            key |= pipeline << (materialBits + depthBits);
+            key |= materialID << depthBits;
+            key |= depth;
+        }
+        else
+        {
+            key |= depth << (63 - depthBits);
+            key |= pipeline << materialBits | materialID;
+        }
+
+        sortKeys[i] = key;
+        sortIndices[i] = i;
+    }
+
+    RadixSort(sortKeys, sortIndices, threadPool, &sortScratch);
+
+    scratchDraws.clear();
+    for (uint32_t i : sortIndices)
+        scratchDraws.push_back((*this)[i]);
+    SwapScratchDraws();
 }
 
 } // namespace Engine::FrameGraph
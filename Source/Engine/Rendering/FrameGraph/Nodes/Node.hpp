@@ -1,6 +1,9 @@
 #pragma once
 #include "../GraphResource.hpp"
+#include "../SceneInstances.hpp"
 #include "GfxDriver/GfxEnums.hpp"
+#include "Libs/FlatHashMap.hpp"
+#include "Libs/RadixSort.hpp"
 #include "Libs/Serialization/Serializable.hpp"
 #include "Libs/Serialization/Serializer.hpp"
 #include "Rendering/RenderGraph/Graph.hpp"
@@ -11,7 +14,11 @@
 #include <vector>
 namespace Engine
 {
+class Material;
+struct Meshlet;
 class MeshRenderer;
+class Submesh;
+class ThreadPool;
 }
 namespace Engine::FrameGraph
 {
@@ -44,23 +51,191 @@ enum class ConfigurableType
     ObjectPtr,
 };
 
-struct SceneObjectDrawData
+class BindlessMaterials;
+
+struct SceneObjectPushConstant
+{
+    glm::mat4 model;
+    // index into the bindless material table, only read by G_BINDLESS shaders
+    uint32_t materialIndex = 0;
+};
+
+// push constant of Game/ShadowMap.shad, its transforms are in the instance buffer
+struct ShadowPushConstant
+{
+    glm::mat4 model = glm::mat4(1);
+    // the cascade of the shadow map drawn
+    uint32_t shadowCascade = 0;
+};
+
+// shader state of the draws of one material, an entry of the material table of a draw list
+struct DrawMaterial
 {
-    SceneObjectDrawData() = default;
-    SceneObjectDrawData(SceneObjectDrawData&& other) = default;
     Gfx::ShaderProgram* shader = nullptr;
     const Gfx::ShaderConfig* shaderConfig = nullptr;
     Gfx::ShaderResource* shaderResource = nullptr;
+    // the material added by DrawList::Add, shader is its program
+    Material* source = nullptr;
+    // index into the bindless material table, only read by G_BINDLESS shaders
+    uint32_t bindlessIndex = 0;
+    // materials with the same shader and config share it, in the order they were added
+    uint32_t pipeline = 0;
+    // blending is enabled on an attachment
+    bool transparent = false;
+    // the shader reads its transform from SceneInstances
+    bool instanced = false;
+};
+
+// a draw packet. It's trivially copyable and owns no memory, the transform and material are indices into the tables
+// of its draw list
+struct SceneObjectDrawData
+{
+    // a submesh binds a buffer per vertex attribute group, usually two
+    static constexpr uint32_t MAX_VERTEX_BINDINGS = 8;
+
+    uint32_t material = 0;
+    uint32_t transform = 0;
+    uint32_t indexCount = 0;
+    // the submesh's range of the shared index and vertex buffers
+    uint32_t firstIndex = 0;
+    int32_t vertexOffset = 0;
+    // the range drawn in the shadow views. Static renderers cast their shadows at level 0 so the cached shadows don't
+    // depend on the camera
+    uint32_t shadowIndexCount = 0;
+    uint32_t shadowFirstIndex = 0;
+    // range of the transforms in SceneInstances, drawn with one instanced draw
+    uint32_t firstInstance = 0;
+    uint32_t instanceCount = 1;
+    // set by BuildInstances when the instances are culled on the GPU, a draw with meshlets has a group per meshlet
+    uint32_t cullGroup = SceneInstances::NO_CULL_GROUP;
+    uint32_t cullGroupCount = 1;
+    // the submesh's meshlets when it's drawn at level 0
+    const Meshlet* meshlets = nullptr;
+    uint32_t meshletCount = 0;
+    // object space bounds of the submesh
+    AABB bounds = {};
+    // the renderer is static, see MeshRenderer::IsStatic. Static and dynamic draws are never merged
+    bool isStatic = false;
+    Gfx::IndexBufferType indexBufferType = Gfx::IndexBufferType::UInt16;
     Gfx::Buffer* indexBuffer = nullptr;
-    Gfx::IndexBufferType indexBufferType;
-    std::vector<Gfx::VertexBufferBinding> vertexBufferBinding;
-    glm::mat4 pushConstant;
-    uint32_t indexCount;
+    uint32_t vertexBindingCount = 0;
+    Gfx::VertexBufferBinding vertexBindings[MAX_VERTEX_BINDINGS];
+
+    std::span<const Gfx::VertexBufferBinding> GetVertexBufferBindings() const
+    {
+        return {vertexBindings, vertexBindingCount};
+    }
 };
+
+// how a draw list is ordered, draws with blending always come after the others and are sorted back to front
+enum class DrawSortMode
+{
+    // the order the objects were added in
+    None,
+    // by pipeline, then material, then front to back. Fewest state changes
+    State,
+    // front to back, then by pipeline and material. Least overdraw
+    Depth,
+};
+
+// The draws of a frame. It's cleared and refilled every frame, the packets, the tables and the scratch memory of
+// sorting and instancing keep their capacity so a frame doesn't allocate once the list has grown to the scene
 class DrawList : public std::vector<SceneObjectDrawData>
 {
 public:
-    void Add(MeshRenderer& meshRenderer);
+    // materials of bindless shaders are added to bindlessMaterials instead of using their own shader resource. The
+    // submeshes are drawn at the renderer's level of detail
+    void Add(MeshRenderer& meshRenderer, BindlessMaterials* bindlessMaterials = nullptr);
+
+    // adds an entry to the material table and returns its index. Add(MeshRenderer) adds a Material once per frame
+    uint32_t AddMaterial(
+        Gfx::ShaderProgram* shader,
+        const Gfx::ShaderConfig& shaderConfig,
+        Gfx::ShaderResource* shaderResource,
+        uint32_t bindlessIndex = 0
+    );
+
+    // adds an entry to the transform table and returns its index
+    uint32_t AddTransform(const glm::mat4& model)
+    {
+        transforms.push_back(model);
+        return transforms.size() - 1;
+    }
+
+    // remove the draws and the tables, the memory is kept
+    void Clear();
+
+    const DrawMaterial& GetMaterial(const SceneObjectDrawData& draw) const
+    {
+        return materials[draw.material];
+    }
+
+    const glm::mat4& GetTransform(const SceneObjectDrawData& draw) const
+    {
+        return transforms[draw.transform];
+    }
+
+    // for shaders that read the transform from the push constant
+    SceneObjectPushConstant GetPushConstant(const SceneObjectDrawData& draw) const
+    {
+        return {transforms[draw.transform], materials[draw.material].bindlessIndex};
+    }
+
+    // write the transforms of the draws from first on to instances. With instancing, draws of G_INSTANCING shaders
+    // that only differ in their transform are merged into one draw, in the order their first draw was added. With
+    // gpuCulling the instanced draws are also added to the cull groups of instances when it supports GPU culling, a
+    // cull group per meshlet when the submesh has them. The draws before first are already built
+    void BuildInstances(SceneInstances& instances, bool instancing, bool gpuCulling = false, size_t first = 0);
+
+    // add the draws of other after BuildInstances, with their materials and transforms. Its materials are uploaded or
+    // added to bindlessMaterials again, the table of the frame
+    void Append(const DrawList& other, BindlessMaterials* bindlessMaterials = nullptr);
+
+    // false when the shader program of a material added by Add changed, e.g. a global shader feature was toggled
+    bool AreMaterialsCurrent() const;
+
+    // draw the instances of the draw at first, the ones visible in view if they are culled on the GPU. The following
+    // draws before end that are culled in the next cull groups and bind the same buffers are merged into the same
+    // indirect draw, with ignoreMaterial also when their material differs. Returns the number of draws drawn, the
+    // state of the first one has to be bound
+    uint32_t DrawIndexed(
+        Gfx::CommandBuffer& cmd, size_t first, size_t end, SceneInstances::CullView view, bool ignoreMaterial = false
+    ) const;
+
+    // A hash of the shadow geometry and the transforms of the static draws, it doesn't depend on their order or on the
+    // level of detail the camera picks. It changes when a static renderer is added, removed, moved or changes its mesh
+    uint64_t HashStaticDraws() const;
+
+    // sort the draws by a 64 bit key laid out by mode, the depth is the distance of the object's origin to viewPos
+    void Sort(DrawSortMode mode, const glm::vec3& viewPos, float farPlane, ThreadPool* threadPool = nullptr);
+
+private:
+    std::vector<glm::mat4> transforms;
+    std::vector<DrawMaterial> materials;
+    // set by BuildInstances
+    SceneInstances* instances = nullptr;
+    // keyed by the Material, and by the shader and config
+    FlatHashMap<uint32_t> materialIDs;
+    FlatHashMap<uint32_t> pipelineIDs;
+    uint32_t pipelineCount = 0;
+
+    static constexpr uint32_t NO_GROUP = UINT32_MAX;
+
+    // reused by BuildInstances and Sort
+    std::vector<SceneObjectDrawData> scratchDraws;
+    std::vector<uint32_t> drawGroups;
+    std::vector<uint32_t> groupFirstDraws;
+    std::vector<uint32_t> groupCounts;
+    // the group created before it with the same hash, groupIDs has the last one
+    std::vector<uint32_t> groupNext;
+    FlatHashMap<uint32_t> groupIDs;
+    std::vector<uint64_t> sortKeys;
+    std::vector<uint32_t> sortIndices;
+    RadixSortScratch sortScratch;
+
+    void AddSubmesh(const Submesh& submesh, uint32_t lod, uint32_t material, uint32_t transform, bool isStatic);
+    // replace the draws with scratchDraws
+    void SwapScratchDraws();
 };
 
 struct Configurable
@@ -281,6 +456,9 @@ public:
         return true;
     }
     virtual void Finalize(RenderGraph::Graph& graph, Resources& resources){};
+    // called after Build and whenever the output size or the render scale changes, before the render graph is
+    // processed. outputSize is zero until the graph's output size is set
+    virtual void Resize(glm::uvec2 outputSize, float renderScale){};
     virtual void ProcessSceneShaderResource(Gfx::ShaderResource& sceneShaderResource){};
     virtual void Execute(GraphResource& graphResource){};
     virtual void OnDestroy() {}
@@ -1,9 +1,14 @@
 #pragma once
 #include "../NodeBlueprint.hpp"
+#include "../SceneInstances.hpp"
+#include "Asset/Shader.hpp"
 #include "Core/Component/MeshRenderer.hpp"
 #include "Core/GameObject.hpp"
 #include "Core/Scene/Scene.hpp"
 #include "GfxDriver/GfxEnums.hpp"
+#include "Rendering/RenderPipeline.hpp"
+#include "ThirdParty/xxHash/xxhash.h"
+#include <algorithm>
 #include <glm/glm.hpp>
 
 namespace Engine::FrameGraph
@@ -32,28 +37,139 @@ public:
 
     void Execute(GraphResource& graphResource) override
     {
-        drawList->clear();
+        drawList->Clear();
 
-        Scene* scene = graphResource.mainCamera->GetGameObject()->GetGameScene();
-        auto objs = scene->GetAllGameObjects();
+        Camera* camera = graphResource.mainCamera;
+        Scene* scene = camera->GetGameObject()->GetGameScene();
+        scene->GetAllGameObjects(gameObjects);
 
-        for (GameObject* go : objs)
+        SceneInstances& instances = *graphResource.sceneInstances;
+        // graphs saved before the default existed have no culling shader
+        ComputeShader* cullingShader = GetConfigurableVal<ComputeShader*>("culling shader");
+        instances.SetCullingShader(cullingShader ? cullingShader : SceneInstances::GetDefaultCullingShader());
+        bool instancing = GetConfigurableVal<bool>("instancing");
+        bool gpuCulling = GetConfigurableVal<bool>("gpu culling") && instances.IsGpuCullingSupported();
+
+        // static renderers only hash their versions, their draws are built again when the hash changes
+        uint64_t staticState[] = {instancing, gpuCulling, Shader::GetEnabledFeaturesHash()};
+        uint64_t staticKey = XXH64(staticState, sizeof(staticState), 0);
+        staticRenderers.clear();
+        dynamicRenderers.clear();
+        glm::vec3 viewPos = camera->GetGameObject()->GetTransform()->GetPosition();
+        bool lod = GetConfigurableVal<bool>("lod");
+        for (GameObject* go : gameObjects)
         {
             MeshRenderer* meshRenderer = go->GetComponent<MeshRenderer>();
             if (meshRenderer)
             {
-                drawList->Add(*meshRenderer);
+                if (lod)
+                    meshRenderer->SetLod(SelectLod(*meshRenderer, *camera, viewPos));
+
+                if (meshRenderer->IsStatic())
+                {
+                    uint64_t state[] = {
+                        (uint64_t)meshRenderer,
+                        meshRenderer->GetVersion(),
+                        go->GetTransform()->GetVersion(),
+                        meshRenderer->GetLod(),
+                    };
+                    staticKey = XXH64(state, sizeof(state), staticKey);
+                    staticRenderers.push_back(meshRenderer);
+                }
+                else
+                    dynamicRenderers.push_back(meshRenderer);
             }
         }
+
+        if (staticKey != instances.GetStaticKey() || !staticDrawList->AreMaterialsCurrent())
+        {
+            staticDrawList->Clear();
+            for (MeshRenderer* meshRenderer : staticRenderers)
+                staticDrawList->Add(*meshRenderer, graphResource.bindlessMaterials);
+            instances.BeginStatic();
+            staticDrawList->BuildInstances(instances, instancing, gpuCulling);
+            instances.EndStatic(staticKey);
+        }
+
+        drawList->Append(*staticDrawList, graphResource.bindlessMaterials);
+        size_t firstDynamic = drawList->size();
+        for (MeshRenderer* meshRenderer : dynamicRenderers)
+            drawList->Add(*meshRenderer, graphResource.bindlessMaterials);
+        drawList->BuildInstances(instances, instancing, gpuCulling, firstDynamic);
+
+        DrawSortMode sortMode = (DrawSortMode)GetConfigurableVal<int>("sort mode");
+        if (sortMode != DrawSortMode::None)
+            drawList->Sort(sortMode, viewPos, camera->GetFar(), &RenderPipeline::Singleton().GetThreadPool());
+    }
+
+    void Finalize(RenderGraph::Graph& graph, Resources& resources) override
+    {
+        // materials pick the shader variant that reads its transform from the instance buffer
+        if (GetConfigurableVal<bool>("instancing"))
+            Shader::EnableFeature("G_INSTANCING");
+        else
+            Shader::DisableFeature("G_INSTANCING");
+    }
+
+    void OnDestroy() override
+    {
+        Shader::DisableFeature("G_INSTANCING");
     }
 
 private:
     std::unique_ptr<DrawList> drawList;
+    // the instanced draws of the static renderers, kept while their hash doesn't change
+    std::unique_ptr<DrawList> staticDrawList;
+    // kept between frames with the draw list so that neither allocates
+    std::vector<GameObject*> gameObjects;
+    std::vector<MeshRenderer*> staticRenderers;
+    std::vector<MeshRenderer*> dynamicRenderers;
     DrawList* append;
+
+    // the level of detail whose error covers at most "lod threshold" of the screen height at the closest point of
+    // the mesh's bounds
+    uint32_t SelectLod(MeshRenderer& meshRenderer, Camera& camera, const glm::vec3& viewPos)
+    {
+        Mesh* mesh = meshRenderer.GetMesh();
+        if (mesh == nullptr || mesh->GetLodCount() <= 1)
+            return 0;
+
+        glm::mat4 model = meshRenderer.GetGameObject()->GetTransform()->GetModelMatrix();
+        float scale = std::max(
+            {glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))}
+        );
+        const AABB& aabb = mesh->GetAABB();
+        glm::vec3 center = model * glm::vec4((aabb.min + aabb.max) * 0.5f, 1);
+        float radius = glm::length(aabb.max - aabb.min) * 0.5f * scale;
+        float distance = std::max(glm::length(center - viewPos) - radius, camera.GetNear());
+
+        // an object space error of 1 at distance covers this fraction of the screen height
+        float errorToScreen = scale * std::abs(camera.GetProjectionMatrix()[1][1]) * 0.5f / distance;
+        return mesh->SelectLod(
+            errorToScreen,
+            meshRenderer.GetLod(),
+            GetConfigurableVal<float>("lod threshold"),
+            GetConfigurableVal<float>("lod hysteresis")
+        );
+    }
+
     void DefineNode()
     {
         AddOutputProperty("draw list", PropertyType::DrawList);
+        AddConfig<ConfigurableType::Bool>("instancing", true);
+        // a DrawSortMode, 0: none, 1: state, 2: depth
+        AddConfig<ConfigurableType::Int>("sort mode", (int)DrawSortMode::State);
+        // instanced draws are frustum culled by the culling shader (Game/CullInstances.comp) and drawn indirectly,
+        // falls back to drawing every instance when the GPU lacks indirect draws
+        AddConfig<ConfigurableType::Bool>("gpu culling", true);
+        AddConfig<ConfigurableType::ObjectPtr>("culling shader", SceneInstances::GetDefaultCullingShader());
+        // meshes with levels of detail draw the coarsest one whose error covers at most "lod threshold" of the screen
+        // height. A coarser level has to be below it by "lod hysteresis" (a fraction of the threshold)
+        AddConfig<ConfigurableType::Bool>("lod", true);
+        AddConfig<ConfigurableType::Float>("lod threshold", 0.001f);
+        AddConfig<ConfigurableType::Float>("lod hysteresis", 0.25f);
         drawList = std::make_unique<DrawList>();
+        staticDrawList = std::make_unique<DrawList>();
     }
     static char _reg;
 };
@@ -2,6 +2,8 @@
 #include "../NodeBlueprint.hpp"
 #include "Asset/Shader.hpp"
 #include "GfxDriver/Image.hpp"
+#include "Libs/ShadowCascades.hpp"
+#include <algorithm>
 
 namespace Engine::FrameGraph
 {
@@ -22,56 +24,196 @@ public:
     std::vector<Resource> Preprocess(RenderGraph::Graph& graph) override
     {
         glm::vec2 shadowMapSize = GetConfigurableVal<glm::vec2>("shadow map size");
+        uint32_t cascadeCount = std::clamp(GetConfigurableVal<int>("cascade count"), 1, (int)MAX_SHADOW_CASCADES);
         Shader* shadowmapShader = GetConfigurableVal<Shader*>("shadow map shader");
-        Gfx::ShaderProgram* shadowmapShaderProgram = shadowmapShader->GetShaderProgram({});
+        shadowmapShaderProgram = shadowmapShader->GetShaderProgram({});
+        cacheStatic = GetConfigurableVal<bool>("cache static shadows");
+        cache.Invalidate();
         std::vector<Gfx::ClearValue> shadowMapClears = {{.depthStencil = {1}}};
+        uint32_t width = (uint32_t)shadowMapSize.x * cascadeCount;
+        uint32_t height = (uint32_t)shadowMapSize.y;
 
+        // the static casters of every cascade are kept from the previous frames, only the cascades whose casters or
+        // matrix changed are cleared and drawn again. The cached cascades keep a margin around their slice so they
+        // only move when the camera leaves it, see FitShadowCascades
+        staticPass = nullptr;
+        copyPass = nullptr;
+        if (cacheStatic)
+        {
+            staticPass = graph.AddNode2(
+                {},
+                {
+                    {
+                        .width = width,
+                        .height = height,
+                        .depth =
+                            RenderGraph::Attachment{
+                                .name = "static shadow depth",
+                                .handle = 3,
+                                .create = true,
+                                .format = Gfx::ImageFormat::D32_SFloat,
+                                .loadOp = Gfx::AttachmentLoadOperation::Load,
+                                .storeOp = Gfx::AttachmentStoreOperation::Store,
+                            },
+                    },
+                },
+                [this,
+                 shadowMapSize,
+                 cascadeCount](Gfx::CommandBuffer& cmd, Gfx::RenderPass& pass, const RenderGraph::ResourceRefs& ref)
+                {
+                    std::span<const ShadowCascade> cascades(graphResource->fittedShadowCascades, cascadeCount);
+                    dirtyCascades = cache.Update(cascades, drawList->HashStaticDraws());
+                    if (dirtyCascades == 0)
+                        return;
+
+                    cmd.BeginRenderPass(pass, {});
+                    for (uint32_t c = 0; c < cascadeCount; ++c)
+                    {
+                        if ((dirtyCascades & (1 << c)) == 0)
+                            continue;
+
+                        Rect2D rect = SetCascadeViewport(cmd, c, shadowMapSize);
+                        cmd.ClearDepthAttachment(rect, 1);
+                        DrawCasters(cmd, c, Casters::Static);
+                    }
+                    cmd.EndRenderPass();
+                }
+            );
+            staticPass->SetName("static shadow map");
+
+            // the shadow map starts from the cached static casters. It keeps the cascades of the previous frame, only
+            // the ones drawn again or covered by dynamic casters since are copied
+            copyPass = graph.AddNode(
+                [this, shadowMapSize, cascadeCount](
+                    Gfx::CommandBuffer& cmd, Gfx::RenderPass& pass, const RenderGraph::ResourceRefs& ref
+                )
+                {
+                    bool hasDynamic = std::any_of(
+                        drawList->begin(),
+                        drawList->end(),
+                        [](const SceneObjectDrawData& draw) { return !draw.isStatic; }
+                    );
+                    uint32_t copied = dirtyCascades;
+                    if (hasDynamic || hadDynamic)
+                        copied = (1 << cascadeCount) - 1;
+                    hadDynamic = hasDynamic;
+
+                    std::vector<Gfx::ImageCopyRegion> regions;
+                    for (uint32_t c = 0; c < cascadeCount; ++c)
+                    {
+                        if ((copied & (1 << c)) == 0)
+                            continue;
+
+                        Gfx::ImageSubresourceLayers layers{.aspectMask = Gfx::ImageAspect::Depth, .layerCount = 1};
+                        Offset3D offset{(int32_t)(shadowMapSize.x * c), 0, 0};
+                        regions.push_back({
+                            .srcLayers = layers,
+                            .srcOffset = offset,
+                            .dstLayers = layers,
+                            .dstOffset = offset,
+                            .extent = {(uint32_t)shadowMapSize.x, (uint32_t)shadowMapSize.y, 1},
+                        });
+                    }
+                    if (!regions.empty())
+                    {
+                        Gfx::Image* src = (Gfx::Image*)ref.at(3)->GetResource();
+                        Gfx::Image* dst = (Gfx::Image*)ref.at(2)->GetResource();
+                        cmd.CopyImage(src, dst, regions);
+                    }
+                },
+                {
+                    {
+                        .name = "static shadow depth",
+                        .handle = 3,
+                        .type = RenderGraph::ResourceType::Image,
+                        .accessFlags = Gfx::AccessMask::Transfer_Read,
+                        .stageFlags = Gfx::PipelineStage::Transfer,
+                        .imageUsagesFlags = Gfx::ImageUsage::TransferSrc,
+                        .imageLayout = Gfx::ImageLayout::Transfer_Src,
+                    },
+                    {
+                        .name = "shadow depth",
+                        .handle = 2,
+                        .type = RenderGraph::ResourceType::Image,
+                        .accessFlags = Gfx::AccessMask::Transfer_Write,
+                        .stageFlags = Gfx::PipelineStage::Transfer,
+                        .imageUsagesFlags = Gfx::ImageUsage::TransferDst,
+                        .imageLayout = Gfx::ImageLayout::Transfer_Dst,
+                        .imageCreateInfo =
+                            {
+                                .width = width,
+                                .height = height,
+                                .format = Gfx::ImageFormat::D32_SFloat,
+                                .multiSampling = Gfx::MultiSampling::Sample_Count_1,
+                                .mipLevels = 1,
+                                .isCubemap = false,
+                            },
+                    },
+                },
+                {}
+            );
+            copyPass->SetName("copy static shadow map");
+            graph.Connect(staticPass, 3, copyPass, 3);
+        }
+
+        // the cascades are side by side in one depth image and drawn in one render pass
         shadowMapPass = graph.AddNode2(
             {},
             {
                 {
-                    .width = (uint32_t)shadowMapSize.x,
-                    .height = (uint32_t)shadowMapSize.y,
+                    .width = width,
+                    .height = height,
                     .depth =
                         RenderGraph::Attachment{
                             .name = "shadow depth",
                             .handle = 2,
-                            .create = true,
+                            .create = !cacheStatic,
                             .format = Gfx::ImageFormat::D32_SFloat,
+                            .loadOp = cacheStatic ? Gfx::AttachmentLoadOperation::Load
+                                                  : Gfx::AttachmentLoadOperation::Clear,
                             .storeOp = Gfx::AttachmentStoreOperation::Store,
                         },
                 },
             },
             [this,
              shadowMapClears,
-             shadowmapShaderProgram,
-             shadowMapSize](Gfx::CommandBuffer& cmd, Gfx::RenderPass& pass, const RenderGraph::ResourceRefs& ref)
+             shadowMapSize,
+             cascadeCount](Gfx::CommandBuffer& cmd, Gfx::RenderPass& pass, const RenderGraph::ResourceRefs& ref)
             {
-                cmd.SetViewport(
-                    {.x = 0, .y = 0, .width = shadowMapSize.x, .height = shadowMapSize.y, .minDepth = 0, .maxDepth = 1}
-                );
-                Rect2D rect = {{0, 0}, {(uint32_t)shadowMapSize.x, (uint32_t)shadowMapSize.y}};
-                cmd.SetScissor(0, 1, &rect);
                 cmd.BeginRenderPass(pass, shadowMapClears);
 
-                for (auto& draw : *drawList)
+                // only the dynamic casters are drawn every frame when the static ones are cached
+                for (uint32_t c = 0; c < cascadeCount; ++c)
                 {
-                    cmd.BindShaderProgram(shadowmapShaderProgram, shadowmapShaderProgram->GetDefaultShaderConfig());
-                    cmd.BindVertexBuffer(draw.vertexBufferBinding, 0);
-                    cmd.BindIndexBuffer(draw.indexBuffer, 0, draw.indexBufferType);
-                    cmd.SetPushConstant(shadowmapShaderProgram, (void*)&draw.pushConstant);
-                    cmd.DrawIndexed(draw.indexCount, 1, 0, 0, 0);
+                    SetCascadeViewport(cmd, c, shadowMapSize);
+                    DrawCasters(cmd, c, cacheStatic ? Casters::Dynamic : Casters::All);
                 }
 
                 cmd.EndRenderPass();
             }
         );
+        shadowMapPass->SetMergeable(true);
+
+        if (cacheStatic)
+            graph.Connect(copyPass, 2, shadowMapPass, 2);
 
         return {
             Resource(ResourceTag::RenderGraphLink{}, outputPropertyIDs["shadow map"], shadowMapPass, 2),
         };
     };
 
+    void Execute(GraphResource& graphResource) override
+    {
+        this->graphResource = &graphResource;
+        graphResource.shadowCascades = {
+            .count = (uint32_t)std::clamp(GetConfigurableVal<int>("cascade count"), 1, (int)MAX_SHADOW_CASCADES),
+            .splitLambda = GetConfigurableVal<float>("split lambda"),
+            .distance = GetConfigurableVal<float>("shadow distance"),
+            .resolution = GetConfigurableVal<glm::vec2>("shadow map size"),
+            .cacheMargin = cacheStatic ? (uint32_t)std::max(GetConfigurableVal<int>("cache margin"), 0) : 0,
+        };
+    }
+
     void ProcessSceneShaderResource(Gfx::ShaderResource& sceneShaderResource) override
     {
         Gfx::Image* shadowImage = (Gfx::Image*)shadowMapPass->GetPass()->GetResourceRef(2)->GetResource();
@@ -85,21 +227,108 @@ public:
         if (drawList == nullptr)
             return false;
 
+        // bound to the scene shader resource, any pass may sample it
+        graph.Export(shadowMapPass, 2);
+        // the caches have to outlive the frame, another image aliasing their memory would overwrite them
+        if (cacheStatic)
+            graph.Export(staticPass, 3);
         return true;
     };
 
+    void Finalize(RenderGraph::Graph& graph, Resources& resources) override
+    {
+        // every shadow caster is drawn with the same shader, create its pipeline before the first frame needs it
+        if (Gfx::RenderPass* pass = shadowMapPass->GetPass()->GetGfxRenderPass())
+        {
+            uint32_t subpass = shadowMapPass->GetPass()->GetSubpassIndex();
+            shadowmapShaderProgram->WarmUp(shadowmapShaderProgram->GetDefaultShaderConfig(), *pass, subpass);
+        }
+
+        if (cacheStatic)
+        {
+            if (Gfx::RenderPass* pass = staticPass->GetPass()->GetGfxRenderPass())
+            {
+                uint32_t subpass = staticPass->GetPass()->GetSubpassIndex();
+                shadowmapShaderProgram->WarmUp(shadowmapShaderProgram->GetDefaultShaderConfig(), *pass, subpass);
+            }
+        }
+    }
+
 private:
+    enum class Casters
+    {
+        All,
+        Static,
+        Dynamic,
+    };
+
     RenderGraph::RenderNode* shadowMapPass;
-    RenderGraph::RenderNode* vsmBoxFilterPass0;
+    RenderGraph::RenderNode* staticPass = nullptr;
+    RenderGraph::RenderNode* copyPass = nullptr;
 
     const DrawList* drawList;
+    Gfx::ShaderProgram* shadowmapShaderProgram;
+    const GraphResource* graphResource = nullptr;
+
+    bool cacheStatic = false;
+    ShadowCascadeCache cache;
+    // the cascades the static pass drew this frame, one bit per cascade
+    uint32_t dirtyCascades = 0;
+    // the previous frame drew dynamic casters over the cascades of the shadow map
+    bool hadDynamic = true;
+
+    Rect2D SetCascadeViewport(Gfx::CommandBuffer& cmd, uint32_t cascade, const glm::vec2& shadowMapSize)
+    {
+        float x = shadowMapSize.x * cascade;
+        float width = shadowMapSize.x;
+        float height = shadowMapSize.y;
+        cmd.SetViewport({.x = x, .y = 0, .width = width, .height = height, .minDepth = 0, .maxDepth = 1});
+        Rect2D rect = {{(int32_t)x, 0}, {(uint32_t)width, (uint32_t)height}};
+        cmd.SetScissor(0, 1, &rect);
+        return rect;
+    }
+
+    // every cascade draws the casters culled against its own view
+    void DrawCasters(Gfx::CommandBuffer& cmd, uint32_t cascade, Casters casters)
+    {
+        ShadowPushConstant pushConstant{.shadowCascade = cascade};
+        SceneInstances::CullView view = SceneInstances::ShadowCascadeView(cascade);
+        for (size_t i = 0; i < drawList->size();)
+        {
+            auto& draw = (*drawList)[i];
+            // static and dynamic draws are never merged, a draw of the other kind is skipped on its own
+            if ((casters == Casters::Static && !draw.isStatic) || (casters == Casters::Dynamic && draw.isStatic))
+            {
+                i += 1;
+                continue;
+            }
+
+            cmd.BindShaderProgram(shadowmapShaderProgram, shadowmapShaderProgram->GetDefaultShaderConfig());
+            cmd.SetPushConstant(shadowmapShaderProgram, &pushConstant);
+            cmd.BindVertexBuffer(draw.GetVertexBufferBindings(), 0);
+            cmd.BindIndexBuffer(draw.indexBuffer, 0, draw.indexBufferType);
+            // the shadow shader reads the transforms from the instance buffer, all draws share it
+            i += drawList->DrawIndexed(cmd, i, drawList->size(), view, true);
+        }
+    }
+
     void DefineNode()
     {
         AddOutputProperty("shadow map", PropertyType::RenderGraphLink);
         AddInputProperty("draw list", PropertyType::DrawList);
 
+        // size of a cascade
         AddConfig<ConfigurableType::Vec2>("shadow map size", glm::vec2{1024, 1024});
+        AddConfig<ConfigurableType::Int>("cascade count", int{4});
+        // 1 for logarithmic splits, 0 for uniform ones, see ComputeCascadeSplits
+        AddConfig<ConfigurableType::Float>("split lambda", 0.7f);
+        // the view distance shadows end at
+        AddConfig<ConfigurableType::Float>("shadow distance", 100.0f);
         AddConfig<ConfigurableType::ObjectPtr>("shadow map shader", nullptr);
+        // keep the shadows of static renderers between frames
+        AddConfig<ConfigurableType::Bool>("cache static shadows", true);
+        // texels around a cached cascade's slice, the camera moves this far before the cascade is drawn again
+        AddConfig<ConfigurableType::Int>("cache margin", int{32});
     }
     static char _reg;
 };
@@ -62,7 +62,13 @@ public:
                 cmd.BindShaderProgram(program, shader->GetDefaultShaderConfig());
                 cmd.BindResource(1, passResource.get());
                 size_t surfelSize = giScene->surfels.size();
-                cmd.DrawIndexed(submesh.GetIndexCount(), surfelSize, 0, 0, 0);
+                cmd.DrawIndexed(
+                    submesh.GetIndexCount(),
+                    surfelSize,
+                    submesh.GetFirstIndex(),
+                    submesh.GetVertexOffset(),
+                    0
+                );
                 cmd.EndRenderPass();
             }
         };
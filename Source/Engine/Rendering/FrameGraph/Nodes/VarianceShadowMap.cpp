@@ -69,13 +69,17 @@ public:
                 cmd.SetScissor(0, 1, &rect);
                 cmd.BeginRenderPass(pass, vsmClears);
 
-                for (auto& draw : *drawList)
+                // the variance shadow map is a single cascade
+                ShadowPushConstant pushConstant{};
+                for (size_t i = 0; i < drawList->size();)
                 {
+                    auto& draw = (*drawList)[i];
                     cmd.BindShaderProgram(shadowmapShaderProgram, shadowmapShaderProgram->GetDefaultShaderConfig());
-                    cmd.BindVertexBuffer(draw.vertexBufferBinding, 0);
+                    cmd.SetPushConstant(shadowmapShaderProgram, &pushConstant);
+                    cmd.BindVertexBuffer(draw.GetVertexBufferBindings(), 0);
                     cmd.BindIndexBuffer(draw.indexBuffer, 0, draw.indexBufferType);
-                    cmd.SetPushConstant(shadowmapShaderProgram, (void*)&draw.pushConstant);
-                    cmd.DrawIndexed(draw.indexCount, 1, 0, 0, 0);
+                    // the shadow shader reads the transforms from the instance buffer, all draws share it
+                    i += drawList->DrawIndexed(cmd, i, drawList->size(), SceneInstances::CullView::Shadow, true);
                 }
 
                 cmd.EndRenderPass();
@@ -136,7 +140,9 @@ public:
             }
         );
         vsmPass->SetName("vsm Pass");
+        vsmPass->SetMergeable(true);
         vsmBoxFilterPass0->SetName("vsm Box Filter Pass 0");
+        vsmBoxFilterPass0->SetMergeable(true);
         graph.Connect(vsmPass, 0, vsmBoxFilterPass0, RenderGraph::StrToHandle("src"));
 
         auto vsmBoxFilterPass1 = graph.AddNode2(
@@ -200,6 +206,7 @@ public:
             RenderGraph::StrToHandle("src")
         );
         vsmBoxFilterPass1->SetName("vsm Box Filter Pass 1");
+        vsmBoxFilterPass1->SetMergeable(true);
 
         return {
             Resource(
@@ -236,6 +243,9 @@ public:
         drawList = resources.GetResource(ResourceTag::DrawList{}, inputPropertyIDs["draw list"]);
         if (drawList == nullptr)
             return false;
+
+        // bound to the scene shader resource, any pass may sample it
+        graph.Export(vsmPass, 0);
         return true;
     };
 
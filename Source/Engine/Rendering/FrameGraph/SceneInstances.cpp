@@ -0,0 +1,435 @@
+#include "SceneInstances.hpp"
+#include "Asset/Shader.hpp"
+#include "GfxDriver/GfxDriver.hpp"
+#include "GfxDriver/ShaderProgram.hpp"
+#include "GfxDriver/ShaderResource.hpp"
+#include <cstring>
+
+namespace Engine::FrameGraph
+{
+namespace
+{
+// push constant of Game/CullInstances.comp
+struct CullParams
+{
+    uint32_t instanceCount;
+    uint32_t viewCount;
+};
+
+const uint32_t CULL_GROUP_SIZE = 64;
+} // namespace
+
+bool SceneInstances::IsInstanced(Gfx::ShaderProgram& shaderProgram)
+{
+    return shaderProgram.GetShaderInfo().bindings.contains(BINDING);
+}
+
+void SceneInstances::BeginFrame()
+{
+    // the frame that retired these buffers has finished
+    retiredBuffers[1].clear();
+    std::swap(retiredBuffers[0], retiredBuffers[1]);
+
+    transforms.resize(staticTransformCount);
+    cullGroups.resize(staticCullGroupCount);
+    drawCommands.resize(staticCullGroupCount * (uint32_t)CullView::Count);
+    culledInstanceGroups.resize(staticCulledInstanceCount);
+}
+
+void SceneInstances::BeginStatic()
+{
+    transforms.clear();
+    cullGroups.clear();
+    drawCommands.clear();
+    culledInstanceGroups.clear();
+    staticTransformCount = 0;
+    staticCullGroupCount = 0;
+    staticCulledInstanceCount = 0;
+    staticKey = 0;
+}
+
+void SceneInstances::EndStatic(uint64_t key)
+{
+    staticTransformCount = transforms.size();
+    staticCullGroupCount = cullGroups.size();
+    staticCulledInstanceCount = culledInstanceGroups.size();
+    staticKey = key;
+    staticDirty = true;
+}
+
+void SceneInstances::SetDefaultCullingShader(ComputeShader* shader)
+{
+    GetDefaultCullingShaderPrivate() = shader;
+}
+
+ComputeShader* SceneInstances::GetDefaultCullingShader()
+{
+    return GetDefaultCullingShaderPrivate();
+}
+
+ComputeShader*& SceneInstances::GetDefaultCullingShaderPrivate()
+{
+    static ComputeShader* shader = nullptr;
+    return shader;
+}
+
+uint32_t SceneInstances::Allocate(uint32_t count)
+{
+    uint32_t first = transforms.size();
+    transforms.resize(first + count);
+    return first;
+}
+
+bool SceneInstances::Reserve(
+    std::unique_ptr<Gfx::Buffer>& buffer,
+    size_t size,
+    size_t minSize,
+    Gfx::BufferUsageFlags usages,
+    bool visibleInCPU,
+    const char* debugName
+)
+{
+    if (buffer != nullptr && buffer->GetSize() >= size)
+        return false;
+
+    size_t capacity = minSize;
+    while (capacity < size)
+        capacity *= 2;
+
+    if (buffer != nullptr)
+        retiredBuffers[0].push_back(std::move(buffer));
+    buffer = GetGfxDriver()->CreateBuffer({
+        .usages = usages,
+        .size = capacity,
+        .visibleInCPU = visibleInCPU,
+        .debugName = debugName,
+    });
+    return true;
+}
+
+bool SceneInstances::IsGpuCullingSupported()
+{
+    return cullingShader != nullptr && cullingShader->GetDefaultShaderProgram() != nullptr &&
+           GetGfxDriver()->GetGPUFeatures().drawIndirect;
+}
+
+uint32_t SceneInstances::AddCullGroup(
+    const AABB& bounds,
+    uint32_t firstInstance,
+    uint32_t instanceCount,
+    uint32_t indexCount,
+    uint32_t firstIndex,
+    int32_t vertexOffset,
+    const glm::vec4& cone
+)
+{
+    uint32_t group = cullGroups.size();
+    uint32_t firstCulledInstance = culledInstanceGroups.size();
+    cullGroups.push_back({
+        .boundsCenter = (bounds.min + bounds.max) * 0.5f,
+        .firstInstance = firstInstance,
+        .boundsExtent = (bounds.max - bounds.min) * 0.5f,
+        .firstCulledInstance = firstCulledInstance,
+        .coneAxis = glm::vec3(cone),
+        .coneCutoff = cone.w,
+    });
+    // every view has instanceCount indices
+    for (uint32_t v = 0; v < (uint32_t)CullView::Count; ++v)
+    {
+        drawCommands.push_back({
+            .indexCount = indexCount,
+            .instanceCount = 0,
+            .firstIndex = firstIndex,
+            .vertexOffset = vertexOffset,
+            .firstInstance = firstCulledInstance * (uint32_t)CullView::Count + v * instanceCount,
+        });
+    }
+    culledInstanceGroups.resize(firstCulledInstance + instanceCount, group);
+    return group;
+}
+
+void SceneInstances::SetShadowIndices(uint32_t group, uint32_t indexCount, uint32_t firstIndex)
+{
+    for (uint32_t v = (uint32_t)CullView::Shadow; v < (uint32_t)CullView::Count; ++v)
+    {
+        auto& command = drawCommands[group * (uint32_t)CullView::Count + v];
+        command.indexCount = indexCount;
+        command.firstIndex = firstIndex;
+    }
+}
+
+void SceneInstances::SetCullView(CullView view, const glm::mat4& viewProjection, const glm::vec3* coneCullingOrigin)
+{
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i)
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+    // the planes of -w <= x, y, z <= w. It also holds a 0 to 1 depth range, the near plane is only conservative
+    auto& planes = cullViews[(int)view].planes;
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[3] + rows[2];
+    planes[5] = rows[3] - rows[2];
+
+    cullViews[(int)view].origin = coneCullingOrigin ? glm::vec4(*coneCullingOrigin, 1) : glm::vec4(0);
+}
+
+void SceneInstances::ClearCullView(CullView view)
+{
+    // every box is behind these planes
+    for (auto& plane : cullViews[(int)view].planes)
+        plane = glm::vec4(0, 0, 0, -1);
+    cullViews[(int)view].origin = glm::vec4(0);
+}
+
+void SceneInstances::Upload(Gfx::CommandBuffer& cmd, Gfx::ShaderResource& sceneShaderResource)
+{
+    const uint32_t viewCount = (uint32_t)CullView::Count;
+    const size_t commandSize = sizeof(Gfx::DrawIndexedIndirectCommand);
+    Gfx::BufferUsageFlags usages = Gfx::BufferUsage::Transfer_Dst | Gfx::BufferUsage::Storage;
+    bool recreated = Reserve(
+        instanceBuffer,
+        transforms.size() * sizeof(glm::mat4),
+        1024 * sizeof(glm::mat4),
+        usages,
+        false,
+        "Scene Instances"
+    );
+    // the culled indices of each view follow an identity index for every transform the buffer can hold
+    uint32_t culledBase = instanceBuffer->GetSize() / sizeof(glm::mat4);
+    recreated |= Reserve(
+        instanceIndexBuffer,
+        (culledBase + viewCount * culledInstanceGroups.size()) * sizeof(uint32_t),
+        1024 * sizeof(uint32_t),
+        usages | Gfx::BufferUsage::Transfer_Src,
+        false,
+        "Scene Instance Indices"
+    );
+    // the scene resource is recreated when the graph compiles, setting the same buffer again is free
+    sceneShaderResource.SetBuffer(BINDING, instanceBuffer.get());
+    sceneShaderResource.SetBuffer(INDEX_BINDING, instanceIndexBuffer.get());
+
+    if (transforms.empty())
+        return;
+
+    bool culling = !cullGroups.empty();
+    if (culling)
+    {
+        size_t viewSize = sizeof(cullViews);
+        Reserve(cullViewBuffer, viewSize, viewSize, usages, false, "Cull Views");
+        recreated |= Reserve(
+            cullGroupBuffer,
+            cullGroups.size() * sizeof(CullGroup),
+            256 * sizeof(CullGroup),
+            usages,
+            false,
+            "Cull Groups"
+        );
+        recreated |= Reserve(
+            culledInstanceBuffer,
+            culledInstanceGroups.size() * sizeof(uint32_t),
+            1024 * sizeof(uint32_t),
+            usages,
+            false,
+            "Culled Instances"
+        );
+        recreated |= Reserve(
+            drawCommandBuffer,
+            drawCommands.size() * commandSize,
+            viewCount * 256 * commandSize,
+            usages | Gfx::BufferUsage::Indirect | Gfx::BufferUsage::Transfer_Src,
+            false,
+            "Cull Draw Commands"
+        );
+        recreated |= Reserve(
+            staticDrawCommandBuffer,
+            staticCullGroupCount * viewCount * commandSize,
+            viewCount * 256 * commandSize,
+            Gfx::BufferUsage::Transfer_Src | Gfx::BufferUsage::Transfer_Dst,
+            false,
+            "Static Cull Draw Commands"
+        );
+    }
+
+    // the static part is only copied when it changed, a recreated buffer lost it
+    staticDirty = staticDirty || recreated;
+    uint32_t firstTransform = staticDirty ? 0 : staticTransformCount;
+    uint32_t firstGroup = staticDirty ? 0 : staticCullGroupCount;
+    uint32_t firstCulledInstance = staticDirty ? 0 : staticCulledInstanceCount;
+    uint32_t transformCount = transforms.size() - firstTransform;
+    uint32_t groupCount = cullGroups.size() - firstGroup;
+    size_t stagingSize = transformCount * (sizeof(glm::mat4) + sizeof(uint32_t));
+    if (culling)
+    {
+        stagingSize += sizeof(cullViews) + groupCount * sizeof(CullGroup) +
+                       (culledInstanceGroups.size() - firstCulledInstance) * sizeof(uint32_t) +
+                       groupCount * viewCount * commandSize;
+    }
+    if (stagingSize == 0)
+        return;
+
+    frame = (frame + 1) % 2;
+    auto& staging = stagingBuffers[frame];
+    Reserve(
+        staging,
+        stagingSize,
+        instanceBuffer->GetSize(),
+        Gfx::BufferUsage::Transfer_Src,
+        true,
+        "Scene Instances Staging"
+    );
+
+    // returns the staging memory of size bytes copied to buffer at dstOffset
+    uint8_t* stagingData = (uint8_t*)staging->GetCPUVisibleAddress();
+    size_t stagingOffset = 0;
+    auto copy = [&](Gfx::Buffer* buffer, size_t size, size_t dstOffset)
+    {
+        uint8_t* data = stagingData + stagingOffset;
+        if (size != 0)
+            cmd.CopyBuffer(buffer, staging.get(), size, dstOffset, stagingOffset);
+        stagingOffset += size;
+        return data;
+    };
+
+    size_t transformSize = transformCount * sizeof(glm::mat4);
+    memcpy(
+        copy(instanceBuffer.get(), transformSize, firstTransform * sizeof(glm::mat4)),
+        transforms.data() + firstTransform,
+        transformSize
+    );
+    size_t identitySize = transformCount * sizeof(uint32_t);
+    uint32_t* identity = (uint32_t*)copy(instanceIndexBuffer.get(), identitySize, firstTransform * sizeof(uint32_t));
+    for (uint32_t i = 0; i < transformCount; ++i)
+        identity[i] = firstTransform + i;
+
+    Gfx::GPUBarrier barriers[6];
+    uint32_t barrierCount = 0;
+    barriers[barrierCount++] = {
+        .buffer = instanceBuffer.get(),
+        .srcStageMask = Gfx::PipelineStage::Transfer,
+        .dstStageMask = Gfx::PipelineStage::Vertex_Shader | Gfx::PipelineStage::Compute_Shader,
+        .srcAccessMask = Gfx::AccessMask::Transfer_Write,
+        .dstAccessMask = Gfx::AccessMask::Shader_Read,
+    };
+    barriers[barrierCount++] = {
+        .buffer = instanceIndexBuffer.get(),
+        .srcStageMask = Gfx::PipelineStage::Transfer,
+        .dstStageMask = Gfx::PipelineStage::Vertex_Shader | Gfx::PipelineStage::Compute_Shader,
+        .srcAccessMask = Gfx::AccessMask::Transfer_Write,
+        .dstAccessMask = Gfx::AccessMask::Shader_Read | Gfx::AccessMask::Shader_Write,
+    };
+
+    if (culling)
+    {
+        auto copyCullData = [&](Gfx::Buffer* buffer, const void* data, size_t size, size_t dstOffset)
+        {
+            memcpy(copy(buffer, size, dstOffset), data, size);
+            barriers[barrierCount++] = {
+                .buffer = buffer,
+                .srcStageMask = Gfx::PipelineStage::Transfer,
+                .dstStageMask = Gfx::PipelineStage::Compute_Shader,
+                .srcAccessMask = Gfx::AccessMask::Transfer_Write,
+                .dstAccessMask = Gfx::AccessMask::Shader_Read | Gfx::AccessMask::Shader_Write,
+            };
+        };
+        copyCullData(cullViewBuffer.get(), cullViews, sizeof(cullViews), 0);
+        copyCullData(
+            cullGroupBuffer.get(),
+            cullGroups.data() + firstGroup,
+            groupCount * sizeof(CullGroup),
+            firstGroup * sizeof(CullGroup)
+        );
+        copyCullData(
+            culledInstanceBuffer.get(),
+            culledInstanceGroups.data() + firstCulledInstance,
+            (culledInstanceGroups.size() - firstCulledInstance) * sizeof(uint32_t),
+            firstCulledInstance * sizeof(uint32_t)
+        );
+
+        // Cull counts the instances of the commands, the static ones are reset from their copy
+        size_t staticCommandSize = staticCullGroupCount * viewCount * commandSize;
+        if (firstGroup != 0)
+        {
+            Gfx::GPUBarrier staticCommandBarrier{
+                .buffer = staticDrawCommandBuffer.get(),
+                .srcStageMask = Gfx::PipelineStage::Transfer,
+                .dstStageMask = Gfx::PipelineStage::Transfer,
+                .srcAccessMask = Gfx::AccessMask::Transfer_Write,
+                .dstAccessMask = Gfx::AccessMask::Transfer_Read,
+            };
+            cmd.Barrier(&staticCommandBarrier, 1);
+            cmd.CopyBuffer(drawCommandBuffer.get(), staticDrawCommandBuffer.get(), staticCommandSize);
+        }
+        else if (staticCommandSize != 0)
+            cmd.CopyBuffer(staticDrawCommandBuffer.get(), staging.get(), staticCommandSize, 0, stagingOffset);
+
+        size_t firstCommand = firstGroup * viewCount;
+        auto commands = (Gfx::DrawIndexedIndirectCommand*)copy(
+            drawCommandBuffer.get(),
+            (drawCommands.size() - firstCommand) * commandSize,
+            firstCommand * commandSize
+        );
+        for (size_t i = firstCommand; i < drawCommands.size(); ++i)
+        {
+            *commands = drawCommands[i];
+            commands->firstInstance += culledBase;
+            commands += 1;
+        }
+        barriers[barrierCount++] = {
+            .buffer = drawCommandBuffer.get(),
+            .srcStageMask = Gfx::PipelineStage::Transfer,
+            .dstStageMask = Gfx::PipelineStage::Compute_Shader,
+            .srcAccessMask = Gfx::AccessMask::Transfer_Write,
+            .dstAccessMask = Gfx::AccessMask::Shader_Read | Gfx::AccessMask::Shader_Write,
+        };
+    }
+
+    cmd.Barrier(barriers, barrierCount);
+    staticDirty = false;
+}
+
+void SceneInstances::Cull(Gfx::CommandBuffer& cmd)
+{
+    if (cullGroups.empty())
+        return;
+
+    if (cullResource == nullptr)
+        cullResource = GetGfxDriver()->CreateShaderResource();
+    cullResource->SetBuffer("CullViews", cullViewBuffer.get());
+    cullResource->SetBuffer("CullGroups", cullGroupBuffer.get());
+    cullResource->SetBuffer("CulledInstances", culledInstanceBuffer.get());
+    cullResource->SetBuffer("DrawCommands", drawCommandBuffer.get());
+    cullResource->SetBuffer(BINDING, instanceBuffer.get());
+    cullResource->SetBuffer(INDEX_BINDING, instanceIndexBuffer.get());
+
+    Gfx::ShaderProgram* program = cullingShader->GetDefaultShaderProgram();
+    CullParams params{
+        .instanceCount = (uint32_t)culledInstanceGroups.size(),
+        .viewCount = (uint32_t)CullView::Count,
+    };
+    cmd.BindShaderProgram(program, program->GetDefaultShaderConfig());
+    cmd.BindResource(0, cullResource.get());
+    cmd.SetPushConstant(program, &params);
+    cmd.Dispatch((params.instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    Gfx::GPUBarrier barriers[] = {
+        {
+            .buffer = drawCommandBuffer.get(),
+            .srcStageMask = Gfx::PipelineStage::Compute_Shader,
+            .dstStageMask = Gfx::PipelineStage::Draw_Indirect,
+            .srcAccessMask = Gfx::AccessMask::Shader_Write,
+            .dstAccessMask = Gfx::AccessMask::Indirect_Command_Read,
+        },
+        {
+            .buffer = instanceIndexBuffer.get(),
+            .srcStageMask = Gfx::PipelineStage::Compute_Shader,
+            .dstStageMask = Gfx::PipelineStage::Vertex_Shader,
+            .srcAccessMask = Gfx::AccessMask::Shader_Write,
+            .dstAccessMask = Gfx::AccessMask::Shader_Read,
+        },
+    };
+    cmd.Barrier(barriers, 2);
+}
+} // namespace Engine::FrameGraph
@@ -0,0 +1,215 @@
+#pragma once
+#include "GfxDriver/Buffer.hpp"
+#include "GfxDriver/CommandBuffer.hpp"
+#include "Utils/Structs.hpp"
+#include <glm/glm.hpp>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace Engine
+{
+class ComputeShader;
+}
+
+namespace Engine::Gfx
+{
+class ShaderProgram;
+class ShaderResource;
+} // namespace Engine::Gfx
+
+namespace Engine::FrameGraph
+{
+// Model matrices of the objects drawn in a frame. Draws of the draw list read their transform through the instance
+// index at gl_InstanceIndex instead of the push constant, so identical draws can be merged into one instanced draw. The
+// buffers are bound in the scene resource, the layouts match SceneInstances and SceneInstanceIndices in
+// Common/Common.glsl. The first indices map every transform to itself
+//
+// Instances added to a cull group are also culled on the GPU. A compute pass tests them against every CullView, writes
+// the indices of the visible transforms behind the identity indices and counts them in an indirect draw command per
+// group and view. A submesh with meshlets adds a cull group per meshlet, meshlets facing away from the camera are
+// culled by their normal cone
+//
+// The instances and cull groups added between BeginStatic and EndStatic are static, they are kept by BeginFrame and
+// only uploaded again after the next EndStatic. A frame only uploads the ones added after them
+class SceneInstances
+{
+public:
+    static constexpr const char* BINDING = "SceneInstances";
+    static constexpr const char* INDEX_BINDING = "SceneInstanceIndices";
+    static constexpr uint32_t NO_CULL_GROUP = UINT32_MAX;
+
+    // the views instances are culled against
+    enum class CullView
+    {
+        Camera,
+        // the cascades of the shadow map, see ShadowCascade. Shadow is the first one
+        Shadow,
+        ShadowCascade1,
+        ShadowCascade2,
+        ShadowCascade3,
+        Count
+    };
+
+    static CullView ShadowCascadeView(uint32_t cascade)
+    {
+        return (CullView)((uint32_t)CullView::Shadow + cascade);
+    }
+
+    // the instances of one submesh, the layout matches CullGroup in Game/CullInstances.comp
+    struct CullGroup
+    {
+        // object space bounds of the submesh
+        glm::vec3 boundsCenter;
+        uint32_t firstInstance;
+        glm::vec3 boundsExtent;
+        // index of the group's first instance among the culled instances, the indices of its visible instances are
+        // written from firstCulledInstance * CullView::Count on
+        uint32_t firstCulledInstance;
+        // normal cone of a meshlet, see Meshlet. A cutoff of 1 never culls
+        glm::vec3 coneAxis;
+        float coneCutoff;
+    };
+
+    // true if the shader program reads its transform from the instance buffer (G_INSTANCING)
+    static bool IsInstanced(Gfx::ShaderProgram& shaderProgram);
+
+    // called before draw lists are built, removes every instance and cull group but the static ones
+    void BeginFrame();
+
+    // remove every instance and cull group, the ones added until EndStatic are static
+    void BeginStatic();
+    // key identifies the static instances to the caller, see GetStaticKey
+    void EndStatic(uint64_t key);
+    // the key passed to the last EndStatic, 0 when there are no static instances
+    uint64_t GetStaticKey() const
+    {
+        return staticKey;
+    }
+
+    // the default of SetCullingShader, Game/CullInstances.comp. Set when the engine's internal assets are loaded
+    static void SetDefaultCullingShader(ComputeShader* shader);
+    static ComputeShader* GetDefaultCullingShader();
+
+    // reserve count transforms, returns the index of the first one
+    uint32_t Allocate(uint32_t count);
+
+    glm::mat4* GetTransforms()
+    {
+        return transforms.data();
+    }
+
+    // the compute shader that culls, GPU culling is supported when it's set and GPUFeatures::drawIndirect is
+    void SetCullingShader(ComputeShader* shader)
+    {
+        cullingShader = shader;
+    }
+    bool IsGpuCullingSupported();
+
+    // cull instanceCount allocated transforms from firstInstance, drawn with indexCount indices from firstIndex. cone
+    // is the normal cone of a meshlet, the axis in xyz and the cutoff in w. Returns the group, the commands of
+    // consecutive groups are GetDrawCommandStride apart in a view
+    uint32_t AddCullGroup(
+        const AABB& bounds,
+        uint32_t firstInstance,
+        uint32_t instanceCount,
+        uint32_t indexCount,
+        uint32_t firstIndex,
+        int32_t vertexOffset,
+        const glm::vec4& cone = glm::vec4(0, 0, 0, 1)
+    );
+    // draw group with indexCount indices from firstIndex in the shadow views instead
+    void SetShadowIndices(uint32_t group, uint32_t indexCount, uint32_t firstIndex);
+    std::span<const CullGroup> GetCullGroups()
+    {
+        return cullGroups;
+    }
+
+    // meshlets are only culled by their normal cone in views with a coneCullingOrigin, the position of the camera
+    void SetCullView(CullView view, const glm::mat4& viewProjection, const glm::vec3* coneCullingOrigin = nullptr);
+    // nothing is visible in view, its draw commands have no instances
+    void ClearCullView(CullView view);
+
+    // the DrawIndexedIndirectCommands written by Cull, one per group and view. The commands of a group are adjacent
+    Gfx::Buffer* GetDrawCommands() const
+    {
+        return drawCommandBuffer.get();
+    }
+    // the transform of every instance drawn, see SceneInstanceIndices in Common/Common.glsl
+    Gfx::Buffer* GetInstanceIndices() const
+    {
+        return instanceIndexBuffer.get();
+    }
+    static uint64_t GetDrawCommandOffset(CullView view, uint32_t cullGroup)
+    {
+        return ((uint64_t)cullGroup * (uint32_t)CullView::Count + (uint32_t)view) *
+               sizeof(Gfx::DrawIndexedIndirectCommand);
+    }
+    static uint32_t GetDrawCommandStride()
+    {
+        return (uint32_t)CullView::Count * sizeof(Gfx::DrawIndexedIndirectCommand);
+    }
+
+    // copy the transforms and the cull groups to the GPU and bind the buffers to the scene resource, recorded before
+    // the passes
+    void Upload(Gfx::CommandBuffer& cmd, Gfx::ShaderResource& sceneShaderResource);
+
+    // write the draw commands of the cull groups, recorded after Upload and before the passes
+    void Cull(Gfx::CommandBuffer& cmd);
+
+private:
+    // clip space planes, the layout matches CullView in Game/CullInstances.comp
+    struct CullPlanes
+    {
+        glm::vec4 planes[6];
+        // the position normal cones are tested from when w is 1
+        glm::vec4 origin;
+    };
+
+    // recreate buffer if it's smaller than size, the capacity doubles from minSize so a growing scene only recreates
+    // it a few times. The old buffer is retired, frames in flight may still read it. Returns true if it was recreated
+    bool Reserve(
+        std::unique_ptr<Gfx::Buffer>& buffer,
+        size_t size,
+        size_t minSize,
+        Gfx::BufferUsageFlags usages,
+        bool visibleInCPU,
+        const char* debugName
+    );
+
+    static ComputeShader*& GetDefaultCullingShaderPrivate();
+
+    std::vector<glm::mat4> transforms;
+    std::vector<CullGroup> cullGroups;
+    // the draw commands of every group, instanceCount is counted by Cull and firstInstance is relative to the culled
+    // indices
+    std::vector<Gfx::DrawIndexedIndirectCommand> drawCommands;
+    // the group of every culled instance
+    std::vector<uint32_t> culledInstanceGroups;
+    // the sizes of the vectors above at EndStatic
+    uint32_t staticTransformCount = 0;
+    uint32_t staticCullGroupCount = 0;
+    uint32_t staticCulledInstanceCount = 0;
+    uint64_t staticKey = 0;
+    // the static part changed or the buffers were recreated since it was last uploaded
+    bool staticDirty = false;
+    CullPlanes cullViews[(int)CullView::Count] = {};
+    ComputeShader* cullingShader = nullptr;
+    std::unique_ptr<Gfx::ShaderResource> cullResource;
+
+    std::unique_ptr<Gfx::Buffer> instanceBuffer;
+    // an index per transform, then the culled indices
+    std::unique_ptr<Gfx::Buffer> instanceIndexBuffer;
+    std::unique_ptr<Gfx::Buffer> cullViewBuffer;
+    std::unique_ptr<Gfx::Buffer> cullGroupBuffer;
+    std::unique_ptr<Gfx::Buffer> culledInstanceBuffer;
+    std::unique_ptr<Gfx::Buffer> drawCommandBuffer;
+    // the commands of the static cull groups before culling, copied to drawCommandBuffer every frame
+    std::unique_ptr<Gfx::Buffer> staticDrawCommandBuffer;
+    // the CPU writes one while the GPU may still copy from the other
+    std::unique_ptr<Gfx::Buffer> stagingBuffers[2];
+    uint32_t frame = 0;
+    // [0]: retired during the frame being recorded, [1]: retired during the frame that is in flight
+    std::vector<std::unique_ptr<Gfx::Buffer>> retiredBuffers[2];
+};
+} // namespace Engine::FrameGraph
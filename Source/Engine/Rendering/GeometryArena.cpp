@@ -0,0 +1,176 @@
+#include "GeometryArena.hpp"
+#include "GfxDriver/GfxDriver.hpp"
+#include "RenderPipeline.hpp"
+#include <algorithm>
+#include <numeric>
+
+namespace Engine
+{
+static constexpr uint64_t VERTEX_PAGE_SIZE = 32 * 1024 * 1024;
+static constexpr uint64_t INDEX_PAGE_SIZE = 16 * 1024 * 1024;
+// binding offsets must be inside the buffer, also for streams without data
+static constexpr uint64_t PAGE_PADDING = 16;
+
+GeometryArena::Range::Range(Range&& other) noexcept
+    : page(other.page), generation(other.generation), offset(other.offset), size(other.size)
+{
+    other.page = nullptr;
+}
+
+GeometryArena::Range& GeometryArena::Range::operator=(Range&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        page = other.page;
+        generation = other.generation;
+        offset = other.offset;
+        size = other.size;
+        other.page = nullptr;
+    }
+    return *this;
+}
+
+GeometryArena::Range::~Range()
+{
+    Release();
+}
+
+void GeometryArena::Range::Release()
+{
+    if (page != nullptr && SingletonPrivate() != nullptr && generation == Generation())
+        Singleton().retired[0].push_back({page, offset, size});
+    page = nullptr;
+}
+
+Gfx::Buffer* GeometryArena::Range::GetBuffer() const
+{
+    return page ? page->buffer.get() : nullptr;
+}
+
+uint64_t GeometryArena::Range::GetStreamOffset(uint32_t stream) const
+{
+    return page->streamOffsets[stream];
+}
+
+std::unique_ptr<GeometryArena>& GeometryArena::SingletonPrivate()
+{
+    static std::unique_ptr<GeometryArena> instance = nullptr;
+    return instance;
+}
+
+uint32_t& GeometryArena::Generation()
+{
+    static uint32_t generation = 0;
+    return generation;
+}
+
+void GeometryArena::Init()
+{
+    Generation() += 1;
+    SingletonPrivate() = std::unique_ptr<GeometryArena>(new GeometryArena());
+}
+
+void GeometryArena::Deinit()
+{
+    SingletonPrivate() = nullptr;
+}
+
+GeometryArena& GeometryArena::Singleton()
+{
+    return *SingletonPrivate();
+}
+
+GeometryArena::Range GeometryArena::AllocateVertices(std::span<const uint32_t> strides, uint32_t vertexCount)
+{
+    return Allocate(Gfx::BufferUsage::Vertex, strides, vertexCount, 1);
+}
+
+GeometryArena::Range GeometryArena::AllocateVertexBytes(uint64_t size)
+{
+    return Allocate(Gfx::BufferUsage::Vertex, {}, size, 16);
+}
+
+GeometryArena::Range GeometryArena::AllocateIndices(uint32_t indexCount, Gfx::IndexBufferType type)
+{
+    uint64_t indexSize = type == Gfx::IndexBufferType::UInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    return Allocate(Gfx::BufferUsage::Index, {}, indexCount * indexSize, indexSize);
+}
+
+GeometryArena::Range GeometryArena::Allocate(
+    Gfx::BufferUsageFlags usages, std::span<const uint32_t> strides, uint64_t size, uint64_t alignment
+)
+{
+    if (size == 0)
+        return Range();
+
+    for (auto& page : pages)
+    {
+        if (page->usages != usages || !std::ranges::equal(page->strides, strides))
+            continue;
+
+        uint64_t offset = page->allocator.Allocate(size, alignment);
+        if (offset != RangeAllocator::INVALID)
+            return Range(page.get(), Generation(), offset, size);
+    }
+
+    // data larger than a page gets a page of its own size
+    uint64_t capacity;
+    if (strides.empty())
+        capacity = std::max(size, usages == Gfx::BufferUsage::Index ? INDEX_PAGE_SIZE : VERTEX_PAGE_SIZE);
+    else
+    {
+        uint64_t vertexSize = std::max(std::accumulate(strides.begin(), strides.end(), 0u), 1u);
+        capacity = std::max(size, VERTEX_PAGE_SIZE / vertexSize);
+    }
+
+    Page& page = CreatePage(usages, strides, capacity);
+    return Range(&page, Generation(), page.allocator.Allocate(size, alignment), size);
+}
+
+GeometryArena::Page& GeometryArena::CreatePage(
+    Gfx::BufferUsageFlags usages, std::span<const uint32_t> strides, uint64_t capacity
+)
+{
+    auto page = std::make_unique<Page>();
+    page->usages = usages;
+    page->allocator = RangeAllocator(capacity);
+    page->strides.assign(strides.begin(), strides.end());
+
+    // every stream has capacity vertices, byte pages have one stream of capacity bytes
+    uint64_t size = strides.empty() ? capacity : 0;
+    for (uint32_t stride : strides)
+    {
+        page->streamOffsets.push_back(size);
+        size += capacity * stride;
+    }
+
+    page->buffer = GetGfxDriver()->CreateBuffer({
+        .usages = usages | Gfx::BufferUsage::Transfer_Dst,
+        .size = size + PAGE_PADDING,
+        .visibleInCPU = false,
+        .debugName = usages == Gfx::BufferUsage::Index ? "Geometry Arena Indices" : "Geometry Arena Vertices",
+    });
+
+    pages.push_back(std::move(page));
+    return *pages.back();
+}
+
+void GeometryArena::RecycleRetiredRanges()
+{
+    for (auto& r : retired[1])
+        r.page->allocator.Free(r.offset, r.size);
+    retired[1].clear();
+    std::swap(retired[0], retired[1]);
+}
+
+void GeometryArena::Upload(std::span<const Write> writes)
+{
+    // staged right away and copied with the other uploads at the start of the next frame
+    for (auto& w : writes)
+    {
+        if (w.size != 0)
+            RenderPipeline::Singleton().UploadBuffer(*w.dst, (uint8_t*)w.data, w.size, w.dstOffset);
+    }
+}
+} // namespace Engine
@@ -0,0 +1,119 @@
+#pragma once
+#include "GfxDriver/Buffer.hpp"
+#include "Libs/RangeAllocator.hpp"
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace Engine
+{
+// Vertex and index data of the submeshes, suballocated from a few large buffers instead of a buffer per submesh.
+//
+// Vertices are allocated in pages per vertex layout, a page keeps every stream of the layout in its own region of one
+// buffer. All submeshes of a page bind the same buffer and stream offsets and select their vertices with the draw's
+// vertexOffset. Indices of both types share index pages and are selected with firstIndex. Draws of a page only differ
+// in their draw parameters, so they can be merged into one indirect draw
+class GeometryArena
+{
+    struct Page;
+
+public:
+    // a range of a page, given back to the arena when destroyed
+    class Range
+    {
+    public:
+        Range() = default;
+        Range(Range&& other) noexcept;
+        Range& operator=(Range&& other) noexcept;
+        ~Range();
+
+        bool IsValid() const
+        {
+            return page != nullptr;
+        }
+
+        Gfx::Buffer* GetBuffer() const;
+
+        // in vertices for AllocateVertices, in bytes otherwise
+        uint64_t GetOffset() const
+        {
+            return offset;
+        }
+
+        // byte offset of the first vertex of a stream of the page, only for AllocateVertices
+        uint64_t GetStreamOffset(uint32_t stream) const;
+
+    private:
+        Range(Page* page, uint32_t generation, uint64_t offset, uint64_t size)
+            : page(page), generation(generation), offset(offset), size(size)
+        {}
+        void Release();
+
+        Page* page = nullptr;
+        // ranges that outlive the arena they are from are not given back
+        uint32_t generation = 0;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+
+        friend class GeometryArena;
+    };
+
+    struct Write
+    {
+        Gfx::Buffer* dst;
+        uint64_t dstOffset;
+        const void* data;
+        size_t size;
+    };
+
+    static void Init();
+    static void Deinit();
+    static GeometryArena& Singleton();
+
+    // vertexCount vertices with a stream per stride
+    Range AllocateVertices(std::span<const uint32_t> strides, uint32_t vertexCount);
+
+    // vertex data of a layout that doesn't fit AllocateVertices, drawn with binding offsets into the buffer
+    Range AllocateVertexBytes(uint64_t size);
+
+    // the range is aligned to the index size, firstIndex is GetOffset() / the index size
+    Range AllocateIndices(uint32_t indexCount, Gfx::IndexBufferType type);
+
+    // copy data to the buffers of the arena with the uploads of the next frame, like RenderPipeline::UploadBuffer.
+    // The data is staged before it returns
+    void Upload(std::span<const Write> writes);
+
+    // called once the GPU finished the previous frame. Ranges released before that frame was recorded are reused
+    void RecycleRetiredRanges();
+
+private:
+    GeometryArena() = default;
+
+    struct Page
+    {
+        std::unique_ptr<Gfx::Buffer> buffer;
+        RangeAllocator allocator;
+        Gfx::BufferUsageFlags usages;
+        // byte pages have no strides
+        std::vector<uint32_t> strides;
+        std::vector<uint64_t> streamOffsets;
+    };
+
+    static std::unique_ptr<GeometryArena>& SingletonPrivate();
+    static uint32_t& Generation();
+
+    Range Allocate(Gfx::BufferUsageFlags usages, std::span<const uint32_t> strides, uint64_t size, uint64_t alignment);
+    Page& CreatePage(Gfx::BufferUsageFlags usages, std::span<const uint32_t> strides, uint64_t capacity);
+
+    std::vector<std::unique_ptr<Page>> pages;
+    struct RetiredRange
+    {
+        Page* page;
+        uint64_t offset;
+        uint64_t size;
+    };
+    // freed ranges are only reused after the GPU finished the frames that may still read them. [0]: released during
+    // the frame being recorded, [1]: released during the frame in flight
+    std::vector<RetiredRange> retired[2];
+};
+} // namespace Engine
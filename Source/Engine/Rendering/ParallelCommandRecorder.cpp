@@ -0,0 +1,59 @@
+#include "ParallelCommandRecorder.hpp"
+#include "GfxDriver/GfxDriver.hpp"
+#include <algorithm>
+
+namespace Engine
+{
+ParallelCommandRecorder::ParallelCommandRecorder(ThreadPool& threadPool) : threadPool(&threadPool)
+{
+    uint32_t queueFamilyIndex = GetGfxDriver()->GetQueue(QueueType::Main)->GetFamilyIndex();
+    contexts.resize(threadPool.GetThreadCount());
+    for (ThreadContext& c : contexts)
+    {
+        for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; ++i)
+        {
+            c.pools[i] = GetGfxDriver()->CreateCommandPool({.queueFamilyIndex = queueFamilyIndex});
+            c.cmds[i] = c.pools[i]->AllocateCommandBuffers(Gfx::CommandBufferType::Secondary, 1)[0];
+        }
+    }
+}
+
+bool ParallelCommandRecorder::IsParallel(size_t drawCount)
+{
+    return threadPool->GetThreadCount() > 1 && drawCount >= 2 * MIN_DRAWS_PER_THREAD;
+}
+
+void ParallelCommandRecorder::Record(
+    Gfx::CommandBuffer& cmd, Gfx::RenderPass& renderPass, uint32_t subpass, size_t drawCount, const RecordFunc& record
+)
+{
+    if (!IsParallel(drawCount))
+    {
+        record(cmd, 0, drawCount);
+        return;
+    }
+
+    frame = (frame + 1) % FRAMES_IN_FLIGHT;
+    uint32_t rangeCount = std::min<size_t>(threadPool->GetThreadCount(), drawCount / MIN_DRAWS_PER_THREAD);
+
+    // ranges are handed out by index so that every range uses its own context no matter which thread records it
+    threadPool->ParallelFor(
+        rangeCount,
+        [&](uint32_t rangeIndex, uint32_t threadIndex)
+        {
+            ThreadContext& c = contexts[rangeIndex];
+            c.pools[frame]->ResetCommandPool();
+
+            Gfx::CommandBuffer& secondary = *c.cmds[frame];
+            secondary.Begin(renderPass, subpass);
+            record(secondary, drawCount * rangeIndex / rangeCount, drawCount * (rangeIndex + 1) / rangeCount);
+            secondary.End();
+        }
+    );
+
+    std::vector<Gfx::CommandBuffer*> secondaries;
+    for (uint32_t i = 0; i < rangeCount; ++i)
+        secondaries.push_back(contexts[i].cmds[frame].get());
+    cmd.ExecuteCommands(secondaries);
+}
+} // namespace Engine
@@ -0,0 +1,61 @@
+#pragma once
+#include "GfxDriver/CommandBuffer.hpp"
+#include "GfxDriver/CommandPool.hpp"
+#include "Libs/ThreadPool.hpp"
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Engine
+{
+// Records the draws of one subpass from several threads. Every thread records a range of the draws into a secondary
+// command buffer from its own command pool, the primary command buffer executes them in order.
+// Render graph passes could also be recorded into their own primary command buffers in parallel, this only splits
+// the draws inside one subpass
+class ParallelCommandRecorder
+{
+public:
+    // record the draws in [begin, end) into cmd. Called from worker threads, cmd starts without any bound state
+    using RecordFunc = std::function<void(Gfx::CommandBuffer& cmd, size_t begin, size_t end)>;
+
+    // with fewer draws per thread the handoff costs more than it saves
+    static constexpr size_t MIN_DRAWS_PER_THREAD = 256;
+
+    // the draws are split across the threads of threadPool, see RenderPipeline::GetThreadPool
+    ParallelCommandRecorder(ThreadPool& threadPool);
+
+    // true if Record splits drawCount draws across threads, the subpass then has to be begun with
+    // SubpassContents::Secondary_Command_Buffers
+    bool IsParallel(size_t drawCount);
+
+    // records the draws into cmd directly if IsParallel(drawCount) is false
+    void Record(
+        Gfx::CommandBuffer& cmd,
+        Gfx::RenderPass& renderPass,
+        uint32_t subpass,
+        size_t drawCount,
+        const RecordFunc& record
+    );
+
+    uint32_t GetThreadCount()
+    {
+        return threadPool->GetThreadCount();
+    }
+
+private:
+    // a frame is recorded while the previous one may still execute, the command buffers of the frame before that are
+    // reused
+    static constexpr uint32_t FRAMES_IN_FLIGHT = 2;
+
+    // one per thread, a command pool can't be used by two threads at the same time
+    struct ThreadContext
+    {
+        std::unique_ptr<Gfx::CommandPool> pools[FRAMES_IN_FLIGHT];
+        std::unique_ptr<Gfx::CommandBuffer> cmds[FRAMES_IN_FLIGHT];
+    };
+
+    ThreadPool* threadPool;
+    std::vector<ThreadContext> contexts;
+    uint32_t frame = 0;
+};
+} // namespace Engine
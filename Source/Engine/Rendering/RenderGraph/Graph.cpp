@@ -1,7 +1,12 @@
 #include "Graph.hpp"
 #include "Errors.hpp"
+#include "Libs/TopologicalSort.hpp"
+#include "ThirdParty/xxHash/xxhash.h"
 
 #include <algorithm>
+#include <iterator>
+#include <limits>
+#include <tuple>
 #include <spdlog/spdlog.h>
 
 namespace Engine::RenderGraph
@@ -33,6 +38,7 @@ void Graph::Process(RenderNode* presentNode, ResourceHandle resourceHandle)
     );
 
     Connect(presentNode, resourceHandle, present, 0);
+    outputNode = present;
 
     Process();
 
@@ -45,7 +51,12 @@ void Graph::Process(RenderNode* presentNode, ResourceHandle resourceHandle)
     }
 }
 
-Graph::~Graph() {}
+Graph::~Graph()
+{
+    // the command buffer of the last layout transfer may still execute
+    if (layoutTransferFence)
+        GetGfxDriver()->WaitForFence({layoutTransferFence}, true, -1);
+}
 
 bool Graph::Connect(RenderNode* src, ResourceHandle srcHandle, RenderNode* dst, ResourceHandle dstHandle)
 {
@@ -77,24 +88,13 @@ bool Graph::Connect(RenderNode* src, ResourceHandle srcHandle, RenderNode* dst,
 void Graph::Process()
 {
     // clean up
+    KeepCompiledPasses();
     resourceOwners.clear();
-    resourcePool.Clear();
+    resourcePool.Retire();
     barrierNodes.clear();
     sortedNodes.clear();
 
-    std::vector<RenderNode*> sortedNodes(nodes.size());
-    std::transform(nodes.begin(), nodes.end(), sortedNodes.begin(), [](auto& n) { return n.get(); });
-
-    // recalculate depth
-    for (RenderNode* n : sortedNodes)
-        n->depth = -1;
-    for (RenderNode* n : sortedNodes)
-        n->depth = GetDepthOfNode(n);
-
-    // sort nodes
-    std::sort(sortedNodes.begin(), sortedNodes.end(), [](RenderNode* l, RenderNode* r) { return l->depth < r->depth; });
-    for (int i = 0; i < sortedNodes.size(); ++i)
-        sortedNodes[i]->sortIndex = i;
+    std::vector<RenderNode*> sortedNodes = SortNodes();
 
     // preprocess
     for (RenderNode* n : sortedNodes)
@@ -102,49 +102,360 @@ void Graph::Process()
         Preprocess(n);
     }
 
+    for (auto& [node, handle] : exports)
+    {
+        if (node->pass->HasResourceDescription(handle))
+        {
+            ResourceOwner* owner = (ResourceOwner*)node->pass->GetResourceRef(handle)->GetOwner();
+            owner->exported = true;
+            // sampled outside of the graph
+            if (owner->request.type == ResourceType::Image)
+                owner->request.imageUsagesFlags |= Gfx::ImageUsage::Texture;
+        }
+    }
+
+    CullNodes(sortedNodes);
+    AssignQueues(sortedNodes);
+    AliasImages(sortedNodes);
+    PlaceAsyncComputeJoins(sortedNodes);
+
     for (auto& resourceOwner : resourceOwners)
     {
         resourceOwner->Finalize(resourcePool);
     }
+    resourcePool.ReleaseRetired();
 
-    for (RenderNode* n : sortedNodes)
+    // images created by this Process start in the layout of their last use
+    std::vector<ResourceOwner*> newImages;
+    for (std::unique_ptr<ResourceOwner>& r : resourceOwners)
     {
-        n->pass->Finalize();
+        // only used by culled nodes
+        if (r->used.empty() || !r->resourceRef.IsType(ResourceType::Image))
+            continue;
+
+        // a reused image is already in a layout tracked by the driver
+        if (r->request.externalImage != nullptr || resourcePool.IsNew((Gfx::Image*)r->resourceRef.GetResource()))
+            newImages.push_back(r.get());
     }
 
-    // insert resources barriers
-    std::unordered_map<SortIndex, std::vector<Gfx::GPUBarrier>> barriers;
-    std::vector<Gfx::GPUBarrier> initialLayoutTransfers;
+    processedNodes = sortedNodes;
+    FinalizePasses(sortedNodes, newImages, true);
+}
 
+bool Graph::ResizeImages()
+{
+    std::vector<ResourceOwner*> resized;
     for (std::unique_ptr<ResourceOwner>& r : resourceOwners)
     {
-        if (r->used.empty())
-            assert("Shouldn't be empty, if empty should be culled");
+        if (r->creator == nullptr || r->used.empty() || !r->resourceRef.IsType(ResourceType::Image))
+            continue;
+
+        const Gfx::ImageDescription& desc = r->creator->GetResourceDescription(r->request.handle).imageCreateInfo;
+        if (desc.width == r->request.imageCreateInfo.width && desc.height == r->request.imageCreateInfo.height)
+            continue;
+
+        // the memory is shared with other images
+        if (r->aliasGroup != -1)
+            return false;
+
+        resized.push_back(r.get());
+    }
 
+    if (resized.empty())
+        return true;
+
+    for (ResourceOwner* r : resized)
+    {
+        const Gfx::ImageDescription& desc = r->creator->GetResourceDescription(r->request.handle).imageCreateInfo;
+        r->request.imageCreateInfo.width = desc.width;
+        r->request.imageCreateInfo.height = desc.height;
+
+        // destroyed after the frame in flight by the driver
+        resourcePool.ReleaseImage((Gfx::Image*)r->resourceRef.GetResource());
+        r->resourceRef.SetResource((Gfx::Image*)nullptr);
+        r->Finalize(resourcePool);
+    }
+
+    // the barriers are planned again, the waits for async compute go back to the nodes
+    barrierNodes.clear();
+    for (size_t i = 0; i < processedNodes.size(); ++i)
+        processedNodes[i]->joinsAsyncCompute = queueTimeline[i].join;
+
+    FinalizePasses(processedNodes, resized, false);
+    return true;
+}
+
+void Graph::FinalizePasses(
+    std::vector<RenderNode*> sortedNodes, const std::vector<ResourceOwner*>& changed, bool finalizeAll
+)
+{
+    UpdateMemoryStats();
+
+    std::vector<bool> finalize(sortedNodes.size(), finalizeAll);
+    for (ResourceOwner* r : changed)
+    {
+        for (auto [sortIndex, handle] : r->used)
+            finalize[sortIndex] = true;
+    }
+
+    // the compile key names the images by address, it only identifies them if they were kept from the last Process
+    auto keptAttachments = [this](RenderPass& pass)
+    {
+        auto kept = [this, &pass](const RenderPass::Attachment& atta)
+        {
+            auto owner = (ResourceOwner*)pass.GetResourceRef(atta.handle)->GetOwner();
+            return owner->request.externalImage == nullptr &&
+                   !resourcePool.IsNew((Gfx::Image*)owner->resourceRef.GetResource());
+        };
+
+        for (const RenderPass::Subpass& subpass : pass.GetSubpasses())
+        {
+            if (!std::all_of(subpass.colors.begin(), subpass.colors.end(), kept) ||
+                (subpass.depth.has_value() && !kept(*subpass.depth)) ||
+                !std::all_of(subpass.inputs.begin(), subpass.inputs.end(), kept))
+                return false;
+        }
+        return true;
+    };
+
+    compileStats = {};
+    for (SortIndex i = 0; i < (SortIndex)sortedNodes.size(); ++i)
+    {
+        if (!finalize[i])
+            continue;
+
+        RenderPass& pass = *sortedNodes[i]->pass;
+        auto iter = keptAttachments(pass) ? compiledPasses.find(pass.GetCompileKey()) : compiledPasses.end();
+        if (iter != compiledPasses.end() && !iter->second.empty())
+        {
+            pass.SetCompiled(std::move(iter->second.back()));
+            iter->second.pop_back();
+            compileStats.reusedPassCount += 1;
+        }
+        else
+        {
+            pass.Finalize();
+            compileStats.finalizedPassCount += 1;
+        }
+    }
+    // what no pass took back is destroyed once the frame in flight finished
+    compiledPasses.clear();
+
+    // the barrier in front of the first use of a changed image transfers from the layout of its last use
+    std::vector<Gfx::GPUBarrier> initialLayoutTransfers;
+    bool waitOnHost = false;
+    for (ResourceOwner* r : changed)
+    {
+        auto image = (Gfx::Image*)r->resourceRef.GetResource();
         auto lastUsed = r->used.back();
         Gfx::ImageLayout currentLayout =
             sortedNodes[lastUsed.first]->pass->GetResourceDescription(lastUsed.second).imageLayout;
 
+        // later submissions to the main queue are ordered after the transfer, the other queues don't wait for it
+        if (sortedNodes[r->used.front().first]->queue != QueueType::Main)
+            waitOnHost = true;
+
+        Gfx::GPUBarrier initialLayoutTransfer{
+            .image = image,
+            .srcStageMask = Gfx::PipelineStage::Top_Of_Pipe,
+            .dstStageMask = Gfx::PipelineStage::All_Commands,
+            .srcAccessMask = Gfx::AccessMask::None,
+            .dstAccessMask = Gfx::AccessMask::Memory_Read | Gfx::AccessMask::Memory_Write,
+            .imageInfo =
+                {
+                    .srcQueueFamilyIndex = GFX_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = GFX_QUEUE_FAMILY_IGNORED,
+                    .oldLayout = Gfx::ImageLayout::Undefined,
+                    .newLayout = currentLayout,
+                    .subresourceRange = image->GetSubresourceRange(),
+                },
+        };
+        initialLayoutTransfers.push_back(initialLayoutTransfer);
+    }
+
+    // insert resources barriers, planned again only if something they depend on changed
+    std::unordered_map<ResourceOwner*, size_t> ownerIndices;
+    for (size_t i = 0; i < resourceOwners.size(); ++i)
+        ownerIndices[resourceOwners[i].get()] = i;
+    auto getOwnerIndices = [&ownerIndices](const std::vector<PlannedBarrier>& barriers)
+    {
+        std::vector<size_t> indices;
+        for (const PlannedBarrier& b : barriers)
+            indices.push_back(ownerIndices.at(b.owner));
+        return indices;
+    };
+    auto restore = [this](std::vector<PlannedBarrier> barriers, const std::vector<size_t>& indices)
+    {
+        for (size_t i = 0; i < barriers.size(); ++i)
+            barriers[i].owner = resourceOwners[indices[i]].get();
+        return barriers;
+    };
+
+    std::vector<PlannedBarrier> barriers;
+    barrierStats = {};
+    uint64_t planHash = HashBarrierPlan(sortedNodes);
+    if (planHash == compiledBarrierPlan.hash)
+    {
+        const CompiledBarrierPlan& plan = compiledBarrierPlan;
+        MergeRenderPasses(sortedNodes, restore(plan.fittedToQueues, plan.fittedToQueuesOwners));
+        barriers = restore(plan.barriers, plan.barrierOwners);
+        barrierStats.validationErrorCount = plan.validationErrorCount;
+        compileStats.reusedBarrierPlan = true;
+    }
+    else
+    {
+        barriers = PlanBarriers(sortedNodes, true);
+        MergeBarriers(barriers);
+        FitBarriersToQueues(sortedNodes, barriers);
+        std::vector<PlannedBarrier> fittedToQueues = barriers;
+        MergeRenderPasses(sortedNodes, barriers);
+        FitBarriersToRenderPasses(sortedNodes, barriers);
+        if (validateBarriers)
+        {
+            std::vector<PlannedBarrier> conservative = PlanBarriers(sortedNodes, false);
+            MergeBarriers(conservative);
+            FitBarriersToQueues(sortedNodes, conservative);
+            FitBarriersToRenderPasses(sortedNodes, conservative);
+            barrierStats.validationErrorCount = ValidateBarriers(sortedNodes, conservative, barriers);
+        }
+
+        compiledBarrierPlan = {
+            .hash = planHash,
+            .fittedToQueues = fittedToQueues,
+            .fittedToQueuesOwners = getOwnerIndices(fittedToQueues),
+            .barriers = barriers,
+            .barrierOwners = getOwnerIndices(barriers),
+            .validationErrorCount = barrierStats.validationErrorCount,
+        };
+    }
+
+    plannedBarriers.clear();
+    for (PlannedBarrier& b : barriers)
+        plannedBarriers.push_back({b.src == -1 ? "" : sortedNodes[b.src]->name, sortedNodes[b.dst]->name, b.barrier});
+    InsertBarrierNodes(sortedNodes, barriers);
+
+    // copy
+    this->sortedNodes = sortedNodes;
+
+    if (initialLayoutTransfers.empty())
+        return;
+
+    auto queue = GetGfxDriver()->GetQueue(QueueType::Main).Get();
+    if (layoutTransferFence == nullptr)
+    {
+        layoutTransferPool = GetGfxDriver()->CreateCommandPool({.queueFamilyIndex = queue->GetFamilyIndex()});
+        layoutTransferCmd = layoutTransferPool->AllocateCommandBuffers(Gfx::CommandBufferType::Primary, 1)[0];
+        layoutTransferFence = GetGfxDriver()->CreateFence({.signaled = true});
+    }
+
+    // the previous transfer finished long ago in practice
+    GetGfxDriver()->WaitForFence({layoutTransferFence}, true, -1);
+    layoutTransferFence->Reset();
+    layoutTransferPool->ResetCommandPool();
+
+    layoutTransferCmd->Begin();
+    layoutTransferCmd->Barrier(initialLayoutTransfers.data(), initialLayoutTransfers.size());
+    layoutTransferCmd->End();
+
+    Gfx::CommandBuffer* cmdBufs[] = {layoutTransferCmd.get()};
+    GetGfxDriver()->QueueSubmit(queue, cmdBufs, {}, {}, {}, layoutTransferFence);
+    if (waitOnHost)
+        GetGfxDriver()->WaitForFence({layoutTransferFence}, true, -1);
+}
+
+void Graph::KeepCompiledPasses()
+{
+    for (std::unique_ptr<RenderNode>& n : nodes)
+    {
+        if (std::optional<RenderPass::Compiled> compiled = n->pass->TakeCompiled())
+            compiledPasses[compiled->key].push_back(std::move(*compiled));
+    }
+}
+
+uint64_t Graph::HashBarrierPlan(const std::vector<RenderNode*>& sortedNodes)
+{
+    std::vector<uint64_t> fields = {sortedNodes.size(), resourceOwners.size(), mergeRenderPasses, validateBarriers};
+    for (RenderNode* n : sortedNodes)
+    {
+        fields.push_back((uint64_t)n->queue);
+        fields.push_back(n->joinsAsyncCompute);
+        fields.push_back(n->mergeable);
+        fields.push_back(n->pass->GetCompileKey());
+    }
+
+    std::unordered_map<ResourceOwner*, uint64_t> ownerIndices;
+    for (size_t i = 0; i < resourceOwners.size(); ++i)
+        ownerIndices[resourceOwners[i].get()] = i;
+
+    for (std::unique_ptr<ResourceOwner>& r : resourceOwners)
+    {
+        fields.push_back(r->used.size());
+        if (r->used.empty())
+            continue;
+
+        // an address may be reused by another resource, the properties the barriers use are hashed with it
+        fields.push_back((uint64_t)r->resourceRef.GetResource());
         if (r->resourceRef.IsType(ResourceType::Image))
         {
-            auto image = (Gfx::Image*)r->resourceRef.GetResource();
-            Gfx::GPUBarrier initialLayoutTransfer{
-                .image = image,
-                .srcStageMask = Gfx::PipelineStage::All_Commands,
-                .dstStageMask = Gfx::PipelineStage::All_Commands,
-                .srcAccessMask = Gfx::AccessMask::Memory_Read | Gfx::AccessMask::Memory_Write,
-                .dstAccessMask = Gfx::AccessMask::Memory_Read | Gfx::AccessMask::Memory_Write,
-                .imageInfo =
-                    {
-                        .srcQueueFamilyIndex = GFX_QUEUE_FAMILY_IGNORED,
-                        .dstQueueFamilyIndex = GFX_QUEUE_FAMILY_IGNORED,
-                        .oldLayout = Gfx::ImageLayout::Undefined,
-                        .newLayout = currentLayout,
-                        .subresourceRange = image->GetSubresourceRange(),
-                    },
-            };
-            initialLayoutTransfers.push_back(initialLayoutTransfer);
+            const Gfx::ImageDescription& desc = ((Gfx::Image*)r->resourceRef.GetResource())->GetDescription();
+            fields.insert(
+                fields.end(),
+                {desc.width,
+                 desc.height,
+                 (uint64_t)desc.format,
+                 (uint64_t)desc.multiSampling,
+                 desc.mipLevels,
+                 (uint64_t)desc.isCubemap}
+            );
         }
+        else
+            fields.push_back(((Gfx::Buffer*)r->resourceRef.GetResource())->GetSize());
+
+        fields.push_back(r->exported);
+        fields.push_back(r->request.externalImage != nullptr || r->request.externalBuffer != nullptr);
+        fields.push_back((uint64_t)r->aliasGroup);
+        fields.push_back(r->aliasPredecessor ? ownerIndices.at(r->aliasPredecessor) : resourceOwners.size());
+        fields.push_back(r->request.imageUsagesFlags);
+
+        for (auto [sortIndex, handle] : r->used)
+        {
+            auto& desc = sortedNodes[sortIndex]->pass->GetResourceDescription(handle);
+            fields.insert(
+                fields.end(),
+                {(uint64_t)sortIndex,
+                 handle,
+                 (uint64_t)desc.accessFlags,
+                 (uint64_t)desc.stageFlags,
+                 (uint64_t)desc.imageLayout,
+                 (uint64_t)desc.imageSubresourceRange.has_value()}
+            );
+            if (desc.imageSubresourceRange.has_value())
+            {
+                const Gfx::ImageSubresourceRange& range = *desc.imageSubresourceRange;
+                fields.insert(
+                    fields.end(),
+                    {(uint64_t)range.aspectMask,
+                     range.baseMipLevel,
+                     range.levelCount,
+                     range.baseArrayLayer,
+                     range.layerCount}
+                );
+            }
+        }
+    }
+
+    return XXH64(fields.data(), fields.size() * sizeof(uint64_t), 0);
+}
+
+std::vector<Graph::PlannedBarrier> Graph::PlanBarriers(const std::vector<RenderNode*>& sortedNodes, bool narrow)
+{
+    std::vector<PlannedBarrier> barriers;
+
+    for (std::unique_ptr<ResourceOwner>& r : resourceOwners)
+    {
+        // only used by culled nodes
+        if (r->used.empty())
+            continue;
 
         using UsedIndex = int;
         std::vector<UsedIndex> readAccess;
@@ -163,19 +474,29 @@ void Graph::Process()
                                                            : image->GetSubresourceRange()};
                 std::vector<Gfx::ImageSubresourceRange> remainingRangeSwap{};
 
-                for (UsedIndex preUsed = usedIndex; preUsed >= 0; preUsed--)
+                // the first use depends on the last use in the previous frame
+                for (UsedIndex preUsed = usedIndex == 0 ? 0 : usedIndex - 1; preUsed >= 0; preUsed--)
                 {
-                    if (preUsed != 0)
-                        preUsed = preUsed - 1;
-
                     SortIndex preUsedSortIndex = r->used[preUsed].first;
                     ResourceHandle preUsedWriteHandle = r->used[preUsed].second;
                     auto preUsedDesc = sortedNodes[preUsedSortIndex]->pass->GetResourceDescription(preUsedWriteHandle);
                     auto preUsedRange = preUsedDesc.imageSubresourceRange.has_value()
                                             ? preUsedDesc.imageSubresourceRange.value()
                                             : image->GetSubresourceRange();
+                    SortIndex srcSortIndex = usedIndex == 0 ? -1 : preUsedSortIndex;
 
-                    if (preUsed == 0)
+                    if (preUsed == 0 && usedIndex == 0 && r->aliasPredecessor != nullptr)
+                    {
+                        // another image wrote to the memory since the last frame, the content is discarded and that
+                        // image's last use has to finish first
+                        auto [aliasSortIndex, aliasHandle] = r->aliasPredecessor->used.back();
+                        auto& aliasDesc = sortedNodes[aliasSortIndex]->pass->GetResourceDescription(aliasHandle);
+                        preUsedDesc.imageLayout = Gfx::ImageLayout::Undefined;
+                        preUsedDesc.accessFlags = aliasDesc.accessFlags | Gfx::AccessMask::Memory_Write;
+                        preUsedDesc.stageFlags = aliasDesc.stageFlags;
+                        srcSortIndex = aliasSortIndex;
+                    }
+                    else if (preUsed == 0)
                     {
                         preUsedDesc.imageLayout = Gfx::ImageLayout::Dynamic;
                     }
@@ -219,7 +540,17 @@ void Graph::Process()
                             if (srcStages != Gfx::PipelineStage::None || srcAccess != Gfx::AccessMask::None ||
                                 preUsedDesc.imageLayout != desc.imageLayout)
                             {
-                                auto image = (Gfx::Image*)r->resourceRef.GetResource();
+                                Gfx::AccessMaskFlags dstAccess = desc.accessFlags;
+                                if (narrow)
+                                {
+                                    // only writes have to be made available. Without them and without a layout
+                                    // transition the barrier is just an execution dependency
+                                    srcAccess = Gfx::WriteAccessMask(srcAccess);
+                                    if (srcAccess == Gfx::AccessMask::None &&
+                                        preUsedDesc.imageLayout == desc.imageLayout)
+                                        dstAccess = Gfx::AccessMask::None;
+                                }
+
                                 if (srcStages == Gfx::PipelineStage::None)
                                     srcStages = Gfx::PipelineStage::Top_Of_Pipe;
                                 Gfx::GPUBarrier barrier{
@@ -227,7 +558,7 @@ void Graph::Process()
                                     .srcStageMask = srcStages,
                                     .dstStageMask = desc.stageFlags,
                                     .srcAccessMask = srcAccess,
-                                    .dstAccessMask = desc.accessFlags,
+                                    .dstAccessMask = dstAccess,
                                     .imageInfo = {
                                         .srcQueueFamilyIndex = GFX_QUEUE_FAMILY_IGNORED,
                                         .dstQueueFamilyIndex = GFX_QUEUE_FAMILY_IGNORED,
@@ -235,7 +566,7 @@ void Graph::Process()
                                         .newLayout = desc.imageLayout,
                                         .subresourceRange = overlapping}};
 
-                                barriers[sortIndex].push_back(barrier);
+                                barriers.push_back({srcSortIndex, sortIndex, r.get(), barrier});
                             }
 
                             auto remainings = currentRange.Subtract(preUsedRange);
@@ -257,10 +588,10 @@ void Graph::Process()
             }
             else if (r->resourceRef.IsType(ResourceType::Buffer))
             {
-                Gfx::Buffer* buf = (Gfx::Buffer*)r->resourceRef.GetResource();
-
-                Gfx::PipelineStageFlags srcStages = Gfx::PipelineStage::Top_Of_Pipe;
+                Gfx::PipelineStageFlags srcStages =
+                    narrow ? Gfx::PipelineStage::None : Gfx::PipelineStage::Top_Of_Pipe;
                 Gfx::AccessMask srcAccessMask = Gfx::AccessMask::None;
+                SortIndex srcSortIndex = -1;
 
                 if (Gfx::HasWriteAccessMask(desc.accessFlags))
                 {
@@ -274,6 +605,7 @@ void Graph::Process()
                             sortedNodes[srcWriteSortIndex]->pass->GetResourceDescription(srcWriteHandle);
                         srcAccessMask |= srcWriteDesc.accessFlags;
                         srcStages |= srcWriteDesc.stageFlags;
+                        srcSortIndex = std::max(srcSortIndex, srcWriteSortIndex);
                     }
 
                     // write after read
@@ -285,6 +617,7 @@ void Graph::Process()
                         auto& srcReadDesc = sortedNodes[srcReadSortIndex]->pass->GetResourceDescription(srcReadHandle);
                         srcAccessMask |= srcReadDesc.accessFlags;
                         srcStages |= srcReadDesc.stageFlags;
+                        srcSortIndex = std::max(srcSortIndex, srcReadSortIndex);
                     }
 
                     writeAccess.push_back(usedIndex);
@@ -299,110 +632,984 @@ void Graph::Process()
                         SortIndex srcWriteSortIndex = r->used[i].first;
                         ResourceHandle srcWriteHandle = r->used[i].second;
                         auto& srcWriteDesc =
-                            sortedNodes[srcWriteSortIndex]->pass->GetResourceDescription(srcWriteSortIndex);
+                            sortedNodes[srcWriteSortIndex]->pass->GetResourceDescription(srcWriteHandle);
                         srcAccessMask |= srcWriteDesc.accessFlags;
                         srcStages |= srcWriteDesc.stageFlags;
+                        srcSortIndex = std::max(srcSortIndex, srcWriteSortIndex);
                     }
 
                     readAccess.push_back(usedIndex);
                 }
 
-                if (srcStages != Gfx::PipelineStage::Top_Of_Pipe || srcAccessMask != Gfx::AccessMask::None)
+                bool needed = narrow ? srcStages != Gfx::PipelineStage::None
+                                     : srcStages != Gfx::PipelineStage::Top_Of_Pipe ||
+                                           srcAccessMask != Gfx::AccessMask::None;
+                if (needed)
                 {
+                    Gfx::AccessMaskFlags dstAccessMask = desc.accessFlags;
+                    if (narrow)
+                    {
+                        srcAccessMask = Gfx::WriteAccessMask(srcAccessMask);
+                        if (srcAccessMask == Gfx::AccessMask::None)
+                            dstAccessMask = Gfx::AccessMask::None;
+                    }
+
                     Gfx::GPUBarrier barrier{
                         .buffer = (Gfx::Buffer*)r->resourceRef.GetResource(),
                         .srcStageMask = srcStages,
                         .dstStageMask = desc.stageFlags,
                         .srcAccessMask = srcAccessMask,
-                        .dstAccessMask = desc.accessFlags,
+                        .dstAccessMask = dstAccessMask,
                         .bufferInfo = {GFX_QUEUE_FAMILY_IGNORED, GFX_QUEUE_FAMILY_IGNORED, 0, GFX_WHOLE_SIZE},
                     };
 
-                    barriers[sortIndex].push_back(barrier);
+                    barriers.push_back({srcSortIndex, sortIndex, r.get(), barrier});
+                }
+            }
+        }
+    }
+
+    return barriers;
+}
+
+static bool HasSameTarget(const Gfx::GPUBarrier& l, const Gfx::GPUBarrier& r)
+{
+    if (l.buffer.Get() != nullptr)
+        return l.buffer.Get() == r.buffer.Get();
+
+    return l.image.Get() == r.image.Get() && l.imageInfo.subresourceRange == r.imageInfo.subresourceRange &&
+           l.imageInfo.oldLayout == r.imageInfo.oldLayout && l.imageInfo.newLayout == r.imageInfo.newLayout;
+}
+
+void Graph::MergeBarriers(std::vector<PlannedBarrier>& barriers)
+{
+    std::vector<PlannedBarrier> merged;
+    merged.reserve(barriers.size());
+    for (PlannedBarrier& b : barriers)
+    {
+        auto iter = std::find_if(
+            merged.begin(),
+            merged.end(),
+            [&b](PlannedBarrier& m) { return m.dst == b.dst && HasSameTarget(m.barrier, b.barrier); }
+        );
+
+        if (iter == merged.end())
+        {
+            merged.push_back(b);
+            continue;
+        }
+
+        // waiting for the later producer also waits for the earlier one
+        iter->src = std::max(iter->src, b.src);
+        iter->barrier.srcStageMask |= b.barrier.srcStageMask;
+        iter->barrier.dstStageMask |= b.barrier.dstStageMask;
+        iter->barrier.srcAccessMask |= b.barrier.srcAccessMask;
+        iter->barrier.dstAccessMask |= b.barrier.dstAccessMask;
+    }
+
+    barriers = std::move(merged);
+}
+
+void Graph::FitBarriersToQueues(const std::vector<RenderNode*>& sortedNodes, std::vector<PlannedBarrier>& barriers)
+{
+    const Gfx::PipelineStageFlags computeQueueStages =
+        Gfx::PipelineStage::Top_Of_Pipe | Gfx::PipelineStage::Draw_Indirect | Gfx::PipelineStage::Compute_Shader |
+        Gfx::PipelineStage::Transfer | Gfx::PipelineStage::Bottom_Of_Pipe | Gfx::PipelineStage::Host |
+        Gfx::PipelineStage::All_Commands;
+
+    for (PlannedBarrier& b : barriers)
+    {
+        if (sortedNodes[b.dst]->queue != QueueType::AsyncCompute ||
+            (b.barrier.srcStageMask & ~computeQueueStages) == 0)
+            continue;
+
+        // the producer is on the main queue. The semaphore the async compute work waits on at All_Commands makes its
+        // writes available, the barrier only has to order the layout transition after the wait
+        b.barrier.srcStageMask = Gfx::PipelineStage::All_Commands;
+        b.barrier.srcAccessMask = Gfx::AccessMask::None;
+    }
+}
+
+void Graph::FitBarriersToRenderPasses(
+    const std::vector<RenderNode*>& sortedNodes, std::vector<PlannedBarrier>& barriers
+)
+{
+    bool moved = false;
+    for (PlannedBarrier& b : barriers)
+    {
+        if (!sortedNodes[b.dst]->mergedWithPrevious)
+            continue;
+
+        SortIndex first = b.dst;
+        while (sortedNodes[first]->mergedWithPrevious)
+            first -= 1;
+
+        // the subpass dependencies of the render pass cover the uses inside it. A source after the destination is in
+        // the previous frame, the last user of an aliased image's memory
+        if (b.src >= first && b.src < b.dst)
+            b.dst = -1;
+        else
+            b.dst = first;
+        moved = true;
+    }
+
+    if (!moved)
+        return;
+
+    std::erase_if(barriers, [](PlannedBarrier& b) { return b.dst == -1; });
+    MergeBarriers(barriers);
+}
+
+bool Graph::IsSplit(const std::vector<RenderNode*>& sortedNodes, const PlannedBarrier& barrier)
+{
+    if (!splitBarriers || barrier.src < 0 || barrier.dst - barrier.src < 2)
+        return false;
+
+    // an event only works within one queue, it's set in front of the node after the producer, outside of a render pass
+    QueueType queue = sortedNodes[barrier.src]->queue;
+    RenderNode* next = sortedNodes[barrier.src + 1];
+    return !next->mergedWithPrevious && next->queue == queue && sortedNodes[barrier.dst]->queue == queue;
+}
+
+uint32_t Graph::ValidateBarriers(
+    const std::vector<RenderNode*>& sortedNodes,
+    const std::vector<PlannedBarrier>& conservative,
+    const std::vector<PlannedBarrier>& optimized
+)
+{
+    uint32_t errorCount = 0;
+    auto report = [&errorCount, &sortedNodes](const PlannedBarrier& b, const char* problem)
+    {
+        SPDLOG_WARN(
+            "render graph barrier before \"{}\" on \"{}\": {}",
+            sortedNodes[b.dst]->name,
+            b.owner->request.name,
+            problem
+        );
+        errorCount += 1;
+    };
+
+    for (const PlannedBarrier& c : conservative)
+    {
+        auto o = std::find_if(
+            optimized.begin(),
+            optimized.end(),
+            [&c](const PlannedBarrier& b) { return b.dst == c.dst && HasSameTarget(b.barrier, c.barrier); }
+        );
+
+        if (o == optimized.end())
+        {
+            report(c, "missing");
+            continue;
+        }
+
+        // Top_Of_Pipe as a source doesn't wait for anything
+        Gfx::PipelineStageFlags srcStages = c.barrier.srcStageMask & ~Gfx::PipelineStage::Top_Of_Pipe;
+        if ((o->barrier.srcStageMask & srcStages) != srcStages)
+            report(c, "source stages narrower than the conservative barrier");
+        if ((o->barrier.dstStageMask & c.barrier.dstStageMask) != c.barrier.dstStageMask)
+            report(c, "destination stages narrower than the conservative barrier");
+
+        Gfx::AccessMaskFlags writes = Gfx::WriteAccessMask(c.barrier.srcAccessMask);
+        if ((o->barrier.srcAccessMask & writes) != writes)
+            report(c, "writes are not made available");
+
+        bool makesVisible = o->barrier.srcAccessMask != Gfx::AccessMask::None ||
+                            o->barrier.imageInfo.oldLayout != o->barrier.imageInfo.newLayout;
+        if (makesVisible && (o->barrier.dstAccessMask & c.barrier.dstAccessMask) != c.barrier.dstAccessMask)
+            report(c, "writes are not made visible to every access");
+
+        if (o->src < c.src)
+            report(c, "waits for an earlier node than the producer");
+    }
+
+    SPDLOG_INFO(
+        "render graph: validated {} barriers against {} conservative ones, {} problems",
+        optimized.size(),
+        conservative.size(),
+        errorCount
+    );
+
+    return errorCount;
+}
+
+void Graph::InsertBarrierNodes(std::vector<RenderNode*>& sortedNodes, const std::vector<PlannedBarrier>& barriers)
+{
+    // what is recorded in front of the node at a sort index
+    struct BarrierBatch
+    {
+        std::vector<std::pair<Gfx::Event*, Gfx::PipelineStageFlags>> setEvents;
+        std::vector<Gfx::GPUBarrier> barriers;
+        std::vector<Gfx::Event*> waitEvents;
+        Gfx::PipelineStageFlags waitSrcStages = Gfx::PipelineStage::None;
+        std::vector<Gfx::GPUBarrier> waitBarriers;
+        std::vector<Gfx::Event*> resetEvents;
+    };
+    std::vector<BarrierBatch> batches(sortedNodes.size());
+
+    // one event per producer, set right after it and reset after the last node waiting for it
+    struct SplitEvent
+    {
+        SortIndex src;
+        SortIndex lastWait;
+        Gfx::PipelineStageFlags stages;
+    };
+    std::vector<SplitEvent> splitEvents;
+    std::unordered_map<SortIndex, size_t> eventIndices;
+    for (const PlannedBarrier& b : barriers)
+    {
+        if (!IsSplit(sortedNodes, b))
+            continue;
+
+        auto iter = eventIndices.find(b.src);
+        if (iter == eventIndices.end())
+        {
+            eventIndices[b.src] = splitEvents.size();
+            splitEvents.push_back({b.src, b.dst, b.barrier.srcStageMask});
+        }
+        else
+        {
+            SplitEvent& e = splitEvents[iter->second];
+            e.lastWait = std::max(e.lastWait, b.dst);
+            e.stages |= b.barrier.srcStageMask;
+        }
+    }
+
+    while (events.size() < splitEvents.size())
+        events.push_back(GetGfxDriver()->CreateEvent());
+
+    for (size_t i = 0; i < splitEvents.size(); ++i)
+    {
+        batches[splitEvents[i].src + 1].setEvents.push_back({events[i].get(), splitEvents[i].stages});
+        batches[splitEvents[i].lastWait].resetEvents.push_back(events[i].get());
+    }
+
+    for (const PlannedBarrier& b : barriers)
+    {
+        BarrierBatch& batch = batches[b.dst];
+        if (!IsSplit(sortedNodes, b))
+        {
+            batch.barriers.push_back(b.barrier);
+            barrierStats.barrierCount += 1;
+            continue;
+        }
+
+        size_t eventIndex = eventIndices[b.src];
+        Gfx::Event* event = events[eventIndex].get();
+        if (std::find(batch.waitEvents.begin(), batch.waitEvents.end(), event) == batch.waitEvents.end())
+        {
+            batch.waitEvents.push_back(event);
+            batch.waitSrcStages |= splitEvents[eventIndex].stages;
+        }
+        batch.waitBarriers.push_back(b.barrier);
+        barrierStats.splitBarrierCount += 1;
+    }
+
+    // insert from the back so that the sort indices in front stay valid
+    for (SortIndex sortIndex = (SortIndex)batches.size() - 1; sortIndex >= 0; --sortIndex)
+    {
+        BarrierBatch& batch = batches[sortIndex];
+        if (batch.setEvents.empty() && batch.barriers.empty() && batch.waitBarriers.empty())
+            continue;
+
+        std::unique_ptr<RenderPass> pass(new RenderPass(
+            [batch = std::move(batch)](Gfx::CommandBuffer& cmd, auto& b, auto& c) mutable
+            {
+                for (auto [event, stages] : batch.setEvents)
+                    cmd.SetEvent(*event, stages);
+
+                if (!batch.barriers.empty())
+                    cmd.Barrier(batch.barriers.data(), batch.barriers.size());
+
+                if (!batch.waitBarriers.empty())
+                {
+                    cmd.WaitEvents(
+                        batch.waitEvents,
+                        batch.waitSrcStages,
+                        batch.waitBarriers.data(),
+                        batch.waitBarriers.size()
+                    );
+
+                    Gfx::PipelineStageFlags waitStages = Gfx::PipelineStage::None;
+                    for (auto& barrier : batch.waitBarriers)
+                        waitStages |= barrier.dstStageMask;
+                    for (Gfx::Event* event : batch.resetEvents)
+                        cmd.ResetEvent(*event, waitStages);
+                }
+            },
+            {},
+            {}
+        ));
+
+        barrierNodes.push_back(std::make_unique<RenderNode>(std::move(pass), "Barrier Node"));
+        // recorded on the queue of the node it's in front of, the wait for async compute moves to the barriers
+        RenderNode* barrierNode = barrierNodes.back().get();
+        barrierNode->queue = sortedNodes[sortIndex]->queue;
+        barrierNode->joinsAsyncCompute = std::exchange(sortedNodes[sortIndex]->joinsAsyncCompute, false);
+        sortedNodes.insert(sortedNodes.begin() + sortIndex, barrierNode);
+        barrierStats.barrierNodeCount += 1;
+    }
+
+    SPDLOG_INFO(
+        "render graph: {} barriers, {} split barriers on {} events, {} barrier nodes",
+        barrierStats.barrierCount,
+        barrierStats.splitBarrierCount,
+        splitEvents.size(),
+        barrierStats.barrierNodeCount
+    );
+}
+
+void Graph::ResourceOwner::Finalize(ResourcePool& pool)
+{
+    // only used by culled nodes
+    if (used.empty())
+        return;
+
+    if (request.type == ResourceType::Image)
+    {
+        // aliased images are already created by Graph::AliasImages
+        if (request.externalImage == nullptr && resourceRef.IsNull())
+        {
+            Gfx::Image* image = pool.CreateImage(request.imageCreateInfo, request.imageUsagesFlags);
+            image->SetName(request.name);
+            resourceRef.SetResource(image);
+        }
+        else if (request.externalImage != nullptr)
+        {
+            resourceRef.SetResource(request.externalImage);
+        }
+    }
+    else if (request.type == ResourceType::Buffer)
+    {
+        if (request.externalBuffer == nullptr)
+        {
+            Gfx::Buffer* buf = pool.CreateBuffer(request.bufferCreateInfo);
+            buf->SetDebugName(request.name.c_str());
+            resourceRef.SetResource(buf);
+        }
+        else
+        {
+            resourceRef.SetResource(request.externalBuffer);
+        }
+    }
+}
+
+// true if the use needs what the image held before the pass
+static bool LoadsContent(RenderPass& pass, ResourceHandle handle)
+{
+    for (auto& subpass : pass.GetSubpasses())
+    {
+        for (auto& color : subpass.colors)
+        {
+            if (color.handle == handle)
+                return color.loadOp == Gfx::AttachmentLoadOperation::Load;
+        }
+
+        if (subpass.depth.has_value() && subpass.depth->handle == handle)
+        {
+            return subpass.depth->loadOp == Gfx::AttachmentLoadOperation::Load ||
+                   subpass.depth->stencilLoadOp == Gfx::AttachmentLoadOperation::Load;
+        }
+    }
+
+    // not an attachment
+    return Gfx::HasReadAccessMask(pass.GetResourceDescription(handle).accessFlags);
+}
+
+void Graph::AliasImages(const std::vector<RenderNode*>& sortedNodes)
+{
+    struct Lifetime
+    {
+        ResourceOwner* owner;
+        SortIndex first;
+        SortIndex last;
+        // estimated, the driver knows the real size
+        uint64_t size;
+    };
+
+    const Gfx::ImageUsageFlags attachmentUsages =
+        Gfx::ImageUsage::ColorAttachment | Gfx::ImageUsage::DepthStencilAttachment;
+
+    std::vector<Lifetime> lifetimes;
+    for (auto& r : resourceOwners)
+    {
+        if (r->request.type != ResourceType::Image || r->request.externalImage != nullptr || r->exported ||
+            r->used.empty() || r->request.resizable)
+            continue;
+
+        // used is filled in sort order
+        auto [first, firstHandle] = r->used.front();
+        SortIndex last = r->used.back().first;
+
+        // the content is kept for the next frame or read back
+        if (LoadsContent(*sortedNodes[first]->pass, firstHandle) ||
+            (r->request.imageUsagesFlags & Gfx::ImageUsage::TransferSrc))
+            continue;
+
+        if (first == last && (r->request.imageUsagesFlags & ~attachmentUsages) == 0)
+        {
+            r->request.imageUsagesFlags |= Gfx::ImageUsage::Transient;
+            continue;
+        }
+
+        auto& desc = r->request.imageCreateInfo;
+        lifetimes.push_back({r.get(), first, last, (uint64_t)desc.GetByteSize() << (uint32_t)desc.multiSampling});
+    }
+
+    // largest first, an image goes to the first memory that has no image alive at the same time
+    std::stable_sort(
+        lifetimes.begin(),
+        lifetimes.end(),
+        [](const Lifetime& l, const Lifetime& r) { return l.size > r.size; }
+    );
+    std::vector<std::vector<Lifetime*>> groups;
+    for (Lifetime& l : lifetimes)
+    {
+        auto overlaps = [&l](Lifetime* o) { return l.first <= o->last && o->first <= l.last; };
+        auto group = std::find_if(
+            groups.begin(),
+            groups.end(),
+            [&overlaps](std::vector<Lifetime*>& g) { return std::none_of(g.begin(), g.end(), overlaps); }
+        );
+
+        if (group != groups.end())
+            group->push_back(&l);
+        else
+            groups.push_back({&l});
+    }
+
+    for (int aliasGroup = 0; aliasGroup < groups.size(); ++aliasGroup)
+    {
+        auto& group = groups[aliasGroup];
+        if (group.size() == 1)
+            continue;
+
+        std::sort(group.begin(), group.end(), [](Lifetime* l, Lifetime* r) { return l->first < r->first; });
+        std::vector<Gfx::ImageDescription> descs;
+        std::vector<Gfx::ImageUsageFlags> usages;
+        for (Lifetime* l : group)
+        {
+            descs.push_back(l->owner->request.imageCreateInfo);
+            usages.push_back(l->owner->request.imageUsagesFlags);
+        }
+
+        std::vector<Gfx::Image*> images = resourcePool.CreateAliasedImages(descs, usages);
+        for (size_t i = 0; i < group.size(); ++i)
+        {
+            ResourceOwner* owner = group[i]->owner;
+            images[i]->SetName(owner->request.name);
+            owner->resourceRef.SetResource(images[i]);
+            owner->aliasGroup = aliasGroup;
+            // the first image of a frame follows the last one of the previous frame
+            owner->aliasPredecessor = group[(i + group.size() - 1) % group.size()]->owner;
+        }
+    }
+}
+
+enum class AttachmentUse
+{
+    None,
+    Color,
+    Depth,
+    Input
+};
+
+// how the pass uses the handle as an attachment, range is set to the subresources it uses
+static AttachmentUse FindAttachment(RenderPass& pass, ResourceHandle handle, Gfx::ImageSubresourceRange& range)
+{
+    auto& subpasses = pass.GetSubpasses();
+    auto& gfxSubpasses = pass.GetGfxSubpasses();
+    for (size_t i = 0; i < subpasses.size(); ++i)
+    {
+        for (size_t j = 0; j < subpasses[i].colors.size(); ++j)
+        {
+            if (subpasses[i].colors[j].handle == handle)
+            {
+                range = gfxSubpasses[i].colors[j].imageView->GetSubresourceRange();
+                return AttachmentUse::Color;
+            }
+        }
+
+        if (subpasses[i].depth.has_value() && subpasses[i].depth->handle == handle)
+        {
+            range = gfxSubpasses[i].depth->imageView->GetSubresourceRange();
+            return AttachmentUse::Depth;
+        }
+
+        for (size_t j = 0; j < subpasses[i].inputs.size(); ++j)
+        {
+            if (subpasses[i].inputs[j].handle == handle)
+            {
+                range = gfxSubpasses[i].inputs[j].imageView->GetSubresourceRange();
+                return AttachmentUse::Input;
+            }
+        }
+    }
+
+    return AttachmentUse::None;
+}
+
+void Graph::MergeRenderPasses(const std::vector<RenderNode*>& sortedNodes, const std::vector<PlannedBarrier>& barriers)
+{
+    renderPassStats = {};
+    for (RenderNode* n : sortedNodes)
+    {
+        n->mergedWithPrevious = false;
+        // ResizeImages only finalizes some of the passes again
+        n->pass->SetMergedRenderPass(nullptr, 0);
+    }
+    // a render pass whose passes weren't finalized again is taken back, the rest is destroyed at the end
+    auto previousRenderPasses = std::move(mergedRenderPasses);
+    mergedRenderPasses.clear();
+
+    auto isRaster = [](RenderNode* n) { return n->queue == QueueType::Main && !n->pass->GetGfxSubpasses().empty(); };
+
+    // the extent and sample count of the framebuffer, zero if the pass has no color or depth attachment
+    auto framebuffer = [](RenderNode* n)
+    {
+        const RenderPass::GfxSubpass& subpass = n->pass->GetGfxSubpasses()[0];
+        const Gfx::RenderPass::Attachment* atta = nullptr;
+        if (!subpass.colors.empty())
+            atta = &subpass.colors[0];
+        else if (subpass.depth.has_value())
+            atta = &*subpass.depth;
+
+        if (atta == nullptr)
+            return std::make_tuple(0u, 0u, Gfx::MultiSampling::Sample_Count_1);
+
+        const Gfx::ImageDescription& desc = atta->imageView->GetImage().GetDescription();
+        uint32_t mip = atta->imageView->GetSubresourceRange().baseMipLevel;
+        return std::make_tuple(std::max(desc.width >> mip, 1u), std::max(desc.height >> mip, 1u), atta->multiSampling);
+    };
+
+    std::vector<std::vector<const PlannedBarrier*>> nodeBarriers(sortedNodes.size());
+    for (const PlannedBarrier& b : barriers)
+        nodeBarriers[b.dst].push_back(&b);
+
+    // every dependency on the passes in [first, n) has to be between attachments of the same subresources, a subpass
+    // can only read what the subpasses before it wrote at the same pixel
+    auto canMerge = [&](SortIndex first, SortIndex n)
+    {
+        RenderNode* node = sortedNodes[n];
+        RenderNode* prev = sortedNodes[n - 1];
+        if (!node->mergeable || !prev->mergeable || !isRaster(node) || !isRaster(prev) || node->joinsAsyncCompute)
+            return false;
+
+        auto extent = framebuffer(node);
+        if (std::get<0>(extent) == 0 || extent != framebuffer(sortedNodes[first]))
+            return false;
+
+        for (const PlannedBarrier* b : nodeBarriers[n])
+        {
+            if (b->src < first)
+                continue;
+
+            ResourceOwner* owner = b->owner;
+            if (!owner->resourceRef.IsType(ResourceType::Image))
+                return false;
+
+            auto& used = owner->used;
+            auto srcUse = std::find_if(used.begin(), used.end(), [b](auto& u) { return u.first == b->src; });
+            auto dstUse = std::find_if(used.begin(), used.end(), [n](auto& u) { return u.first == n; });
+            // an aliasing barrier, the previous use is of another image
+            if (srcUse == owner->used.end() || dstUse == owner->used.end())
+                return false;
+
+            Gfx::ImageSubresourceRange srcRange, dstRange;
+            AttachmentUse srcAttachment = FindAttachment(*sortedNodes[b->src]->pass, srcUse->second, srcRange);
+            AttachmentUse dstAttachment = FindAttachment(*node->pass, dstUse->second, dstRange);
+            if (srcAttachment != AttachmentUse::Color && srcAttachment != AttachmentUse::Depth)
+                return false;
+            if (dstAttachment == AttachmentUse::None || srcRange != dstRange)
+                return false;
+        }
+
+        return true;
+    };
+
+    // nothing reads the content after the render pass
+    auto isDiscardable = [&](ResourceOwner* owner, SortIndex last)
+    {
+        if (owner->exported || owner->request.externalImage != nullptr ||
+            (owner->request.imageUsagesFlags & Gfx::ImageUsage::TransferSrc) || owner->used.empty())
+            return false;
+
+        auto [first, firstHandle] = owner->used.front();
+        return owner->used.back().first <= last && !LoadsContent(*sortedNodes[first]->pass, firstHandle);
+    };
+
+    std::unordered_set<ResourceOwner*> discarded;
+    SortIndex nodeCount = sortedNodes.size();
+    SortIndex first = 0;
+    for (SortIndex i = 0; i < nodeCount; ++i)
+    {
+        if (i + 1 < nodeCount && mergeRenderPasses && canMerge(first, i + 1))
+        {
+            sortedNodes[i + 1]->mergedWithPrevious = true;
+            continue;
+        }
+
+        // [first, i] is a render pass
+        SortIndex last = i;
+        if (!isRaster(sortedNodes[first]))
+        {
+            first = i + 1;
+            continue;
+        }
+
+        bool changed = first != last;
+        std::vector<RenderPass::GfxSubpass> subpasses;
+        std::vector<uint64_t> keyFields;
+        for (SortIndex n = first; n <= last; ++n)
+        {
+            RenderPass& pass = *sortedNodes[n]->pass;
+            keyFields.push_back(pass.GetCompileId());
+            for (size_t s = 0; s < pass.GetSubpasses().size(); ++s)
+            {
+                const RenderPass::Subpass& subpass = pass.GetSubpasses()[s];
+                RenderPass::GfxSubpass& gfxSubpass = subpasses.emplace_back(pass.GetGfxSubpasses()[s]);
+
+                auto discard = [&](ResourceHandle handle, Gfx::RenderPass::Attachment& atta)
+                {
+                    auto owner = (ResourceOwner*)pass.GetResourceRef(handle)->GetOwner();
+                    if (!isDiscardable(owner, last))
+                        return;
+
+                    if (atta.storeOp != Gfx::AttachmentStoreOperation::DontCare ||
+                        atta.stencilStoreOp != Gfx::AttachmentStoreOperation::DontCare)
+                    {
+                        atta.storeOp = Gfx::AttachmentStoreOperation::DontCare;
+                        atta.stencilStoreOp = Gfx::AttachmentStoreOperation::DontCare;
+                        changed = true;
+                    }
+                    discarded.insert(owner);
+                };
+
+                for (size_t c = 0; c < subpass.colors.size(); ++c)
+                    discard(subpass.colors[c].handle, gfxSubpass.colors[c]);
+                if (subpass.depth.has_value())
+                    discard(subpass.depth->handle, *gfxSubpass.depth);
+
+                for (auto& atta : gfxSubpass.colors)
+                    keyFields.push_back((uint64_t)atta.storeOp);
+                if (gfxSubpass.depth.has_value())
+                {
+                    keyFields.push_back((uint64_t)gfxSubpass.depth->storeOp);
+                    keyFields.push_back((uint64_t)gfxSubpass.depth->stencilStoreOp);
                 }
             }
         }
+
+        renderPassStats.renderPassCount += 1;
+        renderPassStats.mergedPassCount += last - first;
+
+        if (changed)
+        {
+            // the compile ids change whenever a pass is finalized, the render pass can't refer to old image views
+            uint64_t key = XXH64(keyFields.data(), keyFields.size() * sizeof(uint64_t), 0);
+            std::unique_ptr<Gfx::RenderPass>& renderPass = mergedRenderPasses[key];
+            auto iter = previousRenderPasses.find(key);
+            if (iter != previousRenderPasses.end())
+                renderPass = std::move(iter->second);
+            else
+            {
+                renderPass = GetGfxDriver()->CreateRenderPass();
+                for (RenderPass::GfxSubpass& subpass : subpasses)
+                    renderPass->AddSubpass(subpass.colors, subpass.depth, subpass.inputs);
+            }
+
+            uint32_t subpassIndex = 0;
+            for (SortIndex n = first; n <= last; ++n)
+            {
+                sortedNodes[n]->pass->SetMergedRenderPass(renderPass.get(), subpassIndex);
+                subpassIndex += sortedNodes[n]->pass->GetGfxSubpasses().size();
+            }
+        }
+
+        if (first != last)
+        {
+            SPDLOG_DEBUG(
+                "render graph: \"{}\" to \"{}\" are recorded as {} subpasses of one render pass",
+                sortedNodes[first]->name,
+                sortedNodes[last]->name,
+                subpasses.size()
+            );
+        }
+
+        first = i + 1;
     }
+    renderPassStats.discardedAttachmentCount = discarded.size();
+}
+
+void Graph::CullNodes(std::vector<RenderNode*>& sortedNodes)
+{
+    culledNodes.clear();
 
-    // convert map barriers to vector barriers so that we can safely insert into sortedNodes
-    std::vector<std::pair<SortIndex, std::vector<Gfx::GPUBarrier>>> vecBarriers;
-    for (auto& b : barriers)
+    std::vector<std::vector<std::pair<ResourceOwner*, ResourceHandle>>> nodeUses(sortedNodes.size());
+    for (auto& r : resourceOwners)
     {
-        vecBarriers.emplace_back(b.first, b.second);
+        for (auto [sortIndex, handle] : r->used)
+            nodeUses[sortIndex].push_back({r.get(), handle});
     }
-    for (auto& b : vecBarriers)
+
+    auto accessFlags = [&sortedNodes](SortIndex sortIndex, ResourceHandle handle)
+    { return sortedNodes[sortIndex]->pass->GetResourceDescription(handle).accessFlags; };
+
+    std::vector<bool> live(sortedNodes.size(), false);
+    std::vector<SortIndex> liveNodes;
+    auto markLive = [&live, &liveNodes](SortIndex sortIndex)
     {
-        SortIndex sortIndex = b.first;
-        std::vector<Gfx::GPUBarrier>& gpuBarriers = b.second;
+        if (!live[sortIndex])
+        {
+            live[sortIndex] = true;
+            liveNodes.push_back(sortIndex);
+        }
+    };
 
-        std::unique_ptr<RenderPass> pass(new RenderPass(
-            [gpuBarriers](Gfx::CommandBuffer& cmd, auto& b, auto& c)
-            // cast to remove const
-            { cmd.Barrier((Gfx::GPUBarrier*)gpuBarriers.data(), gpuBarriers.size()); },
-            {},
-            {}
-        ));
+    // nodes whose work is seen outside of the graph. A node without resources can't be tracked, it's kept
+    for (SortIndex sortIndex = 0; sortIndex < (SortIndex)sortedNodes.size(); ++sortIndex)
+    {
+        if (sortedNodes[sortIndex] == outputNode || sortedNodes[sortIndex]->pass->GetResourceDescriptions().empty())
+            markLive(sortIndex);
+    }
+    for (auto& r : resourceOwners)
+    {
+        bool external = r->request.externalImage != nullptr || r->request.externalBuffer != nullptr;
+        if (!external && !r->exported)
+            continue;
 
-        barrierNodes.push_back(std::make_unique<RenderNode>(std::move(pass), "Barrier Node"));
+        for (auto [sortIndex, handle] : r->used)
+        {
+            if (Gfx::HasWriteAccessMask(accessFlags(sortIndex, handle)))
+                markLive(sortIndex);
+        }
+    }
 
-        sortedNodes.insert(sortedNodes.begin() + sortIndex, barrierNodes.back().get());
+    // nothing anchors the graph, keep every node
+    if (liveNodes.empty())
+        return;
 
-        for (auto& bb : vecBarriers)
+    // a live node needs the nodes that wrote what it reads, an attachment it loads is read too
+    for (size_t i = 0; i < liveNodes.size(); ++i)
+    {
+        SortIndex reader = liveNodes[i];
+        for (auto [owner, handle] : nodeUses[reader])
         {
-            if (bb.first >= sortIndex)
+            bool reads = Gfx::HasReadAccessMask(accessFlags(reader, handle)) ||
+                         LoadsContent(*sortedNodes[reader]->pass, handle);
+            if (sortedNodes[reader] != outputNode && !reads)
+                continue;
+
+            for (auto [sortIndex, writeHandle] : owner->used)
             {
-                bb.first += 1;
+                if (sortIndex < reader && Gfx::HasWriteAccessMask(accessFlags(sortIndex, writeHandle)))
+                    markLive(sortIndex);
             }
         }
     }
 
-    // copy
-    this->sortedNodes = sortedNodes;
+    if (liveNodes.size() == sortedNodes.size())
+        return;
 
-    auto queue = GetGfxDriver()->GetQueue(QueueType::Main).Get();
-    auto commandPool = GetGfxDriver()->CreateCommandPool({.queueFamilyIndex = queue->GetFamilyIndex()});
-    std::unique_ptr<Gfx::CommandBuffer> cmd =
-        commandPool->AllocateCommandBuffers(Gfx::CommandBufferType::Primary, 1)[0];
+    std::vector<SortIndex> newSortIndices(sortedNodes.size(), -1);
+    std::vector<RenderNode*> remaining;
+    for (SortIndex sortIndex = 0; sortIndex < (SortIndex)sortedNodes.size(); ++sortIndex)
+    {
+        RenderNode* n = sortedNodes[sortIndex];
+        if (live[sortIndex])
+        {
+            newSortIndices[sortIndex] = remaining.size();
+            n->sortIndex = remaining.size();
+            remaining.push_back(n);
+        }
+        else
+        {
+            n->sortIndex = -1;
+            culledNodes.push_back(n);
+        }
+    }
+
+    for (auto& r : resourceOwners)
+    {
+        std::erase_if(r->used, [&live](auto& u) { return !live[u.first]; });
+        for (auto& u : r->used)
+            u.first = newSortIndices[u.first];
+    }
 
-    cmd->Begin();
-    cmd->Barrier(initialLayoutTransfers.data(), initialLayoutTransfers.size());
-    cmd->End();
+    sortedNodes = std::move(remaining);
 
-    Gfx::CommandBuffer* cmdBufs[] = {cmd.get()};
-    GetGfxDriver()->QueueSubmit(queue, cmdBufs, {}, {}, {}, nullptr);
-    GetGfxDriver()->WaitForIdle();
+    SPDLOG_INFO("render graph: culled {} of {} passes", culledNodes.size(), culledNodes.size() + sortedNodes.size());
+    for (RenderNode* n : culledNodes)
+        SPDLOG_DEBUG("render graph: culled pass \"{}\"", n->name);
 }
 
-void Graph::ResourceOwner::Finalize(ResourcePool& pool)
+std::vector<std::vector<Graph::ResourceOwner*>> Graph::GetNodeOwners(const std::vector<RenderNode*>& sortedNodes)
 {
-    if (request.type == ResourceType::Image)
+    std::vector<std::vector<ResourceOwner*>> nodeOwners(sortedNodes.size());
+    for (auto& r : resourceOwners)
+    {
+        for (auto [sortIndex, handle] : r->used)
+            nodeOwners[sortIndex].push_back(r.get());
+    }
+    return nodeOwners;
+}
+
+void Graph::AssignQueues(const std::vector<RenderNode*>& sortedNodes)
+{
+    bool available = asyncCompute && GetGfxDriver()->GetQueue(QueueType::AsyncCompute) != nullptr;
+    std::vector<std::vector<ResourceOwner*>> nodeOwners = GetNodeOwners(sortedNodes);
+    for (size_t i = 0; i < sortedNodes.size(); ++i)
     {
-        if (request.externalImage == nullptr)
+        RenderNode* n = sortedNodes[i];
+        n->queue = QueueType::Main;
+        n->joinsAsyncCompute = false;
+        if (n->queueAffinity != QueueType::AsyncCompute || !available)
+            continue;
+
+        if (!n->pass->GetSubpasses().empty())
         {
-            Gfx::Image* image = pool.CreateImage(request.imageCreateInfo, request.imageUsagesFlags);
-            image->SetName(request.name);
-            resourceRef.SetResource(image);
+            SPDLOG_WARN("render graph: \"{}\" has subpasses, it can't run on the async compute queue", n->name);
+            continue;
         }
-        else
+
+        // resources are exclusive to the main queue family unless they have the AsyncCompute usage, the graph adds it
+        // to the ones it creates. External ones are created with their usages
+        bool shared = true;
+        for (ResourceOwner* owner : nodeOwners[i])
         {
-            resourceRef.SetResource(request.externalImage);
+            if (owner->request.externalImage != nullptr)
+                shared &= (owner->request.externalImage->GetUsages() & Gfx::ImageUsage::AsyncCompute) != 0;
+            if (owner->request.externalBuffer != nullptr)
+                shared &= HasFlag(owner->request.externalBuffer->GetUsages(), Gfx::BufferUsage::AsyncCompute);
+        }
+        if (!shared)
+        {
+            SPDLOG_WARN(
+                "render graph: \"{}\" uses an external resource without the AsyncCompute usage, it runs on the main "
+                "queue",
+                n->name
+            );
+            continue;
+        }
+
+        n->queue = QueueType::AsyncCompute;
+        for (ResourceOwner* owner : nodeOwners[i])
+        {
+            if (owner->request.type == ResourceType::Image)
+                owner->request.imageUsagesFlags |= Gfx::ImageUsage::AsyncCompute;
+            else if (owner->request.type == ResourceType::Buffer)
+                owner->request.bufferCreateInfo.usages |= Gfx::BufferUsage::AsyncCompute;
         }
     }
-    else if (request.type == ResourceType::Buffer)
+}
+
+void Graph::PlaceAsyncComputeJoins(const std::vector<RenderNode*>& sortedNodes)
+{
+    std::vector<std::vector<ResourceOwner*>> nodeOwners = GetNodeOwners(sortedNodes);
+
+    // the main queue waits in front of the first node that uses a resource the async compute work since the last wait
+    // used. Images sharing memory count as one resource. External and exported resources are read outside of the
+    // graph's connections, the main queue waits for them right away
+    std::unordered_set<ResourceOwner*> computeOwners;
+    std::unordered_set<int> computeAliasGroups;
+    bool computeUsesOutside = false;
+    for (size_t i = 0; i < sortedNodes.size(); ++i)
     {
-        if (request.externalBuffer == nullptr)
+        RenderNode* n = sortedNodes[i];
+        if (n->queue == QueueType::AsyncCompute)
         {
-            Gfx::Buffer* buf = pool.CreateBuffer(request.bufferCreateInfo);
-            buf->SetDebugName(request.name.c_str());
-            resourceRef.SetResource(buf);
+            for (ResourceOwner* owner : nodeOwners[i])
+            {
+                computeOwners.insert(owner);
+                if (owner->aliasGroup != -1)
+                    computeAliasGroups.insert(owner->aliasGroup);
+                computeUsesOutside |= owner->exported || owner->request.externalImage != nullptr ||
+                                      owner->request.externalBuffer != nullptr;
+            }
+            continue;
         }
-        else
+
+        if (computeOwners.empty())
+            continue;
+
+        bool join = computeUsesOutside;
+        for (ResourceOwner* owner : nodeOwners[i])
         {
-            resourceRef.SetResource(request.externalBuffer);
+            join |= computeOwners.contains(owner) ||
+                    (owner->aliasGroup != -1 && computeAliasGroups.contains(owner->aliasGroup));
+        }
+
+        if (join)
+        {
+            n->joinsAsyncCompute = true;
+            computeOwners.clear();
+            computeAliasGroups.clear();
+            computeUsesOutside = false;
+        }
+    }
+
+    queueTimeline.clear();
+    uint32_t asyncComputeCount = 0;
+    for (RenderNode* n : sortedNodes)
+    {
+        queueTimeline.push_back({n->name, n->queue, n->joinsAsyncCompute});
+        asyncComputeCount += n->queue == QueueType::AsyncCompute;
+    }
+
+    if (asyncComputeCount != 0)
+    {
+        SPDLOG_INFO(
+            "render graph: {} of {} passes run on the async compute queue",
+            asyncComputeCount,
+            sortedNodes.size()
+        );
+        for (auto& entry : queueTimeline)
+        {
+            SPDLOG_DEBUG(
+                "render graph: {:<14} {}{}",
+                entry.queue == QueueType::Main ? "main" : "async compute",
+                entry.name,
+                entry.join ? " (waits for async compute)" : ""
+            );
         }
     }
 }
 
+void Graph::UpdateMemoryStats()
+{
+    memoryStats = {};
+
+    std::unordered_map<int, uint64_t> aliasGroupSizes;
+    for (auto& r : resourceOwners)
+    {
+        if (r->request.type != ResourceType::Image || r->request.externalImage != nullptr || r->resourceRef.IsNull())
+            continue;
+
+        uint64_t size = ((Gfx::Image*)r->resourceRef.GetResource())->GetMemorySize();
+        memoryStats.renderTargetSize += size;
+        if (r->aliasGroup == -1)
+            memoryStats.aliasedRenderTargetSize += size;
+        else
+            aliasGroupSizes[r->aliasGroup] = std::max(aliasGroupSizes[r->aliasGroup], size);
+
+        if (r->request.imageUsagesFlags & Gfx::ImageUsage::Transient)
+            memoryStats.transientRenderTargetCount += 1;
+    }
+
+    for (auto& [aliasGroup, size] : aliasGroupSizes)
+        memoryStats.aliasedRenderTargetSize += size;
+
+    if (memoryStats.renderTargetSize != 0)
+    {
+        SPDLOG_INFO(
+            "render graph: render targets use {:.2f} MB, {:.2f} MB after aliasing, {} transient",
+            memoryStats.renderTargetSize / (1024.0 * 1024.0),
+            memoryStats.aliasedRenderTargetSize / (1024.0 * 1024.0),
+            memoryStats.transientRenderTargetCount
+        );
+    }
+}
+
 Graph::ResourceOwner* Graph::CreateResourceOwner(const RenderPass::ResourceDescription& request)
 {
     auto owner = std::make_unique<ResourceOwner>(request);
@@ -410,29 +1617,36 @@ Graph::ResourceOwner* Graph::CreateResourceOwner(const RenderPass::ResourceDescr
     return resourceOwners.back().get();
 }
 
-int Graph::GetDepthOfNode(RenderNode* node)
+std::vector<RenderNode*> Graph::SortNodes()
 {
-    if (node)
+    std::unordered_map<RenderNode*, size_t> indices;
+    for (size_t i = 0; i < nodes.size(); ++i)
+        indices[nodes[i].get()] = i;
+
+    std::vector<std::vector<size_t>> dependents(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i)
     {
-        if (node->depth != -1)
-            return node->depth;
-        else
+        for (auto& port : nodes[i]->inputPorts)
         {
-            int depth = 1;
-            for (auto& port : node->inputPorts)
-            {
-                RenderNode::Port* connected = port->connected;
-                if (connected)
-                {
-                    depth += GetDepthOfNode(connected->parent);
-                }
-            }
-
-            return depth;
+            // unconnected ports are reported by Preprocess
+            if (port->connected)
+                dependents[indices.at(port->connected->parent)].push_back(i);
         }
     }
 
-    return 0;
+    std::optional<std::vector<size_t>> order = TopologicalSort(dependents);
+    if (!order.has_value())
+        throw Errrors::GraphCompile("The graph has a cycle");
+
+    std::vector<RenderNode*> sortedNodes;
+    sortedNodes.reserve(nodes.size());
+    for (size_t index : order.value())
+    {
+        nodes[index]->sortIndex = sortedNodes.size();
+        sortedNodes.push_back(nodes[index].get());
+    }
+
+    return sortedNodes;
 }
 
 void Graph::Preprocess(RenderNode* n)
@@ -444,10 +1658,13 @@ void Graph::Preprocess(RenderNode* n)
     resourceHandles.assign(creationRequests.begin(), creationRequests.end());
     resourceHandles.insert(resourceHandles.end(), externalResources.begin(), externalResources.end());
 
-    for (auto handle : resourceHandles)
+    for (size_t i = 0; i < resourceHandles.size(); ++i)
     {
+        ResourceHandle handle = resourceHandles[i];
         auto& request = n->pass->GetResourceDescription(handle);
         ResourceOwner* owner = CreateResourceOwner(request);
+        if (i < creationRequests.size())
+            owner->creator = n->pass.get();
         n->pass->SetResourceRef(request.handle, &owner->resourceRef);
         owner->used.push_back({n->sortIndex, handle});
     }
@@ -473,17 +1690,114 @@ void Graph::Preprocess(RenderNode* n)
 
 void Graph::Compile() {}
 
+// fields are hashed one by one, ImageDescription has padding
+static uint64_t GetImageKey(
+    std::span<const Gfx::ImageDescription> imageDescs, std::span<const Gfx::ImageUsageFlags> usages, bool aliased
+)
+{
+    uint64_t key = aliased;
+    for (size_t i = 0; i < imageDescs.size(); ++i)
+    {
+        const Gfx::ImageDescription& desc = imageDescs[i];
+        uint32_t fields[] = {
+            desc.width,
+            desc.height,
+            (uint32_t)desc.format,
+            (uint32_t)desc.multiSampling,
+            desc.mipLevels,
+            desc.isCubemap,
+            usages[i],
+        };
+        key = XXH64(fields, sizeof(fields), key);
+    }
+
+    return key;
+}
+
 Gfx::Buffer* Graph::ResourcePool::CreateBuffer(const Gfx::Buffer::CreateInfo& createInfo)
 {
-    buffers.push_back(std::move(GetGfxDriver()->CreateBuffer(createInfo)));
+    uint64_t fields[] = {(uint64_t)createInfo.usages, createInfo.size, createInfo.visibleInCPU};
+    uint64_t key = XXH64(fields, sizeof(fields), 0);
+
+    auto iter = std::find_if(
+        retiredBuffers.begin(),
+        retiredBuffers.end(),
+        [key](PooledBuffer& p) { return p.key == key; }
+    );
+    if (iter != retiredBuffers.end())
+    {
+        buffers.push_back(std::move(*iter));
+        retiredBuffers.erase(iter);
+    }
+    else
+    {
+        buffers.push_back({key, GetGfxDriver()->CreateBuffer(createInfo)});
+    }
 
-    return buffers.back().get();
+    return buffers.back().buffer.get();
 }
+
 Gfx::Image* Graph::ResourcePool::CreateImage(const Gfx::ImageDescription& imageDesc, Gfx::ImageUsageFlags usages)
 {
-    images.push_back(std::move(GetGfxDriver()->CreateImage(imageDesc, usages)));
+    return AcquireImages({&imageDesc, 1}, {&usages, 1}, false)[0];
+}
+
+std::vector<Gfx::Image*> Graph::ResourcePool::CreateAliasedImages(
+    std::span<const Gfx::ImageDescription> imageDescs, std::span<const Gfx::ImageUsageFlags> usages
+)
+{
+    return AcquireImages(imageDescs, usages, true);
+}
+
+std::vector<Gfx::Image*> Graph::ResourcePool::AcquireImages(
+    std::span<const Gfx::ImageDescription> imageDescs, std::span<const Gfx::ImageUsageFlags> usages, bool aliased
+)
+{
+    uint64_t key = GetImageKey(imageDescs, usages, aliased);
+
+    auto iter = std::find_if(
+        retiredImages.begin(),
+        retiredImages.end(),
+        [key](PooledImages& p) { return p.key == key; }
+    );
+    if (iter != retiredImages.end())
+    {
+        images.push_back(std::move(*iter));
+        retiredImages.erase(iter);
+    }
+    else
+    {
+        PooledImages pooled{.key = key};
+        if (aliased)
+            pooled.images = GetGfxDriver()->CreateAliasedImages(imageDescs, usages);
+        else
+            pooled.images.push_back(GetGfxDriver()->CreateImage(imageDescs[0], usages[0]));
+
+        for (auto& image : pooled.images)
+            newImages.insert(image.get());
+        images.push_back(std::move(pooled));
+    }
+
+    std::vector<Gfx::Image*> acquired;
+    for (auto& image : images.back().images)
+        acquired.push_back(image.get());
+
+    return acquired;
+}
+
+void Graph::ResourcePool::Retire()
+{
+    std::move(images.begin(), images.end(), std::back_inserter(retiredImages));
+    std::move(buffers.begin(), buffers.end(), std::back_inserter(retiredBuffers));
+    images.clear();
+    buffers.clear();
+    newImages.clear();
+}
 
-    return images.back().get();
+void Graph::ResourcePool::ReleaseRetired()
+{
+    retiredImages.clear();
+    retiredBuffers.clear();
 }
 
 void Graph::ResourcePool::ReleaseBuffer(Gfx::Buffer* handle)
@@ -491,7 +1805,7 @@ void Graph::ResourcePool::ReleaseBuffer(Gfx::Buffer* handle)
     auto iter = std::find_if(
         buffers.begin(),
         buffers.end(),
-        [handle](std::unique_ptr<Gfx::Buffer>& p) { return p.get() == handle; }
+        [handle](PooledBuffer& p) { return p.buffer.get() == handle; }
     );
 
     if (iter != buffers.end())
@@ -500,12 +1814,20 @@ void Graph::ResourcePool::ReleaseBuffer(Gfx::Buffer* handle)
     }
 }
 
+// images sharing memory with the image are released with it
 void Graph::ResourcePool::ReleaseImage(Gfx::Image* handle)
 {
     auto iter = std::find_if(
         images.begin(),
         images.end(),
-        [handle](std::unique_ptr<Gfx::Image>& p) { return p.get() == handle; }
+        [handle](PooledImages& p)
+        {
+            return std::any_of(
+                p.images.begin(),
+                p.images.end(),
+                [handle](std::unique_ptr<Gfx::Image>& image) { return image.get() == handle; }
+            );
+        }
     );
 
     if (iter != images.end())
@@ -516,19 +1838,182 @@ void Graph::ResourcePool::ReleaseImage(Gfx::Image* handle)
 
 void Graph::Execute(Gfx::CommandBuffer& cmd)
 {
-    for (auto n : sortedNodes)
+    ProfileFrame* profile = BeginProfileFrame(cmd);
+    AsyncComputeFrame* frame = nullptr;
+    size_t frameCmdCount = 0;
+    Gfx::CommandBuffer* computeCmd = nullptr;
+    for (size_t i = 0; i < sortedNodes.size(); ++i)
+    {
+        RenderNode* n = sortedNodes[i];
+        if (n->queue == QueueType::Main)
+        {
+            if (n->joinsAsyncCompute)
+                cmd.Join();
+            ExecuteNode(cmd, i, profile);
+            continue;
+        }
+
+        // consecutive async compute nodes are one segment, it's forked from the main queue where it starts
+        if (computeCmd == nullptr)
+        {
+            if (frame == nullptr)
+            {
+                asyncComputeFrame = (asyncComputeFrame + 1) % FRAMES_IN_FLIGHT;
+                frame = &asyncComputeFrames[asyncComputeFrame];
+                if (frame->pool == nullptr)
+                {
+                    uint32_t queueFamilyIndex = GetGfxDriver()->GetQueue(QueueType::AsyncCompute)->GetFamilyIndex();
+                    frame->pool = GetGfxDriver()->CreateCommandPool({queueFamilyIndex});
+                }
+                frame->pool->ResetCommandPool();
+            }
+
+            if (frameCmdCount == frame->cmds.size())
+                frame->cmds.push_back(frame->pool->AllocateCommandBuffers(Gfx::CommandBufferType::Primary, 1)[0]);
+            computeCmd = frame->cmds[frameCmdCount++].get();
+            computeCmd->Begin();
+        }
+
+        ExecuteNode(*computeCmd, i, profile);
+
+        if (i + 1 == sortedNodes.size() || sortedNodes[i + 1]->queue != QueueType::AsyncCompute)
+        {
+            computeCmd->End();
+            cmd.Fork(*GetGfxDriver()->GetQueue(QueueType::AsyncCompute), *computeCmd);
+            computeCmd = nullptr;
+        }
+    }
+
+    if (profile)
+        profile->written = true;
+}
+
+void Graph::ExecuteNode(Gfx::CommandBuffer& cmd, size_t sortIndex, ProfileFrame* profile)
+{
+    RenderNode* n = sortedNodes[sortIndex];
+    if (profile == nullptr)
     {
         n->pass->Execute(cmd);
+        return;
+    }
+
+    // passes merged into one render pass are timed as one, a subpass may only execute secondary command buffers
+    if (!n->mergedWithPrevious)
+    {
+        uint32_t query = profile->firstQuery + profile->passes.size() * 2;
+        cmd.WriteTimestamp(*timestampPool, query, Gfx::PipelineStage::Top_Of_Pipe);
+        profile->passes.push_back({n->name, n->queue, 0});
+    }
+    else
+        profile->passes.back().name += " + " + n->name;
+
+    n->pass->Execute(cmd);
+
+    if (sortIndex + 1 == sortedNodes.size() || !sortedNodes[sortIndex + 1]->mergedWithPrevious)
+    {
+        uint32_t query = profile->firstQuery + profile->passes.size() * 2 - 1;
+        cmd.WriteTimestamp(*timestampPool, query, Gfx::PipelineStage::Bottom_Of_Pipe);
+    }
+}
+
+Graph::ProfileFrame* Graph::BeginProfileFrame(Gfx::CommandBuffer& cmd)
+{
+    if (!gpuProfiling || !GetGfxDriver()->GetGPUFeatures().timestamps || sortedNodes.empty())
+        return nullptr;
+
+    uint32_t frameQueryCount = sortedNodes.size() * 2;
+    if (timestampPool == nullptr || timestampPool->GetQueryCount() < frameQueryCount * PROFILE_FRAMES)
+    {
+        // only when the graph grew, the frames in flight may still write the old queries
+        GetGfxDriver()->WaitForIdle();
+        for (ProfileFrame& f : profileFrames)
+            f.written = false;
+        timestampPool = GetGfxDriver()->CreateTimestampQueryPool(std::max(frameQueryCount, 64u) * PROFILE_FRAMES);
+    }
+
+    profileFrame = (profileFrame + 1) % PROFILE_FRAMES;
+    ProfileFrame& frame = profileFrames[profileFrame];
+    if (frame.written)
+        ReadTimestamps(frame);
+
+    frame.firstQuery = profileFrame * (timestampPool->GetQueryCount() / PROFILE_FRAMES);
+    frame.passes.clear();
+    frame.written = false;
+    cmd.ResetQueryPool(*timestampPool, frame.firstQuery, frameQueryCount);
+    return &frame;
+}
+
+void Graph::ReadTimestamps(ProfileFrame& frame)
+{
+    std::vector<uint64_t> ticks(frame.passes.size() * 2);
+    // the GPU is still behind or the frame wasn't submitted, the last timings are kept
+    if (ticks.empty() || !timestampPool->GetResults(frame.firstQuery, ticks))
+        return;
+
+    float msPerTick = GetGfxDriver()->GetGPUFeatures().timestampPeriod / 1e6f;
+    uint64_t frameBegin = std::numeric_limits<uint64_t>::max();
+    uint64_t frameEnd = 0;
+    for (size_t i = 0; i < frame.passes.size(); ++i)
+    {
+        uint64_t begin = ticks[i * 2];
+        uint64_t end = ticks[i * 2 + 1];
+        frame.passes[i].gpuTime = end > begin ? (end - begin) * msPerTick : 0;
+        if (frame.passes[i].queue == QueueType::Main)
+        {
+            frameBegin = std::min(frameBegin, begin);
+            frameEnd = std::max(frameEnd, end);
+        }
+    }
+
+    passTimings = frame.passes;
+    gpuFrameTime = frameEnd > frameBegin ? (frameEnd - frameBegin) * msPerTick : 0;
+    profiledFrameCount += 1;
+
+    if (timingCsv.is_open())
+    {
+        for (PassTiming& p : passTimings)
+        {
+            const char* queue = p.queue == QueueType::Main ? "main" : "async compute";
+            timingCsv << profiledFrameCount << ",\"" << p.name << "\"," << queue << "," << p.gpuTime << "\n";
+        }
+        timingCsv.flush();
+    }
+}
+
+void Graph::SetTimingCsv(const std::filesystem::path& path)
+{
+    timingCsv.close();
+    if (path.empty())
+        return;
+
+    timingCsv.open(path, std::ios::trunc);
+    if (!timingCsv)
+    {
+        SPDLOG_WARN("render graph: can't write the pass timings to {}", path.string());
+        return;
     }
+    timingCsv << "frame,pass,queue,ms\n";
+}
+
+void Graph::Export(RenderNode* node, ResourceHandle handle)
+{
+    exports.emplace_back(node, handle);
 }
 
 void Graph::Clear()
 {
+    KeepCompiledPasses();
     nodes.clear();
+    exports.clear();
+    outputNode = nullptr;
+    culledNodes.clear();
     sortedNodes.clear();
+    processedNodes.clear();
     barrierNodes.clear();
+    plannedBarriers.clear();
     resourceOwners.clear();
-    resourcePool.Clear();
+    // kept until the next Process, the rebuilt graph reuses what didn't change
+    resourcePool.Retire();
 }
 
 NodeBuilder& NodeBuilder::InputTexture(
@@ -629,10 +2114,10 @@ NodeBuilder& NodeBuilder::AllocateRT(
         .type = ResourceType::Image,
         .accessFlags = Gfx::AccessMask::None,          // access flag is filled later
         .stageFlags = Gfx::PipelineStage::Top_Of_Pipe, // usage is filled later
-        .imageUsagesFlags = extraUsages |
-                            (Gfx::IsDepthStencilFormat(format) ? Gfx::ImageUsage::DepthStencilAttachment
-                                                               : Gfx::ImageUsage::ColorAttachment) |
-                            Gfx::ImageUsage::Texture,
+        // the passes reading it add their usages, an image only drawn to in one pass can be transient
+        .imageUsagesFlags =
+            extraUsages | (Gfx::IsDepthStencilFormat(format) ? Gfx::ImageUsage::DepthStencilAttachment
+                                                             : Gfx::ImageUsage::ColorAttachment),
         .imageLayout = Gfx::IsDepthStencilFormat(format)
                            ? Gfx::ImageLayout::Depth_Stencil_Attachment
                            : Gfx::ImageLayout::Color_Attachment, // changed later in AddColor
@@ -774,6 +2259,54 @@ NodeBuilder& NodeBuilder::AddDepthStencil(
     return *this;
 }
 
+NodeBuilder& NodeBuilder::AddInputAttachment(
+    ResourceHandle handle, Gfx::ImageAspectFlags aspectMask, uint32_t mip, uint32_t arrayLayer
+)
+{
+    auto iter = descs.find(handle);
+    if (iter == descs.end())
+    {
+        SPDLOG_ERROR("No such resources");
+        return *this;
+    }
+
+    if (subpasses.empty())
+    {
+        subpasses.push_back(RenderPass::Subpass{});
+    }
+
+    auto& desc = iter->second;
+    desc.stageFlags = Gfx::PipelineStage::Fragment_Shader;
+    desc.accessFlags = Gfx::AccessMask::Input_Attachment_Read;
+    desc.imageUsagesFlags |= Gfx::ImageUsage::InputAttachment;
+    desc.imageLayout = (aspectMask & Gfx::ImageAspect::Color) != Gfx::ImageAspect::None
+                           ? Gfx::ImageLayout::Shader_Read_Only
+                           : Gfx::ImageLayout::Depth_Stencil_Read_Only;
+
+    RenderPass::Attachment att{
+        .handle = handle,
+        .imageView =
+            RenderPass::ImageView{
+                .imageViewType = Gfx::ImageViewType::Image_2D,
+                .subresourceRange =
+                    {
+                        .aspectMask = aspectMask,
+                        .baseMipLevel = mip,
+                        .levelCount = 1,
+                        .baseArrayLayer = arrayLayer,
+                        .layerCount = 1,
+                    },
+            },
+        .multiSampling = desc.imageCreateInfo.multiSampling,
+        .loadOp = Gfx::AttachmentLoadOperation::Load,
+        .storeOp = Gfx::AttachmentStoreOperation::Store,
+    };
+
+    subpasses[subpassesIndex].inputs.push_back(att);
+
+    return *this;
+}
+
 NodeBuilder& NodeBuilder::AllocateBuffer(std::string_view name, ResourceHandle handle, size_t size)
 {
     // not implemented
@@ -791,6 +2324,8 @@ RenderNode* NodeBuilder::Finish()
     }
     auto node = graph->AddNode(execFunc, resourceDescriptions, subpasses);
     node->SetName(name);
+    node->SetQueueAffinity(queueAffinity);
+    node->SetMergeable(mergeable);
     return node;
 }
 
@@ -1,11 +1,15 @@
 #pragma once
 #include "GfxDriver/CommandBuffer.hpp"
+#include "GfxDriver/CommandPool.hpp"
 #include "RenderPass.hpp"
+#include <filesystem>
+#include <fstream>
 #include <list>
 #include <memory>
 #include <nlohmann/json.hpp>
 #include <span>
 #include <string_view>
+#include <unordered_set>
 #include <vector>
 
 namespace Engine::RenderGraph
@@ -29,6 +33,20 @@ public:
         this->name = name;
     }
 
+    // the queue the pass prefers. An async compute pass runs on the main queue if it has subpasses or the device has
+    // no async compute queue
+    void SetQueueAffinity(QueueType queue)
+    {
+        queueAffinity = queue;
+    }
+
+    // the pass always begins and ends its render pass once and records nothing outside of it, so the graph can record
+    // it as the later subpasses of the render pass of the pass before it
+    void SetMergeable(bool mergeable)
+    {
+        this->mergeable = mergeable;
+    }
+
 private:
     class Port
     {
@@ -46,9 +64,16 @@ private:
     std::vector<std::unique_ptr<Port>> inputPorts;
     std::vector<std::unique_ptr<Port>> outputPorts;
 
+    QueueType queueAffinity = QueueType::Main;
+    bool mergeable = false;
+
     // used by Graph
-    int depth = -1;
     SortIndex sortIndex = -1;
+    QueueType queue = QueueType::Main;
+    // the main queue waits for the async compute work forked before the node
+    bool joinsAsyncCompute = false;
+    // recorded in the render pass of the node before it
+    bool mergedWithPrevious = false;
 
     friend class Graph;
 };
@@ -173,8 +198,30 @@ public:
         uint32_t arrayLayer = 0
     );
 
+    // read the image at the pixel being drawn with subpassInput. Merged with the pass that wrote it the image stays in
+    // tile memory
+    NodeBuilder& AddInputAttachment(
+        ResourceHandle handle,
+        Gfx::ImageAspectFlags aspectMask = Gfx::ImageAspect::Color,
+        uint32_t mip = 0,
+        uint32_t arrayLayer = 0
+    );
+
     NodeBuilder& NextSubpass();
 
+    NodeBuilder& SetQueueAffinity(QueueType queue)
+    {
+        queueAffinity = queue;
+        return *this;
+    }
+
+    // see RenderNode::SetMergeable
+    NodeBuilder& SetMergeable(bool mergeable)
+    {
+        this->mergeable = mergeable;
+        return *this;
+    }
+
     // automatically called when this NodeBuilder is destroied
     RenderNode* Finish();
 
@@ -186,6 +233,8 @@ private:
     Graph* graph;
     bool finished = false;
     RenderPass::ExecutionFunc execFunc;
+    QueueType queueAffinity = QueueType::Main;
+    bool mergeable = false;
 };
 
 class Graph
@@ -390,39 +439,252 @@ public:
 
     static bool Connect(RenderNode* src, ResourceHandle srcHandle, RenderNode* dst, ResourceHandle dstHandle);
 
+    // order the nodes so that every node comes after the nodes it reads from, throws Errrors::GraphCompile if the
+    // connections form a cycle. Called by Process
+    std::vector<RenderNode*> SortNodes();
+
+    // the resource is read outside of the graph's connections (bound globally, displayed, read back), Process won't
+    // alias its memory with other resources
+    void Export(RenderNode* node, ResourceHandle handle);
+
+    struct MemoryStats
+    {
+        // render targets created by the graph if every one had its own memory
+        uint64_t renderTargetSize = 0;
+        uint64_t aliasedRenderTargetSize = 0;
+        uint32_t transientRenderTargetCount = 0;
+    };
+
+    // valid after Process
+    const MemoryStats& GetMemoryStats()
+    {
+        return memoryStats;
+    }
+
+    struct BarrierStats
+    {
+        // barriers recorded right in front of the node that needs them
+        uint32_t barrierCount = 0;
+        // barriers recorded as event waits, the producer signals the event as soon as it's done
+        uint32_t splitBarrierCount = 0;
+        uint32_t barrierNodeCount = 0;
+        // dependencies of the conservative barriers the optimized ones miss, only counted with SetValidateBarriers
+        uint32_t validationErrorCount = 0;
+    };
+
+    // valid after Process
+    const BarrierStats& GetBarrierStats()
+    {
+        return barrierStats;
+    }
+
+    struct CompileStats
+    {
+        // passes that created their render pass and image views
+        uint32_t finalizedPassCount = 0;
+        // passes that took back what they created in the last Process, their attachments didn't change
+        uint32_t reusedPassCount = 0;
+        // nothing the barriers depend on changed since the last Process
+        bool reusedBarrierPlan = false;
+    };
+
+    // valid after Process
+    const CompileStats& GetCompileStats()
+    {
+        return compileStats;
+    }
+
+    struct PlannedBarrierEntry
+    {
+        // the node of the previous use, empty if it's in the last frame
+        std::string src;
+        // the node the barrier is recorded in front of, the first pass of a merged render pass
+        std::string dst;
+        Gfx::GPUBarrier barrier;
+    };
+
+    // the barriers between the nodes in the order they are recorded, valid after Process
+    const std::vector<PlannedBarrierEntry>& GetPlannedBarriers()
+    {
+        return plannedBarriers;
+    }
+
+    // barriers with other nodes between the producer and the consumer wait on an event instead, on by default
+    void SetSplitBarriers(bool split)
+    {
+        splitBarriers = split;
+    }
+
+    // Process also plans the barriers without narrowing their masks and reports where the optimized barriers don't
+    // cover them
+    void SetValidateBarriers(bool validate)
+    {
+        validateBarriers = validate;
+    }
+
+    // nodes Process found no use for, they don't get resources and are not executed
+    const std::vector<RenderNode*>& GetCulledNodes()
+    {
+        return culledNodes;
+    }
+
+    // nodes with the async compute affinity run on the async compute queue when the device has one, on by default
+    void SetAsyncCompute(bool enable)
+    {
+        asyncCompute = enable;
+    }
+
+    struct QueueTimelineEntry
+    {
+        std::string name;
+        QueueType queue;
+        // the main queue waits for the async compute work before the node
+        bool join;
+    };
+
+    // the nodes in the order they are recorded and the queues they run on, valid after Process
+    const std::vector<QueueTimelineEntry>& GetQueueTimeline()
+    {
+        return queueTimeline;
+    }
+
+    // adjacent mergeable passes drawing to the same extent, where a pass only reads the attachments of the passes
+    // before it at the pixel it draws, are recorded as the subpasses of one render pass. On by default
+    void SetMergeRenderPasses(bool merge)
+    {
+        mergeRenderPasses = merge;
+    }
+
+    struct RenderPassStats
+    {
+        // render passes recorded in a frame
+        uint32_t renderPassCount = 0;
+        // passes recorded as a later subpass of another pass' render pass
+        uint32_t mergedPassCount = 0;
+        // attachments whose content isn't stored to memory because nothing reads it after the render pass
+        uint32_t discardedAttachmentCount = 0;
+    };
+
+    // valid after Process
+    const RenderPassStats& GetRenderPassStats()
+    {
+        return renderPassStats;
+    }
+
+    // wrap every pass in GPU timestamps, on by default when the device supports them
+    void SetGpuProfiling(bool enable)
+    {
+        gpuProfiling = enable;
+    }
+
+    struct PassTiming
+    {
+        // passes merged into one render pass are timed together, their names are joined
+        std::string name;
+        QueueType queue;
+        // milliseconds
+        float gpuTime;
+    };
+
+    // the passes of the latest frame whose timestamps were read back, in execution order. The timestamps are read
+    // when their queries are reused PROFILE_FRAMES frames later, so nothing waits for the GPU
+    const std::vector<PassTiming>& GetPassTimings()
+    {
+        return passTimings;
+    }
+
+    // milliseconds from the start of the first pass to the end of the last one on the main queue, 0 until the first
+    // timestamps are read back
+    float GetGpuFrameTime()
+    {
+        return gpuFrameTime;
+    }
+
+    // append the timings of every frame read back to a csv file, one "frame,pass,queue,ms" row per pass. An empty
+    // path stops writing
+    void SetTimingCsv(const std::filesystem::path& path);
+
     // After all nodes are configured, call process once before calling Execute
     // the graph handles the transition of swapchain image, set the resourceHandle of the presentNode to the output of
     // the swapchain image
     void Process(RenderNode* presentNode, ResourceHandle resourceHandle);
     virtual void Process();
 
+    // recreate the images whose extent was changed with RenderPass::SetImageExtent since Process and the render passes
+    // that use them, without planning the graph again. The old images are destroyed once the frame in flight finished.
+    // Returns false if the graph has to be processed again
+    bool ResizeImages();
+
     // used before Execute to override external resource state that can't be tracked by the graph
     void OverrideResourceState();
 
     // execute all nodes for once
     virtual void Execute(Gfx::CommandBuffer& cmd);
 
+    // remove all nodes. The resources, the render passes of the passes and the barrier plan are kept, the next Process
+    // reuses what didn't change
     void Clear();
 
 private:
+    // resources of the previous Process are retired instead of destroyed. A request with the same description takes
+    // a retired resource back, so recompiling a graph only creates the resources that changed
     class ResourcePool
     {
     public:
         Gfx::Buffer* CreateBuffer(const Gfx::Buffer::CreateInfo& createInfo);
         Gfx::Image* CreateImage(const Gfx::ImageDescription& imageDesc, Gfx::ImageUsageFlags usages);
+        std::vector<Gfx::Image*> CreateAliasedImages(
+            std::span<const Gfx::ImageDescription> imageDescs, std::span<const Gfx::ImageUsageFlags> usages
+        );
 
         void ReleaseBuffer(Gfx::Buffer* handle);
         void ReleaseImage(Gfx::Image* handle);
 
+        // resources in use become candidates for reuse
+        void Retire();
+        // destroy the retired resources that weren't reused
+        void ReleaseRetired();
+
+        // true if the image was created rather than reused since the last Retire
+        bool IsNew(Gfx::Image* image)
+        {
+            return newImages.contains(image);
+        }
+
         void Clear()
         {
             images.clear();
             buffers.clear();
+            retiredImages.clear();
+            retiredBuffers.clear();
+            newImages.clear();
         }
 
     private:
-        std::vector<std::unique_ptr<Gfx::Image>> images;
-        std::vector<std::unique_ptr<Gfx::Buffer>> buffers;
+        // a single image or images sharing one memory, aliased images are only reused together
+        struct PooledImages
+        {
+            uint64_t key;
+            std::vector<std::unique_ptr<Gfx::Image>> images;
+        };
+
+        struct PooledBuffer
+        {
+            uint64_t key;
+            std::unique_ptr<Gfx::Buffer> buffer;
+        };
+
+        std::vector<PooledImages> images;
+        std::vector<PooledImages> retiredImages;
+        std::vector<PooledBuffer> buffers;
+        std::vector<PooledBuffer> retiredBuffers;
+        std::unordered_set<Gfx::Image*> newImages;
+
+        std::vector<Gfx::Image*> AcquireImages(
+            std::span<const Gfx::ImageDescription> imageDescs,
+            std::span<const Gfx::ImageUsageFlags> usages,
+            bool aliased
+        );
     };
 
     // keep track of where the resource is used in the node, so that we can create resource barriers for them
@@ -436,8 +698,17 @@ private:
         ResourceRef resourceRef;
 
         RenderPass::ResourceDescription request;
+        // the pass that requested the resource, nullptr for external resources
+        RenderPass* creator = nullptr;
 
         std::vector<std::pair<SortIndex, ResourceHandle>> used;
+
+        bool exported = false;
+        // index of the memory the image shares with other images, -1 if it has its own
+        int aliasGroup = -1;
+        // the image in the same memory that is used last before this one, its content is overwritten by it
+        ResourceOwner* aliasPredecessor = nullptr;
+
         void Finalize(ResourcePool& pool);
     };
 
@@ -447,16 +718,149 @@ private:
     void Compile();
     ResourceOwner* CreateResourceOwner(const RenderPass::ResourceDescription& request);
 
-    static int GetDepthOfNode(RenderNode* node);
+    // find images whose lifetimes don't overlap and let them share memory, attachments that stay inside one pass
+    // become transient. Called between Preprocess and ResourceOwner::Finalize
+    void AliasImages(const std::vector<RenderNode*>& sortedNodes);
+
+    // remove the nodes whose results don't reach the output node, an exported resource or an external resource.
+    // Called after Preprocess, used of the resource owners are remapped to the remaining nodes
+    void CullNodes(std::vector<RenderNode*>& sortedNodes);
+    void UpdateMemoryStats();
+
+    // the resource owners every node uses
+    std::vector<std::vector<ResourceOwner*>> GetNodeOwners(const std::vector<RenderNode*>& sortedNodes);
+    // pick the queue of every node, the resources async compute nodes use get the AsyncCompute usage. Called after
+    // CullNodes, before the resources are created
+    void AssignQueues(const std::vector<RenderNode*>& sortedNodes);
+    // pick the nodes the main queue waits for the async compute work in front of. Called after AliasImages
+    void PlaceAsyncComputeJoins(const std::vector<RenderNode*>& sortedNodes);
+
+    // a barrier in front of the node at dst. src is the node of the previous use, -1 if it's in the last frame
+    struct PlannedBarrier
+    {
+        SortIndex src;
+        SortIndex dst;
+        ResourceOwner* owner;
+        Gfx::GPUBarrier barrier;
+    };
+
+    // the barriers between the uses of every resource. narrow reduces the masks to what the accesses need, the
+    // conservative plan is only used to validate the narrowed one
+    std::vector<PlannedBarrier> PlanBarriers(const std::vector<RenderNode*>& sortedNodes, bool narrow);
+    // combine the barriers on the same resource in front of the same node
+    static void MergeBarriers(std::vector<PlannedBarrier>& barriers);
+    // barriers recorded on the async compute queue can't name graphics stages, the semaphore between the queues
+    // covers those dependencies
+    static void FitBarriersToQueues(const std::vector<RenderNode*>& sortedNodes, std::vector<PlannedBarrier>& barriers);
+    // merge adjacent passes into the subpasses of one render pass, the attachments nothing reads after their render
+    // pass aren't stored. Called after the passes are finalized, barriers are the planned ones
+    void MergeRenderPasses(const std::vector<RenderNode*>& sortedNodes, const std::vector<PlannedBarrier>& barriers);
+    // dependencies inside a merged render pass are its subpass dependencies, the barriers from outside of it move in
+    // front of it
+    static void FitBarriersToRenderPasses(
+        const std::vector<RenderNode*>& sortedNodes, std::vector<PlannedBarrier>& barriers
+    );
+    bool IsSplit(const std::vector<RenderNode*>& sortedNodes, const PlannedBarrier& barrier);
+    // returns the number of problems found
+    uint32_t ValidateBarriers(
+        const std::vector<RenderNode*>& sortedNodes,
+        const std::vector<PlannedBarrier>& conservative,
+        const std::vector<PlannedBarrier>& optimized
+    );
+    void InsertBarrierNodes(std::vector<RenderNode*>& sortedNodes, const std::vector<PlannedBarrier>& barriers);
+    // keep what the passes created in Finalize so that the next Process can give it back to passes that didn't change
+    void KeepCompiledPasses();
+    // hash of everything the barriers are planned from
+    uint64_t HashBarrierPlan(const std::vector<RenderNode*>& sortedNodes);
+    // the part of Process after the resources are created. Finalizes the passes using an image in changed, every pass
+    // if finalizeAll, moves the images in changed to the layout of their last use and inserts the barriers
+    void FinalizePasses(
+        std::vector<RenderNode*> sortedNodes, const std::vector<ResourceOwner*>& changed, bool finalizeAll
+    );
+
 
 protected:
     // rendering related stuffs, maybe factor out of Graph?
 private:
     std::vector<std::unique_ptr<RenderNode>> nodes;
     std::vector<RenderNode*> sortedNodes;
+    // sortedNodes without the barrier nodes, the sort indices of the resource owners index it
+    std::vector<RenderNode*> processedNodes;
     std::vector<std::unique_ptr<RenderNode>> barrierNodes;
     std::vector<std::unique_ptr<ResourceOwner>> resourceOwners;
+    std::vector<std::pair<RenderNode*, ResourceHandle>> exports;
+    // the present node added by Process(presentNode, resourceHandle)
+    RenderNode* outputNode = nullptr;
+    std::vector<RenderNode*> culledNodes;
     ResourcePool resourcePool;
+    MemoryStats memoryStats;
+    BarrierStats barrierStats;
+    std::vector<PlannedBarrierEntry> plannedBarriers;
+    bool splitBarriers = true;
+    bool validateBarriers = false;
+    // events of split barriers, kept across Process
+    std::vector<std::unique_ptr<Gfx::Event>> events;
+    bool asyncCompute = true;
+    std::vector<QueueTimelineEntry> queueTimeline;
+    bool mergeRenderPasses = true;
+    RenderPassStats renderPassStats;
+    // render passes of merged passes and of passes whose attachments are discarded, by the compile ids of their
+    // passes and the discarded attachments
+    std::unordered_map<uint64_t, std::unique_ptr<Gfx::RenderPass>> mergedRenderPasses;
+    // what the passes of the last Process created, by compile key
+    std::unordered_map<uint64_t, std::vector<RenderPass::Compiled>> compiledPasses;
+    // the barriers of the last Process, the owners of the barriers are kept as indices into resourceOwners
+    struct CompiledBarrierPlan
+    {
+        uint64_t hash = 0;
+        // the input of MergeRenderPasses
+        std::vector<PlannedBarrier> fittedToQueues;
+        std::vector<size_t> fittedToQueuesOwners;
+        std::vector<PlannedBarrier> barriers;
+        std::vector<size_t> barrierOwners;
+        uint32_t validationErrorCount = 0;
+    };
+    CompiledBarrierPlan compiledBarrierPlan;
+    CompileStats compileStats;
+    // records the initial layouts of new images, reused once the previous submission finished
+    std::unique_ptr<Gfx::CommandPool> layoutTransferPool;
+    std::unique_ptr<Gfx::CommandBuffer> layoutTransferCmd;
+    std::unique_ptr<Gfx::Fence> layoutTransferFence;
+
+    // a frame is recorded while the previous one may still execute
+    static constexpr uint32_t FRAMES_IN_FLIGHT = 2;
+    // command buffers of the async compute segments of a frame
+    struct AsyncComputeFrame
+    {
+        std::unique_ptr<Gfx::CommandPool> pool;
+        std::vector<std::unique_ptr<Gfx::CommandBuffer>> cmds;
+    };
+    AsyncComputeFrame asyncComputeFrames[FRAMES_IN_FLIGHT];
+    uint32_t asyncComputeFrame = 0;
+
+    // the queries of a frame are reused after every frame in flight finished
+    static constexpr uint32_t PROFILE_FRAMES = FRAMES_IN_FLIGHT + 1;
+    // a begin and an end timestamp per timed range
+    struct ProfileFrame
+    {
+        uint32_t firstQuery = 0;
+        std::vector<PassTiming> passes;
+        bool written = false;
+    };
+    bool gpuProfiling = true;
+    std::unique_ptr<Gfx::QueryPool> timestampPool;
+    ProfileFrame profileFrames[PROFILE_FRAMES];
+    uint32_t profileFrame = 0;
+    std::vector<PassTiming> passTimings;
+    float gpuFrameTime = 0;
+    uint64_t profiledFrameCount = 0;
+    std::ofstream timingCsv;
+
+    // read back the frame that used the queries last and reset them, nullptr if the frame isn't profiled
+    ProfileFrame* BeginProfileFrame(Gfx::CommandBuffer& cmd);
+    // execute the pass at sortIndex and time it if profile isn't nullptr
+    void ExecuteNode(Gfx::CommandBuffer& cmd, size_t sortIndex, ProfileFrame* profile);
+    void ReadTimestamps(ProfileFrame& frame);
 }; // namespace Engine::RenderGraph
    //
    //
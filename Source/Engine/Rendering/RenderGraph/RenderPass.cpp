@@ -1,11 +1,15 @@
 #include "RenderPass.hpp"
+#include "ThirdParty/xxHash/xxhash.h"
+#include <utility>
 
 namespace Engine::RenderGraph
 {
+// ids of what Finalize created, never reused
+static uint64_t nextCompileId = 1;
 
 const std::vector<Gfx::ImageView*>& RenderPass::GetImageViews(Gfx::Image* image)
 {
-    return imageToImageViews[image];
+    return compiled.imageToImageViews[image];
 }
 
 RenderPass::RenderPass(
@@ -44,74 +48,120 @@ RenderPass::RenderPass(
     resourceRefs.reserve(resourceDescs.size());
 }
 
-void RenderPass::Finalize()
+uint64_t RenderPass::GetCompileKey()
 {
-    renderPass = GetGfxDriver()->CreateRenderPass();
-
-    for (auto& subpass : subpasses)
+    std::vector<uint64_t> fields;
+    auto addAttachment = [this, &fields](const Attachment& atta)
     {
-        std::vector<Gfx::RenderPass::Attachment> colors;
-
-        for (Attachment colorAtta : subpass.colors)
+        fields.push_back((uint64_t)resourceRefs[atta.handle]->GetResource());
+        fields.push_back(atta.imageView.has_value());
+        if (atta.imageView.has_value())
         {
-            Gfx::Image* image = (Gfx::Image*)resourceRefs[colorAtta.handle]->GetResource();
-
-            Gfx::ImageView* imageView = nullptr;
-            if (colorAtta.imageView.has_value())
-            {
-                auto newImageView = GetGfxDriver()->CreateImageView({
-                    .image = *image,
-                    .imageViewType = colorAtta.imageView->imageViewType,
-                    .subresourceRange = colorAtta.imageView->subresourceRange,
-                });
-                imageView = newImageView.get();
-                imageViews.push_back(std::move(newImageView));
-            }
-            else
-                imageView = &image->GetDefaultImageView();
-
-            colors.push_back(
-                {.imageView = imageView,
-                 .multiSampling = colorAtta.multiSampling,
-                 .loadOp = colorAtta.loadOp,
-                 .storeOp = colorAtta.storeOp,
-                 .stencilLoadOp = colorAtta.stencilLoadOp,
-                 .stencilStoreOp = colorAtta.stencilStoreOp}
-            );
-            imageToImageViews[image].push_back(imageView);
+            const Gfx::ImageSubresourceRange& range = atta.imageView->subresourceRange;
+            fields.push_back((uint64_t)atta.imageView->imageViewType);
+            fields.push_back((uint64_t)range.aspectMask);
+            fields.push_back(range.baseMipLevel);
+            fields.push_back(range.levelCount);
+            fields.push_back(range.baseArrayLayer);
+            fields.push_back(range.layerCount);
         }
+        fields.push_back((uint64_t)atta.multiSampling);
+        fields.push_back((uint64_t)atta.loadOp);
+        fields.push_back((uint64_t)atta.storeOp);
+        fields.push_back((uint64_t)atta.stencilLoadOp);
+        fields.push_back((uint64_t)atta.stencilStoreOp);
+    };
+
+    for (const Subpass& subpass : subpasses)
+    {
+        // the attachment counts separate the attachments of the subpasses
+        fields.push_back(subpass.colors.size());
+        for (const Attachment& colorAtta : subpass.colors)
+            addAttachment(colorAtta);
 
-        std::optional<Gfx::RenderPass::Attachment> depth = std::nullopt;
+        fields.push_back(subpass.depth.has_value());
         if (subpass.depth.has_value())
+            addAttachment(*subpass.depth);
+
+        fields.push_back(subpass.inputs.size());
+        for (const Attachment& inputAtta : subpass.inputs)
+            addAttachment(inputAtta);
+    }
+
+    return XXH64(fields.data(), fields.size() * sizeof(uint64_t), subpasses.size());
+}
+
+std::optional<RenderPass::Compiled> RenderPass::TakeCompiled()
+{
+    if (compiled.renderPass == nullptr)
+        return std::nullopt;
+
+    mergedRenderPass = nullptr;
+    mergedSubpassIndex = 0;
+    return std::exchange(compiled, {});
+}
+
+void RenderPass::SetCompiled(Compiled&& compiled)
+{
+    this->compiled = std::move(compiled);
+    mergedRenderPass = nullptr;
+    mergedSubpassIndex = 0;
+}
+
+void RenderPass::Finalize()
+{
+    compiled.key = GetCompileKey();
+    compiled.id = nextCompileId++;
+    compiled.renderPass = GetGfxDriver()->CreateRenderPass();
+    compiled.gfxSubpasses.clear();
+    // the images may have been recreated since the last Finalize
+    compiled.imageViews.clear();
+    compiled.imageToImageViews.clear();
+    mergedRenderPass = nullptr;
+    mergedSubpassIndex = 0;
+
+    auto toGfxAttachment = [this](const Attachment& atta)
+    {
+        Gfx::Image* image = (Gfx::Image*)resourceRefs[atta.handle]->GetResource();
+
+        Gfx::ImageView* imageView = nullptr;
+        if (atta.imageView.has_value())
         {
-            auto depthImage = (Gfx::Image*)resourceRefs[subpass.depth->handle]->GetResource();
-
-            Gfx::ImageView* imageView = nullptr;
-            if (subpass.depth->imageView.has_value())
-            {
-                auto newImageView = GetGfxDriver()->CreateImageView({
-                    .image = *depthImage,
-                    .imageViewType = subpass.depth->imageView->imageViewType,
-                    .subresourceRange = subpass.depth->imageView->subresourceRange,
-                });
-                imageView = newImageView.get();
-                imageViews.push_back(std::move(newImageView));
-            }
-            else
-                imageView = &depthImage->GetDefaultImageView();
-
-            depth = {
-                .imageView = imageView,
-                .multiSampling = subpass.depth->multiSampling,
-                .loadOp = subpass.depth->loadOp,
-                .storeOp = subpass.depth->storeOp,
-                .stencilLoadOp = subpass.depth->stencilLoadOp,
-                .stencilStoreOp = subpass.depth->stencilStoreOp,
-            };
-            imageToImageViews[depthImage].push_back(imageView);
+            auto newImageView = GetGfxDriver()->CreateImageView({
+                .image = *image,
+                .imageViewType = atta.imageView->imageViewType,
+                .subresourceRange = atta.imageView->subresourceRange,
+            });
+            imageView = newImageView.get();
+            compiled.imageViews.push_back(std::move(newImageView));
         }
+        else
+            imageView = &image->GetDefaultImageView();
+
+        compiled.imageToImageViews[image].push_back(imageView);
+        return Gfx::RenderPass::Attachment{
+            .imageView = imageView,
+            .multiSampling = atta.multiSampling,
+            .loadOp = atta.loadOp,
+            .storeOp = atta.storeOp,
+            .stencilLoadOp = atta.stencilLoadOp,
+            .stencilStoreOp = atta.stencilStoreOp,
+        };
+    };
+
+    for (auto& subpass : subpasses)
+    {
+        GfxSubpass& gfxSubpass = compiled.gfxSubpasses.emplace_back();
+        for (const Attachment& colorAtta : subpass.colors)
+            gfxSubpass.colors.push_back(toGfxAttachment(colorAtta));
+
+        if (subpass.depth.has_value())
+            gfxSubpass.depth = toGfxAttachment(*subpass.depth);
+
+        for (const Attachment& inputAtta : subpass.inputs)
+            gfxSubpass.inputs.push_back(toGfxAttachment(inputAtta));
 
-        renderPass->AddSubpass(colors, depth);
+        compiled.renderPass->AddSubpass(gfxSubpass.colors, gfxSubpass.depth, gfxSubpass.inputs);
     }
 }
 } // namespace Engine::RenderGraph
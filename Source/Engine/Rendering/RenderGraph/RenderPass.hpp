@@ -48,6 +48,9 @@ public:
 
         // used when you want to set a barrier to part of the image
         std::optional<Gfx::ImageSubresourceRange> imageSubresourceRange;
+
+        // the extent is changed by SetImageExtent, the image gets memory of its own so it can be recreated alone
+        bool resizable = false;
     };
 
     struct Attachment
@@ -65,6 +68,29 @@ public:
     {
         std::vector<Attachment> colors;
         std::optional<Attachment> depth;
+        // read with subpassInput, the load and store operations are not used
+        std::vector<Attachment> inputs;
+    };
+
+    // a subpass with the image views of its attachments, filled in Finalize
+    struct GfxSubpass
+    {
+        std::vector<Gfx::RenderPass::Attachment> colors;
+        std::optional<Gfx::RenderPass::Attachment> depth;
+        std::vector<Gfx::RenderPass::Attachment> inputs;
+    };
+
+    // what Finalize creates. The graph keeps it when the pass is recompiled, a pass with the same compile key takes
+    // it back and the pipelines created for the render pass are reused
+    struct Compiled
+    {
+        uint64_t key = 0;
+        // unique across every Finalize
+        uint64_t id = 0;
+        std::unique_ptr<Gfx::RenderPass> renderPass;
+        std::vector<GfxSubpass> gfxSubpasses;
+        std::vector<std::unique_ptr<Gfx::ImageView>> imageViews;
+        std::unordered_map<Gfx::Image*, std::vector<Gfx::ImageView*>> imageToImageViews;
     };
 
 public:
@@ -110,6 +136,16 @@ public:
         return resourceDescriptions[handle];
     }
 
+    // change the size of an image the pass creates, the image is recreated by the next Graph::Process or
+    // Graph::ResizeImages
+    void SetImageExtent(ResourceHandle handle, uint32_t width, uint32_t height)
+    {
+        ResourceDescription& desc = resourceDescriptions.at(handle);
+        desc.imageCreateInfo.width = width;
+        desc.imageCreateInfo.height = height;
+        desc.resizable = true;
+    }
+
     std::span<const ResourceHandle> GetExternalResources()
     {
         return externalResources;
@@ -117,26 +153,71 @@ public:
 
     const std::vector<Gfx::ImageView*>& GetImageViews(Gfx::Image* image);
 
+    const std::vector<Subpass>& GetSubpasses()
+    {
+        return subpasses;
+    }
+
     // Recording all the gfx commands.
     // Don't insert any pipeline barriers for resources from outside, it's managed by the frame
     virtual void Execute(Gfx::CommandBuffer& cmdBuf)
     {
         if (execute)
-            execute(cmdBuf, *renderPass, resourceRefs);
+            execute(cmdBuf, *GetGfxRenderPass(), resourceRefs);
     };
 
     // call when all the resources are set
     void Finalize();
 
+    // hash of the attachments and the images set to them, Finalize creates the same render pass for the same key
+    uint64_t GetCompileKey();
+
+    // identifies what the last Finalize created, 0 before that
+    uint64_t GetCompileId()
+    {
+        return compiled.id;
+    }
+
+    // move out what Finalize created, nullopt if the pass isn't finalized
+    std::optional<Compiled> TakeCompiled();
+
+    // use what another pass with the same compile key created instead of calling Finalize
+    void SetCompiled(Compiled&& compiled);
+
+    // the gfx render pass created in Finalize, nullptr before that. It's the render pass the graph merged this pass
+    // into if it did
+    Gfx::RenderPass* GetGfxRenderPass()
+    {
+        return mergedRenderPass ? mergedRenderPass : compiled.renderPass.get();
+    }
+
+    // the index of the first subpass of this pass in GetGfxRenderPass
+    uint32_t GetSubpassIndex()
+    {
+        return mergedSubpassIndex;
+    }
+
+    const std::vector<GfxSubpass>& GetGfxSubpasses()
+    {
+        return compiled.gfxSubpasses;
+    }
+
+    // the pass is recorded into renderPass starting at subpassIndex, it begins and ends the render pass as usual and
+    // the command buffer continues the render pass instead. Reset by Finalize
+    void SetMergedRenderPass(Gfx::RenderPass* renderPass, uint32_t subpassIndex)
+    {
+        mergedRenderPass = renderPass;
+        mergedSubpassIndex = subpassIndex;
+    }
+
 protected:
     std::vector<ResourceHandle> externalResources;
-    std::unique_ptr<Gfx::RenderPass> renderPass = nullptr;
-    std::vector<ResourceHandle> creationRequests;
-    std::vector<std::unique_ptr<Gfx::ImageView>> imageViews;
-
-    // it's possition a image is read from a subresource and write to another subresource
+    // the image views in it are used when an image is read from a subresource and written to another subresource,
     // this is used to enable finer control over Graph's barrier insertion
-    std::unordered_map<Gfx::Image*, std::vector<Gfx::ImageView*>> imageToImageViews;
+    Compiled compiled;
+    Gfx::RenderPass* mergedRenderPass = nullptr;
+    uint32_t mergedSubpassIndex = 0;
+    std::vector<ResourceHandle> creationRequests;
     const std::vector<Subpass> subpasses;
     ResourceRefs resourceRefs;
     std::unordered_map<ResourceHandle, ResourceDescription> resourceDescriptions;
@@ -1,5 +1,7 @@
 #include "RenderPipeline.hpp"
 #include "Core/Scene/Scene.hpp"
+#include "GeometryArena.hpp"
+#include "Libs/ThreadPool.hpp"
 
 namespace Engine
 {
@@ -54,6 +56,7 @@ void RenderPipeline::Render()
         f(*cmd);
     }
     cmd->End();
+    lastFrameStats = cmd->GetStats();
 
     cmdQueue.clear();
     cmdQueue.push_back(cmd);
@@ -62,6 +65,7 @@ void RenderPipeline::Render()
     submitFence->Reset();
 
     GetGfxDriver()->ClearResources();
+    GeometryArena::Singleton().RecycleRetiredRanges();
     staging.Clear(); // staing resources will be deleted next frame
 
     RefPtr<Gfx::Semaphore> waitSemaphores[] = {swapchainAcquireSemaphore};
@@ -121,6 +125,13 @@ RenderPipeline& RenderPipeline::Singleton()
     return *SingletonPrivate();
 }
 
+ThreadPool& RenderPipeline::GetThreadPool()
+{
+    if (threadPool == nullptr)
+        threadPool = std::make_unique<ThreadPool>();
+    return *threadPool;
+}
+
 void RenderPipeline::UploadBuffer(Gfx::Buffer& dst, uint8_t* data, size_t size, size_t dstOffset)
 {
     staging.UploadBuffer(dst, data, size, dstOffset);
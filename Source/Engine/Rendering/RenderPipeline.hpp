@@ -6,6 +6,7 @@
 namespace Engine
 {
 class Scene;
+class ThreadPool;
 class RenderPipeline
 {
 
@@ -20,6 +21,16 @@ public:
     void UploadBuffer(Gfx::Buffer& dst, uint8_t* data, size_t size, size_t dstOffset = 0);
     void UploadImage(Gfx::Image& dst, uint8_t* data, size_t size, uint32_t mipLevel = 0, uint32_t arayLayer = 0);
 
+    // binding calls issued and skipped and the draws recorded in the last frame
+    const Gfx::CommandBufferStats& GetLastFrameStats()
+    {
+        return lastFrameStats;
+    }
+
+    // the worker threads shared by the rendering code that splits its work, created on the first call. The frame is
+    // recorded on one thread so its users never call ParallelFor at the same time
+    ThreadPool& GetThreadPool();
+
 private:
     RenderPipeline();
     class FrameCmdBuffer
@@ -88,6 +99,8 @@ private:
     std::vector<PendingBufferUpload> pendingSetBuffers;
 
     std::vector<Gfx::CommandBuffer*> cmdQueue;
+    Gfx::CommandBufferStats lastFrameStats;
+    std::unique_ptr<ThreadPool> threadPool;
 
     bool AcquireSwapchainImage();
     static std::unique_ptr<RenderPipeline>& SingletonPrivate();
@@ -83,12 +83,14 @@ public:
                 cmd.BeginRenderPass(pass, clearValues);
                 for (auto& draw : *drawList)
                 {
-                    cmd.BindShaderProgram(draw.shader, *draw.shaderConfig);
-                    cmd.BindVertexBuffer(draw.vertexBufferBinding, 0);
+                    auto& material = drawList->GetMaterial(draw);
+                    SceneObjectPushConstant pushConstant = drawList->GetPushConstant(draw);
+                    cmd.BindShaderProgram(material.shader, *material.shaderConfig);
+                    cmd.BindVertexBuffer(draw.GetVertexBufferBindings(), 0);
                     cmd.BindIndexBuffer(draw.indexBuffer, 0, draw.indexBufferType);
-                    cmd.BindResource(2, draw.shaderResource);
-                    cmd.SetPushConstant(draw.shader, (void*)&draw.pushConstant);
-                    cmd.DrawIndexed(draw.indexCount, 1, 0, 0, 0);
+                    cmd.BindResource(2, material.shaderResource);
+                    cmd.SetPushConstant(material.shader, &pushConstant);
+                    cmd.DrawIndexed(draw.indexCount, draw.instanceCount, 0, 0, draw.firstInstance);
                 }
                 cmd.EndRenderPass();
 
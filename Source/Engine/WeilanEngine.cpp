@@ -13,6 +13,7 @@ WeilanEngine::~WeilanEngine()
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
     RenderPipeline::Deinit();
+    GeometryArena::Deinit();
 }
 
 void WeilanEngine::Init(const CreateInfo& createInfo)
@@ -34,7 +35,11 @@ void WeilanEngine::Init(const CreateInfo& createInfo)
     }
 
     Gfx::GfxDriver::CreateInfo gfxCreateInfo{{1960, 1024}};
+    if (!projectPath.empty())
+        gfxCreateInfo.pipelineCachePath = projectPath / "Cache" / "PipelineCache.bin";
     gfxDriver = Gfx::GfxDriver::CreateGfxDriver(Gfx::Backend::Vulkan, gfxCreateInfo);
+    // the asset database loads meshes
+    GeometryArena::Init();
     assetDatabase = std::make_unique<AssetDatabase>(projectPath);
     RenderPipeline::Init();
     event = std::make_unique<Event>();
@@ -5,6 +5,7 @@
 #include "Core/Time.hpp"
 #include "Event/Event.hpp"
 #include "GfxDriver/GfxDriver.hpp"
+#include "Rendering/GeometryArena.hpp"
 #include "Rendering/RenderPipeline.hpp"
 #include "Rendering/Shaders.hpp"
 #include <filesystem>
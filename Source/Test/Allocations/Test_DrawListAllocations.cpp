@@ -0,0 +1,107 @@
+#include "Libs/ThreadPool.hpp"
+#include "Rendering/FrameGraph/Nodes/Node.hpp"
+#include "Rendering/FrameGraph/SceneInstances.hpp"
+#include "WeilanEngine.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <new>
+#include <spdlog/spdlog.h>
+using namespace Engine;
+
+// counts the allocations of the test binary while enabled. Replacing operator new affects the whole binary, the tests
+// in Allocations/ are built into EngineAllocationTest instead of EngineUnitTest
+static std::atomic<bool> countAllocations = false;
+static std::atomic<uint64_t> allocationCount = 0;
+
+void* operator new(size_t size)
+{
+    if (countAllocations)
+        allocationCount += 1;
+
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t size) noexcept
+{
+    std::free(p);
+}
+
+// once the draw list has grown to the scene, building it again for 100k objects doesn't allocate
+TEST(DrawList, NoAllocations)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+    Shader::EnableFeature("G_INSTANCING");
+
+    const uint32_t meshCount = 100;
+    const uint32_t objectCount = 100000;
+    Shader shader("Assets/Shaders/Game/StandardPBR.shad");
+    Material material(&shader);
+    std::vector<std::unique_ptr<Mesh>> meshes;
+    for (uint32_t i = 0; i < meshCount; ++i)
+    {
+        Submesh submesh;
+        submesh.SetPositions(std::vector<glm::vec3>{{0, 0, 0}, {1, 0, 0}, {0, 1, 0}});
+        submesh.SetIndices(std::vector<uint32_t>{0, 1, 2});
+        submesh.Apply();
+        std::vector<Submesh> submeshes;
+        submeshes.push_back(std::move(submesh));
+        meshes.push_back(std::make_unique<Mesh>());
+        meshes.back()->SetSubmeshes(std::move(submeshes));
+    }
+
+    Scene scene;
+    std::vector<MeshRenderer*> meshRenderers;
+    for (uint32_t i = 0; i < objectCount; ++i)
+    {
+        GameObject* gameObject = scene.CreateGameObject();
+        gameObject->GetTransform()->SetPosition(glm::vec3(i % 300, i / 300, 0));
+        meshRenderers.push_back(gameObject->AddComponent<MeshRenderer>(meshes[i % meshCount].get(), &material));
+    }
+
+    FrameGraph::DrawList drawList;
+    FrameGraph::SceneInstances instances;
+    ThreadPool threadPool;
+    auto buildFrame = [&]()
+    {
+        instances.BeginFrame();
+        drawList.Clear();
+        for (MeshRenderer* meshRenderer : meshRenderers)
+            drawList.Add(*meshRenderer);
+        drawList.Sort(FrameGraph::DrawSortMode::State, glm::vec3(0), 1000, &threadPool);
+        drawList.BuildInstances(instances, true);
+    };
+
+    // the first frame grows the tables
+    buildFrame();
+
+    using Clock = std::chrono::high_resolution_clock;
+    auto start = Clock::now();
+    allocationCount = 0;
+    countAllocations = true;
+    buildFrame();
+    countAllocations = false;
+    double time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    EXPECT_EQ(allocationCount, 0);
+    EXPECT_EQ(drawList.size(), meshCount);
+    spdlog::info(
+        "draw list of {} objects built in {:.2f}ms, {} allocations",
+        objectCount,
+        time,
+        allocationCount.load()
+    );
+
+    Shader::DisableFeature("G_INSTANCING");
+    GetGfxDriver()->WaitForIdle();
+    engine = nullptr;
+}
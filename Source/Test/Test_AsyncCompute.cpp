@@ -0,0 +1,165 @@
+#include "GfxDriver/Vulkan/VKCommandBuffer.hpp"
+#include "Rendering/RenderGraph/Graph.hpp"
+#include "WeilanEngine.hpp"
+#include <gtest/gtest.h>
+
+using namespace Engine;
+
+static RenderGraph::RenderPass::ResourceDescription BufferUse(
+    RenderGraph::ResourceHandle handle, Gfx::AccessMaskFlags access, bool create
+)
+{
+    RenderGraph::RenderPass::ResourceDescription desc{
+        .name = "buffer",
+        .handle = handle,
+        .type = RenderGraph::ResourceType::Buffer,
+        .accessFlags = access,
+        .stageFlags = Gfx::PipelineStage::Compute_Shader,
+    };
+    if (create)
+        desc.bufferCreateInfo = {.usages = Gfx::BufferUsage::Storage, .size = 256, .visibleInCPU = false};
+    return desc;
+}
+
+static Gfx::Buffer* GetBuffer(RenderGraph::RenderNode* node, RenderGraph::ResourceHandle handle)
+{
+    return (Gfx::Buffer*)node->GetPass()->GetResourceRef(handle)->GetResource();
+}
+
+// the producer prefers the async compute queue, the consumer reads its buffer and the other node is unrelated
+TEST(AsyncCompute, AssignQueues)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+    bool available = GetGfxDriver()->GetGPUFeatures().asyncCompute;
+
+    {
+        auto empty = [](Gfx::CommandBuffer&, Gfx::RenderPass&, const RenderGraph::ResourceRefs&) {};
+        RenderGraph::Graph graph;
+        RenderGraph::RenderNode* producer =
+            graph.AddNode(empty, {BufferUse(0, Gfx::AccessMask::Shader_Write, true)}, {});
+        producer->SetName("producer");
+        producer->SetQueueAffinity(QueueType::AsyncCompute);
+        RenderGraph::RenderNode* consumer = graph.AddNode(
+            empty,
+            {BufferUse(0, Gfx::AccessMask::Shader_Read, false), BufferUse(1, Gfx::AccessMask::Shader_Write, true)},
+            {}
+        );
+        consumer->SetName("consumer");
+        RenderGraph::RenderNode* other = graph.AddNode(empty, {BufferUse(0, Gfx::AccessMask::Shader_Write, true)}, {});
+        other->SetName("other");
+        RenderGraph::Graph::Connect(producer, 0, consumer, 0);
+        graph.Export(consumer, 1);
+        graph.Export(other, 0);
+        graph.Process();
+
+        std::unordered_map<std::string, RenderGraph::Graph::QueueTimelineEntry> timeline;
+        for (auto& entry : graph.GetQueueTimeline())
+            timeline[entry.name] = entry;
+        ASSERT_EQ(timeline.size(), 3);
+
+        QueueType producerQueue = available ? QueueType::AsyncCompute : QueueType::Main;
+        EXPECT_EQ(timeline["producer"].queue, producerQueue);
+        EXPECT_EQ(timeline["consumer"].queue, QueueType::Main);
+        EXPECT_EQ(timeline["other"].queue, QueueType::Main);
+        // only the first use of the producer's buffer on the main queue waits
+        EXPECT_EQ(timeline["consumer"].join, available);
+        EXPECT_FALSE(timeline["other"].join);
+
+        // only the resources the async compute queue uses are shared with it
+        EXPECT_EQ(HasFlag(GetBuffer(producer, 0)->GetUsages(), Gfx::BufferUsage::AsyncCompute), available);
+        EXPECT_FALSE(HasFlag(GetBuffer(consumer, 1)->GetUsages(), Gfx::BufferUsage::AsyncCompute));
+        EXPECT_FALSE(HasFlag(GetBuffer(other, 0)->GetUsages(), Gfx::BufferUsage::AsyncCompute));
+
+        auto queue = GetGfxDriver()->GetQueue(QueueType::Main);
+        std::unique_ptr<Gfx::CommandPool> cmdPool = GetGfxDriver()->CreateCommandPool({queue->GetFamilyIndex()});
+        std::unique_ptr<Gfx::CommandBuffer> cmd =
+            cmdPool->AllocateCommandBuffers(Gfx::CommandBufferType::Primary, 1)[0];
+        cmd->Begin();
+        graph.Execute(*cmd);
+        cmd->End();
+        Gfx::CommandBuffer* cmdBufs[] = {cmd.get()};
+        GetGfxDriver()->QueueSubmit(queue, cmdBufs, {}, {}, {}, nullptr);
+        GetGfxDriver()->WaitForIdle();
+    }
+
+    engine = nullptr;
+}
+
+// the forked part waits for the commands before Fork, the commands after Join wait for the forked part. Forks to the
+// main queue when the device has no async compute queue, the semaphores are the same
+TEST(AsyncCompute, ForkJoinSubmissions)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+
+    {
+        auto queue = GetGfxDriver()->GetQueue(QueueType::Main);
+        auto forkQueue = GetGfxDriver()->GetQueue(QueueType::AsyncCompute);
+        if (forkQueue == nullptr)
+            forkQueue = queue;
+
+        const size_t size = 64 * sizeof(uint32_t);
+        Gfx::BufferUsageFlags usages =
+            Gfx::BufferUsage::Transfer_Src | Gfx::BufferUsage::Transfer_Dst | Gfx::BufferUsage::AsyncCompute;
+        auto createBuffer = [usages, size](bool visibleInCPU, const char* name)
+        {
+            return GetGfxDriver()->CreateBuffer(
+                {.usages = usages, .size = size, .visibleInCPU = visibleInCPU, .debugName = name}
+            );
+        };
+        std::unique_ptr<Gfx::Buffer> source = createBuffer(true, "source");
+        std::unique_ptr<Gfx::Buffer> middle = createBuffer(false, "middle");
+        std::unique_ptr<Gfx::Buffer> forked = createBuffer(false, "forked");
+        std::unique_ptr<Gfx::Buffer> result = createBuffer(true, "result");
+        uint32_t* sourceData = (uint32_t*)source->GetCPUVisibleAddress();
+        for (uint32_t i = 0; i < 64; ++i)
+            sourceData[i] = i * 3 + 1;
+
+        std::unique_ptr<Gfx::CommandPool> cmdPool = GetGfxDriver()->CreateCommandPool({queue->GetFamilyIndex()});
+        std::unique_ptr<Gfx::CommandPool> forkPool = GetGfxDriver()->CreateCommandPool({forkQueue->GetFamilyIndex()});
+        std::unique_ptr<Gfx::CommandBuffer> cmd =
+            cmdPool->AllocateCommandBuffers(Gfx::CommandBufferType::Primary, 1)[0];
+        std::unique_ptr<Gfx::CommandBuffer> forkCmd =
+            forkPool->AllocateCommandBuffers(Gfx::CommandBufferType::Primary, 1)[0];
+        Gfx::BufferCopyRegion region{.srcOffset = 0, .dstOffset = 0, .size = size};
+
+        // source -> middle on the main queue, middle -> forked on the fork queue, forked -> result after the join
+        forkCmd->Begin();
+        forkCmd->CopyBuffer(middle, forked, {&region, 1});
+        forkCmd->End();
+
+        cmd->Begin();
+        cmd->CopyBuffer(source, middle, {&region, 1});
+        cmd->Fork(*forkQueue, *forkCmd);
+        cmd->Join();
+        cmd->CopyBuffer(forked, result, {&region, 1});
+        cmd->End();
+
+        // before the fork, the forked part, between fork and join, after the join
+        auto& submissions = static_cast<Gfx::VKCommandBuffer*>(cmd.get())->GetSubmissions();
+        ASSERT_EQ(submissions.size(), 4);
+        EXPECT_EQ(submissions[0].queue, VK_NULL_HANDLE);
+        EXPECT_TRUE(submissions[0].waits.empty());
+        ASSERT_EQ(submissions[0].signals.size(), 1);
+        EXPECT_NE(submissions[1].queue, VK_NULL_HANDLE);
+        EXPECT_EQ(submissions[1].waits, submissions[0].signals);
+        ASSERT_EQ(submissions[1].signals.size(), 1);
+        EXPECT_TRUE(submissions[2].waits.empty());
+        EXPECT_TRUE(submissions[2].signals.empty());
+        EXPECT_EQ(submissions[3].waits, submissions[1].signals);
+        EXPECT_TRUE(submissions[3].signals.empty());
+
+        std::unique_ptr<Gfx::Fence> fence = GetGfxDriver()->CreateFence({.signaled = false});
+        Gfx::CommandBuffer* cmdBufs[] = {cmd.get()};
+        GetGfxDriver()->QueueSubmit(queue, cmdBufs, {}, {}, {}, fence);
+        // the fence is signaled by the last part, after the forked work
+        GetGfxDriver()->WaitForFence({fence}, true, -1);
+
+        uint32_t* resultData = (uint32_t*)result->GetCPUVisibleAddress();
+        for (uint32_t i = 0; i < 64; ++i)
+            EXPECT_EQ(resultData[i], i * 3 + 1);
+    }
+
+    engine = nullptr;
+}
@@ -0,0 +1,221 @@
+#include "GfxDriver/ShaderConfig.hpp"
+#include "Rendering/FrameGraph/Nodes/Node.hpp"
+#include "Rendering/FrameGraph/SceneInstances.hpp"
+#include "WeilanEngine.hpp"
+#include <chrono>
+#include <glm/gtc/matrix_transform.hpp>
+#include <gtest/gtest.h>
+#include <spdlog/spdlog.h>
+using namespace Engine;
+
+// a stress scene of many copies of a few meshes with one material, the draws of a mesh become one instanced draw
+TEST(DrawList, Instancing)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+
+    const uint32_t meshCount = 100;
+    const uint32_t objectCount = 100000;
+    Shader shader("Assets/Shaders/Game/StandardPBR.shad");
+    Gfx::ShaderProgram* program = shader.GetShaderProgram({"G_PCF", "G_INSTANCING"});
+    ASSERT_TRUE(FrameGraph::SceneInstances::IsInstanced(*program));
+
+    std::vector<std::unique_ptr<Gfx::Buffer>> buffers;
+    for (uint32_t i = 0; i < meshCount; ++i)
+    {
+        buffers.push_back(GetGfxDriver()->CreateBuffer({
+            .usages = Gfx::BufferUsage::Vertex | Gfx::BufferUsage::Index,
+            .size = 256,
+            .visibleInCPU = false,
+            .debugName = "mesh",
+        }));
+    }
+
+    auto build = [&](bool instancing)
+    {
+        FrameGraph::DrawList drawList;
+        uint32_t material = drawList.AddMaterial(program, program->GetDefaultShaderConfig(), nullptr);
+        for (uint32_t i = 0; i < objectCount; ++i)
+        {
+            auto& draw = drawList.emplace_back();
+            Gfx::Buffer* mesh = buffers[i % meshCount].get();
+            draw.material = material;
+            draw.transform = drawList.AddTransform(glm::translate(glm::mat4(1), glm::vec3(i, 0, 0)));
+            draw.indexBuffer = mesh;
+            draw.indexCount = 36;
+            draw.vertexBindingCount = 2;
+            draw.vertexBindings[0] = {mesh, 0};
+            draw.vertexBindings[1] = {mesh, 128};
+        }
+
+        FrameGraph::SceneInstances instances;
+        instances.BeginFrame();
+        using Clock = std::chrono::high_resolution_clock;
+        auto start = Clock::now();
+        drawList.BuildInstances(instances, instancing);
+        double time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        // every object is drawn exactly once with its own transform
+        std::vector<bool> drawn(objectCount, false);
+        uint32_t instanceCount = 0;
+        for (auto& draw : drawList)
+        {
+            for (uint32_t i = draw.firstInstance; i < draw.firstInstance + draw.instanceCount; ++i)
+            {
+                uint32_t object = instances.GetTransforms()[i][3].x;
+                EXPECT_EQ(draw.indexBuffer, buffers[object % meshCount].get());
+                EXPECT_FALSE(drawn[object]);
+                drawn[object] = true;
+            }
+            instanceCount += draw.instanceCount;
+        }
+        EXPECT_EQ(instanceCount, objectCount);
+        return std::make_pair(drawList.size(), time);
+    };
+
+    auto [draws, time] = build(false);
+    auto [instancedDraws, instancedTime] = build(true);
+    EXPECT_EQ(draws, objectCount);
+    EXPECT_EQ(instancedDraws, meshCount);
+    spdlog::info(
+        "{} objects of {} meshes: {} draw calls, {} with instancing ({:.2f}ms to build the instances)",
+        objectCount,
+        meshCount,
+        draws,
+        instancedDraws,
+        instancedTime
+    );
+
+    GetGfxDriver()->WaitForIdle();
+    engine = nullptr;
+}
+
+// opaque draws are grouped by pipeline and material, the draws with blending go last and back to front
+TEST(DrawList, Sort)
+{
+    Gfx::ShaderConfig opaque;
+    Gfx::ShaderConfig transparent;
+    transparent.color.blends.resize(1);
+    transparent.color.blends[0].blendEnable = true;
+
+    FrameGraph::DrawList drawList;
+    uint32_t materials[3] = {
+        drawList.AddMaterial(nullptr, opaque, nullptr),
+        drawList.AddMaterial(nullptr, opaque, nullptr),
+        drawList.AddMaterial(nullptr, transparent, nullptr),
+    };
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        auto& draw = drawList.emplace_back();
+        draw.material = i % 4 == 3 ? materials[2] : materials[i % 2];
+        draw.transform = drawList.AddTransform(glm::translate(glm::mat4(1), glm::vec3(0, 0, 8 - i)));
+        draw.indexCount = i;
+    }
+
+    auto order = [&drawList]()
+    {
+        std::vector<uint32_t> order;
+        for (auto& draw : drawList)
+            order.push_back(draw.indexCount);
+        return order;
+    };
+
+    drawList.Sort(FrameGraph::DrawSortMode::State, glm::vec3(0), 100);
+    EXPECT_EQ(order(), (std::vector<uint32_t>{6, 4, 2, 0, 5, 1, 3, 7}));
+
+    drawList.Sort(FrameGraph::DrawSortMode::Depth, glm::vec3(0), 100);
+    EXPECT_EQ(order(), (std::vector<uint32_t>{6, 5, 4, 2, 1, 0, 3, 7}));
+}
+
+// the hash of the static draws ignores the dynamic ones and the order of the draws
+TEST(DrawList, StaticHash)
+{
+    auto build = [](bool reversed, float dynamicX, float staticX, uint32_t cameraLod = 0)
+    {
+        FrameGraph::DrawList drawList;
+        for (uint32_t n = 0; n < 6; ++n)
+        {
+            uint32_t i = reversed ? 5 - n : n;
+            auto& draw = drawList.emplace_back();
+            draw.isStatic = i % 2 == 0;
+            float x = i == 0 ? staticX : (i == 1 ? dynamicX : i);
+            draw.transform = drawList.AddTransform(glm::translate(glm::mat4(1), glm::vec3(x, 0, 0)));
+            draw.shadowIndexCount = 6 * i;
+            draw.indexCount = draw.shadowIndexCount >> cameraLod;
+            draw.firstIndex = draw.shadowIndexCount * cameraLod;
+        }
+        return drawList.HashStaticDraws();
+    };
+
+    uint64_t hash = build(false, 1, 0);
+    EXPECT_EQ(build(true, 1, 0), hash);
+    EXPECT_EQ(build(false, 10, 0), hash);
+    EXPECT_NE(build(false, 1, 10), hash);
+    // the level of detail the camera picks doesn't change the shadows
+    EXPECT_EQ(build(false, 1, 0, 2), hash);
+    EXPECT_NE(FrameGraph::DrawList().HashStaticDraws(), hash);
+}
+
+// the instanced draws of a GPU culled list get a cull group over the same instances
+TEST(DrawList, CullGroups)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+
+    {
+        Shader shader("Assets/Shaders/Game/StandardPBR.shad");
+        ComputeShader cullingShader("Assets/Shaders/Game/CullInstances.comp");
+        Gfx::ShaderProgram* program = shader.GetShaderProgram({"G_PCF", "G_INSTANCING"});
+        FrameGraph::SceneInstances instances;
+        instances.SetCullingShader(&cullingShader);
+        if (!instances.IsGpuCullingSupported())
+            GTEST_SKIP() << "no indirect draws";
+
+        auto buffer = GetGfxDriver()->CreateBuffer({
+            .usages = Gfx::BufferUsage::Vertex | Gfx::BufferUsage::Index,
+            .size = 256,
+            .visibleInCPU = false,
+            .debugName = "mesh",
+        });
+
+        FrameGraph::DrawList drawList;
+        uint32_t material = drawList.AddMaterial(program, program->GetDefaultShaderConfig(), nullptr);
+        for (uint32_t i = 0; i < 10; ++i)
+        {
+            auto& draw = drawList.emplace_back();
+            draw.material = material;
+            draw.transform = drawList.AddTransform(glm::translate(glm::mat4(1), glm::vec3(i, 0, 0)));
+            draw.indexBuffer = buffer.get();
+            draw.indexCount = i % 2 == 0 ? 36 : 6;
+            draw.bounds = {glm::vec3(-1), glm::vec3(1, 3, 1)};
+        }
+
+        instances.BeginFrame();
+        drawList.BuildInstances(instances, true, true);
+        ASSERT_EQ(drawList.size(), 2u);
+        ASSERT_EQ(instances.GetCullGroups().size(), 2u);
+        for (auto& draw : drawList)
+        {
+            ASSERT_NE(draw.cullGroup, FrameGraph::SceneInstances::NO_CULL_GROUP);
+            auto& group = instances.GetCullGroups()[draw.cullGroup];
+            EXPECT_EQ(group.firstInstance, draw.firstInstance);
+            EXPECT_EQ(group.boundsCenter, glm::vec3(0, 1, 0));
+            EXPECT_EQ(group.boundsExtent, glm::vec3(1, 2, 1));
+        }
+        EXPECT_EQ(instances.GetCullGroups()[1].firstCulledInstance, drawList[0].instanceCount);
+
+        using SceneInstances = FrameGraph::SceneInstances;
+        // the commands of a group are adjacent, the ones of the next group follow a stride later
+        EXPECT_EQ(
+            SceneInstances::GetDrawCommandOffset(SceneInstances::CullView::Shadow, 0),
+            sizeof(Gfx::DrawIndexedIndirectCommand)
+        );
+        EXPECT_EQ(
+            SceneInstances::GetDrawCommandOffset(SceneInstances::CullView::Camera, 1),
+            SceneInstances::GetDrawCommandStride()
+        );
+    }
+
+    GetGfxDriver()->WaitForIdle();
+    engine = nullptr;
+}
@@ -0,0 +1,56 @@
+#include "Rendering/DynamicResolution.hpp"
+#include <gtest/gtest.h>
+using namespace Engine;
+
+// the scale follows the frame time in steps, waits a few frames after every change and stays within its range
+TEST(DynamicResolution, Update)
+{
+    DynamicResolution resolution({
+        .targetFrameTime = 10,
+        .minScale = 0.5f,
+        .maxScale = 1,
+        .step = 0.1f,
+        .cooldownFrames = 3,
+    });
+    EXPECT_FLOAT_EQ(resolution.GetScale(), 1);
+
+    // twice the target time, the pixel count is halved
+    EXPECT_TRUE(resolution.Update(20));
+    EXPECT_NEAR(resolution.GetScale(), 0.7f, 1e-4f);
+
+    for (int i = 0; i < 3; ++i)
+        EXPECT_FALSE(resolution.Update(40));
+    EXPECT_TRUE(resolution.Update(40));
+    EXPECT_NEAR(resolution.GetScale(), 0.5f, 1e-4f);
+
+    // already at the minimum
+    for (int i = 0; i < 10; ++i)
+        EXPECT_FALSE(resolution.Update(40));
+    EXPECT_NEAR(resolution.GetScale(), 0.5f, 1e-4f);
+
+    // no measurement
+    EXPECT_FALSE(resolution.Update(0));
+
+    resolution.SetSettings({
+        .targetFrameTime = 10,
+        .minScale = 0.8f,
+        .maxScale = 1,
+        .step = 0.1f,
+        .cooldownFrames = 3,
+    });
+    EXPECT_NEAR(resolution.GetScale(), 0.8f, 1e-4f);
+
+    // a light load goes back to the full size
+    for (int i = 0; i < 100; ++i)
+        resolution.Update(2.5f);
+    EXPECT_FLOAT_EQ(resolution.GetScale(), 1);
+}
+
+// frames at the target never resize the images
+TEST(DynamicResolution, SteadyAtTarget)
+{
+    DynamicResolution resolution({.targetFrameTime = 10, .minScale = 0.5f, .maxScale = 1, .step = 0.05f});
+    for (int i = 0; i < 100; ++i)
+        EXPECT_FALSE(resolution.Update(i % 2 == 0 ? 9.8f : 10.2f));
+    EXPECT_FLOAT_EQ(resolution.GetScale(), 1);
+}
@@ -0,0 +1,48 @@
+#include "Rendering/GeometryArena.hpp"
+#include "WeilanEngine.hpp"
+#include <gtest/gtest.h>
+using namespace Engine;
+
+// a released range is only reused after the frame in flight and the frame being recorded are finished
+TEST(GeometryArena, RecycleRetiredRanges)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+
+    {
+        auto& arena = GeometryArena::Singleton();
+        // a layout no engine mesh uses, so the ranges come from a page of their own
+        uint32_t strides[] = {12, 4, 7};
+        GeometryArena::Range a = arena.AllocateVertices(strides, 100);
+        GeometryArena::Range b = arena.AllocateVertices(strides, 100);
+        ASSERT_TRUE(a.IsValid());
+        EXPECT_EQ(a.GetOffset(), 0);
+        EXPECT_EQ(b.GetOffset(), 100);
+        EXPECT_EQ(a.GetBuffer(), b.GetBuffer());
+        EXPECT_EQ(a.GetStreamOffset(0), 0);
+        EXPECT_EQ(a.GetStreamOffset(2) - a.GetStreamOffset(1), (a.GetStreamOffset(1) - a.GetStreamOffset(0)) / 3);
+
+        a = GeometryArena::Range();
+        GeometryArena::Range c = arena.AllocateVertices(strides, 100);
+        EXPECT_EQ(c.GetOffset(), 200);
+
+        // the frame that released a is in flight
+        arena.RecycleRetiredRanges();
+        GeometryArena::Range d = arena.AllocateVertices(strides, 100);
+        EXPECT_EQ(d.GetOffset(), 300);
+
+        // the frame that released a is finished
+        arena.RecycleRetiredRanges();
+        GeometryArena::Range e = arena.AllocateVertices(strides, 100);
+        EXPECT_EQ(e.GetOffset(), 0);
+        EXPECT_EQ(e.GetBuffer(), b.GetBuffer());
+
+        // indices are aligned to their size
+        GeometryArena::Range indices16 = arena.AllocateIndices(3, Gfx::IndexBufferType::UInt16);
+        GeometryArena::Range indices32 = arena.AllocateIndices(3, Gfx::IndexBufferType::UInt32);
+        EXPECT_EQ(indices32.GetOffset() % sizeof(uint32_t), 0);
+        EXPECT_EQ(indices16.GetBuffer(), indices32.GetBuffer());
+    }
+
+    engine = nullptr;
+}
@@ -0,0 +1,82 @@
+#include "Libs/MeshOptimizer.hpp"
+#include <algorithm>
+#include <array>
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+using namespace Engine;
+
+namespace
+{
+// a grid of size * size quads with its triangles shuffled
+std::vector<uint32_t> CreateShuffledGrid(uint32_t size)
+{
+    std::vector<uint32_t> indices;
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            uint32_t i = y * (size + 1) + x;
+            indices.insert(indices.end(), {i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2});
+        }
+    }
+
+    std::vector<uint32_t> order(indices.size() / 3);
+    for (uint32_t t = 0; t < order.size(); ++t)
+        order[t] = t;
+    std::shuffle(order.begin(), order.end(), std::mt19937(7));
+
+    std::vector<uint32_t> shuffled;
+    for (uint32_t t : order)
+        shuffled.insert(shuffled.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+    return shuffled;
+}
+
+std::multiset<std::array<uint32_t, 3>> Triangles(std::span<const uint32_t> indices)
+{
+    std::multiset<std::array<uint32_t, 3>> triangles;
+    for (size_t t = 0; t < indices.size(); t += 3)
+    {
+        // the winding is kept, the rotation doesn't matter
+        std::array<uint32_t, 3> tri = {indices[t], indices[t + 1], indices[t + 2]};
+        std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+        triangles.insert(tri);
+    }
+    return triangles;
+}
+} // namespace
+
+// the reordered grid transforms far fewer vertices and keeps every triangle
+TEST(MeshOptimizer, VertexCache)
+{
+    const uint32_t size = 100;
+    const size_t vertexCount = (size + 1) * (size + 1);
+    std::vector<uint32_t> indices = CreateShuffledGrid(size);
+    float before = AnalyzeVertexCache(indices, vertexCount);
+
+    std::vector<uint32_t> optimized = indices;
+    OptimizeVertexCache(optimized, vertexCount);
+    float after = AnalyzeVertexCache(optimized, vertexCount);
+
+    EXPECT_GT(before, 2.0f);
+    EXPECT_LT(after, 0.8f);
+    EXPECT_EQ(Triangles(indices), Triangles(optimized));
+}
+
+// vertices are numbered by first use and unused ones are dropped
+TEST(MeshOptimizer, VertexFetch)
+{
+    std::vector<uint32_t> indices = {4, 2, 0, 0, 2, 5};
+    float vertices[] = {0, 1, 2, 3, 4, 5};
+    size_t uniqueVertexCount;
+    std::vector<uint32_t> remap = OptimizeVertexFetch(indices, 6, &uniqueVertexCount);
+    EXPECT_EQ(uniqueVertexCount, 4u);
+    EXPECT_EQ(remap[1], UINT32_MAX);
+    EXPECT_EQ(remap[3], UINT32_MAX);
+
+    std::vector<float> fetched(uniqueVertexCount);
+    RemapIndices(indices, remap);
+    RemapVertices(fetched.data(), vertices, sizeof(float), remap);
+    EXPECT_EQ(indices, (std::vector<uint32_t>{0, 1, 2, 2, 1, 3}));
+    EXPECT_EQ(fetched, (std::vector<float>{4, 2, 0, 5}));
+}
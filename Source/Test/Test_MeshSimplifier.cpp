@@ -0,0 +1,104 @@
+#include "Libs/MeshSimplifier.hpp"
+#include <chrono>
+#include <gtest/gtest.h>
+#include <spdlog/spdlog.h>
+#include <unordered_set>
+using namespace Engine;
+
+namespace
+{
+// a closed unit sphere without duplicated vertices, 2 * segments * (rings - 1) triangles
+void CreateSphere(uint32_t rings, uint32_t segments, std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices)
+{
+    const float pi = 3.14159265f;
+    positions.push_back({0, 1, 0});
+    for (uint32_t r = 1; r < rings; ++r)
+    {
+        float theta = pi * r / rings;
+        for (uint32_t s = 0; s < segments; ++s)
+        {
+            float phi = 2 * pi * s / segments;
+            positions.push_back({std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)});
+        }
+    }
+    positions.push_back({0, -1, 0});
+
+    uint32_t bottom = positions.size() - 1;
+    auto ring = [&](uint32_t r, uint32_t s) { return 1 + (r - 1) * segments + s % segments; };
+    for (uint32_t s = 0; s < segments; ++s)
+    {
+        indices.insert(indices.end(), {0, ring(1, s + 1), ring(1, s)});
+        indices.insert(indices.end(), {bottom, ring(rings - 1, s), ring(rings - 1, s + 1)});
+        for (uint32_t r = 1; r < rings - 1; ++r)
+        {
+            indices.insert(indices.end(), {ring(r, s), ring(r, s + 1), ring(r + 1, s)});
+            indices.insert(indices.end(), {ring(r, s + 1), ring(r + 1, s + 1), ring(r + 1, s)});
+        }
+    }
+}
+} // namespace
+
+// a flat grid loses its interior vertices without error and keeps its border
+TEST(MeshSimplifier, FlatGrid)
+{
+    const uint32_t size = 50;
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    for (uint32_t y = 0; y <= size; ++y)
+    {
+        for (uint32_t x = 0; x <= size; ++x)
+            positions.push_back({(float)x, 0, (float)y});
+    }
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            uint32_t i = y * (size + 1) + x;
+            indices.insert(indices.end(), {i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2});
+        }
+    }
+
+    float error;
+    std::vector<uint32_t> result = SimplifyMesh(positions, indices, 0, FLT_MAX, &error);
+    EXPECT_LT(result.size(), indices.size() / 4);
+    EXPECT_NEAR(error, 0, 1e-4f);
+
+    std::unordered_set<uint32_t> used(result.begin(), result.end());
+    for (uint32_t i = 0; i <= size; ++i)
+    {
+        EXPECT_TRUE(used.contains(i));
+        EXPECT_TRUE(used.contains(size * (size + 1) + i));
+    }
+}
+
+// simplifies a 1M triangle sphere to 1% of its triangles
+TEST(MeshSimplifier, Sphere1M)
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    CreateSphere(501, 1000, positions, indices);
+    ASSERT_EQ(indices.size() / 3, 1000000u);
+
+    using Clock = std::chrono::high_resolution_clock;
+    auto start = Clock::now();
+    float error;
+    std::vector<uint32_t> result = SimplifyMesh(positions, indices, indices.size() / 100, FLT_MAX, &error);
+    double time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    spdlog::info("simplified 1M triangles to {} in {:.2f}ms, error {}", result.size() / 3, time, error);
+
+    EXPECT_LE(result.size(), indices.size() / 100);
+    EXPECT_GT(result.size(), 0u);
+    EXPECT_LT(error, 0.05f);
+    for (size_t t = 0; t < result.size(); t += 3)
+    {
+        // outward facing, the collapses never flip a triangle over
+        glm::vec3 p0 = positions[result[t]];
+        glm::vec3 normal = glm::cross(positions[result[t + 1]] - p0, positions[result[t + 2]] - p0);
+        EXPECT_GT(glm::dot(normal, p0), 0);
+    }
+
+    // the error is bounded by the maximum error
+    result = SimplifyMesh(positions, indices, 0, 0.001f, &error);
+    EXPECT_LE(error, 0.001f);
+    EXPECT_LT(result.size(), indices.size());
+}
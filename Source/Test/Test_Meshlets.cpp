@@ -0,0 +1,162 @@
+#include "Libs/MeshOptimizer.hpp"
+#include "Libs/Meshlets.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <random>
+#include <set>
+#include <spdlog/spdlog.h>
+#include <unordered_set>
+using namespace Engine;
+
+namespace
+{
+// a grid of size * size quads in the xz plane facing +y
+void CreateGrid(uint32_t size, std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices)
+{
+    for (uint32_t y = 0; y <= size; ++y)
+    {
+        for (uint32_t x = 0; x <= size; ++x)
+            positions.push_back({(float)x, 0, (float)y});
+    }
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            uint32_t i = y * (size + 1) + x;
+            indices.insert(indices.end(), {i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2});
+        }
+    }
+}
+
+// the planes of the box [min, max]
+std::array<glm::vec4, 6> BoxPlanes(const glm::vec3& min, const glm::vec3& max)
+{
+    return {
+        glm::vec4(1, 0, 0, -min.x),
+        glm::vec4(-1, 0, 0, max.x),
+        glm::vec4(0, 1, 0, -min.y),
+        glm::vec4(0, -1, 0, max.y),
+        glm::vec4(0, 0, 1, -min.z),
+        glm::vec4(0, 0, -1, max.z),
+    };
+}
+} // namespace
+
+// every triangle is in one meshlet, meshlets respect the limits and their bounds contain their vertices
+TEST(Meshlets, Build)
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    CreateGrid(100, positions, indices);
+    std::multiset<std::array<uint32_t, 3>> triangles;
+    for (size_t t = 0; t < indices.size(); t += 3)
+        triangles.insert({indices[t], indices[t + 1], indices[t + 2]});
+
+    std::vector<uint32_t> reordered = indices;
+    std::vector<Meshlet> meshlets = BuildMeshlets(positions, reordered);
+
+    uint32_t next = 0;
+    std::multiset<std::array<uint32_t, 3>> meshletTriangles;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        EXPECT_EQ(meshlet.firstIndex, next);
+        EXPECT_LE(meshlet.triangleCount, Meshlet::MAX_TRIANGLES);
+        EXPECT_LE(meshlet.vertexCount, Meshlet::MAX_VERTICES);
+        next += meshlet.triangleCount * 3;
+
+        std::unordered_set<uint32_t> vertices;
+        for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.triangleCount * 3; i += 3)
+        {
+            meshletTriangles.insert({reordered[i], reordered[i + 1], reordered[i + 2]});
+            for (int c = 0; c < 3; ++c)
+            {
+                vertices.insert(reordered[i + c]);
+                EXPECT_LE(glm::length(positions[reordered[i + c]] - meshlet.center), meshlet.radius + 1e-4f);
+            }
+        }
+        EXPECT_EQ(vertices.size(), meshlet.vertexCount);
+
+        // flat, the cone is the plane's normal
+        EXPECT_NEAR(meshlet.coneAxis.y, 1, 1e-5f);
+        EXPECT_NEAR(meshlet.coneCutoff, 0, 1e-3f);
+    }
+    EXPECT_EQ(next, indices.size());
+    EXPECT_EQ(triangles, meshletTriangles);
+
+    // a grid meshlet grows next to itself, most of them are nearly full
+    EXPECT_LT(meshlets.size(), indices.size() / 3 / Meshlet::MAX_TRIANGLES * 2);
+}
+
+// the triangles of a shuffled meshlet are reordered within its range and transform fewer vertices
+TEST(Meshlets, OptimizeVertexCache)
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    CreateGrid(64, positions, indices);
+    std::vector<Meshlet> meshlets = BuildMeshlets(positions, indices);
+
+    std::mt19937 random(5);
+    std::vector<std::multiset<std::array<uint32_t, 3>>> meshletTriangles;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        std::vector<std::array<uint32_t, 3>> triangles;
+        for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.triangleCount * 3; i += 3)
+            triangles.push_back({indices[i], indices[i + 1], indices[i + 2]});
+        std::shuffle(triangles.begin(), triangles.end(), random);
+        for (size_t t = 0; t < triangles.size(); ++t)
+            std::copy(triangles[t].begin(), triangles[t].end(), indices.begin() + meshlet.firstIndex + t * 3);
+        meshletTriangles.emplace_back(triangles.begin(), triangles.end());
+    }
+    float shuffled = AnalyzeVertexCache(indices, positions.size());
+
+    OptimizeMeshletVertexCache(meshlets, indices, positions.size());
+    for (size_t m = 0; m < meshlets.size(); ++m)
+    {
+        std::multiset<std::array<uint32_t, 3>> triangles;
+        for (uint32_t i = meshlets[m].firstIndex; i < meshlets[m].firstIndex + meshlets[m].triangleCount * 3; i += 3)
+            triangles.insert({indices[i], indices[i + 1], indices[i + 2]});
+        EXPECT_EQ(triangles, meshletTriangles[m]);
+    }
+    EXPECT_LT(AnalyzeVertexCache(indices, positions.size()), shuffled * 0.75f);
+}
+
+TEST(Meshlets, Culling)
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    CreateGrid(32, positions, indices);
+    std::vector<Meshlet> meshlets = BuildMeshlets(positions, indices);
+
+    auto inside = BoxPlanes(glm::vec3(-1), glm::vec3(33));
+    auto half = BoxPlanes(glm::vec3(-1), glm::vec3(8, 1, 33));
+    glm::vec3 below = {16, -100, 16};
+    glm::vec3 above = {16, 10, 16};
+    uint32_t halfVisible = 0;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        EXPECT_TRUE(IsMeshletVisible(meshlet, inside, nullptr));
+        // the grid's triangles face +y, they're back facing from below
+        EXPECT_TRUE(IsMeshletVisible(meshlet, inside, &above));
+        EXPECT_FALSE(IsMeshletVisible(meshlet, inside, &below));
+        halfVisible += IsMeshletVisible(meshlet, half, nullptr);
+    }
+    EXPECT_GT(halfVisible, 0u);
+    EXPECT_LT(halfVisible, meshlets.size());
+}
+
+// builds the meshlets of 1M triangles
+TEST(Meshlets, Grid1M)
+{
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    CreateGrid(708, positions, indices);
+
+    using Clock = std::chrono::high_resolution_clock;
+    auto start = Clock::now();
+    std::vector<Meshlet> meshlets = BuildMeshlets(positions, indices);
+    double time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    spdlog::info("built {} meshlets of {} triangles in {:.2f}ms", meshlets.size(), indices.size() / 3, time);
+    EXPECT_GT(meshlets.size(), 0u);
+}
@@ -0,0 +1,101 @@
+#include "Rendering/ParallelCommandRecorder.hpp"
+#include "WeilanEngine.hpp"
+#include <chrono>
+#include <limits>
+#include <gtest/gtest.h>
+#include <spdlog/spdlog.h>
+using namespace Engine;
+
+// records the same draws with one and with every thread, works on a software driver like lavapipe
+TEST(ParallelCommandRecorder, Benchmark)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+
+    const size_t drawCount = 50000;
+    Shader shader("Assets/Shaders/Utils/CopyOnly.shad");
+    Gfx::ShaderProgram* program = shader.GetDefaultShaderProgram();
+
+    Gfx::ImageDescription imageDesc{
+        .width = 64,
+        .height = 64,
+        .format = Gfx::ImageFormat::R8G8B8A8_UNorm,
+        .multiSampling = Gfx::MultiSampling::Sample_Count_1,
+        .mipLevels = 1,
+        .isCubemap = false,
+    };
+    std::unique_ptr<Gfx::Image> target = GetGfxDriver()->CreateImage(imageDesc, Gfx::ImageUsage::ColorAttachment);
+    std::unique_ptr<Gfx::Image> source = GetGfxDriver()->CreateImage(imageDesc, Gfx::ImageUsage::Texture);
+    std::unique_ptr<Gfx::ShaderResource> resource = GetGfxDriver()->CreateShaderResource();
+    resource->SetImage("source", source.get());
+
+    std::unique_ptr<Gfx::RenderPass> renderPass = GetGfxDriver()->CreateRenderPass();
+    renderPass->AddSubpass(
+        {{
+            .imageView = &target->GetDefaultImageView(),
+            .loadOp = Gfx::AttachmentLoadOperation::Clear,
+            .storeOp = Gfx::AttachmentStoreOperation::Store,
+        }},
+        std::nullopt
+    );
+    std::vector<Gfx::ClearValue> clearValues(1);
+
+    auto queueFamilyIndex = GetGfxDriver()->GetQueue(QueueType::Main)->GetFamilyIndex();
+    std::unique_ptr<Gfx::CommandPool> cmdPool = GetGfxDriver()->CreateCommandPool({queueFamilyIndex});
+    std::unique_ptr<Gfx::CommandBuffer> cmd = cmdPool->AllocateCommandBuffers(Gfx::CommandBufferType::Primary, 1)[0];
+
+    float lod = 0;
+    auto recordDraws = [&](Gfx::CommandBuffer& cmd, size_t begin, size_t end)
+    {
+        cmd.SetViewport({.x = 0, .y = 0, .width = 64, .height = 64, .minDepth = 0, .maxDepth = 1});
+        Rect2D rect = {{0, 0}, {64, 64}};
+        cmd.SetScissor(0, 1, &rect);
+        for (size_t i = begin; i < end; ++i)
+        {
+            cmd.BindShaderProgram(program, program->GetDefaultShaderConfig());
+            cmd.BindResource(2, resource.get());
+            cmd.SetPushConstant(program, &lod);
+            cmd.Draw(6, 1, 0, 0);
+        }
+    };
+
+    // the pipeline is created on the first bind, keep it out of the measurement
+    program->WarmUp(program->GetDefaultShaderConfig(), *renderPass, 0);
+
+    auto measure = [&](uint32_t threadCount)
+    {
+        ThreadPool threadPool(threadCount);
+        ParallelCommandRecorder recorder(threadPool);
+        bool parallel = recorder.IsParallel(drawCount);
+        double best = std::numeric_limits<double>::max();
+        for (int iteration = 0; iteration < 5; ++iteration)
+        {
+            using Clock = std::chrono::high_resolution_clock;
+            auto start = Clock::now();
+            cmdPool->ResetCommandPool();
+            cmd->Begin();
+            cmd->BeginRenderPass(
+                *renderPass,
+                clearValues,
+                parallel ? Gfx::SubpassContents::Secondary_Command_Buffers : Gfx::SubpassContents::Inline
+            );
+            recorder.Record(*cmd, *renderPass, 0, drawCount, recordDraws);
+            cmd->EndRenderPass();
+            cmd->End();
+            best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+
+        // every draw pushes its constants once, the secondaries' stats are merged into the primary
+        auto& pushConstant = cmd->GetStats().pushConstant;
+        EXPECT_EQ(pushConstant.issued + pushConstant.skipped, drawCount);
+        return std::make_pair(recorder.GetThreadCount(), best);
+    };
+
+    auto [singleThreads, singleTime] = measure(1);
+    auto [threadCount, parallelTime] = measure(0);
+    spdlog::info("recording {} draws: {} thread {:.2f}ms, {} threads {:.2f}ms", drawCount, singleThreads, singleTime,
+                 threadCount, parallelTime);
+
+    GetGfxDriver()->WaitForIdle();
+    engine = nullptr;
+}
@@ -0,0 +1,46 @@
+#include "Libs/RadixSort.hpp"
+#include "Libs/ThreadPool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <random>
+#include <spdlog/spdlog.h>
+using namespace Engine;
+
+// compares with std::stable_sort, keys repeat so that a broken order of equal keys shows in the values
+TEST(RadixSort, MatchesStableSort)
+{
+    std::mt19937_64 random(7);
+    ThreadPool threadPool;
+    for (size_t count : {0, 1, 100, 5000, 300000})
+    {
+        std::vector<uint64_t> keys(count);
+        std::vector<uint32_t> values(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            keys[i] = (random() % 1000) << 40 | (random() % 16);
+            values[i] = i;
+        }
+
+        std::vector<uint32_t> expected = values;
+        std::stable_sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+        for (ThreadPool* pool : {(ThreadPool*)nullptr, &threadPool})
+        {
+            std::vector<uint64_t> sortedKeys = keys;
+            std::vector<uint32_t> sortedValues = values;
+
+            using Clock = std::chrono::high_resolution_clock;
+            auto start = Clock::now();
+            RadixSort(sortedKeys, sortedValues, pool);
+            double time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+            EXPECT_EQ(sortedValues, expected);
+            if (count >= 100000)
+            {
+                uint32_t threadCount = pool ? pool->GetThreadCount() : 1;
+                spdlog::info("radix sort of {} keys with {} threads: {:.2f}ms", count, threadCount, time);
+            }
+        }
+    }
+}
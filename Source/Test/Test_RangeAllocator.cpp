@@ -0,0 +1,63 @@
+#include "Libs/RangeAllocator.hpp"
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+using namespace Engine;
+
+TEST(RangeAllocator, AlignsAndMerges)
+{
+    RangeAllocator allocator(100);
+    EXPECT_EQ(allocator.Allocate(10), 0u);
+    EXPECT_EQ(allocator.Allocate(10, 16), 16u);
+    // the padding between the two is still free
+    EXPECT_EQ(allocator.Allocate(6), 10u);
+    EXPECT_EQ(allocator.Allocate(100), RangeAllocator::INVALID);
+    EXPECT_EQ(allocator.GetFreeSize(), 74u);
+
+    allocator.Free(10, 6);
+    allocator.Free(0, 10);
+    allocator.Free(16, 10);
+    EXPECT_EQ(allocator.GetFreeSize(), 100u);
+    EXPECT_EQ(allocator.Allocate(100), 0u);
+}
+
+// random allocations never overlap and freeing everything gives back one range
+TEST(RangeAllocator, RandomAllocations)
+{
+    std::mt19937 random(3);
+    RangeAllocator allocator(1 << 16);
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    std::vector<bool> used(1 << 16, false);
+    for (int i = 0; i < 2000; ++i)
+    {
+        if (ranges.empty() || random() % 3 != 0)
+        {
+            uint64_t size = random() % 200 + 1;
+            uint64_t alignment = 1 << (random() % 4);
+            uint64_t offset = allocator.Allocate(size, alignment);
+            if (offset == RangeAllocator::INVALID)
+                continue;
+            EXPECT_EQ(offset % alignment, 0u);
+            for (uint64_t j = offset; j < offset + size; ++j)
+            {
+                EXPECT_FALSE(used[j]);
+                used[j] = true;
+            }
+            ranges.push_back({offset, size});
+        }
+        else
+        {
+            size_t index = random() % ranges.size();
+            auto [offset, size] = ranges[index];
+            for (uint64_t j = offset; j < offset + size; ++j)
+                used[j] = false;
+            allocator.Free(offset, size);
+            ranges[index] = ranges.back();
+            ranges.pop_back();
+        }
+    }
+
+    for (auto [offset, size] : ranges)
+        allocator.Free(offset, size);
+    EXPECT_EQ(allocator.Allocate(1 << 16), 0u);
+}
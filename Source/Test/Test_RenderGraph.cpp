@@ -0,0 +1,706 @@
+#include "GfxDriver/Vulkan/VKRenderPass.hpp"
+#include "Libs/TopologicalSort.hpp"
+#include "Rendering/RenderGraph/Errors.hpp"
+#include "Rendering/RenderGraph/Graph.hpp"
+#include "WeilanEngine.hpp"
+#include <algorithm>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <spdlog/spdlog.h>
+
+using namespace Engine;
+
+TEST(RenderGraph, TopologicalSort)
+{
+    // 0 -> 2, 1 -> 2, 2 -> 3
+    std::vector<std::vector<size_t>> dependents = {{2}, {2}, {3}, {}};
+    auto order = TopologicalSort(dependents);
+    ASSERT_TRUE(order.has_value());
+    ASSERT_EQ(order->size(), 4);
+    EXPECT_EQ(order->back(), 3);
+    EXPECT_EQ((*order)[2], 2);
+
+    // 3 -> 1 closes 1 -> 2 -> 3
+    dependents[3].push_back(1);
+    EXPECT_FALSE(TopologicalSort(dependents).has_value());
+}
+
+// every node writes one buffer and reads the buffers of up to fanIn nodes added after it, so the order the nodes are
+// added in is the reverse of a valid order
+static std::vector<RenderGraph::RenderNode*> BuildSyntheticGraph(RenderGraph::Graph& graph, int nodeCount, int fanIn)
+{
+    std::vector<RenderGraph::RenderNode*> nodes;
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        std::vector<RenderGraph::RenderPass::ResourceDescription> descs;
+        for (int h = 0; h <= fanIn; ++h)
+        {
+            descs.push_back({
+                .name = h == 0 ? "out" : "in",
+                .handle = (RenderGraph::ResourceHandle)h,
+                .type = RenderGraph::ResourceType::Buffer,
+                .accessFlags = h == 0 ? Gfx::AccessMask::Shader_Write : Gfx::AccessMask::Shader_Read,
+                .stageFlags = Gfx::PipelineStage::Compute_Shader,
+            });
+        }
+        nodes.push_back(graph.AddNode(nullptr, descs, {}));
+    }
+
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        for (int h = 1; h <= fanIn && i + h < nodeCount; ++h)
+            RenderGraph::Graph::Connect(nodes[i + h], 0, nodes[i], h);
+    }
+
+    return nodes;
+}
+
+TEST(RenderGraph, SortBenchmark)
+{
+    const int nodeCount = 500;
+    RenderGraph::Graph graph;
+    auto nodes = BuildSyntheticGraph(graph, nodeCount, 4);
+
+    using Clock = std::chrono::high_resolution_clock;
+    auto start = Clock::now();
+    std::vector<RenderGraph::RenderNode*> sorted = graph.SortNodes();
+    auto sortTime = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    ASSERT_EQ(sorted.size(), nodeCount);
+    // nodes[i] reads from nodes[i + 1 .. i + 4]
+    std::unordered_map<RenderGraph::RenderNode*, size_t> positions;
+    for (size_t i = 0; i < sorted.size(); ++i)
+        positions[sorted[i]] = i;
+    for (int i = 0; i + 1 < nodeCount; ++i)
+        EXPECT_LT(positions[nodes[i + 1]], positions[nodes[i]]);
+
+    spdlog::info("sorting a {} node graph with fan-in 4 took {:.1f}us", nodeCount, sortTime);
+}
+
+TEST(RenderGraph, SortDetectsCycle)
+{
+    RenderGraph::Graph graph;
+    auto nodes = BuildSyntheticGraph(graph, 3, 1);
+    RenderGraph::Graph::Connect(nodes[0], 0, nodes[2], 1);
+
+    EXPECT_THROW(graph.SortNodes(), RenderGraph::Errrors::GraphCompile);
+}
+
+// runs a few frames of a small graph and writes the pass timings to a csv file, works on a software driver like
+// lavapipe
+TEST(RenderGraph, GpuTimings)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+    if (!GetGfxDriver()->GetGPUFeatures().timestamps)
+    {
+        engine = nullptr;
+        GTEST_SKIP() << "the device doesn't support timestamp queries";
+    }
+
+    auto clear = [](Gfx::CommandBuffer& cmd, Gfx::RenderPass& pass, const RenderGraph::ResourceRefs&)
+    {
+        std::vector<Gfx::ClearValue> clears(1);
+        cmd.BeginRenderPass(pass, clears);
+        cmd.EndRenderPass();
+    };
+
+    {
+        RenderGraph::Graph graph;
+        RenderGraph::RenderNode* first = graph.AddNode("first")
+                                             .AllocateRT("color", 0, 256, 256, Gfx::ImageFormat::R8G8B8A8_UNorm)
+                                             .AddColor(0)
+                                             .SetExecFunc(clear)
+                                             .Finish();
+        RenderGraph::RenderNode* second = graph.AddNode("second")
+                                              .InputRT("color", 0)
+                                              .AddColor(0, false, Gfx::AttachmentLoadOperation::Load)
+                                              .SetExecFunc(clear)
+                                              .Finish();
+        RenderGraph::Graph::Connect(first, 0, second, 0);
+        graph.Export(second, 0);
+        graph.Process();
+
+        std::filesystem::path csv = std::filesystem::path(TEMP_FILE_DIR) / "render_graph_timings.csv";
+        graph.SetTimingCsv(csv);
+
+        auto queue = GetGfxDriver()->GetQueue(QueueType::Main);
+        std::unique_ptr<Gfx::CommandPool> cmdPool = GetGfxDriver()->CreateCommandPool({queue->GetFamilyIndex()});
+        std::unique_ptr<Gfx::CommandBuffer> cmd =
+            cmdPool->AllocateCommandBuffers(Gfx::CommandBufferType::Primary, 1)[0];
+        for (int frame = 0; frame < 8; ++frame)
+        {
+            cmdPool->ResetCommandPool();
+            cmd->Begin();
+            graph.Execute(*cmd);
+            cmd->End();
+            Gfx::CommandBuffer* cmdBufs[] = {cmd.get()};
+            GetGfxDriver()->QueueSubmit(queue, cmdBufs, {}, {}, {}, nullptr);
+            GetGfxDriver()->WaitForIdle();
+        }
+        graph.SetTimingCsv({});
+
+        auto timings = graph.GetPassTimings();
+        ASSERT_FALSE(timings.empty());
+        bool hasFirst = false;
+        bool hasSecond = false;
+        for (auto& timing : timings)
+        {
+            hasFirst |= timing.name.find("first") != std::string::npos;
+            hasSecond |= timing.name.find("second") != std::string::npos;
+            EXPECT_GE(timing.gpuTime, 0);
+            spdlog::info("{}: {:.3f}ms", timing.name, timing.gpuTime);
+        }
+        EXPECT_TRUE(hasFirst);
+        EXPECT_TRUE(hasSecond);
+        EXPECT_GT(std::filesystem::file_size(csv), 0);
+    }
+
+    GetGfxDriver()->WaitForIdle();
+    engine = nullptr;
+}
+
+static RenderGraph::RenderPass::ResourceDescription BufferUse(
+    RenderGraph::ResourceHandle handle,
+    Gfx::AccessMaskFlags access,
+    Gfx::PipelineStageFlags stages,
+    bool create = false
+)
+{
+    RenderGraph::RenderPass::ResourceDescription desc{
+        .name = "buffer",
+        .handle = handle,
+        .type = RenderGraph::ResourceType::Buffer,
+        .accessFlags = access,
+        .stageFlags = stages,
+    };
+    if (create)
+        desc.bufferCreateInfo = {.usages = Gfx::BufferUsage::Storage, .size = 256, .visibleInCPU = false};
+    return desc;
+}
+
+static std::vector<RenderGraph::Graph::PlannedBarrierEntry> GetBarriersBefore(
+    RenderGraph::Graph& graph, const std::string& dst
+)
+{
+    std::vector<RenderGraph::Graph::PlannedBarrierEntry> barriers;
+    for (auto& b : graph.GetPlannedBarriers())
+    {
+        if (b.dst == dst)
+            barriers.push_back(b);
+    }
+    return barriers;
+}
+
+// a buffer is written, read twice by one node and written again, an attachment is sampled after it's drawn
+TEST(RenderGraph, PlanBarriers)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+
+    {
+        using namespace Gfx;
+        RenderGraph::Graph graph;
+        RenderGraph::RenderNode* write =
+            graph.AddNode(nullptr, {BufferUse(0, AccessMask::Shader_Write, PipelineStage::Compute_Shader, true)}, {});
+        write->SetName("write");
+        RenderGraph::RenderNode* read = graph.AddNode(
+            nullptr,
+            {
+                BufferUse(0, AccessMask::Shader_Read, PipelineStage::Compute_Shader),
+                BufferUse(1, AccessMask::Indirect_Command_Read, PipelineStage::Draw_Indirect),
+            },
+            {}
+        );
+        read->SetName("read");
+        RenderGraph::RenderNode* overwrite =
+            graph.AddNode(nullptr, {BufferUse(0, AccessMask::Shader_Write, PipelineStage::Compute_Shader)}, {});
+        overwrite->SetName("overwrite");
+        RenderGraph::Graph::Connect(write, 0, read, 0);
+        RenderGraph::Graph::Connect(write, 0, read, 1);
+        RenderGraph::Graph::Connect(read, 0, overwrite, 0);
+        graph.Export(overwrite, 0);
+
+        RenderGraph::RenderNode* draw = graph.AddNode("draw")
+                                            .AllocateRT("color", 0, 64, 64, ImageFormat::R8G8B8A8_UNorm)
+                                            .AddColor(0)
+                                            .Finish();
+        RenderGraph::RenderNode* sample =
+            graph.AddNode("sample").InputTexture("color", 0, PipelineStage::Fragment_Shader).Finish();
+        RenderGraph::Graph::Connect(draw, 0, sample, 0);
+        graph.Export(sample, 0);
+        graph.Process();
+
+        // the first frame's uses don't wait for anything
+        EXPECT_TRUE(GetBarriersBefore(graph, "write").empty());
+
+        // read after write, the two uses of the same node are merged into one barrier
+        auto readBarriers = GetBarriersBefore(graph, "read");
+        ASSERT_EQ(readBarriers.size(), 1);
+        EXPECT_EQ(readBarriers[0].src, "write");
+        EXPECT_EQ(readBarriers[0].barrier.srcStageMask, PipelineStage::Compute_Shader);
+        EXPECT_EQ(readBarriers[0].barrier.srcAccessMask, AccessMask::Shader_Write);
+        EXPECT_EQ(readBarriers[0].barrier.dstStageMask, PipelineStage::Compute_Shader | PipelineStage::Draw_Indirect);
+        EXPECT_EQ(
+            readBarriers[0].barrier.dstAccessMask,
+            AccessMask::Shader_Read | AccessMask::Indirect_Command_Read
+        );
+
+        // write after write and after read waits for the readers too, only the write is made available
+        auto overwriteBarriers = GetBarriersBefore(graph, "overwrite");
+        ASSERT_EQ(overwriteBarriers.size(), 1);
+        EXPECT_EQ(overwriteBarriers[0].src, "read");
+        EXPECT_TRUE(HasFlag(overwriteBarriers[0].barrier.srcStageMask, PipelineStage::Draw_Indirect));
+        EXPECT_TRUE(HasFlag(overwriteBarriers[0].barrier.srcStageMask, PipelineStage::Compute_Shader));
+        EXPECT_EQ(overwriteBarriers[0].barrier.srcAccessMask, AccessMask::Shader_Write);
+        EXPECT_EQ(overwriteBarriers[0].barrier.dstAccessMask, AccessMask::Shader_Write);
+
+        // the attachment is transitioned to be sampled
+        auto sampleBarriers = GetBarriersBefore(graph, "sample");
+        ASSERT_EQ(sampleBarriers.size(), 1);
+        EXPECT_EQ(sampleBarriers[0].src, "draw");
+        EXPECT_EQ(sampleBarriers[0].barrier.imageInfo.oldLayout, ImageLayout::Color_Attachment);
+        EXPECT_EQ(sampleBarriers[0].barrier.imageInfo.newLayout, ImageLayout::Shader_Read_Only);
+        EXPECT_EQ(sampleBarriers[0].barrier.srcStageMask, PipelineStage::Color_Attachment_Output);
+        EXPECT_EQ(sampleBarriers[0].barrier.srcAccessMask, AccessMask::Color_Attachment_Write);
+        EXPECT_EQ(sampleBarriers[0].barrier.dstStageMask, PipelineStage::Fragment_Shader);
+        EXPECT_EQ(sampleBarriers[0].barrier.dstAccessMask, AccessMask::Shader_Read);
+    }
+
+    GetGfxDriver()->WaitForIdle();
+    engine = nullptr;
+}
+
+// barriers with the same stages share a batch unless a barrier on the same subresource comes between them
+TEST(RenderGraph, BatchBarriers)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+
+    {
+        using namespace Gfx;
+        ImageDescription desc{
+            .width = 64,
+            .height = 64,
+            .format = ImageFormat::R8G8B8A8_UNorm,
+            .multiSampling = MultiSampling::Sample_Count_1,
+            .mipLevels = 2,
+            .isCubemap = false,
+        };
+        std::unique_ptr<Image> a = GetGfxDriver()->CreateImage(desc, ImageUsage::Texture | ImageUsage::TransferSrc);
+        std::unique_ptr<Image> b = GetGfxDriver()->CreateImage(desc, ImageUsage::Texture | ImageUsage::TransferSrc);
+        ImageSubresourceRange mip0 = a->GetSubresourceRange();
+        mip0.levelCount = 1;
+        ImageSubresourceRange mip1 = mip0;
+        mip1.baseMipLevel = 1;
+
+        auto transition = [](Image* image,
+                             ImageSubresourceRange range,
+                             PipelineStageFlags src,
+                             PipelineStageFlags dst,
+                             ImageLayout oldLayout,
+                             ImageLayout newLayout)
+        {
+            return GPUBarrier{
+                .image = image,
+                .srcStageMask = src,
+                .dstStageMask = dst,
+                .imageInfo = {.oldLayout = oldLayout, .newLayout = newLayout, .subresourceRange = range},
+            };
+        };
+        const PipelineStageFlags compute = PipelineStage::Compute_Shader;
+        const PipelineStageFlags fragment = PipelineStage::Fragment_Shader;
+        const PipelineStageFlags transfer = PipelineStage::Transfer;
+        std::vector<GPUBarrier> barriers = {
+            transition(a.get(), mip0, compute, fragment, ImageLayout::General, ImageLayout::Shader_Read_Only),
+            transition(a.get(), mip0, fragment, transfer, ImageLayout::Shader_Read_Only, ImageLayout::Transfer_Src),
+            // other images and other subresources don't have to wait
+            transition(b.get(), mip0, compute, fragment, ImageLayout::General, ImageLayout::Shader_Read_Only),
+            transition(a.get(), mip1, compute, fragment, ImageLayout::General, ImageLayout::Shader_Read_Only),
+            // has to come after the second transition of mip 0
+            transition(a.get(), mip0, compute, fragment, ImageLayout::Transfer_Src, ImageLayout::Shader_Read_Only),
+        };
+
+        EXPECT_EQ(BatchBarriers(barriers), (std::vector<uint32_t>{0, 1, 0, 0, 2}));
+    }
+
+    GetGfxDriver()->WaitForIdle();
+    engine = nullptr;
+}
+
+// a gbuffer pass, a lighting pass reading it as an input attachment and a pass blending onto the lit image are recorded
+// as the subpasses of one render pass. The barriers from the compute pass before them move in front of the render pass
+TEST(RenderGraph, MergeRenderPasses)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+
+    {
+        using namespace Gfx;
+        auto draw = [](CommandBuffer& cmd, RenderPass& pass, const RenderGraph::ResourceRefs&)
+        {
+            std::vector<ClearValue> clears(2);
+            cmd.BeginRenderPass(pass, clears);
+            cmd.EndRenderPass();
+        };
+
+        RenderGraph::Graph graph;
+        RenderGraph::RenderNode* compute =
+            graph.AddNode(nullptr, {BufferUse(0, AccessMask::Shader_Write, PipelineStage::Compute_Shader, true)}, {});
+        compute->SetName("compute");
+        RenderGraph::RenderNode* gbuffer = graph.AddNode("gbuffer")
+                                               .AllocateRT("albedo", 0, 64, 64, ImageFormat::R8G8B8A8_UNorm)
+                                               .AddColor(0)
+                                               .InputBuffer("data", 2, PipelineStage::Vertex_Shader)
+                                               .SetExecFunc(draw)
+                                               .SetMergeable(true)
+                                               .Finish();
+        RenderGraph::RenderNode* lighting = graph.AddNode("lighting")
+                                                .InputRT("albedo", 0)
+                                                .AddInputAttachment(0)
+                                                .AllocateRT("lit", 1, 64, 64, ImageFormat::R8G8B8A8_UNorm)
+                                                .AddColor(1)
+                                                .InputBuffer("data", 2, PipelineStage::Fragment_Shader)
+                                                .SetExecFunc(draw)
+                                                .SetMergeable(true)
+                                                .Finish();
+        RenderGraph::RenderNode* blend = graph.AddNode("blend")
+                                             .InputRT("lit", 1)
+                                             .AddColor(1, true, AttachmentLoadOperation::Load)
+                                             .SetExecFunc(draw)
+                                             .SetMergeable(true)
+                                             .Finish();
+        RenderGraph::Graph::Connect(compute, 0, gbuffer, 2);
+        RenderGraph::Graph::Connect(compute, 0, lighting, 2);
+        RenderGraph::Graph::Connect(gbuffer, 0, lighting, 0);
+        RenderGraph::Graph::Connect(lighting, 1, blend, 1);
+        graph.Export(blend, 1);
+        graph.Process();
+
+        auto& stats = graph.GetRenderPassStats();
+        EXPECT_EQ(stats.renderPassCount, 1);
+        EXPECT_EQ(stats.mergedPassCount, 2);
+        // the albedo is only read inside the render pass
+        EXPECT_EQ(stats.discardedAttachmentCount, 1);
+
+        RenderPass* renderPass = gbuffer->GetPass()->GetGfxRenderPass();
+        EXPECT_EQ(lighting->GetPass()->GetGfxRenderPass(), renderPass);
+        EXPECT_EQ(blend->GetPass()->GetGfxRenderPass(), renderPass);
+        EXPECT_EQ(gbuffer->GetPass()->GetSubpassIndex(), 0);
+        EXPECT_EQ(lighting->GetPass()->GetSubpassIndex(), 1);
+        EXPECT_EQ(blend->GetPass()->GetSubpassIndex(), 2);
+
+        // the subpass dependencies cover the uses inside the render pass
+        EXPECT_TRUE(GetBarriersBefore(graph, "lighting").empty());
+        EXPECT_TRUE(GetBarriersBefore(graph, "blend").empty());
+
+        // both reads of the compute pass' buffer are waited for by one barrier in front of the render pass
+        uint32_t bufferBarrierCount = 0;
+        for (auto& b : GetBarriersBefore(graph, "gbuffer"))
+        {
+            if (b.barrier.buffer == nullptr)
+                continue;
+            bufferBarrierCount += 1;
+            EXPECT_EQ(b.src, "compute");
+            EXPECT_EQ(b.barrier.dstStageMask, PipelineStage::Vertex_Shader | PipelineStage::Fragment_Shader);
+        }
+        EXPECT_EQ(bufferBarrierCount, 1);
+
+        // the lighting subpass waits for the gbuffer subpass, the blend subpass for the lighting subpass
+        VKRenderPass* vkRenderPass = static_cast<VKRenderPass*>(renderPass);
+        ASSERT_NE(vkRenderPass->GetHandle(), VK_NULL_HANDLE);
+        std::vector<std::pair<uint32_t, uint32_t>> dependencies;
+        for (const VkSubpassDependency& d : vkRenderPass->GetSubpassDependencies())
+        {
+            dependencies.push_back({d.srcSubpass, d.dstSubpass});
+            EXPECT_TRUE(d.dependencyFlags & VK_DEPENDENCY_BY_REGION_BIT);
+        }
+        EXPECT_EQ(
+            dependencies,
+            (std::vector<std::pair<uint32_t, uint32_t>>{{VK_SUBPASS_EXTERNAL, 0}, {0, 1}, {1, 2}})
+        );
+
+        auto queue = GetGfxDriver()->GetQueue(QueueType::Main);
+        std::unique_ptr<CommandPool> cmdPool = GetGfxDriver()->CreateCommandPool({queue->GetFamilyIndex()});
+        std::unique_ptr<CommandBuffer> cmd = cmdPool->AllocateCommandBuffers(CommandBufferType::Primary, 1)[0];
+        cmd->Begin();
+        graph.Execute(*cmd);
+        cmd->End();
+        CommandBuffer* cmdBufs[] = {cmd.get()};
+        GetGfxDriver()->QueueSubmit(queue, cmdBufs, {}, {}, {}, nullptr);
+        GetGfxDriver()->WaitForIdle();
+    }
+
+    engine = nullptr;
+}
+
+// rebuilding the same graph takes back the render passes and the barrier plan, a change only finalizes the passes
+// whose attachments changed
+TEST(RenderGraph, RecompileReuse)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+
+    {
+        using namespace Gfx;
+        RenderGraph::Graph graph;
+        RenderGraph::RenderNode* first = nullptr;
+        RenderGraph::RenderNode* second = nullptr;
+        auto build = [&](uint32_t secondSize)
+        {
+            graph.Clear();
+            first = graph.AddNode("first")
+                        .AllocateRT("a", 0, 64, 64, ImageFormat::R8G8B8A8_UNorm)
+                        .AddColor(0)
+                        .Finish();
+            second = graph.AddNode("second")
+                         .InputTexture("a", 0, PipelineStage::Fragment_Shader)
+                         .AllocateRT("b", 1, secondSize, secondSize, ImageFormat::R8G8B8A8_UNorm)
+                         .AddColor(1)
+                         .Finish();
+            RenderGraph::Graph::Connect(first, 0, second, 0);
+            graph.Export(second, 1);
+            graph.Process();
+        };
+
+        build(64);
+        EXPECT_EQ(graph.GetCompileStats().finalizedPassCount, 2);
+        EXPECT_EQ(graph.GetCompileStats().reusedPassCount, 0);
+        EXPECT_FALSE(graph.GetCompileStats().reusedBarrierPlan);
+        RenderPass* firstRenderPass = first->GetPass()->GetGfxRenderPass();
+        RenderPass* secondRenderPass = second->GetPass()->GetGfxRenderPass();
+        size_t barrierCount = graph.GetPlannedBarriers().size();
+
+        build(64);
+        EXPECT_EQ(graph.GetCompileStats().finalizedPassCount, 0);
+        EXPECT_EQ(graph.GetCompileStats().reusedPassCount, 2);
+        EXPECT_TRUE(graph.GetCompileStats().reusedBarrierPlan);
+        EXPECT_EQ(first->GetPass()->GetGfxRenderPass(), firstRenderPass);
+        EXPECT_EQ(second->GetPass()->GetGfxRenderPass(), secondRenderPass);
+        EXPECT_EQ(graph.GetPlannedBarriers().size(), barrierCount);
+
+        // only the second pass renders to a new image
+        build(32);
+        EXPECT_EQ(graph.GetCompileStats().finalizedPassCount, 1);
+        EXPECT_EQ(graph.GetCompileStats().reusedPassCount, 1);
+        EXPECT_FALSE(graph.GetCompileStats().reusedBarrierPlan);
+        EXPECT_EQ(first->GetPass()->GetGfxRenderPass(), firstRenderPass);
+    }
+
+    GetGfxDriver()->WaitForIdle();
+    engine = nullptr;
+}
+
+// an image resized after Process is recreated with the passes using it, the other images are kept
+TEST(RenderGraph, ResizeImages)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+
+    {
+        using namespace Gfx;
+        auto draw = [](CommandBuffer& cmd, RenderPass& pass, const RenderGraph::ResourceRefs&)
+        {
+            std::vector<ClearValue> clears(1);
+            cmd.BeginRenderPass(pass, clears);
+            cmd.EndRenderPass();
+        };
+
+        RenderGraph::Graph graph;
+        RenderGraph::RenderNode* scaled = graph.AddNode("scaled")
+                                              .AllocateRT("color", 0, 64, 64, ImageFormat::R8G8B8A8_UNorm)
+                                              .AddColor(0)
+                                              .SetExecFunc(draw)
+                                              .Finish();
+        RenderGraph::RenderNode* sample =
+            graph.AddNode("sample").InputTexture("color", 0, PipelineStage::Fragment_Shader).Finish();
+        RenderGraph::RenderNode* fixed = graph.AddNode("fixed")
+                                             .AllocateRT("color", 0, 64, 64, ImageFormat::R8G8B8A8_UNorm)
+                                             .AddColor(0)
+                                             .SetExecFunc(draw)
+                                             .Finish();
+        RenderGraph::Graph::Connect(scaled, 0, sample, 0);
+        graph.Export(sample, 0);
+        graph.Export(fixed, 0);
+
+        // sized before Process like a frame graph node does
+        scaled->GetPass()->SetImageExtent(0, 64, 64);
+        graph.Process();
+        Image* fixedImage = (Image*)fixed->GetPass()->GetResourceRef(0)->GetResource();
+
+        scaled->GetPass()->SetImageExtent(0, 32, 32);
+        EXPECT_TRUE(graph.ResizeImages());
+
+        auto image = (Image*)sample->GetPass()->GetResourceRef(0)->GetResource();
+        EXPECT_EQ(image->GetDescription().width, 32u);
+        EXPECT_EQ(image->GetDescription().height, 32u);
+        EXPECT_EQ(scaled->GetPass()->GetResourceRef(0)->GetResource(), image);
+        EXPECT_EQ(fixed->GetPass()->GetResourceRef(0)->GetResource(), fixedImage);
+        EXPECT_EQ(&scaled->GetPass()->GetGfxSubpasses()[0].colors[0].imageView->GetImage(), image);
+
+        // the barriers are planned again
+        auto sampleBarriers = GetBarriersBefore(graph, "sample");
+        ASSERT_EQ(sampleBarriers.size(), 1);
+        EXPECT_EQ(sampleBarriers[0].barrier.image.Get(), image);
+
+        // nothing changed
+        EXPECT_TRUE(graph.ResizeImages());
+
+        auto queue = GetGfxDriver()->GetQueue(QueueType::Main);
+        std::unique_ptr<CommandPool> cmdPool = GetGfxDriver()->CreateCommandPool({queue->GetFamilyIndex()});
+        std::unique_ptr<CommandBuffer> cmd = cmdPool->AllocateCommandBuffers(CommandBufferType::Primary, 1)[0];
+        cmd->Begin();
+        graph.Execute(*cmd);
+        cmd->End();
+        CommandBuffer* cmdBufs[] = {cmd.get()};
+        GetGfxDriver()->QueueSubmit(queue, cmdBufs, {}, {}, {}, nullptr);
+        GetGfxDriver()->WaitForIdle();
+    }
+
+    engine = nullptr;
+}
+
+// the passes whose results reach no export and no external resource are culled and their resources aren't created. A
+// pass loading an attachment keeps the pass that drew it
+TEST(RenderGraph, CullNodes)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+
+    {
+        using namespace Gfx;
+        ImageDescription desc{
+            .width = 64,
+            .height = 64,
+            .format = ImageFormat::R8G8B8A8_UNorm,
+            .multiSampling = MultiSampling::Sample_Count_1,
+            .mipLevels = 1,
+            .isCubemap = false,
+        };
+        std::unique_ptr<Image> external = GetGfxDriver()->CreateImage(desc, ImageUsage::ColorAttachment);
+
+        RenderGraph::Graph graph;
+        RenderGraph::RenderNode* draw = graph.AddNode("draw")
+                                            .AllocateRT("color", 0, 64, 64, ImageFormat::R8G8B8A8_UNorm)
+                                            .AddColor(0)
+                                            .Finish();
+        RenderGraph::RenderNode* load = graph.AddNode("load")
+                                            .InputRT("color", 0)
+                                            .AddColor(0, false, AttachmentLoadOperation::Load)
+                                            .Finish();
+        RenderGraph::Graph::Connect(draw, 0, load, 0);
+        graph.Export(load, 0);
+
+        RenderGraph::RenderNode* deadDraw = graph.AddNode("deadDraw")
+                                                .AllocateRT("dead", 0, 64, 64, ImageFormat::R8G8B8A8_UNorm)
+                                                .AddColor(0)
+                                                .Finish();
+        RenderGraph::RenderNode* deadSample =
+            graph.AddNode("deadSample").InputTexture("dead", 0, PipelineStage::Fragment_Shader).Finish();
+        RenderGraph::Graph::Connect(deadDraw, 0, deadSample, 0);
+
+        RenderGraph::RenderNode* drawExternal =
+            graph.AddNode("drawExternal").InputRT("target", 0, external.get()).AddColor(0).Finish();
+        graph.Process();
+
+        auto culled = [&graph](RenderGraph::RenderNode* node)
+        {
+            auto& nodes = graph.GetCulledNodes();
+            return std::find(nodes.begin(), nodes.end(), node) != nodes.end();
+        };
+        EXPECT_EQ(graph.GetCulledNodes().size(), 2);
+        EXPECT_TRUE(culled(deadDraw));
+        EXPECT_TRUE(culled(deadSample));
+        EXPECT_FALSE(culled(draw));
+        EXPECT_FALSE(culled(load));
+        EXPECT_FALSE(culled(drawExternal));
+
+        EXPECT_EQ(deadDraw->GetPass()->GetResourceRef(0)->GetResource(), nullptr);
+        EXPECT_NE(draw->GetPass()->GetResourceRef(0)->GetResource(), nullptr);
+        EXPECT_EQ(drawExternal->GetPass()->GetResourceRef(0)->GetResource(), external.get());
+    }
+
+    GetGfxDriver()->WaitForIdle();
+    engine = nullptr;
+}
+
+// images alive at different times share memory, the first use of each waits for the last use of the image before it.
+// An image drawn to in only one pass is transient
+TEST(RenderGraph, AliasImages)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+
+    {
+        using namespace Gfx;
+        RenderGraph::Graph graph;
+        RenderGraph::RenderNode* drawA = graph.AddNode("drawA")
+                                             .AllocateRT("a", 0, 64, 64, ImageFormat::R8G8B8A8_UNorm)
+                                             .AddColor(0)
+                                             .Finish();
+        RenderGraph::RenderNode* drawB = graph.AddNode("drawB")
+                                             .InputTexture("a", 0, PipelineStage::Fragment_Shader)
+                                             .AllocateRT("b", 1, 64, 64, ImageFormat::R8G8B8A8_UNorm)
+                                             .AddColor(1)
+                                             .Finish();
+        RenderGraph::RenderNode* drawC = graph.AddNode("drawC")
+                                             .InputTexture("b", 0, PipelineStage::Fragment_Shader)
+                                             .AllocateRT("c", 1, 64, 64, ImageFormat::R8G8B8A8_UNorm)
+                                             .AddColor(1)
+                                             .Finish();
+        RenderGraph::RenderNode* finalPass = graph.AddNode("final")
+                                                 .InputTexture("c", 0, PipelineStage::Fragment_Shader)
+                                                 .AllocateRT("out", 1, 64, 64, ImageFormat::R8G8B8A8_UNorm)
+                                                 .AddColor(1)
+                                                 .AllocateRT("depth", 2, 64, 64, ImageFormat::D32_SFloat)
+                                                 .AddDepthStencil(2)
+                                                 .Finish();
+        RenderGraph::Graph::Connect(drawA, 0, drawB, 0);
+        RenderGraph::Graph::Connect(drawB, 1, drawC, 0);
+        RenderGraph::Graph::Connect(drawC, 1, finalPass, 0);
+        graph.Export(finalPass, 1);
+        graph.Process();
+
+        // a is dead after drawB and c is created in drawC, b overlaps both
+        Image* a = (Image*)drawA->GetPass()->GetResourceRef(0)->GetResource();
+        Image* b = (Image*)drawB->GetPass()->GetResourceRef(1)->GetResource();
+        Image* c = (Image*)drawC->GetPass()->GetResourceRef(1)->GetResource();
+        ASSERT_NE(a, nullptr);
+        ASSERT_NE(b, nullptr);
+        ASSERT_NE(c, nullptr);
+        EXPECT_NE(a, c);
+        auto& stats = graph.GetMemoryStats();
+        EXPECT_EQ(stats.renderTargetSize - stats.aliasedRenderTargetSize, c->GetMemorySize());
+        EXPECT_EQ(stats.transientRenderTargetCount, 1);
+
+        auto barriersOn = [&graph](const std::string& dst, Image* image)
+        {
+            std::vector<RenderGraph::Graph::PlannedBarrierEntry> barriers;
+            for (auto& entry : GetBarriersBefore(graph, dst))
+            {
+                if (entry.barrier.image.Get() == image)
+                    barriers.push_back(entry);
+            }
+            return barriers;
+        };
+
+        // c's memory was last sampled as a in drawB
+        auto cBarriers = barriersOn("drawC", c);
+        ASSERT_EQ(cBarriers.size(), 1);
+        EXPECT_EQ(cBarriers[0].src, "drawB");
+        EXPECT_EQ(cBarriers[0].barrier.imageInfo.oldLayout, ImageLayout::Undefined);
+        EXPECT_EQ(cBarriers[0].barrier.imageInfo.newLayout, ImageLayout::Color_Attachment);
+        EXPECT_EQ(cBarriers[0].barrier.srcStageMask, PipelineStage::Fragment_Shader);
+
+        // a's memory was last sampled as c in the previous frame's final pass
+        auto aBarriers = barriersOn("drawA", a);
+        ASSERT_EQ(aBarriers.size(), 1);
+        EXPECT_EQ(aBarriers[0].src, "final");
+        EXPECT_EQ(aBarriers[0].barrier.imageInfo.oldLayout, ImageLayout::Undefined);
+        EXPECT_EQ(aBarriers[0].barrier.imageInfo.newLayout, ImageLayout::Color_Attachment);
+        EXPECT_EQ(aBarriers[0].barrier.srcStageMask, PipelineStage::Fragment_Shader);
+    }
+
+    GetGfxDriver()->WaitForIdle();
+    engine = nullptr;
+}
@@ -0,0 +1,143 @@
+#include "Rendering/FrameGraph/SceneInstances.hpp"
+#include "WeilanEngine.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <gtest/gtest.h>
+using namespace Engine;
+
+// dispatches Game/CullInstances.comp and reads back the draw commands and the indices of the visible instances. The
+// static groups are uploaded in the first frame and reset from their copy in the second
+TEST(SceneInstances, Cull)
+{
+    auto engine = std::make_unique<Engine::WeilanEngine>();
+    engine->Init({});
+
+    {
+        using SceneInstances = FrameGraph::SceneInstances;
+        using CullView = SceneInstances::CullView;
+        ComputeShader cullingShader("Assets/Shaders/Game/CullInstances.comp");
+        SceneInstances instances;
+        instances.SetCullingShader(&cullingShader);
+        if (!instances.IsGpuCullingSupported())
+            GTEST_SKIP() << "no indirect draws";
+
+        std::unique_ptr<Gfx::ShaderResource> sceneResource = GetGfxDriver()->CreateShaderResource();
+        auto queue = GetGfxDriver()->GetQueue(QueueType::Main);
+        std::unique_ptr<Gfx::CommandPool> cmdPool = GetGfxDriver()->CreateCommandPool({queue->GetFamilyIndex()});
+        std::unique_ptr<Gfx::CommandBuffer> cmd =
+            cmdPool->AllocateCommandBuffers(Gfx::CommandBufferType::Primary, 1)[0];
+        auto createReadback = [](size_t size)
+        {
+            return GetGfxDriver()->CreateBuffer(
+                {.usages = Gfx::BufferUsage::Transfer_Dst, .size = size, .visibleInCPU = true, .debugName = "readback"}
+            );
+        };
+        std::unique_ptr<Gfx::Buffer> commandReadback;
+        std::unique_ptr<Gfx::Buffer> indexReadback;
+
+        // the camera is at the origin and looks down -z
+        glm::vec3 cameraPos(0);
+        glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f);
+        glm::mat4 visible = glm::translate(glm::mat4(1), glm::vec3(0, 0, -5));
+        AABB bounds = {glm::vec3(-0.5f), glm::vec3(0.5f)};
+        // the meshlet's triangles face away from the camera unless the model mirrors them
+        glm::vec4 cone(0, 0, -1, 0);
+
+        auto cull = [&]()
+        {
+            instances.SetCullView(CullView::Camera, viewProjection, &cameraPos);
+            for (uint32_t i = 0; i < 4; ++i)
+                instances.ClearCullView(SceneInstances::ShadowCascadeView(i));
+
+            cmdPool->ResetCommandPool();
+            cmd->Begin();
+            instances.Upload(*cmd, *sceneResource);
+            instances.Cull(*cmd);
+
+            Gfx::Buffer* commands = instances.GetDrawCommands();
+            Gfx::Buffer* indices = instances.GetInstanceIndices();
+            Gfx::GPUBarrier barriers[2];
+            for (int i = 0; i < 2; ++i)
+            {
+                barriers[i] = {
+                    .buffer = i == 0 ? commands : indices,
+                    .srcStageMask = Gfx::PipelineStage::Compute_Shader,
+                    .dstStageMask = Gfx::PipelineStage::Transfer,
+                    .srcAccessMask = Gfx::AccessMask::Shader_Write,
+                    .dstAccessMask = Gfx::AccessMask::Transfer_Read,
+                };
+            }
+            cmd->Barrier(barriers, 2);
+            commandReadback = createReadback(commands->GetSize());
+            indexReadback = createReadback(indices->GetSize());
+            cmd->CopyBuffer(commandReadback.get(), commands, commands->GetSize());
+            cmd->CopyBuffer(indexReadback.get(), indices, indices->GetSize());
+            cmd->End();
+
+            std::unique_ptr<Gfx::Fence> fence = GetGfxDriver()->CreateFence({.signaled = false});
+            Gfx::CommandBuffer* cmdBufs[] = {cmd.get()};
+            GetGfxDriver()->QueueSubmit(queue, cmdBufs, {}, {}, {}, fence);
+            GetGfxDriver()->WaitForFence({fence}, true, -1);
+        };
+
+        // the transforms of the visible instances in view
+        auto getVisible = [&](uint32_t group, CullView view)
+        {
+            auto command = *(Gfx::DrawIndexedIndirectCommand*)(
+                (uint8_t*)commandReadback->GetCPUVisibleAddress() + SceneInstances::GetDrawCommandOffset(view, group)
+            );
+            uint32_t* indices = (uint32_t*)indexReadback->GetCPUVisibleAddress() + command.firstInstance;
+            std::vector<uint32_t> transforms(indices, indices + command.instanceCount);
+            std::sort(transforms.begin(), transforms.end());
+            return transforms;
+        };
+
+        instances.BeginFrame();
+        instances.BeginStatic();
+        uint32_t first = instances.Allocate(4);
+        glm::mat4* transforms = instances.GetTransforms();
+        transforms[first] = visible;
+        transforms[first + 1] = glm::translate(glm::mat4(1), glm::vec3(100, 0, -5));
+        transforms[first + 2] = visible;
+        transforms[first + 3] = glm::scale(visible, glm::vec3(-1, 1, 1));
+        uint32_t frustumGroup = instances.AddCullGroup(bounds, first, 2, 36, 0, 0);
+        uint32_t coneGroup = instances.AddCullGroup(bounds, first + 2, 2, 36, 0, 0, cone);
+        instances.EndStatic(1);
+        cull();
+
+        EXPECT_EQ(getVisible(frustumGroup, CullView::Camera), std::vector<uint32_t>{first});
+        EXPECT_EQ(getVisible(coneGroup, CullView::Camera), std::vector<uint32_t>{first + 3});
+        EXPECT_TRUE(getVisible(frustumGroup, CullView::Shadow).empty());
+
+        // the static groups are kept and counted again from zero
+        instances.BeginFrame();
+        uint32_t dynamic = instances.Allocate(1);
+        instances.GetTransforms()[dynamic] = visible;
+        uint32_t dynamicGroup = instances.AddCullGroup(bounds, dynamic, 1, 36, 0, 0);
+        cull();
+
+        EXPECT_EQ(instances.GetStaticKey(), 1u);
+        EXPECT_EQ(getVisible(frustumGroup, CullView::Camera), std::vector<uint32_t>{first});
+        EXPECT_EQ(getVisible(coneGroup, CullView::Camera), std::vector<uint32_t>{first + 3});
+        EXPECT_EQ(getVisible(dynamicGroup, CullView::Camera), std::vector<uint32_t>{dynamic});
+        auto command = *(Gfx::DrawIndexedIndirectCommand*)(
+            (uint8_t*)commandReadback->GetCPUVisibleAddress() +
+            SceneInstances::GetDrawCommandOffset(CullView::Camera, frustumGroup)
+        );
+        EXPECT_EQ(command.indexCount, 36u);
+
+        // turned around, the camera sees none of them
+        viewProjection = glm::rotate(viewProjection, glm::radians(180.0f), glm::vec3(0, 1, 0));
+        instances.BeginFrame();
+        dynamic = instances.Allocate(1);
+        instances.GetTransforms()[dynamic] = visible;
+        dynamicGroup = instances.AddCullGroup(bounds, dynamic, 1, 36, 0, 0);
+        cull();
+
+        EXPECT_TRUE(getVisible(frustumGroup, CullView::Camera).empty());
+        EXPECT_TRUE(getVisible(coneGroup, CullView::Camera).empty());
+        EXPECT_TRUE(getVisible(dynamicGroup, CullView::Camera).empty());
+    }
+
+    GetGfxDriver()->WaitForIdle();
+    engine = nullptr;
+}
@@ -0,0 +1,190 @@
+#include "GfxDriver/ShaderConfig.hpp"
+#include "GfxDriver/PipelineCache.hpp"
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+using namespace Engine;
+
+// builds configs that only differ in a few states, the way material variants usually do
+static std::vector<Gfx::ShaderConfig> CreateConfigVariants(int count)
+{
+    std::vector<Gfx::ShaderConfig> configs(count);
+    for (int i = 0; i < count; ++i)
+    {
+        configs[i].cullMode = (Gfx::CullMode)(i % 3);
+        configs[i].depth.writeEnable = (i / 3) % 2;
+        configs[i].stencil.front.reference = i;
+        configs[i].color.blends.resize(1);
+        configs[i].color.blends[0].blendEnable = (i / 6) % 2;
+    }
+    return configs;
+}
+
+TEST(ShaderProgram, ConfigHash)
+{
+    auto configs = CreateConfigVariants(64);
+    Gfx::ShaderConfig copy = configs[10];
+    EXPECT_EQ(copy.GetHash(), configs[10].GetHash());
+
+    // states ignored by operator== must not change the hash
+    copy.features.push_back({"_A"});
+    copy.vertexInterleaved = !copy.vertexInterleaved;
+    EXPECT_EQ(copy.GetHash(), configs[10].GetHash());
+
+    for (int i = 0; i < configs.size(); ++i)
+    {
+        for (int j = i + 1; j < configs.size(); ++j)
+        {
+            EXPECT_NE(configs[i].GetHash(), configs[j].GetHash());
+        }
+    }
+}
+
+TEST(ShaderProgram, PipelineCacheComparesFullState)
+{
+    auto configs = CreateConfigVariants(4);
+    Gfx::PipelineCache<uint64_t, uint64_t> cache;
+    cache.Insert(configs[0], 1, 0, 10);
+    cache.Insert(configs[1], 1, 0, 11);
+    cache.Insert(configs[0], 2, 0, 20);
+    cache.Insert(configs[0], 1, 1, 30);
+
+    EXPECT_EQ(*cache.Find(configs[0], 1, 0), 10);
+    EXPECT_EQ(*cache.Find(configs[1], 1, 0), 11);
+    EXPECT_EQ(*cache.Find(configs[0], 2, 0), 20);
+    EXPECT_EQ(*cache.Find(configs[0], 1, 1), 30);
+    EXPECT_EQ(cache.Find(configs[2], 1, 0), nullptr);
+    EXPECT_EQ(cache.Find(configs[1], 2, 0), nullptr);
+
+    // a config edited in place after the pipeline was created must miss
+    Gfx::ShaderConfig edited = configs[0];
+    edited.depth.compOp = Gfx::CompareOp::Always;
+    EXPECT_EQ(cache.Find(edited, 1, 0), nullptr);
+    EXPECT_EQ(cache.Size(), 4);
+}
+
+TEST(ShaderProgram, PipelineCacheConcurrentRequests)
+{
+    auto configs = CreateConfigVariants(64);
+    Gfx::PipelineCache<uint64_t, uint64_t> cache;
+    std::atomic<uint64_t> created = 0;
+
+    std::vector<std::vector<uint64_t>> results(8);
+    std::vector<std::thread> threads;
+    for (auto& result : results)
+    {
+        threads.emplace_back(
+            [&configs, &cache, &created, &result]()
+            {
+                for (int i = 0; i < 4; ++i)
+                {
+                    for (auto& config : configs)
+                        result.push_back(cache.Request(config, 1, 0, [&created]() { return created++; }));
+                }
+            }
+        );
+    }
+    for (auto& t : threads)
+        t.join();
+
+    // every state is created once and all threads see the same pipeline for it
+    EXPECT_EQ(created, configs.size());
+    EXPECT_EQ(cache.Size(), configs.size());
+    for (auto& result : results)
+        EXPECT_EQ(result, results[0]);
+}
+
+// the index grows while another thread looks pipelines up, entries published before the growth stay visible
+TEST(ShaderProgram, PipelineCacheGrowsWhileReading)
+{
+    auto configs = CreateConfigVariants(256);
+    Gfx::PipelineCache<uint64_t, uint64_t> cache;
+    cache.Insert(configs[0], 1, 0, 0);
+
+    std::atomic<bool> done = false;
+    std::atomic<int> misses = 0;
+    std::thread reader(
+        [&]()
+        {
+            while (!done)
+            {
+                const uint64_t* pipeline = cache.Find(configs[0], 1, 0);
+                if (pipeline == nullptr || *pipeline != 0)
+                    misses++;
+            }
+        }
+    );
+    for (uint64_t i = 1; i < configs.size(); ++i)
+        cache.Insert(configs[i], 1, 0, i);
+    done = true;
+    reader.join();
+
+    EXPECT_EQ(misses, 0);
+    EXPECT_EQ(cache.Size(), configs.size());
+    for (uint64_t i = 0; i < configs.size(); ++i)
+    {
+        ASSERT_NE(cache.Find(configs[i], 1, 0), nullptr);
+        EXPECT_EQ(*cache.Find(configs[i], 1, 0), i);
+    }
+}
+
+// times the lookup RequestPipeline does on every bind against the linear scan it replaced
+TEST(ShaderProgram, PipelineLookupBenchmark)
+{
+    const int bindCount = 10000;
+    const uint64_t renderPass = 1;
+    auto configs = CreateConfigVariants(64);
+
+    struct Entry
+    {
+        Gfx::ShaderConfig config;
+        uint64_t renderPass;
+        uint32_t subpass;
+        uint64_t pipeline;
+    };
+    std::vector<Entry> linear;
+    Gfx::PipelineCache<uint64_t, uint64_t> cache;
+    for (uint64_t i = 0; i < configs.size(); ++i)
+    {
+        linear.push_back({configs[i], renderPass, 0, i});
+        cache.Insert(configs[i], renderPass, 0, i);
+    }
+
+    using Clock = std::chrono::high_resolution_clock;
+    uint64_t linearSum = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < bindCount; ++i)
+    {
+        const Gfx::ShaderConfig& config = configs[(i * 7) % configs.size()];
+        for (auto& e : linear)
+        {
+            if (e.renderPass == renderPass && e.subpass == 0 && e.config == config)
+            {
+                linearSum += e.pipeline;
+                break;
+            }
+        }
+    }
+    auto linearTime = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    uint64_t hashedSum = 0;
+    start = Clock::now();
+    for (int i = 0; i < bindCount; ++i)
+    {
+        const Gfx::ShaderConfig& config = configs[(i * 7) % configs.size()];
+        hashedSum += *cache.Find(config, renderPass, 0);
+    }
+    auto hashedTime = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    EXPECT_EQ(linearSum, hashedSum);
+    spdlog::info(
+        "{} binds over {} configs: linear scan {:.1f}us, pipeline cache {:.1f}us",
+        bindCount,
+        configs.size(),
+        linearTime,
+        hashedTime
+    );
+}
@@ -0,0 +1,187 @@
+#include "Libs/ShadowCascades.hpp"
+#include <algorithm>
+#include <cmath>
+#include <gtest/gtest.h>
+using namespace Engine;
+
+namespace
+{
+// a transform at position looking along forward, the z axis points backwards like a camera's
+glm::mat4 LookAlong(const glm::vec3& position, const glm::vec3& forward)
+{
+    glm::vec3 back = -glm::normalize(forward);
+    glm::vec3 right = glm::normalize(glm::cross(glm::vec3(0, 1, 0), back));
+    glm::vec3 up = glm::cross(back, right);
+    glm::mat4 m(1);
+    m[0] = glm::vec4(right, 0);
+    m[1] = glm::vec4(up, 0);
+    m[2] = glm::vec4(back, 0);
+    m[3] = glm::vec4(position, 1);
+    return m;
+}
+
+// only the parts of a perspective projection FitShadowCascades uses, y is flipped
+glm::mat4 Perspective(float fovy, float aspect)
+{
+    glm::mat4 m(0);
+    float tanHalfFovy = std::tan(fovy / 2);
+    m[0][0] = 1 / (aspect * tanHalfFovy);
+    m[1][1] = -1 / tanHalfFovy;
+    return m;
+}
+
+const float near = 0.1f;
+const float far = 100.0f;
+const glm::vec2 resolution = {1024, 512};
+const glm::mat4 projection = Perspective(0.8f, 16.0f / 9);
+// z is the direction the light shines
+const glm::mat4 light = LookAlong(glm::vec3(0), glm::vec3(-0.3f, 1, 0.5f));
+
+// every corner of a slice of the frustum is inside its cascade
+void ExpectSlicesCovered(const glm::mat4& camera, std::span<const ShadowCascade> cascades)
+{
+    float tanX = 1 / projection[0][0];
+    float tanY = -1 / projection[1][1];
+    float sliceNear = near;
+    for (const ShadowCascade& cascade : cascades)
+    {
+        EXPECT_GT(cascade.splitDistance, sliceNear);
+        for (float d : {sliceNear, cascade.splitDistance})
+        {
+            for (float x : {-1.0f, 1.0f})
+            {
+                for (float y : {-1.0f, 1.0f})
+                {
+                    glm::vec4 corner = camera * glm::vec4(x * d * tanX, y * d * tanY, -d, 1);
+                    glm::vec4 p = cascade.worldToShadow * corner;
+                    EXPECT_LE(std::abs(p.x), 1);
+                    EXPECT_LE(std::abs(p.y), 1);
+                    EXPECT_GE(p.z, 0);
+                    EXPECT_LE(p.z, 1);
+                }
+            }
+        }
+        sliceNear = cascade.splitDistance;
+    }
+    EXPECT_FLOAT_EQ(sliceNear, far);
+}
+} // namespace
+
+TEST(ShadowCascades, Splits)
+{
+    float uniform[4];
+    ComputeCascadeSplits(1, 101, 0, uniform);
+    EXPECT_FLOAT_EQ(uniform[0], 26);
+    EXPECT_FLOAT_EQ(uniform[1], 51);
+    EXPECT_FLOAT_EQ(uniform[3], 101);
+
+    float logarithmic[4];
+    ComputeCascadeSplits(1, 10000, 1, logarithmic);
+    EXPECT_NEAR(logarithmic[0], 10, 1e-3f);
+    EXPECT_NEAR(logarithmic[1], 100, 1e-2f);
+    EXPECT_FLOAT_EQ(logarithmic[3], 10000);
+}
+
+// every corner of a slice of the frustum is inside its cascade
+TEST(ShadowCascades, CoverSlices)
+{
+    glm::mat4 camera = LookAlong(glm::vec3(3, 5, -7), glm::vec3(1, -0.2f, 0.4f));
+    ShadowCascade cascades[4];
+    FitShadowCascades(camera, projection, near, far, 0.7f, light, resolution, 50, cascades);
+    ExpectSlicesCovered(camera, cascades);
+}
+
+// cascades keep their size when the camera rotates and only move in whole texels when it moves
+TEST(ShadowCascades, Stable)
+{
+    auto fit = [](const glm::mat4& camera, std::span<ShadowCascade> cascades)
+    {
+        FitShadowCascades(camera, projection, near, far, 0.7f, light, resolution, 50, cascades);
+    };
+    ShadowCascade reference[4];
+    fit(LookAlong(glm::vec3(0), glm::vec3(0, 0, -1)), reference);
+
+    for (int i = 0; i < 20; ++i)
+    {
+        glm::vec3 position = glm::vec3(i * 0.37f, i * -0.11f, i * 0.23f);
+        glm::vec3 forward = glm::vec3(std::sin(i * 0.5f), 0.1f * i - 1, std::cos(i * 0.5f));
+        ShadowCascade cascades[4];
+        fit(LookAlong(position, forward), cascades);
+
+        for (int c = 0; c < 4; ++c)
+        {
+            const glm::mat4& m = cascades[c].worldToShadow;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                EXPECT_FLOAT_EQ(m[axis][0], reference[c].worldToShadow[axis][0]);
+                EXPECT_FLOAT_EQ(m[axis][1], reference[c].worldToShadow[axis][1]);
+            }
+
+            // the offsets in texels of the shadow map
+            float texelsX = m[3][0] * resolution.x / 2;
+            float texelsY = m[3][1] * resolution.y / 2;
+            EXPECT_NEAR(texelsX, std::round(texelsX), 1e-2f);
+            EXPECT_NEAR(texelsY, std::round(texelsY), 1e-2f);
+        }
+    }
+}
+
+// with a cache margin the cascades stay where they are while the camera moves a little and still cover their slices
+TEST(ShadowCascades, CacheMargin)
+{
+    auto fit = [](const glm::mat4& camera, const glm::mat4& light, std::span<ShadowCascade> cascades)
+    {
+        FitShadowCascades(camera, projection, near, far, 0.7f, light, resolution, 50, cascades, 16);
+    };
+    ShadowCascade cascades[4];
+    glm::mat4 camera = LookAlong(glm::vec3(3, 5, -7), glm::vec3(1, -0.2f, 0.4f));
+    fit(camera, light, cascades);
+    ExpectSlicesCovered(camera, cascades);
+    ShadowCascade first[4];
+    std::copy(cascades, cascades + 4, first);
+
+    // less than a texel of the first cascade
+    camera = LookAlong(glm::vec3(3.001f, 5, -7), glm::vec3(1, -0.2f, 0.4f));
+    fit(camera, light, cascades);
+    ExpectSlicesCovered(camera, cascades);
+    for (int c = 0; c < 4; ++c)
+        EXPECT_EQ(cascades[c].worldToShadow, first[c].worldToShadow);
+
+    // the first cascade is moved, the last one is large enough to keep its matrix
+    camera = LookAlong(glm::vec3(5, 5, -7), glm::vec3(1, -0.2f, 0.4f));
+    fit(camera, light, cascades);
+    ExpectSlicesCovered(camera, cascades);
+    EXPECT_NE(cascades[0].worldToShadow, first[0].worldToShadow);
+    EXPECT_EQ(cascades[3].worldToShadow, first[3].worldToShadow);
+
+    // another light direction fits every cascade again
+    fit(camera, LookAlong(glm::vec3(0), glm::vec3(-0.3f, 1, 0.6f)), cascades);
+    ExpectSlicesCovered(camera, cascades);
+    for (int c = 0; c < 4; ++c)
+        EXPECT_NE(cascades[c].worldToShadow, first[c].worldToShadow);
+}
+
+// a bit per cascade that has to be drawn again
+TEST(ShadowCascades, CacheDirtyMask)
+{
+    ShadowCascade cascades[4];
+    for (int c = 0; c < 4; ++c)
+        cascades[c] = {glm::mat4(c + 1.0f), 10.0f * (c + 1)};
+
+    ShadowCascadeCache cache;
+    EXPECT_EQ(cache.Update(cascades, 1), 0b1111);
+    EXPECT_EQ(cache.Update(cascades, 1), 0);
+
+    cascades[2].worldToShadow[3][0] += 0.5f;
+    EXPECT_EQ(cache.Update(cascades, 1), 0b0100);
+    cascades[0].worldToShadow[3][1] += 0.5f;
+    cascades[3].worldToShadow[3][1] += 0.5f;
+    EXPECT_EQ(cache.Update(cascades, 1), 0b1001);
+
+    // the casters, the number of cascades and a lost cache
+    EXPECT_EQ(cache.Update(cascades, 2), 0b1111);
+    EXPECT_EQ(cache.Update(std::span<const ShadowCascade>(cascades, 2), 2), 0b0011);
+    EXPECT_EQ(cache.Update(std::span<const ShadowCascade>(cascades, 2), 2), 0);
+    cache.Invalidate();
+    EXPECT_EQ(cache.Update(std::span<const ShadowCascade>(cascades, 2), 2), 0b0011);
+}